@@ -193,6 +193,7 @@ t_stat udp_create (DEVICE *pdtr, const char *premote, int32 *plink);
 t_stat udp_release (DEVICE *dptr, int32 link);
 t_stat udp_send (DEVICE *pdtr, int32 link, uint16 *pdata, uint16 count);
 t_stat udp_set_link_loopback (DEVICE *dptr, int32 link, t_bool enable_loopback);
+t_stat udp_show_stats (FILE *st, DEVICE *dptr, int32 link);
 int32 udp_receive (DEVICE *dptr, int32 link, uint16 *pdata, uint16 maxbufg);
 
 #endif  // #ifndef _H316_IMP_H_
@@ -191,6 +191,7 @@ t_stat mi_attach (UNIT *uptr, CONST char *cptr);
 t_stat mi_detach (UNIT *uptr);
 t_stat mi_set_loopback (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
 t_stat mi_show_loopback (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
+t_stat mi_show_stats (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 
 
 
@@ -261,6 +262,7 @@ REG mi5_reg[] = MI_REG(5);
   { MTAB_XTD|MTAB_VDV, 1, NULL,            "NOLOOPINTERFACE", &mi_set_loopback, NULL,              NULL }, \
   { MTAB_XTD|MTAB_VDV, 2, NULL,            "LOOPLINE",        &mi_set_loopback, NULL,              NULL }, \
   { MTAB_XTD|MTAB_VDV, 3, NULL,            "NOLOOPLINE",      &mi_set_loopback, NULL,              NULL }, \
+  { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "STATISTICS", NULL, NULL, &mi_show_stats, NULL },                       \
   { 0 }                                                                                                    \
 }
 MTAB mi1_mod[] = MI_MOD(1), mi2_mod[] = MI_MOD(2);
@@ -763,4 +765,15 @@ t_stat mi_show_loopback (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
   return SCPE_OK;
 }
 
+t_stat mi_show_stats (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+  //   This routine handles "SHOW MIn STATISTICS", which shows the packet
+  // counts for the UDP link this modem is attached to.
+  uint16 line = uptr->mline;
+
+  if (PMIDB(line)->link == NOLINK)
+    return SCPE_UNATT;
+  return udp_show_stats (st, PDEVICE(line), PMIDB(line)->link);
+}
+
 #endif // #ifdef VM_IMPTIP from the very top
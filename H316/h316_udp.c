@@ -350,6 +350,18 @@ t_stat udp_set_link_loopback (DEVICE *dptr, int32 link, t_bool enable_loopback)
   return tmxr_set_line_loopback (&udp_lines[link], enable_loopback);
 }
 
+t_stat udp_show_stats (FILE *st, DEVICE *dptr, int32 link)
+{
+  // Show the traffic statistics, including the number of packets received
+  // per system call, for this link...
+  if ((link < 0) || (link >= MAXLINKS)) return SCPE_IERR;
+  if (!udp_links[link].used) return SCPE_IERR;
+  if (dptr != udp_links[link].dptr) return SCPE_IERR;
+
+  tmxr_fstats (st, &udp_lines[link], -1);
+  return SCPE_OK;
+}
+
 int32 udp_receive_packet (int32 link, UDP_PACKET *ppkt)
 {
   //   This routine will do the hard part of receiving a UDP packet.  If it's
@@ -1181,6 +1181,8 @@ for (unit = 0; unit < cvptr->device->numunits; unit++) {    /* look for a write
                         }
                     };
 
+                sim_tape_file_moved (uptr);                 /* the file was positioned outside the tape library */
+
                 dpprintf (cvptr->device, TL_DEB_INCO,
                           "Unit %u controller clear stopped tape motion at position %" T_ADDR_FMT "u\n",
                           unit, uptr->pos);
@@ -98,6 +98,12 @@ binloader (FILE *fd, const char *file, int loadpt)
    int loadaddr = LOADADDR;
    int curraddr = LOADADDR;
    char inbuf[OBJRECLEN+2];
+   MEMFILE img;
+   t_stat r;
+
+   r = sim_load_image (fd, &img);           /* Read the whole deck */
+   if (r != SCPE_OK)
+      return r;
 
 #ifdef DEBUGLOADER
    lfd = fopen ("load.log", "w");
@@ -110,7 +116,7 @@ binloader (FILE *fd, const char *file, int loadpt)
       curraddr = loadpt;
    }
 
-   while (fgets (inbuf, sizeof(inbuf), fd))
+   while (sim_load_image_gets (inbuf, sizeof(inbuf), &img))
    {
       char *op = inbuf;
       int i;
@@ -208,6 +214,7 @@ GOSTART:
 #ifdef DEBUGLOADER
    fclose (lfd);
 #endif
+   sim_load_image_free (&img);
 
    return SCPE_OK;
 }
@@ -217,6 +217,8 @@ t_stat cpu_show_serial (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 
 d10 adjsp (d10 val, a10 ea);
 void ibp (a10 ea, int32 pflgs);
+d10 ildb (a10 ea, int32 pflgs);
+void idpb (d10 val, a10 ea, int32 pflgs);
 d10 ldb (a10 ea, int32 pflgs);
 void dpb (d10 val, a10 ea, int32 pflgs);
 void adjbp (int32 ac, a10 ea, int32 pflgs);
@@ -971,9 +973,9 @@ case 0132:  AC(ac) = fsc (AC(ac), ea); break;           /* FSC */
 case 0133:  if (!ac)                                    /* IBP */
                 ibp (ea, pflgs);
             else adjbp (ac, ea, pflgs); break;
-case 0134:  CIBP; LDB; CLRF (F_FPD); break;             /* ILBP */
+case 0134:  AC(ac) = ildb (ea, pflgs); CLRF (F_FPD); break; /* ILBP */
 case 0135:  LDB; break;                                 /* LDB */
-case 0136:  CIBP; DPB; CLRF (F_FPD); break;             /* IDBP */
+case 0136:  idpb (AC(ac), ea, pflgs); CLRF (F_FPD); break; /* IDBP */
 case 0137:  DPB; break;                                 /* DPB */
 case 0140:  RD; AC(ac) = FAD (mb); break;               /* FAD */
 /* case 0141:   MUUO                                  *//* FADL */
@@ -1964,6 +1966,76 @@ Write (ba, wd & DMASK, MM_BSTK);
 return;
 }
 
+/* Increment and load byte, increment and deposit byte
+
+   When the pointer is in memory and has no index or indirect, the pointer
+   word is translated once for both its read and its update, and the byte
+   word is translated once for IDPB's read and write.  F_FPD is set as soon
+   as the incremented pointer is stored, so a page fail on the byte word
+   restarts without a second increment, as with CIBP.  All other cases, and
+   any reference that would page fail, go through ibp/ldb/dpb.
+*/
+
+d10 ildb (a10 ea, int32 pflgs)
+{
+int32 p, s, bpa, pa;
+d10 bp;
+
+if (TSTF (F_FPD) ||                                     /* restart or */
+    ((bpa = AccPA (ea, MM_OPND, PTF_WR)) < 0) ||        /* ptr not in mem */
+    TST_IND (M[bpa]) || GET_XR (M[bpa])) {              /* or not simple? */
+    CIBP;
+    return ldb (ea, pflgs);
+    }
+bp = M[bpa];                                            /* get byte ptr */
+p = GET_P (bp);                                         /* get P and S */
+s = GET_S (bp);
+p = p - s;                                              /* adv P */
+if (p < 0) {                                            /* end of word? */
+    bp = (bp & LMASK) | (INCR (bp));                    /* incr addr */
+    p = (36 - s) & 077;                                 /* reset P */
+    }
+bp = PUT_P (bp, p);                                     /* store new P */
+M[bpa] = bp;                                            /* store byte ptr */
+SETF (F_FPD);
+if ((pa = AccPA (GET_ADDR (bp), MM_BSTK, PTF_RD)) < 0)  /* byte word? */
+    return ldb (ea, pflgs);                             /* fail the slow way */
+return (M[pa] >> p) & bytemask[s];                      /* align, mask byte */
+}
+
+void idpb (d10 val, a10 ea, int32 pflgs)
+{
+int32 p, s, bpa, pa;
+d10 bp, mask;
+
+if (TSTF (F_FPD) ||                                     /* restart or */
+    ((bpa = AccPA (ea, MM_OPND, PTF_WR)) < 0) ||        /* ptr not in mem */
+    TST_IND (M[bpa]) || GET_XR (M[bpa])) {              /* or not simple? */
+    CIBP;
+    dpb (val, ea, pflgs);
+    return;
+    }
+bp = M[bpa];                                            /* get byte ptr */
+p = GET_P (bp);                                         /* get P and S */
+s = GET_S (bp);
+p = p - s;                                              /* adv P */
+if (p < 0) {                                            /* end of word? */
+    bp = (bp & LMASK) | (INCR (bp));                    /* incr addr */
+    p = (36 - s) & 077;                                 /* reset P */
+    }
+bp = PUT_P (bp, p);                                     /* store new P */
+M[bpa] = bp;                                            /* store byte ptr */
+SETF (F_FPD);
+if ((pa = AccPA (GET_ADDR (bp), MM_BSTK, PTF_WR)) < 0) {/* byte word? */
+    dpb (val, ea, pflgs);                               /* fail the slow way */
+    return;
+    }
+mask = bytemask[s] << p;                                /* shift mask, val */
+val = val << p;
+M[pa] = ((M[pa] & ~mask) | (val & mask)) & DMASK;       /* insert byte */
+return;
+}
+
 /* Adjust byte pointer - checked against KS10 ucode 
    The KS10 divide checks if the bytes per word = 0, which is a simpler
    formulation of the processor reference manual check.
@@ -2004,6 +2076,13 @@ return;
    to set the AC properly for restart.  Lacking this mechanism,
    the simulator must test references in advance.
    The clocking test guarantees forward progress under single step.
+
+   When both the source and destination words are accessible memory,
+   the transfer runs to the nearer page boundary in a host loop, no
+   further than the clock allows.  The loop copies upward a word at a
+   time, so overlapping moves (BLT AC,AC+1 page zeroing) propagate as
+   they do one reference at a time.  The clock is charged one tick per
+   word, as in the word at a time loop.
 */
 
 void blt (int32 ac, a10 ea, int32 pflgs)
@@ -2012,7 +2091,7 @@ a10 srca = (a10) LRZ (AC(ac));
 a10 dsta = (a10) RRZ (AC(ac));
 a10 lnt = ea - dsta + 1;
 d10 srcv;
-int32 flg, t;
+int32 flg, t, n, i, spa, dpa;
 
 AC(ac) = XWD (srca + lnt, dsta + lnt);
 for (flg = 0; dsta <= ea; flg++) {                      /* loop */
@@ -2020,6 +2099,28 @@ for (flg = 0; dsta <= ea; flg++) {                      /* loop */
         AC(ac) = XWD (srca, dsta);                      /* AC for intr */
         ABORT (t);
         }
+    if (((spa = AccPA (srca & AMASK, MM_BSTK, PTF_RD)) >= 0) &&
+        ((dpa = AccPA (dsta & AMASK, MM_OPND, PTF_WR)) >= 0)) {
+        n = ea - dsta + 1;                              /* words left */
+        if (n > (PAG_SIZE - PAG_GETOFF (srca)))         /* to src page end */
+            n = PAG_SIZE - PAG_GETOFF (srca);
+        if (n > (PAG_SIZE - PAG_GETOFF (dsta)))         /* to dst page end */
+            n = PAG_SIZE - PAG_GETOFF (dsta);
+        if (n > (sim_interval + 1))                     /* to next event */
+            n = (sim_interval > 0)? sim_interval + 1: 1;
+        if (MEM_ADDR_NXM (spa + n - 1) || MEM_ADDR_NXM (dpa + n - 1))
+            n = 1;
+        if (dpa == (spa + 1)) {                         /* zeroing idiom? */
+            for (i = 0, srcv = M[spa]; i < n; i++)
+                M[dpa + i] = srcv;
+            }
+        else for (i = 0; i < n; i++)                    /* upward copy */
+            M[dpa + i] = M[spa + i];
+        sim_interval = sim_interval - (n - 1);          /* charge clock */
+        srca = srca + n;                                /* incr addr */
+        dsta = dsta + n;
+        continue;
+        }
     if (AccViol (srca & AMASK, MM_BSTK, PTF_RD)) {      /* src access viol? */
         AC(ac) = XWD (srca, dsta);                      /* AC for page fail */
         Read (srca & AMASK, MM_BSTK);                   /* force trap */
@@ -781,6 +781,7 @@ extern void Write (a10 ea, d10 val, int32 prv);         /* write */
 extern void WriteE (a10 ea, d10 val);                   /* write, exec */
 extern void WriteP (a10 ea, d10 val);                   /* write, physical */
 extern t_bool AccViol (a10 ea, int32 prv, int32 mode);  /* access check */
+extern int32 AccPA (a10 ea, int32 prv, int32 mode);     /* access, phys addr */
 
 t_stat set_addr (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
 t_stat set_addr_flt (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
@@ -151,6 +151,7 @@ DEVICE pag_dev = {
    WriteE - write exec
    WriteP - write physical
    AccChk - test accessibility of virtual address
+   AccPA - translate accessible virtual address for direct reference
 */
 
 d10 Read (a10 ea, int32 prv)
@@ -282,6 +283,32 @@ if (xpte)                                               /* accessible */
 return TRUE;                                            /* not accessible */
 }
 
+/* Translate for direct memory reference
+
+   Used by the BLT and byte instruction fast paths.  Returns the physical
+   address of a memory (not AC) reference that would succeed, or -1.  Like
+   AccViol, a failed translation does not page fail; the caller redoes the
+   reference through Read/Write to get the page fail (or NXM) right.
+*/
+
+int32 AccPA (a10 ea, int32 prv, int32 mode)
+{
+int32 pa, vpn, xpte;
+
+if (ea < AC_NUM)                                        /* AC request */
+    return -1;
+vpn = PAG_GETVPN (ea);                                  /* get page num */
+xpte = prv? ptbl_prv[vpn]: ptbl_cur[vpn];               /* get exp pte */
+if ((xpte == 0) || ((mode & PTF_WR) && (xpte > 0)))     /* not accessible? */
+    xpte = ptbl_fill (ea, prv? ptbl_prv: ptbl_cur, mode | PTF_MAP);
+if (xpte == 0)                                          /* not accessible */
+    return -1;
+pa = PAG_XPTEPA (xpte, ea);                             /* calc phys addr */
+if (MEM_ADDR_NXM (pa))                                  /* nxm? */
+    return -1;
+return pa;
+}
+
 void pag_nxm (a10 pa, int32 phys, int32 trap)
 {
 apr_flg = apr_flg | APRF_NXM;                           /* set APR flag */
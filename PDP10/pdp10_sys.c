@@ -167,14 +167,14 @@ const char *sim_stop_messages[] = {
    Here it is simply skipped.
 */
 
-d10 getrimw (FILE *fileref)
+d10 getrimw (MEMFILE *img)
 {
 int32 i, tmp;
 d10 word;
 
 word = 0;
 for (i = 0; i < 6;) {
-    if ((tmp = getc (fileref)) == EOF)
+    if ((tmp = sim_load_image_getc (img)) == EOF)
         return -1;
     if (tmp & 0200) {
         word = (word << 6) | ((d10) tmp & 077);
@@ -184,7 +184,7 @@ for (i = 0; i < 6;) {
 return word;
 }
 
-t_stat load_rim (FILE *fileref)
+t_stat load_rim (MEMFILE *img)
 {
 d10 count, cksm, data;
 a10 pa;
@@ -192,7 +192,7 @@ int32 op, i, ldrc;
 t_bool its_rim;
 extern d10 rot (d10 val, a10 ea);
 
-data = getrimw (fileref);                               /* get first word */
+data = getrimw (img);                               /* get first word */
 if ((data < 0) || ((data & AMASK) != 0))                /* error? SA != 0? */
     return SCPE_FMT;
 ldrc = 01000000 - ((int32) (LRZ (data)));               /* get loader count */
@@ -203,18 +203,18 @@ else if (ldrc == 017)                                   /* 17? ITS RIM */
 else return SCPE_FMT;                                   /* unknown */
 
 for (i = 0; i < ldrc; i++) {                            /* skip the loader */
-    data = getrimw (fileref);
+    data = getrimw (img);
     if (data < 0)
         return SCPE_FMT;
     }
 
 for ( ;; ) {                                            /* loop until JRST */
-    count = cksm = getrimw (fileref);                   /* get header */
+    count = cksm = getrimw (img);                   /* get header */
     if (count < 0)                                      /* read err? */
         return SCPE_FMT;
     if (TSTS (count)) {                                 /* hdr = IOWD? */
         for ( ; TSTS (count); count = AOB (count)) {
-            data = getrimw (fileref);                   /* get data wd */
+            data = getrimw (img);                   /* get data wd */
             if (data < 0)
                 return SCPE_FMT;
             if (its_rim) {                              /* ITS RIM? */
@@ -227,7 +227,7 @@ for ( ;; ) {                                            /* loop until JRST */
                 }
             M[pa] = data;
             }                                           /* end for */
-        data = getrimw (fileref);                       /* get cksm */
+        data = getrimw (img);                       /* get cksm */
         if (data < 0)
             return SCPE_FMT;
         if (cksm != data)                               /* test cksm */
@@ -257,19 +257,19 @@ return SCPE_OK;
         JRST start
 */
 
-t_stat load_sav (FILE *fileref)
+t_stat load_sav (MEMFILE *img)
 {
 d10 count, data;
 a10 pa;
 int32 wc, op;
 
 for ( ;; ) {                                            /* loop */
-    wc = fxread (&count, sizeof (d10), 1, fileref);     /* read IOWD */
+    wc = sim_load_image_read (&count, sizeof (d10), 1, img);/* read IOWD */
     if (wc == 0)                                        /* done? */
         return SCPE_OK;
     if (TSTS (count)) {                                 /* IOWD? */
         for ( ; TSTS (count); count = AOB (count)) {
-            wc = fxread (&data, sizeof (d10), 1, fileref);
+            wc = sim_load_image_read (&data, sizeof (d10), 1, img);
             if (wc == 0)
                 return SCPE_FMT;
             pa = ((a10) count + 1) & AMASK;             /* store data */
@@ -313,7 +313,7 @@ return SCPE_OK;
 
 #define DIRSIZ  (2 * PAG_SIZE)
 
-t_stat load_exe (FILE *fileref)
+t_stat load_exe (MEMFILE *img)
 {
 d10 data, dirbuf[DIRSIZ], pagbuf[PAG_SIZE], entbuf[2];
 int32 ndir, entvec, i, j, k, cont, bsz, bty, rpt, wc;
@@ -323,7 +323,7 @@ a10 ma;
 ndir = entvec = 0;                                      /* no dir, entvec */
 cont = 1;
 do {
-    wc = fxread (&data, sizeof (d10), 1, fileref);      /* read blk hdr */
+    wc = sim_load_image_read (&data, sizeof (d10), 1, img);/* read blk hdr */
     if (wc == 0)                                        /* error? */
         return SCPE_FMT;
     bsz = (int32) ((data & RMASK) - 1);                 /* get count */
@@ -335,19 +335,21 @@ do {
     case EXE_DIR:                                       /* directory */
         if (ndir)                                       /* got one */
             return SCPE_FMT;
-        ndir = fxread (dirbuf, sizeof (d10), bsz, fileref);
+        if (bsz > DIRSIZ)                               /* too big? */
+            return SCPE_FMT;
+        ndir = sim_load_image_read (dirbuf, sizeof (d10), bsz, img);
         if (ndir < bsz)                                 /* error */
             return SCPE_FMT;
         break;
 
     case EXE_PDV:                                       /* ??? */
-        fseek (fileref, bsz * sizeof (d10), SEEK_CUR);
+        img->pos += bsz * sizeof (d10);
         break;
 
     case EXE_VEC:                                       /* entry vec */
         if (bsz != 2)                                   /* must be 2 wds */
             return SCPE_FMT;
-        entvec = fxread (entbuf, sizeof (d10), bsz, fileref);
+        entvec = sim_load_image_read (entbuf, sizeof (d10), bsz, img);
         if (entvec < 2)                                 /* error? */
             return SCPE_FMT;
         cont = 0;                                       /* stop */
@@ -370,8 +372,8 @@ for (i = 0; i < ndir; i = i + 2) {                      /* loop thru dir */
     rpt = (int32) ((dirbuf[i + 1] >> 27) + 1);          /* repeat count */
     for (j = 0; j < rpt; j++, mpage++) {                /* loop thru rpts */
         if (fpage) {                                    /* file pages? */
-            fseek (fileref, (fpage << PAG_V_PN) * sizeof (d10), SEEK_SET);
-            wc = fxread (pagbuf, sizeof (d10), PAG_SIZE, fileref);
+            img->pos = (fpage << PAG_V_PN) * sizeof (d10);
+            wc = sim_load_image_read (pagbuf, sizeof (d10), PAG_SIZE, img);
             if (wc < PAG_SIZE)
                 return SCPE_FMT;
             fpage++;
@@ -389,12 +391,18 @@ if (entvec && entbuf[1])
 return SCPE_OK;
 }
 
-/* Master loader */
+/* Master loader
+
+   The load file is read into memory once; the format loaders decode
+   it from there.
+*/
 
 t_stat sim_load (FILE *fileref, CONST char *cptr, CONST char *fnam, int flag)
 {
 d10 data;
 int32 wc, fmt;
+MEMFILE img;
+t_stat r;
 
 fmt = 0;                                                /* no fmt */
 if (sim_switches & SWMASK ('R'))                        /* -r? */
@@ -409,10 +417,15 @@ else if (match_ext (fnam, "SAV"))                       /* .SAV? */
     fmt = FMT_S;
 else if (match_ext (fnam, "EXE"))                       /* .EXE? */
     fmt = FMT_E;
-else {
-    wc = fxread (&data, sizeof (d10), 1, fileref);      /* read hdr */
-    if (wc == 0)                                        /* error? */
+r = sim_load_image (fileref, &img);                     /* read file */
+if (r != SCPE_OK)
+    return r;
+if (fmt == 0) {
+    wc = sim_load_image_read (&data, sizeof (d10), 1, &img);/* read hdr */
+    if (wc == 0) {                                      /* error? */
+        sim_load_image_free (&img);
         return SCPE_FMT;
+        }
     if (LRZ (data) == EXE_DIR)                          /* EXE magic? */
         fmt = FMT_E;
     else if (TSTS (data)) {                             /* SAV/RIM magic? */
@@ -420,23 +433,31 @@ else {
            fmt = FMT_S;
         else fmt = FMT_R;                               /* RIM has SA == 0 */
         }
-    fseek (fileref, 0, SEEK_SET);                       /* rewind */
+    img.pos = 0;                                        /* rewind */
     }
 
 switch (fmt) {                                          /* case fmt */
 
     case FMT_R:                                         /* RIM */
-        return load_rim (fileref);
+        r = load_rim (&img);
+        break;
 
     case FMT_S:                                         /* SAV */
-        return load_sav (fileref);
+        r = load_sav (&img);
+        break;
 
     case FMT_E:                                         /* EXE */
-        return load_exe (fileref);
+        r = load_exe (&img);
+        break;
+
+    default:
+        sim_printf ("Can't determine load file format\n");
+        r = SCPE_FMT;
+        break;
         }
 
-sim_printf ("Can't determine load file format\n");
-return SCPE_FMT;
+sim_load_image_free (&img);
+return r;
 }
 
 /* Symbol tables */
@@ -245,14 +245,50 @@
 #define JMP_PC(x)       PCQ_ENTRY; PC = (x)
 #define BRANCH_F(x)     PCQ_ENTRY; PC = (PC + (((x) + (x)) & 0377)) & 0177777
 #define BRANCH_B(x)     PCQ_ENTRY; PC = (PC + (((x) + (x)) | 0177400)) & 0177777
+#define BRANCH_X(x)     PCQ_ENTRY; PC = (PC + (((((x) & 0377) ^ 0200) - 0200) * 2)) & 0177777
 #define UNIT_V_MSIZE    (UNIT_V_UF + 0)                 /* dummy */
+#define UNIT_V_NODT     (UNIT_V_UF + 1)                 /* no predecode */
 #define UNIT_MSIZE      (1u << UNIT_V_MSIZE)
+#define UNIT_NODT       (1u << UNIT_V_NODT)
 
 #define HIST_MIN        64
 #define HIST_MAX        (1u << 18)
 #define HIST_VLD        1                               /* make PC odd */
 #define HIST_ILNT       4                               /* max inst length */
 
+/* Predecoded dispatch classes */
+
+#define DT_NONE         0                               /* general decode */
+#define DT_MOV_RR       1                               /* MOV R,R */
+#define DT_CMP_RR       2                               /* CMP R,R */
+#define DT_BIT_RR       3                               /* BIT R,R */
+#define DT_BIC_RR       4                               /* BIC R,R */
+#define DT_BIS_RR       5                               /* BIS R,R */
+#define DT_ADD_RR       6                               /* ADD R,R */
+#define DT_SUB_RR       7                               /* SUB R,R */
+#define DT_MOVB_RR      8                               /* MOVB R,R */
+#define DT_XOR_RR       9                               /* XOR R,R */
+#define DT_CLR_R        10                              /* CLR R */
+#define DT_INC_R        11                              /* INC R */
+#define DT_DEC_R        12                              /* DEC R */
+#define DT_TST_R        13                              /* TST R */
+#define DT_SOB          14                              /* SOB */
+#define DT_BR           15                              /* branches */
+#define DT_BNE          16
+#define DT_BEQ          17
+#define DT_BGE          18
+#define DT_BLT          19
+#define DT_BGT          20
+#define DT_BLE          21
+#define DT_BPL          22
+#define DT_BMI          23
+#define DT_BHI          24
+#define DT_BLOS         25
+#define DT_BVC          26
+#define DT_BVS          27
+#define DT_BCC          28
+#define DT_BCS          29
+
 typedef struct {
     uint16              pc;
     uint16              psw;
@@ -315,6 +351,9 @@ int16 reg_mods;                                         /* reg deltas */
 int32 last_pa;                                          /* pa from ReadMW/ReadMB */
 int32 saved_sim_interval;                               /* saved at inst start */
 t_stat reason;                                          /* stop reason */
+uint8 *cpu_dtab = NULL;                                 /* predecode table */
+uint32 cpu_dtab_type = 0;                               /* built for type */
+uint32 cpu_dtab_opt = 0;                                /* built for options */
 
 extern int32 CPUERR, MAINT;
 extern CPUTAB cpu_tab[];
@@ -355,10 +394,13 @@ void set_stack_trap (int32 adr);
 int32 get_PSW (void);
 void put_PSW (int32 val, t_bool prot);
 void put_PIRQ (int32 val);
+uint8 *cpu_build_dtab (void);
 
 extern void fp11 (int32 IR);
 extern t_stat cis11 (int32 IR);
 extern t_stat fis11 (int32 IR);
+extern t_stat fp11_set_host (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+extern t_stat fp11_show_host (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 extern t_stat build_dib_tab (void);
 extern t_stat show_iospace (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 extern t_stat set_autocon (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
@@ -659,8 +701,18 @@ MTAB cpu_mod[] = {
 #endif
     { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IOSPACE", NULL,
       NULL, &show_iospace },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IOSTATS", NULL,
+      NULL, &show_iostats, NULL, "Display I/O page access counts" },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "IOSTATS",
+      &set_iostats, NULL, NULL, "Enable (or restart) I/O page access counts" },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIOSTATS",
+      &set_iostats, NULL, NULL, "Disable I/O page access counts" },
     { MTAB_XTD|MTAB_VDV, 0, "IDLE", "IDLE", &sim_set_idle, &sim_show_idle },
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE", &sim_clr_idle, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_VALR, 0, "FPHOST", "FPHOST",
+      &fp11_set_host, &fp11_show_host, NULL, "FP11 host fast path: FPHOST=ON|OFF|CHECK{;n}" },
+    { UNIT_NODT, 0, NULL, "FASTDISPATCH", NULL, NULL, NULL, "Enable predecoded instruction dispatch" },
+    { UNIT_NODT, UNIT_NODT, "no fast dispatch", "NOFASTDISPATCH", NULL, NULL, NULL, "Disable predecoded instruction dispatch" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "HISTORY", "HISTORY",
       &cpu_set_hist, &cpu_show_hist },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
@@ -699,6 +751,7 @@ t_stat sim_instr (void)
 int abortval, i;
 volatile int32 trapea;                                  /* used by setjmp */
 InstHistory *hst_ent = NULL;
+uint8 *dtab;
 
 sim_vm_pc_value = &pdp11_pc_value;
 
@@ -718,6 +771,9 @@ if (MEMSIZE >= (cpu_tab[cpu_model].maxm - IOPAGESIZE))  /* mem size >= max - io
     MEMSIZE = cpu_tab[cpu_model].maxm - IOPAGESIZE;     /* max - io page */
 cpu_type = 1u << cpu_model;                             /* reset type mask */
 cpu_bme = (MMR3 & MMR3_BME) && (cpu_opt & OPT_UBM);     /* map enabled? */
+if ((cpu_unit.flags & UNIT_NODT) || hst_lnt)            /* predecode off? */
+    dtab = NULL;
+else dtab = cpu_build_dtab ();                          /* build, chk dtab */
 PC = saved_PC;
 put_PSW (PSW, 0);                                       /* set PSW, call calc_xs */
 for (i = 0; i < 6; i++)
@@ -977,6 +1033,230 @@ while (reason == 0)  {
             hst_p = 0;
         }
     PC = (PC + 2) & 0177777;                            /* incr PC, mod 65k */
+
+/* Predecoded dispatch
+
+   Register mode operates and branches are looked up by the full
+   instruction word in the table built by cpu_build_dtab.  Model
+   dependencies have been resolved when the table was built, so each
+   case only performs the operation.  Anything else, including all
+   instructions that reference memory through an address specifier,
+   falls through to the general decoder.  History recording always
+   uses the general decoder.
+*/
+
+    if (dtab != NULL) {
+        switch (dtab[IR]) {
+
+        case DT_MOV_RR:                                 /* MOV R,R */
+            dst = R[srcspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            R[dstspec] = dst;
+            continue;
+
+        case DT_CMP_RR:                                 /* CMP R,R */
+            src = R[srcspec];
+            src2 = R[dstspec];
+            dst = (src - src2) & 0177777;
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = GET_SIGN_W ((src ^ src2) & (~src2 ^ dst));
+            C = (src < src2);
+            continue;
+
+        case DT_BIT_RR:                                 /* BIT R,R */
+            dst = R[dstspec] & R[srcspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            continue;
+
+        case DT_BIC_RR:                                 /* BIC R,R */
+            dst = R[dstspec] & ~R[srcspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            R[dstspec] = dst;
+            continue;
+
+        case DT_BIS_RR:                                 /* BIS R,R */
+            dst = R[dstspec] | R[srcspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            R[dstspec] = dst;
+            continue;
+
+        case DT_ADD_RR:                                 /* ADD R,R */
+            src = R[srcspec];
+            src2 = R[dstspec];
+            dst = (src2 + src) & 0177777;
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = GET_SIGN_W ((~src ^ src2) & (src ^ dst));
+            C = (dst < src);
+            R[dstspec] = dst;
+            continue;
+
+        case DT_SUB_RR:                                 /* SUB R,R */
+            src = R[srcspec];
+            src2 = R[dstspec];
+            dst = (src2 - src) & 0177777;
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = GET_SIGN_W ((src ^ src2) & (~src ^ dst));
+            C = (src2 < src);
+            R[dstspec] = dst;
+            continue;
+
+        case DT_MOVB_RR:                                /* MOVB R,R */
+            dst = R[srcspec] & 0377;
+            N = GET_SIGN_B (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            R[dstspec] = (dst & 0200)? 0177400 | dst: dst;
+            continue;
+
+        case DT_XOR_RR:                                 /* XOR R,R */
+            dst = R[srcspec & 07] ^ R[dstspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = 0;
+            R[dstspec] = dst;
+            continue;
+
+        case DT_CLR_R:                                  /* CLR R */
+            N = V = C = 0;
+            Z = 1;
+            R[dstspec] = 0;
+            continue;
+
+        case DT_INC_R:                                  /* INC R */
+            dst = (R[dstspec] + 1) & 0177777;
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = (dst == 0100000);
+            R[dstspec] = dst;
+            continue;
+
+        case DT_DEC_R:                                  /* DEC R */
+            dst = (R[dstspec] - 1) & 0177777;
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = (dst == 077777);
+            R[dstspec] = dst;
+            continue;
+
+        case DT_TST_R:                                  /* TST R */
+            dst = R[dstspec];
+            N = GET_SIGN_W (dst);
+            Z = GET_Z (dst);
+            V = C = 0;
+            continue;
+
+        case DT_SOB:                                    /* SOB */
+            srcspec = srcspec & 07;
+            R[srcspec] = (R[srcspec] - 1) & 0177777;
+            if (R[srcspec]) {
+                JMP_PC ((PC - dstspec - dstspec) & 0177777);
+                }
+            continue;
+
+        case DT_BR:                                     /* BR */
+            BRANCH_X (IR);
+            continue;
+
+        case DT_BNE:                                    /* BNE */
+            if (Z == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BEQ:                                    /* BEQ */
+            if (Z) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BGE:                                    /* BGE */
+            if ((N ^ V) == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BLT:                                    /* BLT */
+            if (N ^ V) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BGT:                                    /* BGT */
+            if ((Z | (N ^ V)) == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BLE:                                    /* BLE */
+            if (Z | (N ^ V)) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BPL:                                    /* BPL */
+            if (N == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BMI:                                    /* BMI */
+            if (N) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BHI:                                    /* BHI */
+            if ((C | Z) == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BLOS:                                   /* BLOS */
+            if (C | Z) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BVC:                                    /* BVC */
+            if (V == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BVS:                                    /* BVS */
+            if (V) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BCC:                                    /* BCC */
+            if (C == 0) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        case DT_BCS:                                    /* BCS */
+            if (C) {
+                BRANCH_X (IR);
+                }
+            continue;
+
+        default:                                        /* DT_NONE */
+            break;
+            }
+        }
+
     switch ((IR >> 12) & 017) {                         /* decode IR<15:12> */
 
 /* Opcode 0: no operands, specials, branches, JSR, SOPs */
@@ -2465,6 +2745,71 @@ return reason;
    - Modes 46 and 56 must check for stack overflow if kernel mode
 */
 
+/* Build predecoded dispatch table
+
+   The table is indexed by the full 16b instruction word and holds the
+   dispatch class for sim_instr.  It depends only on the CPU type and
+   options, so it is rebuilt only when the model or options change.
+   Returns NULL if the table cannot be allocated (general decode only).
+*/
+
+uint8 *cpu_build_dtab (void)
+{
+static const struct {
+    int32 op;
+    int32 cls;
+    } br_tab[] = {
+    { 0000400, DT_BR },   { 0001000, DT_BNE },  { 0001400, DT_BEQ },
+    { 0002000, DT_BGE },  { 0002400, DT_BLT },  { 0003000, DT_BGT },
+    { 0003400, DT_BLE },  { 0100000, DT_BPL },  { 0100400, DT_BMI },
+    { 0101000, DT_BHI },  { 0101400, DT_BLOS }, { 0102000, DT_BVC },
+    { 0102400, DT_BVS },  { 0103000, DT_BCC },  { 0103400, DT_BCS },
+    { 0, DT_NONE }
+    };
+int32 i, j;
+
+if ((cpu_dtab != NULL) &&                               /* already built? */
+    (cpu_dtab_type == cpu_type) &&
+    (cpu_dtab_opt == cpu_opt))
+    return cpu_dtab;
+if (cpu_dtab == NULL) {
+    cpu_dtab = (uint8 *) calloc (0200000, sizeof (uint8));
+    if (cpu_dtab == NULL)
+        return NULL;
+    }
+else memset (cpu_dtab, DT_NONE, 0200000 * sizeof (uint8));
+for (i = 0; i < 0100; i++) {                            /* src, dst R */
+    j = ((i & 070) << 3) | (i & 07);
+    cpu_dtab[0010000 | j] = DT_MOV_RR;
+    cpu_dtab[0020000 | j] = DT_CMP_RR;
+    cpu_dtab[0030000 | j] = DT_BIT_RR;
+    cpu_dtab[0040000 | j] = DT_BIC_RR;
+    cpu_dtab[0050000 | j] = DT_BIS_RR;
+    cpu_dtab[0060000 | j] = DT_ADD_RR;
+    cpu_dtab[0160000 | j] = DT_SUB_RR;
+    cpu_dtab[0110000 | j] = DT_MOVB_RR;
+    if (CPUT (HAS_SXS))
+        cpu_dtab[0074000 | j] = DT_XOR_RR;
+    }
+for (i = 0; i < 010; i++) {                             /* dst R */
+    cpu_dtab[0005000 | i] = DT_CLR_R;
+    cpu_dtab[0005200 | i] = DT_INC_R;
+    cpu_dtab[0005300 | i] = DT_DEC_R;
+    cpu_dtab[0005700 | i] = DT_TST_R;
+    }
+if (CPUT (HAS_SXS)) {
+    for (i = 0; i < 01000; i++)
+        cpu_dtab[0077000 | i] = DT_SOB;
+    }
+for (j = 0; br_tab[j].cls != DT_NONE; j++) {
+    for (i = 0; i < 0400; i++)
+        cpu_dtab[br_tab[j].op | i] = (uint8) br_tab[j].cls;
+    }
+cpu_dtab_type = cpu_type;
+cpu_dtab_opt = cpu_opt;
+return cpu_dtab;
+}
+
 /* Effective address calculation for words */
 
 int32 GeteaW (int32 spec)
@@ -216,6 +216,10 @@ BITFIELD dz_tdr_bits[] = {
   ENDBITS
 };
 
+#define UNIT_V_FASTOUT  (TTUF_V_UF + 0)                  /* fast output */
+#define UNIT_FASTOUT    (1 << UNIT_V_FASTOUT)
+#define DZ_FBURST       16                              /* dflt fast output burst */
+
 extern int32 IREQ (HLVL);
 extern int32 tmxr_poll;                                 /* calibrated delay */
 
@@ -230,6 +234,8 @@ uint16 dz_scnt[MAX_DZ_MUXES] = { 0 };                   /* silo used */
 uint8 dz_sae[MAX_DZ_MUXES] = { 0 };                     /* silo alarm enabled */
 uint32 dz_rxi = 0;                                      /* rcv interrupts */
 uint32 dz_txi = 0;                                      /* xmt interrupts */
+int32 dz_fburst = DZ_FBURST;                            /* fast output burst */
+uint8 dz_fcnt[MAX_DZ_MUXES * DZ_LINES] = { 0 };         /* fast output count */
 int32 dz_mctl = 0;                                      /* modem ctrl enabled */
 int32 dz_auto = 0;                                      /* autodiscon enabled */
 TMLN *dz_ldsc = NULL;                                   /* line descriptors */
@@ -272,6 +278,7 @@ t_stat dz_clear (int32 dz, t_bool flag);
 uint16 dz_getc (int32 dz);
 void dz_update_rcvi (void);
 void dz_update_xmti (void);
+void dz_scan_xmt (int32 dz);
 void dz_clr_rxint (int32 dz);
 void dz_set_rxint (int32 dz);
 void dz_clr_txint (int32 dz);
@@ -314,6 +321,7 @@ REG dz_reg[] = {
     { GRDATAD  (RXINT, dz_rxi,   DEV_RDX, MAX_DZ_MUXES,  0, "receive interrupts") },
     { GRDATAD  (TXINT, dz_txi,   DEV_RDX, MAX_DZ_MUXES,  0, "transmit interrupts") },
     { DRDATAD  (TIME, dz_unit[1].wait,   24,                "output character delay"), PV_LEFT },
+    { DRDATAD  (FBURST, dz_fburst,       8,                 "fast output burst limit"), REG_NZ + PV_LEFT },
     { FLDATAD  (MDMCTL, dz_mctl, 0,                         "modem control enabled") },
     { FLDATAD  (AUTODS, dz_auto, 0,                         "autodisconnect enabled") },
     { GRDATA   (DEVADDR, dz_dib.ba, DEV_RDX, 32, 0), REG_HRO },
@@ -325,6 +333,8 @@ MTAB dz_mod[] = {
     { TT_MODE, TT_MODE_7B, "7b", "7B", NULL, NULL, NULL, "7 bit mode" },
     { TT_MODE, TT_MODE_8B, "8b", "8B", NULL, NULL, NULL, "8 bit mode" },
     { TT_MODE, TT_MODE_7P, "7p", "7P", NULL, NULL, NULL, "7 bit mode - non printing suppressed" },
+    { UNIT_FASTOUT, UNIT_FASTOUT, "fast output", "FASTOUTPUT", NULL, NULL, NULL, "Coalesce output interrupts" },
+    { UNIT_FASTOUT, 0, NULL, "NOFASTOUTPUT", NULL, NULL, NULL, "One output interrupt per character" },
     { MTAB_XTD|MTAB_VDV|MTAB_VALR, 1, NULL, "DISCONNECT",
         &tmxr_dscln, NULL, &dz_desc, "Disconnect a specific line" },
     { UNIT_ATT, UNIT_ATT, "summary", NULL,
@@ -533,6 +543,16 @@ switch ((PA >> 1) & 03) {                               /* case on PA<2:1> */
             if (c >= 0)                                 /* store char */
                 tmxr_putc_ln (lp, c);
             sim_activate (&dz_unit[1], dz_unit[1].wait);/* */
+            if ((dz_unit[0].flags & UNIT_FASTOUT) &&    /* fast output */
+                (lp->txbps == 0)) {                     /* and unthrottled? */
+                if (dz_fcnt[line] < dz_fburst)          /* count, saturating */
+                    ++dz_fcnt[line];
+                if (dz_fcnt[line] < dz_fburst) {        /* burst not done? */
+                    dz_scan_xmt (dz);                   /* next line rdy now */
+                    dz_update_xmti ();                  /* update int */
+                    }
+                else dz_csr[dz] &= ~CSR_TRDY;           /* wait for xmt svc */
+                }
             }
         break;
         }
@@ -583,6 +603,7 @@ return SCPE_OK;
 
 t_stat dz_xmt_svc (UNIT *uptr)
 {
+memset (dz_fcnt, 0, sizeof (dz_fcnt));                  /* new burst */
 tmxr_poll_tx (&dz_desc);                                /* poll output */
 dz_update_xmti ();                                      /* update int */
 return SCPE_OK;
@@ -649,25 +670,43 @@ for (dz = 0; dz < dz_desc.lines/DZ_LINES; dz++) {       /* loop thru muxes */
 return;
 }
 
+/* Scan for the next line ready to transmit
+
+   With FASTOUTPUT set, this is also called directly from a TDR write so
+   that TRDY and TLINE advance at once.  A driver that loops on TRDY in its
+   interrupt service routine then fills several characters per interrupt;
+   the interrupt itself is still only requested from dz_update_xmti.
+*/
+
+void dz_scan_xmt (int32 dz)
+{
+int32 linemask, i, j, line;
+
+linemask = dz_tcr[dz] & DZ_LMASK;                       /* enabled lines */
+dz_csr[dz] &= ~CSR_TRDY;                                /* assume not rdy */
+j = CSR_GETTL (dz_csr[dz]);                             /* start at current */
+for (i = 0; i < DZ_LINES; i++) {                        /* loop thru lines */
+    j = (j + 1) & DZ_LNOMASK;                           /* next line */
+    line = (dz * DZ_LINES) + j;                         /* get line num */
+    if ((linemask & (1 << j)) && dz_ldsc[line].xmte &&
+        (!(dz_unit[0].flags & UNIT_FASTOUT) ||          /* burst limit */
+         (dz_fcnt[line] < dz_fburst))) {                /* not reached? */
+        CSR_PUTTL (dz_csr[dz], j);                      /* put ln in csr */
+        dz_csr[dz] |= CSR_TRDY;                         /* set xmt rdy */
+        break;
+        }
+    }
+return;
+}
+
 /* Update transmit interrupts */
 
 void dz_update_xmti (void)
 {
-int32 dz, linemask, i, j, line;
+int32 dz;
 
 for (dz = 0; dz < dz_desc.lines/DZ_LINES; dz++) {       /* loop thru muxes */
-    linemask = dz_tcr[dz] & DZ_LMASK;                   /* enabled lines */
-    dz_csr[dz] &= ~CSR_TRDY;                            /* assume not rdy */
-    j = CSR_GETTL (dz_csr[dz]);                         /* start at current */
-    for (i = 0; i < DZ_LINES; i++) {                    /* loop thru lines */
-        j = (j + 1) & DZ_LNOMASK;                       /* next line */
-        line = (dz * DZ_LINES) + j;                     /* get line num */
-        if ((linemask & (1 << j)) && dz_ldsc[line].xmte) {
-            CSR_PUTTL (dz_csr[dz], j);                  /* put ln in csr */
-            dz_csr[dz] |= CSR_TRDY;                     /* set xmt rdy */
-            break;
-            }
-        }
+    dz_scan_xmt (dz);                                   /* find ready line */
     if ((dz_csr[dz] & CSR_TIE) && (dz_csr[dz] & CSR_TRDY)) /* ready plus int? */
          dz_set_txint (dz);
     else dz_clr_txint (dz);                             /* no int req */
@@ -937,6 +976,14 @@ fprintf (st, "                  non-printing characters suppressed\n");
 fprintf (st, "  7B  high-order bit cleared  high-order bit cleared\n");
 fprintf (st, "  8B  no changes      no changes\n\n");
 fprintf (st, "The default is 8B.\n\n");
+fprintf (st, "By default, the %s requests a transmit interrupt for every character sent.\n", devtype);
+fprintf (st, "The command\n\n");
+fprintf (st, "   sim> SET %s FASTOUTPUT\n\n", dptr->name);
+fprintf (st, "lets a line accept up to FBURST characters (default %d, minimum 1) before transmitter\n", DZ_FBURST);
+fprintf (st, "ready is deferred to the next output service.  Operating systems which\n");
+fprintf (st, "loop on transmitter ready in their interrupt routine then move a burst of\n");
+fprintf (st, "output per interrupt.  Lines with a transmit speed limit keep one character\n");
+fprintf (st, "per service.  SET %s NOFASTOUTPUT restores the default.\n\n", dptr->name);
 fprintf (st, "The %s supports logging on a per-line basis.  The command\n\n", devtype);
 fprintf (st, "   sim> SET %s LOG=n=filename\n\n", dptr->name);
 fprintf (st, "enables logging for the specified line(n) to the indicated file.  The command\n\n");
@@ -95,6 +95,7 @@
 */
 
 #include "pdp11_defs.h"
+#include <math.h>
 
 /* Floating point status register */
 
@@ -247,6 +248,18 @@ static const uint32 and_mask[33] = { 0,
     };
 int32 backup_PC;
 int32 fp_change;
+int32 fp_host = 0;                                      /* host fast path */
+uint32 fp_host_err = 0;                                 /* check mismatches */
+
+/* Host fast path modes and operations */
+
+#define FPH_OFF         0                               /* disabled */
+#define FPH_ON          1                               /* enabled */
+#define FPH_CHECK       2                               /* enabled, checked */
+#define FPH_ADD         0
+#define FPH_MUL         1
+#define FPH_DIV         2
+#define FPH_TEST_DFLT   100000                          /* self test count */
 
 int32 fpnotrap (int32 code);
 int32 GeteaFW (int32 spec);
@@ -263,6 +276,9 @@ int32 modfp11 (fpac_t *src1, fpac_t *src2, fpac_t *frac);
 void frac_mulfp11 (fpac_t *src1, fpac_t *src2);
 int32 roundfp11 (fpac_t *src);
 int32 round_and_pack (fpac_t *fac, int32 exp, fpac_t *frac, int r);
+t_bool fp11_host (int32 op, fpac_t *facp, fpac_t *fsrcp, int32 *newV);
+t_stat fp11_set_host (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+t_stat fp11_show_host (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 
 extern int32 relocW (int32 addr);
 extern int32 ReadW (int32 addr);
@@ -528,7 +544,8 @@ switch ((IR >> 8) & 017) {                              /* decode IR<11:8> */
     case 002:                                           /* MULf */
         if (ReadFP (&fsrc, GeteaFP (dstspec, lenf), dstspec, lenf)) {
             F_LOAD (qdouble, FR[ac], fac);
-            newV = mulfp11 (&fac, &fsrc);
+            if (!fp_host || !fp11_host (FPH_MUL, &fac, &fsrc, &newV))
+                newV = mulfp11 (&fac, &fsrc);
             F_STORE (qdouble, fac, FR[ac]);
             FPS = setfcc (FPS, fac.h, newV);
             }
@@ -547,7 +564,8 @@ switch ((IR >> 8) & 017) {                              /* decode IR<11:8> */
     case 004:                                           /* ADDf */
         if (ReadFP (&fsrc, GeteaFP (dstspec, lenf), dstspec, lenf)) {
             F_LOAD (qdouble, FR[ac], fac);
-            newV = addfp11 (&fac, &fsrc);
+            if (!fp_host || !fp11_host (FPH_ADD, &fac, &fsrc, &newV))
+                newV = addfp11 (&fac, &fsrc);
             F_STORE (qdouble, fac, FR[ac]);
             FPS = setfcc (FPS, fac.h, newV);
             }
@@ -558,7 +576,8 @@ switch ((IR >> 8) & 017) {                              /* decode IR<11:8> */
             F_LOAD (qdouble, FR[ac], fac);
             if (GET_EXP (fsrc.h) != 0)
                 fsrc.h = fsrc.h ^ FP_SIGN;
-            newV = addfp11 (&fac, &fsrc);
+            if (!fp_host || !fp11_host (FPH_ADD, &fac, &fsrc, &newV))
+                newV = addfp11 (&fac, &fsrc);
             F_STORE (qdouble, fac, FR[ac]);
             FPS = setfcc (FPS, fac.h, newV);
             }
@@ -570,7 +589,8 @@ switch ((IR >> 8) & 017) {                              /* decode IR<11:8> */
             if (GET_EXP (fsrc.h) == 0)                  /* divide by zero? */
                 fpnotrap (FEC_DZRO);
             else {                                      /* no, do divide */
-                newV = divfp11 (&fac, &fsrc);
+                if (!fp_host || !fp11_host (FPH_DIV, &fac, &fsrc, &newV))
+                    newV = divfp11 (&fac, &fsrc);
                 F_STORE (qdouble, fac, FR[ac]);
                 FPS = setfcc (FPS, fac.h, newV);
                 }
@@ -1408,3 +1428,244 @@ if ((FPS & FPS_ID) == 0)
     setTRAP (TRAP_FPE);
 return FALSE;
 }
+
+/* Host floating point fast path
+
+   ADDf, SUBf, MULf and DIVf can be evaluated with host doubles when the
+   result is provably the same as the bit-exact simulation:
+
+   - F format fractions are 24b.  Sums (exponent difference <= 29) and
+     products (48b) are exact in a 53b host double; the FP11 keeps all
+     of these bits, so rounding the exact host result at the F round
+     point (round half away from zero, or truncate) gives the FP11
+     result.  A quotient of two 24b fractions cannot lie within 2**-48
+     of a rounding boundary unless it is on it, so the correctly
+     rounded 53b host quotient rounds or truncates identically.
+   - D format operands are accepted only if their low 32b of fraction
+     are zero; sums and products are then exact in 53b and need no
+     rounding at all.  D format divides always use the simulation.
+
+   Zero and -0 operands, and results that would overflow or underflow,
+   are left to the simulation, which handles the traps.  No state is
+   changed unless the fast path succeeds.
+
+   Inputs:
+        op      =       FPH_ADD, FPH_MUL, FPH_DIV
+        facp    =       pointer to src1 (output)
+        fsrcp   =       pointer to src2
+        newV    =       pointer to overflow indicator (output)
+   Outputs:
+        done    =       TRUE if the result was computed on the host
+*/
+
+static t_bool fp11_to_host (fpac_t *fptr, int32 qd, double *dptr)
+{
+int32 exp = GET_EXP (fptr->h);
+double val;
+
+if ((exp == 0) || (qd && (fptr->l != 0)))               /* zero, long frac? */
+    return FALSE;
+val = ldexp ((double) ((fptr->h & FP_FRACH) | FP_HB), exp - FP_BIAS - (FP_V_HB + 1));
+*dptr = GET_SIGN (fptr->h)? -val: val;
+return TRUE;
+}
+
+static t_bool fp11_from_host (double val, int32 qd, fpac_t *fptr)
+{
+int32 exp;
+double m, hi, lo;
+uint32 frac;
+
+if (val == 0.0) {                                       /* exact zero */
+    *fptr = zero_fac;
+    return TRUE;
+    }
+m = frexp (fabs (val), &exp);                           /* m in [.5,1) */
+exp = exp + FP_BIAS;
+hi = ldexp (m, FP_V_HB + 1);                            /* 24b fraction */
+frac = (uint32) hi;
+lo = hi - (double) frac;                                /* exact remainder */
+if (qd) {
+    lo = ldexp (lo, 32);                                /* low 32b */
+    if (lo != floor (lo))                               /* must be exact */
+        return FALSE;
+    fptr->l = (uint32) lo;
+    }
+else {
+    if (((FPS & FPS_T) == 0) && (lo >= 0.5)) {          /* round? */
+        frac = frac + 1;
+        if (frac & (FP_HB << 1)) {                      /* carry out? */
+            frac = frac >> 1;
+            exp = exp + 1;
+            }
+        }
+    fptr->l = 0;
+    }
+if ((exp <= 0) || (exp > FP_M_EXP))                     /* ovflo, unflo? */
+    return FALSE;
+fptr->h = ((val < 0.0)? FP_SIGN: 0) | (exp << FP_V_EXP) | (frac & FP_FRACH);
+return TRUE;
+}
+
+t_bool fp11_host (int32 op, fpac_t *facp, fpac_t *fsrcp, int32 *newV)
+{
+int32 qd = FPS & FPS_D;
+int32 ediff, refV;
+double a, b, r;
+fpac_t res, ref, src;
+
+if (!fp11_to_host (facp, qd, &a) ||
+    !fp11_to_host (fsrcp, qd, &b))
+    return FALSE;
+switch (op) {
+
+    case FPH_ADD:
+        ediff = GET_EXP (facp->h) - GET_EXP (fsrcp->h);
+        if ((ediff > 29) || (ediff < -29))              /* not exact? */
+            return FALSE;
+        r = a + b;
+        break;
+
+    case FPH_MUL:
+        r = a * b;
+        break;
+
+    case FPH_DIV:
+        if (qd)                                         /* D quotient inexact */
+            return FALSE;
+        r = a / b;
+        break;
+
+    default:
+        return FALSE;
+        }
+if (!fp11_from_host (r, qd, &res))
+    return FALSE;
+if (fp_host == FPH_CHECK) {                             /* cross check? */
+    ref = *facp;
+    src = *fsrcp;
+    if (op == FPH_ADD)
+        refV = addfp11 (&ref, &src);
+    else if (op == FPH_MUL)
+        refV = mulfp11 (&ref, &src);
+    else refV = divfp11 (&ref, &src);
+    if ((ref.h != res.h) || (qd && (ref.l != res.l)) || (refV != 0)) {
+        fp_host_err = fp_host_err + 1;
+        sim_printf ("FP11 host %s mismatch: %08X %08X, %08X %08X = %08X %08X, expected %08X %08X\n",
+            (op == FPH_ADD)? "ADD": ((op == FPH_MUL)? "MUL": "DIV"),
+            facp->h, facp->l, fsrcp->h, fsrcp->l, res.h, res.l, ref.h, ref.l);
+        *facp = ref;                                    /* use simulation */
+        *newV = refV;
+        return TRUE;
+        }
+    }
+*facp = res;
+*newV = 0;
+return TRUE;
+}
+
+/* Host fast path self test
+
+   Runs random operands through the host path and the simulation in
+   every combination of F/D and round/truncate, and reports mismatches.
+   Operands and results outside the host path are skipped.
+*/
+
+static uint32 fp11_host_rand (void)
+{
+return ((((uint32) rand ()) & 0xFFFF) << 16) | (((uint32) rand ()) & 0xFFFF);
+}
+
+static void fp11_host_test (int32 cnt)
+{
+static const int32 modes[4] = { 0, FPS_T, FPS_D, FPS_D | FPS_T };
+int32 saved_FPS = FPS, saved_FEC = FEC, saved_FEA = FEA;
+int32 saved_host = fp_host;
+uint32 saved_err = fp_host_err;
+int32 i, m, op, V;
+uint32 tested = 0, done = 0;
+fpac_t fac, fsrc;
+
+fp_host = FPH_CHECK;
+fp_host_err = 0;
+for (m = 0; m < 4; m++) {
+    FPS = modes[m] | FPS_ID;                            /* no traps */
+    for (i = 0; i < cnt; i++) {
+        for (op = FPH_ADD; op <= FPH_DIV; op++) {
+            fac.h = fp11_host_rand ();
+            fsrc.h = fp11_host_rand ();
+            fac.h = (fac.h & ~FP_EXP) |                 /* exp in 0100:0277 */
+                ((0100 + (GET_EXP (fac.h) & 0177)) << FP_V_EXP);
+            if (op == FPH_ADD)                          /* add: exps close */
+                fsrc.h = (fsrc.h & ~FP_EXP) |
+                    ((GET_EXP (fac.h) + (fsrc.h & 037) - 020) << FP_V_EXP);
+            else fsrc.h = (fsrc.h & ~FP_EXP) |
+                ((0100 + (GET_EXP (fsrc.h) & 0177)) << FP_V_EXP);
+            fac.l = (i & 1)? fp11_host_rand (): 0;
+            fsrc.l = 0;
+            if (modes[m] & FPS_D) {
+                if ((i & 3) == 3)                       /* some long fracs */
+                    fsrc.l = fp11_host_rand ();
+                }
+            else fac.l = 0;
+            tested = tested + 1;
+            if (fp11_host (op, &fac, &fsrc, &V))
+                done = done + 1;
+            }
+        }
+    }
+sim_printf ("FP11 host check: %u operations, %u on host path, %u mismatches\n",
+    tested, done, fp_host_err);
+fp_host_err = fp_host_err + saved_err;
+fp_host = saved_host;
+FPS = saved_FPS;
+FEC = saved_FEC;
+FEA = saved_FEA;
+}
+
+/* Set/show host fast path
+
+   SET CPU FPHOST=ON|OFF|CHECK{;n}
+
+   CHECK runs n (default 100000) random operand tests per operation and
+   mode, then leaves every host result cross checked against the
+   simulation.
+*/
+
+t_stat fp11_set_host (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+char gbuf[CBUFSIZE];
+int32 cnt = FPH_TEST_DFLT;
+t_stat r;
+
+if (cptr == NULL)
+    return SCPE_ARG;
+cptr = get_glyph (cptr, gbuf, ';');
+if (strcmp (gbuf, "ON") == 0)
+    fp_host = FPH_ON;
+else if (strcmp (gbuf, "OFF") == 0)
+    fp_host = FPH_OFF;
+else if (strcmp (gbuf, "CHECK") == 0) {
+    if (*cptr) {
+        cnt = (int32) get_uint (cptr, 10, 10000000, &r);
+        if (r != SCPE_OK)
+            return SCPE_ARG;
+        }
+    fp11_host_test (cnt);
+    fp_host = FPH_CHECK;
+    }
+else return SCPE_ARG;
+return SCPE_OK;
+}
+
+t_stat fp11_show_host (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+if (fp_host == FPH_OFF)
+    fprintf (st, "FP host path disabled");
+else {
+    fprintf (st, "FP host path enabled");
+    if (fp_host == FPH_CHECK)
+        fprintf (st, ", checked, %u mismatches", fp_host_err);
+    }
+return SCPE_OK;
+}
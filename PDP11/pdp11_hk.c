@@ -1065,7 +1065,7 @@ t_seccnt sectsread;
 t_stat err;
 int32 wc, awc, da;
 uint32 drv, ba;
-uint16 comp;
+uint16 comp, *xb;
 DEVICE *dptr = find_dev_from_unit (uptr);
 
 drv = (uint32) (uptr - hk_dev.units);                   /* get drv number */
@@ -1150,6 +1150,10 @@ switch (fnc) {                                          /* case on function */
                 break;
                 }
             }
+        xb = (uint16 *)sim_disk_mapped (uptr, da/HK_NUMWD, /* container mapped? */
+                                        (wc + (HK_NUMWD - 1))/HK_NUMWD, (uptr->FNC == FNC_WRITE));
+        if (xb == NULL)                                 /* no, use buffer */
+            xb = hkxb;
 
         if (uptr->FNC == FNC_WRITE) {                   /* write? */
             if (hkcs2 & CS2_UAI) {                      /* no addr inc? */
@@ -1158,10 +1162,10 @@ switch (fnc) {                                          /* case on function */
                     hk_err (CS1_ERR, CS2_NEM, 0, drv);
                     }
                 for (i = 0; i < wc; i++)
-                    hkxb[i] = comp;
+                    xb[i] = comp;
                 }
             else {                                      /* normal */
-                if ((t = Map_ReadW (ba, wc << 1, hkxb))) {/* get buf */
+                if ((t = Map_ReadW (ba, wc << 1, xb))) {/* get buf */
                     wc = wc - (t >> 1);                 /* NXM, adj wc */
                      hk_err (CS1_ERR, CS2_NEM, 0, drv);
                     }
@@ -1169,23 +1173,23 @@ switch (fnc) {                                          /* case on function */
                 }
             awc = (wc + (HK_NUMWD - 1)) & ~(HK_NUMWD - 1);
             for (i = wc; i < awc; i++)                  /* fill buf */
-                hkxb[i] = 0;
+                xb[i] = 0;
             if (wc) {                           /* write buf */
-                sim_disk_data_trace (uptr, (uint8 *)hkxb, da/HK_NUMWD, awc, "sim_disk_wrsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
-                err = sim_disk_wrsect (uptr, da/HK_NUMWD, (uint8 *)hkxb, NULL, awc/HK_NUMWD);
+                sim_disk_data_trace (uptr, (uint8 *)xb, da/HK_NUMWD, awc, "sim_disk_wrsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
+                err = sim_disk_wrsect (uptr, da/HK_NUMWD, (uint8 *)xb, NULL, awc/HK_NUMWD);
                 }
             }                                           /* end if wr */
         else if (uptr->FNC == FNC_READ) {               /* read? */
-            err = sim_disk_rdsect (uptr, da/HK_NUMWD, (uint8 *)hkxb, &sectsread, wc/HK_NUMWD);
-            sim_disk_data_trace (uptr, (uint8 *)hkxb, da/HK_NUMWD, sectsread*HK_NUMWD*sizeof(*hkxb), "sim_disk_rdsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
+            err = sim_disk_rdsect (uptr, da/HK_NUMWD, (uint8 *)xb, &sectsread, wc/HK_NUMWD);
+            sim_disk_data_trace (uptr, (uint8 *)xb, da/HK_NUMWD, sectsread*HK_NUMWD*sizeof(*xb), "sim_disk_rdsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
             if (hkcs2 & CS2_UAI) {                      /* no addr inc? */
-                if ((t = Map_WriteW (ba, 2, &hkxb[wc - 1]))) {
+                if ((t = Map_WriteW (ba, 2, &xb[wc - 1]))) {
                     wc = 0;                             /* NXM, no xfr */
                     hk_err (CS1_ERR, CS2_NEM, 0, drv);
                     }
                 }
             else {                                      /* normal */
-                if ((t = Map_WriteW (ba, wc << 1, hkxb))) {/* put buf */
+                if ((t = Map_WriteW (ba, wc << 1, xb))) {/* put buf */
                     wc = wc - (t >> 1);                 /* NXM, adj wc */
                     hk_err (CS1_ERR, CS2_NEM, 0, drv);
                     }
@@ -1193,15 +1197,15 @@ switch (fnc) {                                          /* case on function */
                 }
             }                                           /* end if read */
         else {                                          /* wchk */                  
-            err = sim_disk_rdsect (uptr, da/HK_NUMWD, (uint8 *)hkxb, &sectsread, wc/HK_NUMWD);
-            sim_disk_data_trace (uptr, (uint8 *)hkxb, da/HK_NUMWD, sectsread*HK_NUMWD*sizeof(*hkxb), "sim_disk_rdsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
+            err = sim_disk_rdsect (uptr, da/HK_NUMWD, (uint8 *)xb, &sectsread, wc/HK_NUMWD);
+            sim_disk_data_trace (uptr, (uint8 *)xb, da/HK_NUMWD, sectsread*HK_NUMWD*sizeof(*xb), "sim_disk_rdsect", HKDEB_DAT & dptr->dctrl, HKDEB_OPS);
             awc = wc;
             for (wc = 0; wc < awc; wc++) {              /* loop thru buf */
                 if (Map_ReadW (ba, 2, &comp)) {         /* read word */
                     hk_err (CS1_ERR, CS2_NEM, 0, drv);
                     break;
                     }
-                if (comp != hkxb[wc]) {                 /* compare wd */
+                if (comp != xb[wc]) {                 /* compare wd */
                     hk_err (CS1_ERR, CS2_WCE, 0, drv);
                     break;
                     }
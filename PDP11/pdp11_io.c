@@ -98,6 +98,8 @@ t_stat stat;
 
 idx = (pa & IOPAGEMASK) >> 1;
 if (iodispR[idx]) {
+    if (iostatR)                                        /* counting? */
+        iostatR[idx]++;
     stat = iodispR[idx] (data, pa, access);
     trap_req = calc_ints (ipl, trap_req);
     return stat;
@@ -112,6 +114,8 @@ t_stat stat;
 
 idx = (pa & IOPAGEMASK) >> 1;
 if (iodispW[idx]) {
+    if (iostatW)                                        /* counting? */
+        iostatW[idx]++;
     stat = iodispW[idx] (data, pa, access);
     trap_req = calc_ints (ipl, trap_req);
     return stat;
@@ -51,8 +51,26 @@ extern t_stat (*iodispW[IOPAGESIZE >> 1])(int32 dat, int32 ad, int32 md);
 extern t_stat build_dib_tab (void);
 
 static DIB *iodibp[IOPAGESIZE >> 1];
+void *iodispC[IOPAGESIZE >> 1];                         /* per-reg handler context */
+
+t_uint64 *iostatR = NULL;                               /* I/O page read counts */
+t_uint64 *iostatW = NULL;                               /* I/O page write counts */
+
+#define IOREG_MAX       64                              /* max per-reg handlers */
+
+typedef struct {
+    DIB                 *dibp;                          /* owning DIB */
+    uint32              off;                            /* offset from base */
+    t_stat              (*rd)(int32 *dat, int32 ad, int32 md);
+    t_stat              (*wr)(int32 dat, int32 ad, int32 md);
+    void                *ctx;                           /* handler context */
+    } IOREG;
+
+static IOREG ioreg_tab[IOREG_MAX];                      /* per-reg handlers */
+static int32 ioreg_cnt = 0;
 
 static void build_vector_tab (void);
+static void install_ioreg (IOREG *rp);
 
 #if !defined(UNIMEMSIZE)
 #define UNIMEMSIZE      001000000                       /* 2**18 */
@@ -279,6 +297,7 @@ for (i = 0; i < IPL_HLVL; i++) {                        /* clear intr tab */
 for (i = 0; i < (IOPAGESIZE >> 1); i++) {               /* clear dispatch tab */
     iodispR[i] = NULL;
     iodispW[i] = NULL;
+    iodispC[i] = NULL;
     iodibp[i] = NULL;
     }
 return;
@@ -381,7 +400,8 @@ for (i = 0; i < (int32) dibp->lnt; i = i + 2) {         /* create entries */
             if ((cdptr->flags & DEV_DIS) || !cdibp || cdibp == dibp) {
                 continue;
                 }
-            if ((iodispR[idx] && dibp->rd &&
+            if ((iodibp[idx] == cdibp) ||               /* owner of entry? */
+                (iodispR[idx] && dibp->rd &&
                 (iodispR[idx] != dibp->rd) &&
                 (cdibp->rd == iodispR[idx])) ||
                 (iodispW[idx] && dibp->wr &&
@@ -403,9 +423,179 @@ for (i = 0; i < (int32) dibp->lnt; i = i + 2) {         /* create entries */
         iodispR[idx] = dibp->rd;
     if (dibp->wr)                                       /* set wr dispatch */
         iodispW[idx] = dibp->wr;
+    iodispC[idx] = NULL;
     iodibp[idx] = dibp;                                 /* remember DIB */
     }
+for (i = 0; i < ioreg_cnt; i++) {                       /* per-reg handlers */
+    if (ioreg_tab[i].dibp == dibp)
+        install_ioreg (&ioreg_tab[i]);
+    }
+return SCPE_OK;
+}
+
+/* Install a per-register handler over its DIB's dispatch entry */
+
+static void install_ioreg (IOREG *rp)
+{
+DIB *dibp = rp->dibp;
+int32 idx;
+
+if (rp->off >= dibp->lnt)
+    return;
+idx = ((dibp->ba + rp->off) & IOPAGEMASK) >> 1;
+if (iodibp[idx] != dibp)                                /* DIB not mapped here? */
+    return;
+if (rp->rd && dibp->rd)
+    iodispR[idx] = rp->rd;
+if (rp->wr && dibp->wr)
+    iodispW[idx] = rp->wr;
+iodispC[idx] = rp->ctx;
+}
+
+/* Register per-register I/O page handlers
+
+   A device whose DIB rd/wr routines decode the register offset on every
+   access can publish handlers for individual registers.  build_ubus_tab
+   installs them over the DIB routines, so an access to that register is a
+   single indirect call.  The context is kept beside the dispatch entry, and
+   a handler fetches it with IOREG_CTX (pa) instead of searching for its
+   controller.  Registrations persist across table rebuilds, and take effect
+   at once if the DIB is already mapped; registering the same DIB and offset
+   again replaces the handlers.  A NULL handler leaves the DIB routine in
+   place for that direction.
+
+   Inputs:
+        dibp    =       DIB owning the register
+        off     =       byte offset of the register from dibp->ba
+        rd      =       read handler, or NULL
+        wr      =       write handler, or NULL
+        ctx     =       handler context
+   Outputs:
+        status  =       SCPE_OK or SCPE_IERR
+*/
+
+t_stat set_ioreg (DIB *dibp, uint32 off,
+    t_stat (*rd)(int32 *dat, int32 ad, int32 md),
+    t_stat (*wr)(int32 dat, int32 ad, int32 md),
+    void *ctx)
+{
+int32 i;
+
+if ((dibp == NULL) || (off & 1))
+    return SCPE_IERR;
+for (i = 0; i < ioreg_cnt; i++) {                       /* already known? */
+    if ((ioreg_tab[i].dibp == dibp) && (ioreg_tab[i].off == off))
+        break;
+    }
+if (i == ioreg_cnt) {                                   /* new entry */
+    if (ioreg_cnt >= IOREG_MAX)
+        return SCPE_IERR;
+    ioreg_cnt = ioreg_cnt + 1;
+    }
+ioreg_tab[i].dibp = dibp;
+ioreg_tab[i].off = off;
+ioreg_tab[i].rd = rd;
+ioreg_tab[i].wr = wr;
+ioreg_tab[i].ctx = ctx;
+install_ioreg (&ioreg_tab[i]);                          /* update live table */
+return SCPE_OK;
+}
+
+/* Enable, clear or disable I/O page access counters */
+
+t_stat set_iostats (UNIT *uptr, int32 val, CONST char *cptr, void *desc)
+{
+if (cptr != NULL)
+    return SCPE_ARG;
+if (val) {                                              /* IOSTATS? */
+    if (iostatR == NULL) {                              /* allocate */
+        iostatR = (t_uint64 *) calloc (IOPAGESIZE >> 1, sizeof (t_uint64));
+        iostatW = (t_uint64 *) calloc (IOPAGESIZE >> 1, sizeof (t_uint64));
+        if ((iostatR == NULL) || (iostatW == NULL)) {
+            free (iostatR);
+            free (iostatW);
+            iostatR = iostatW = NULL;
+            return SCPE_MEM;
+            }
+        }
+    else {                                              /* restart counts */
+        memset (iostatR, 0, (IOPAGESIZE >> 1) * sizeof (t_uint64));
+        memset (iostatW, 0, (IOPAGESIZE >> 1) * sizeof (t_uint64));
+        }
+    }
+else {                                                  /* NOIOSTATS */
+    free (iostatR);
+    free (iostatW);
+    iostatR = iostatW = NULL;
+    }
+return SCPE_OK;
+}
+
+/* Show I/O page access counters, busiest register first */
+
+static int iostat_cmp (const void *a, const void *b)
+{
+int32 ia = *((const int32 *) a);
+int32 ib = *((const int32 *) b);
+t_uint64 ta = iostatR[ia] + iostatW[ia];
+t_uint64 tb = iostatR[ib] + iostatW[ib];
+
+if (ta != tb)
+    return (ta < tb)? 1: -1;
+return ia - ib;
+}
+
+t_stat show_iostats (FILE *st, UNIT *uptr, int32 val, CONST void *desc)
+{
+int32 *order;
+int32 i, n;
+uint32 j;
+DEVICE *dptr;
+DIB *dibp;
+
+#if defined DEV_RDX && DEV_RDX == 16
+#define ADR_FMT "%08X +%-5X"
+#else
+#define ADR_FMT "%08o +%-5o"
+#endif
+
+if (iostatR == NULL) {
+    fprintf (st, "I/O page access counting is disabled\n");
+    return SCPE_OK;
+    }
+if (build_dib_tab ())                                   /* build IO page */
+    return SCPE_OK;
+order = (int32 *) malloc ((IOPAGESIZE >> 1) * sizeof (int32));
+if (order == NULL)
+    return SCPE_MEM;
+for (i = n = 0; i < (IOPAGESIZE >> 1); i++) {           /* used registers */
+    if (iostatR[i] || iostatW[i])
+        order[n++] = i;
+    }
+if (n == 0)
+    fprintf (st, "No I/O page accesses counted\n");
+else {
+    qsort (order, n, sizeof (int32), iostat_cmp);
+    fprintf (st, "Address  Offset Device           Reads           Writes\n");
+    fprintf (st, "-------- ------ -------- ---------------- ----------------\n");
+    for (i = 0; i < n; i++) {
+        dibp = iodibp[order[i]];
+        for (j = 0, dptr = NULL; dibp && (sim_devices[j] != NULL); j++) {
+            if (((DIB*) sim_devices[j]->ctxt) == dibp) {
+                dptr = sim_devices[j];                  /* locate device */
+                break;
+                }
+            }
+        fprintf (st, ADR_FMT " %-8s %16" LL_FMT "u %16" LL_FMT "u\n",
+                 IOPAGEBASE + (order[i] << 1),
+                 dibp? ((IOPAGEBASE + (order[i] << 1)) - dibp->ba): 0,
+                 dptr? sim_dname (dptr): (dibp? "CPU": "-"),
+                 iostatR[order[i]], iostatW[order[i]]);
+        }
+    }
+free (order);
 return SCPE_OK;
+#undef ADR_FMT
 }
 
 /* Show IO space */
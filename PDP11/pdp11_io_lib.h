@@ -36,9 +36,20 @@ t_stat set_vec (UNIT *uptr, int32 arg, CONST char *cptr, void *desc);
 t_stat show_vec (FILE *st, UNIT *uptr, int32 arg, CONST void *desc);
 t_stat show_vec_mux (FILE *st, UNIT *uptr, int32 arg, CONST void *desc);
 t_stat show_iospace (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
+t_stat set_iostats (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
+t_stat show_iostats (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
+t_stat set_ioreg (DIB *dibp, uint32 off,
+    t_stat (*rd)(int32 *dat, int32 ad, int32 md),
+    t_stat (*wr)(int32 dat, int32 ad, int32 md),
+    void *ctx);
 t_stat auto_config (const char *name, int32 nctrl);
 t_stat pdp11_bad_block (UNIT *uptr, int32 sec, int32 wds);
 void init_ubus_tab (void);
 t_stat build_ubus_tab (DEVICE *dptr, DIB *dibp);
 
+extern t_uint64 *iostatR;                               /* I/O page read counts */
+extern t_uint64 *iostatW;                               /* I/O page write counts */
+extern void *iodispC[IOPAGESIZE >> 1];                  /* per-reg handler context */
+#define IOREG_CTX(pa)   (iodispC[((pa) & IOPAGEMASK) >> 1])
+
 #endif
@@ -753,7 +753,7 @@ t_stat err;
 t_seccnt sectsread;
 int32 i, da, awc;
 uint32 ma;
-uint16 comp;
+uint16 comp, *xb;
 DEVICE *dptr = find_dev_from_unit (uptr);
 static const char * const funcname[] = {
     "NOP", "WCK", "GSTA", "SEEK",
@@ -903,10 +903,15 @@ if (wc > maxwc)                                         /* track overrun? */
 
 sim_debug (RLDEB_OPS, &rl_dev, ">>RL svc: cyl %d, sect %d, wc %d, maxwc %d\n", GET_CYL (rlda), GET_SECT (rlda), wc, maxwc);
 
+xb = (uint16 *)sim_disk_mapped (uptr, da/RL_NUMWD,      /* container mapped? */
+                                (wc + (RL_NUMWD - 1))/RL_NUMWD, (uptr->FNC == RLCS_WRITE));
+if (xb == NULL)                                         /* no, use buffer */
+    xb = rlxb;
+
 if (uptr->FNC >= RLCS_READ) {                           /* read (no hdr)? */
-    err = sim_disk_rdsect (uptr, da/RL_NUMWD, (uint8 *)rlxb, &sectsread, wc/RL_NUMWD);
-    sim_disk_data_trace (uptr, (uint8 *)rlxb, da/RL_NUMWD, sectsread*RL_NUMWD*sizeof(*rlxb), "sim_disk_rdsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
-    if ((t = Map_WriteW (ma, wc << 1, rlxb))) {         /* store buffer */
+    err = sim_disk_rdsect (uptr, da/RL_NUMWD, (uint8 *)xb, &sectsread, wc/RL_NUMWD);
+    sim_disk_data_trace (uptr, (uint8 *)xb, da/RL_NUMWD, sectsread*RL_NUMWD*sizeof(*xb), "sim_disk_rdsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
+    if ((t = Map_WriteW (ma, wc << 1, xb))) {           /* store buffer */
         rlcs = rlcs | RLCS_ERR | RLCS_NXM;              /* nxm */
         wc = wc - t;                                    /* adjust wc */
         }
@@ -914,23 +919,23 @@ if (uptr->FNC >= RLCS_READ) {                           /* read (no hdr)? */
 
 else
 if (uptr->FNC == RLCS_WRITE) {                          /* write? */
-    if ((t = Map_ReadW (ma, wc << 1, rlxb))) {          /* fetch buffer */
+    if ((t = Map_ReadW (ma, wc << 1, xb))) {            /* fetch buffer */
         rlcs = rlcs | RLCS_ERR | RLCS_NXM;              /* nxm */
         wc = wc - t;                                    /* adj xfer lnt */
         }
     if (wc) {                                           /* any xfer? */
         awc = (wc + (RL_NUMWD - 1)) & ~(RL_NUMWD - 1);  /* clr to */
         for (i = wc; i < awc; i++)                      /* end of blk */
-            rlxb[i] = 0;
-        sim_disk_data_trace (uptr, (uint8 *)rlxb, da/RL_NUMWD, awc, "sim_disk_wrsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
-        err = sim_disk_wrsect (uptr, da/RL_NUMWD, (uint8 *)rlxb, NULL, awc/RL_NUMWD);
+            xb[i] = 0;
+        sim_disk_data_trace (uptr, (uint8 *)xb, da/RL_NUMWD, awc, "sim_disk_wrsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
+        err = sim_disk_wrsect (uptr, da/RL_NUMWD, (uint8 *)xb, NULL, awc/RL_NUMWD);
         }
     }                                                   /* end write */
 
 else
 if (uptr->FNC == RLCS_WCHK) {                           /* write check? */
-    err = sim_disk_rdsect (uptr, da/RL_NUMWD, (uint8 *)rlxb, &sectsread, wc/RL_NUMWD);
-    sim_disk_data_trace (uptr, (uint8 *)rlxb, da/RL_NUMWD, sectsread*RL_NUMWD*sizeof(*rlxb), "sim_disk_rdsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
+    err = sim_disk_rdsect (uptr, da/RL_NUMWD, (uint8 *)xb, &sectsread, wc/RL_NUMWD);
+    sim_disk_data_trace (uptr, (uint8 *)xb, da/RL_NUMWD, sectsread*RL_NUMWD*sizeof(*xb), "sim_disk_rdsect", RLDEB_DAT & dptr->dctrl, RLDEB_OPS);
     awc = wc;                                           /* save wc */
     for (wc = 0; (err == 0) && (wc < awc); wc++)  {     /* loop thru buf */
         if (Map_ReadW (ma + (wc << 1), 2, &comp)) {     /* mem wd */
@@ -551,6 +551,7 @@ static struct drvtyp drv_tab[] = {
     };
 
 uint16 *rpxb[RP_NUMDR] = { 0 };                          /* xfer buffer */
+uint16 *rpxp[RP_NUMDR] = { 0 };                         /* current xfer (buffer or mapped) */
 uint16 rpcs1[RP_NUMDR] = { 0 };                         /* control/status 1 */
 uint16 rpda[RP_NUMDR] = { 0 };                          /* track/sector */
 uint16 rpds[RP_NUMDR] = { 0 };                          /* drive status */
@@ -1185,19 +1186,23 @@ if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
                     break;
                     }
                 }
+            rpxp[drv] = (uint16 *)sim_disk_mapped (uptr, da/RP_NUMWD, /* container mapped? */
+                                                   (wc + (RP_NUMWD - 1))/RP_NUMWD, (fnc == FNC_WRITE));
+            if (rpxp[drv] == NULL)                      /* no, use buffer */
+                rpxp[drv] = rpxb[drv];
             if (fnc == FNC_WRITE) {                     /* write? */
-                abc = mba_rdbufW (dibp->ba, mbc, rpxb[drv]);/* get buffer */
+                abc = mba_rdbufW (dibp->ba, mbc, rpxp[drv]);/* get buffer */
                 wc = (abc + 1) >> 1;                    /* actual # wds */
                 awc = (wc + (RP_NUMWD - 1)) & ~(RP_NUMWD - 1);
                 for (i = wc; i < awc; i++)              /* fill buf */
-                    rpxb[drv][i] = 0;
-                sim_disk_data_trace (uptr, (uint8 *)rpxb[drv], da/RP_NUMWD, awc, "sim_disk_wrsect-WR", DBG_DAT & dptr->dctrl, DBG_REQ);
-                sim_disk_wrsect_a (uptr, da/RP_NUMWD, (uint8 *)rpxb[drv], NULL, awc/RP_NUMWD, rp_io_complete);
+                    rpxp[drv][i] = 0;
+                sim_disk_data_trace (uptr, (uint8 *)rpxp[drv], da/RP_NUMWD, awc, "sim_disk_wrsect-WR", DBG_DAT & dptr->dctrl, DBG_REQ);
+                sim_disk_wrsect_a (uptr, da/RP_NUMWD, (uint8 *)rpxp[drv], NULL, awc/RP_NUMWD, rp_io_complete);
                 return SCPE_OK;
                 }                                       /* end if wr */
             else {                                      /* read or wchk */
                 awc = (wc + (RP_NUMWD - 1)) & ~(RP_NUMWD - 1);
-                sim_disk_rdsect_a (uptr, da/RP_NUMWD, (uint8 *)rpxb[drv], (t_seccnt*)&uptr->sectsread, awc/RP_NUMWD, rp_io_complete);
+                sim_disk_rdsect_a (uptr, da/RP_NUMWD, (uint8 *)rpxp[drv], (t_seccnt*)&uptr->sectsread, awc/RP_NUMWD, rp_io_complete);
                 return SCPE_OK;
                 }                                       /* end if read */
 
@@ -1233,12 +1238,12 @@ else { /* Bottom End (After I/O processing) */
                 }                                       /* end if wr */
             else {                                      /* read or wchk */
                 awc = uptr->sectsread * RP_NUMWD;
-                sim_disk_data_trace (uptr, (uint8*)rpxb[drv], da/RP_NUMWD, awc << 1, "sim_disk_rdsect", DBG_DAT & dptr->dctrl, DBG_REQ);
+                sim_disk_data_trace (uptr, (uint8*)rpxp[drv], da/RP_NUMWD, awc << 1, "sim_disk_rdsect", DBG_DAT & dptr->dctrl, DBG_REQ);
                 for (i = awc; i < wc; i++)              /* fill buf */
-                    rpxb[drv][i] = 0;
+                    rpxp[drv][i] = 0;
                 if (fnc == FNC_WCHK)                    /* write check? */
-                    mba_chbufW (dibp->ba, mbc, rpxb[drv]); /* check vs mem */
-                else mba_wrbufW (dibp->ba, mbc, rpxb[drv]);/* store in mem */
+                    mba_chbufW (dibp->ba, mbc, rpxp[drv]); /* check vs mem */
+                else mba_wrbufW (dibp->ba, mbc, rpxp[drv]);/* store in mem */
                 }                                       /* end if read */
             da = da + wc + (RP_NUMWD - 1);
             if (da >= drv_tab[dtype].size)
@@ -173,6 +173,7 @@ extern int32 MMR2;
 #define io_status       u5                              /* io status from callback */
 #define io_complete     u6                              /* io completion flag */
 #define rqxb            filebuf                         /* xfer buffer */
+#define rqxp            up7                             /* current xfer (buffer or mapped) */
 #define UNIT_WPRT       (UNIT_WLK | UNIT_RO)            /* write prot */
 #define RQ_RMV(u)       ((drv_tab[GET_DTYPE (u->flags)].flgs & RQDF_RMV)? \
                         UF_RMV: 0)
@@ -832,6 +833,10 @@ static const char *rq_cmdname[] = {
 
 t_stat rq_rd (int32 *data, int32 PA, int32 access);
 t_stat rq_wr (int32 data, int32 PA, int32 access);
+t_stat rq_rd_ip (int32 *data, int32 PA, int32 access);
+t_stat rq_rd_sa (int32 *data, int32 PA, int32 access);
+t_stat rq_wr_ip (int32 data, int32 PA, int32 access);
+t_stat rq_wr_sa (int32 data, int32 PA, int32 access);
 t_stat rq_svc (UNIT *uptr);
 t_stat rq_tmrsvc (UNIT *uptr);
 t_stat rq_quesvc (UNIT *uptr);
@@ -887,7 +892,6 @@ void rq_init_int (MSC *cp);
 void rq_ring_int (MSC *cp, struct uq_ring *ring);
 t_bool rq_fatal (MSC *cp, uint16 err);
 UNIT *rq_getucb (MSC *cp, uint16 lu);
-int32 rq_map_pa (uint32 pa);
 void rq_setint (MSC *cp);
 void rq_clrint (MSC *cp);
 int32 rq_inta (void);
@@ -1312,84 +1316,87 @@ static MSC *rq_ctxmap[RQ_NUMCT] = {
 
    base + 0     IP      read/write
    base + 2     SA      read/write
+
+   rq_reset publishes the per-register routines to the I/O page dispatch
+   table with the controller context beside them, so host polls of IP go
+   straight to rq_rd_ip with no search for the controller; rq_rd and rq_wr
+   remain the DIB routines.
 */
 
 t_stat rq_rd (int32 *data, int32 PA, int32 access)
 {
-int32 cidx = rq_map_pa ((uint32) PA);
-MSC *cp = rq_ctxmap[cidx];
-DEVICE *dptr = rq_devmap[cidx];
+if ((PA >> 1) & 01)                                     /* decode PA<1> */
+    return rq_rd_sa (data, PA, access);
+return rq_rd_ip (data, PA, access);
+}
 
-sim_debug(DBG_REG, dptr, "rq_rd(PA=0x%08X [%s], access=%d)=0x%04X\n", PA, ((PA >> 1) & 01) ? "SA" : "IP", access, ((PA >> 1) & 01) ? cp->sa : 0);
+t_stat rq_wr (int32 data, int32 PA, int32 access)
+{
+if ((PA >> 1) & 01)                                     /* decode PA<1> */
+    return rq_wr_sa (data, PA, access);
+return rq_wr_ip (data, PA, access);
+}
 
-if (cidx < 0)
-    return SCPE_IERR;
-switch ((PA >> 1) & 01) {                               /* decode PA<1> */
-
-    case 0:                                             /* IP */
-        *data = 0;                                      /* reads zero */
-        if (cp->csta == CST_S3_PPB)                     /* waiting for poll? */
-            rq_step4 (cp);
-        else if (cp->csta == CST_UP) {                  /* if up */
-            sim_debug (DBG_REQ, dptr, "poll started, PC=%X\n", OLDPC);
-            cp->pip = 1;                                /* poll host */
-            sim_activate (dptr->units + RQ_QUEUE, rq_qtime);
-            }
-        break;
+t_stat rq_rd_ip (int32 *data, int32 PA, int32 access)
+{
+MSC *cp = (MSC *) IOREG_CTX (PA);
+DEVICE *dptr;
 
-    case 1:                                             /* SA */
-        *data = cp->sa;
-        break;
-        }
+if (cp == NULL)
+    return SCPE_IERR;
+dptr = rq_devmap[cp->cnum];
+sim_debug(DBG_REG, dptr, "rq_rd(PA=0x%08X [IP], access=%d)=0x%04X\n", PA, access, 0);
+*data = 0;                                              /* reads zero */
+if (cp->csta == CST_S3_PPB)                             /* waiting for poll? */
+    rq_step4 (cp);
+else if (cp->csta == CST_UP) {                          /* if up */
+    sim_debug (DBG_REQ, dptr, "poll started, PC=%X\n", OLDPC);
+    cp->pip = 1;                                        /* poll host */
+    sim_activate (dptr->units + RQ_QUEUE, rq_qtime);
+    }
 return SCPE_OK;
 }
 
-t_stat rq_wr (int32 data, int32 PA, int32 access)
+t_stat rq_rd_sa (int32 *data, int32 PA, int32 access)
 {
-int32 cidx = rq_map_pa ((uint32) PA);
-MSC *cp = rq_ctxmap[cidx];
-DEVICE *dptr = rq_devmap[cidx];
+MSC *cp = (MSC *) IOREG_CTX (PA);
 
-if (cidx < 0)
+if (cp == NULL)
     return SCPE_IERR;
+sim_debug(DBG_REG, rq_devmap[cp->cnum], "rq_rd(PA=0x%08X [SA], access=%d)=0x%04X\n", PA, access, cp->sa);
+*data = cp->sa;
+return SCPE_OK;
+}
 
-sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [%s], access=%d, data=0x%04X)\n", PA, ((PA >> 1) & 01) ? "SA" : "IP", access, data);
-
-switch ((PA >> 1) & 01) {                               /* decode PA<1> */
-
-    case 0:                                             /* IP */
-        rq_reset (rq_devmap[cidx]);                     /* init device */
-        sim_debug (DBG_REQ, dptr, "initialization started\n");
-        break;
-
-    case 1:                                             /* SA */
-        cp->saw = data;
-        if (cp->csta < CST_S4)                          /* stages 1-3 */
-            sim_activate (dptr->units + RQ_QUEUE, rq_itime);
-        else if (cp->csta == CST_S4)                    /* stage 4 (fast) */
-            sim_activate (dptr->units + RQ_QUEUE, rq_itime4);
-        break;
-        }
+t_stat rq_wr_ip (int32 data, int32 PA, int32 access)
+{
+MSC *cp = (MSC *) IOREG_CTX (PA);
+DEVICE *dptr;
 
+if (cp == NULL)
+    return SCPE_IERR;
+dptr = rq_devmap[cp->cnum];
+sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [IP], access=%d, data=0x%04X)\n", PA, access, data);
+rq_reset (dptr);                                        /* init device */
+sim_debug (DBG_REQ, dptr, "initialization started\n");
 return SCPE_OK;
 }
 
-/* Map physical address to device context */
-
-int32 rq_map_pa (uint32 pa)
+t_stat rq_wr_sa (int32 data, int32 PA, int32 access)
 {
-int32 i;
+MSC *cp = (MSC *) IOREG_CTX (PA);
 DEVICE *dptr;
-DIB *dibp;
 
-for (i = 0; i < RQ_NUMCT; i++) {                        /* loop thru ctrls */
-    dptr = rq_devmap[i];                                /* get device */
-    dibp = (DIB *) dptr->ctxt;                          /* get DIB */
-    if ((pa >= dibp->ba) &&                             /* in range? */
-        (pa < (dibp->ba + dibp->lnt)))
-        return i;                                       /* return ctrl idx */
-    }
-return -1;
+if (cp == NULL)
+    return SCPE_IERR;
+dptr = rq_devmap[cp->cnum];
+sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [SA], access=%d, data=0x%04X)\n", PA, access, data);
+cp->saw = data;
+if (cp->csta < CST_S4)                                  /* stages 1-3 */
+    sim_activate (dptr->units + RQ_QUEUE, rq_itime);
+else if (cp->csta == CST_S4)                            /* stage 4 (fast) */
+    sim_activate (dptr->units + RQ_QUEUE, rq_itime4);
+return SCPE_OK;
 }
 
 /* Transition to step 4 - init communications region */
@@ -2156,6 +2163,10 @@ if ((cmd == OP_ERS) || (cmd == OP_WR)) {                /* write op? */
     }
 
 if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
+    uptr->rqxp = sim_disk_mapped (uptr, bl,             /* container mapped? */
+                                  (tbc + RQ_NUMBY - 1) / RQ_NUMBY, (cmd == OP_WR));
+    if (uptr->rqxp == NULL)                             /* no, use buffer */
+        uptr->rqxp = uptr->rqxb;
     if (cmd == OP_ERS) {                                /* erase? */
         wwc = ((tbc + (RQ_NUMBY - 1)) & ~(RQ_NUMBY - 1)) >> 1;
         memset (uptr->rqxb, 0, wwc * sizeof(uint16));   /* clr buf */
@@ -2164,18 +2175,18 @@ if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
         }
 
     else if (cmd == OP_WR) {                            /* write? */
-        t = rq_readw (ba, tbc, ma, (uint16 *)uptr->rqxb);/* fetch buffer */
+        t = rq_readw (ba, tbc, ma, (uint16 *)uptr->rqxp);/* fetch buffer */
         if ((abc = tbc - t)) {                          /* any xfer? */
             wwc = ((abc + (RQ_NUMBY - 1)) & ~(RQ_NUMBY - 1)) >> 1;
             for (i = (abc >> 1); i < wwc; i++)
-                ((uint16 *)(uptr->rqxb))[i] = 0;
-            sim_disk_data_trace(uptr, (uint8 *)uptr->rqxb, bl, wwc << 1, "sim_disk_wrsect-WR", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
-            err = sim_disk_wrsect_a (uptr, bl, (uint8 *)uptr->rqxb, NULL, (wwc << 1) / RQ_NUMBY, rq_io_complete);
+                ((uint16 *)(uptr->rqxp))[i] = 0;
+            sim_disk_data_trace(uptr, (uint8 *)uptr->rqxp, bl, wwc << 1, "sim_disk_wrsect-WR", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
+            err = sim_disk_wrsect_a (uptr, bl, (uint8 *)uptr->rqxp, NULL, (wwc << 1) / RQ_NUMBY, rq_io_complete);
             }
         }
 
     else {  /* OP_RD & OP_CMP */
-        err = sim_disk_rdsect_a (uptr, bl, (uint8 *)uptr->rqxb, NULL, (tbc + RQ_NUMBY - 1) / RQ_NUMBY, rq_io_complete);
+        err = sim_disk_rdsect_a (uptr, bl, (uint8 *)uptr->rqxp, NULL, (tbc + RQ_NUMBY - 1) / RQ_NUMBY, rq_io_complete);
         }                                               /* end else read */
     return SCPE_OK;                                     /* done for now until callback */    
     }
@@ -2198,9 +2209,9 @@ else { /* Bottom End (After I/O processing) */
         }
 
     else {
-        sim_disk_data_trace(uptr, (uint8 *)uptr->rqxb, bl, tbc, "sim_disk_rdsect", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
+        sim_disk_data_trace(uptr, (uint8 *)uptr->rqxp, bl, tbc, "sim_disk_rdsect", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
         if ((cmd == OP_RD) && !err) {                   /* read? */
-            if ((t = rq_writew (ba, tbc, ma, (uint16 *)uptr->rqxb))) {/* store, nxm? */
+            if ((t = rq_writew (ba, tbc, ma, (uint16 *)uptr->rqxp))) {/* store, nxm? */
                 PUTP32 (pkt, RW_WBCL, bc - (tbc - t));  /* adj bc */
                 PUTP32 (pkt, RW_WBAL, ba + (tbc - t));  /* adj ba */
                 if (rq_hbe (cp, uptr))                  /* post err log */
@@ -2218,7 +2229,7 @@ else { /* Bottom End (After I/O processing) */
                         rq_rw_end (cp, uptr, EF_LOG, ST_HST | SB_HST_NXM);
                     return SCPE_OK;
                     }
-                dby = (((uint16 *)(uptr->rqxb))[i >> 1] >> ((i & 1)? 8: 0)) & 0xFF;
+                dby = (((uint16 *)(uptr->rqxp))[i >> 1] >> ((i & 1)? 8: 0)) & 0xFF;
                 if (mby != dby) {                       /* cmp err? */
                     PUTP32 (pkt, RW_WBCL, bc - i);      /* adj bc */
                     rq_rw_end (cp, uptr, 0, ST_CMP);    /* done */
@@ -2863,6 +2874,9 @@ if (cidx < 0)                                           /* not found??? */
     return SCPE_IERR;
 cp = rq_ctxmap[cidx];                                   /* get context */
 cp->cnum = cidx;                                        /* init index */
+if ((set_ioreg (dibp, 0, &rq_rd_ip, &rq_wr_ip, cp) != SCPE_OK) || /* IP, SA handlers */
+    (set_ioreg (dibp, 2, &rq_rd_sa, &rq_wr_sa, cp) != SCPE_OK))
+    return SCPE_IERR;
 if (cp->ctype == DEFAULT_CTYPE)
     cp->ctype = (UNIBUS? UDA50_CTYPE : RQDX3_CTYPE);
 
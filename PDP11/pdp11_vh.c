@@ -102,6 +102,7 @@ extern int32    tmxr_poll, clk_tps;
 #define VH_LINES    (UNIBUS?16:8)
 #endif
 #define VH_LINES_ALLOC 16
+#define VH_DMA_CHUNK   64                  /* DMA fetch size */
 
 #define UNIT_V_MODEDHU  (UNIT_V_UF + 0)
 #define UNIT_V_FASTDMA  (UNIT_V_UF + 1)
@@ -1325,18 +1326,31 @@ static void doDMA ( int32   vh,
         pa = lp->tbuf1;
         pa |= (lp->tbuf2 & TB2_M_TBUFFAD) << 16;
         status = chan << CSR_V_TX_LINE;
+        /* fetch the buffer in chunks; a chunk is only partly consumed
+           when the line stalls, and a bus error is only reported once
+           every byte before the bad address has been sent */
         while (lp->tbuffct) {
-            uint8   buf;
-            if (Map_ReadB (pa, 1, &buf)) {
+            uint8   buf[VH_DMA_CHUNK];
+            int32   i, cnt, good;
+
+            cnt = (lp->tbuffct < VH_DMA_CHUNK) ? lp->tbuffct : VH_DMA_CHUNK;
+            if ((pa + cnt) > (1u << 22))        /* don't run past 4MB */
+                cnt = (1 << 22) - pa;
+            good = cnt - Map_ReadB (pa, cnt, buf);
+            for (i = 0; i < good; i++) {
+                if (vh_putc (vh, lp, chan, buf[i]) != SCPE_OK)
+                    break;
+                /* pa = (pa + 1) & PAMASK; */
+                pa = (pa + 1) & ((1 << 22) - 1);
+                lp->tbuffct--;
+            }
+            if (i < good)                       /* line stalled */
+                break;
+            if (good < cnt) {                   /* bus error */
                 status |= CSR_TX_DMA_ERR;
                 lp->tbuffct = 0;
                 break;
             }
-            if (vh_putc (vh, lp, chan, buf) != SCPE_OK)
-                break;
-            /* pa = (pa + 1) & PAMASK; */
-            pa = (pa + 1) & ((1 << 22) - 1);
-            lp->tbuffct--;
         }
         lp->tbuf1 = pa & 0177777;
         lp->tbuf2 = (lp->tbuf2 & ~TB2_M_TBUFFAD) |
@@ -276,6 +276,8 @@ t_stat xq_show_sanity (FILE* st, UNIT* uptr, int32 val, CONST void* desc);
 t_stat xq_set_sanity (UNIT* uptr, int32 val, CONST char* cptr, void* desc);
 t_stat xq_show_throttle (FILE* st, UNIT* uptr, int32 val, CONST void* desc);
 t_stat xq_set_throttle (UNIT* uptr, int32 val, CONST char* cptr, void* desc);
+t_stat xq_show_capture (FILE* st, UNIT* uptr, int32 val, CONST void* desc);
+t_stat xq_set_capture (UNIT* uptr, int32 val, CONST char* cptr, void* desc);
 t_stat xq_show_lockmode (FILE* st, UNIT* uptr, int32 val, CONST void* desc);
 t_stat xq_set_lockmode (UNIT* uptr, int32 val, CONST char* cptr, void* desc);
 t_stat xq_show_poll (FILE* st, UNIT* uptr, int32 val, CONST void* desc);
@@ -512,6 +514,10 @@ MTAB xq_mod[] = {
     &xq_set_sanity, &xq_show_sanity, NULL, "Sanity timer" },
   { MTAB_XTD|MTAB_VDV|MTAB_VALR, 0, "THROTTLE", "THROTTLE=DISABLED|TIME=n{;BURST=n{;DELAY=n}}",
     &xq_set_throttle, &xq_show_throttle, NULL, "Display transmit throttle configuration" },
+  { MTAB_XTD|MTAB_VDV|MTAB_VALR|MTAB_NC, 0, "CAPTURE", "CAPTURE=file{;MAXSIZE=n{;FILES=n}}",
+    &xq_set_capture, &xq_show_capture, NULL, "Capture packets to a pcapng file" },
+  { MTAB_XTD|MTAB_VDV, 1, NULL, "NOCAPTURE",
+    &xq_set_capture, NULL, NULL, "Stop packet capture" },
   { MTAB_XTD|MTAB_VDV|MTAB_VALR, 0, "DEQNALOCK", "DEQNALOCK={ON|OFF}",
     &xq_set_lockmode, &xq_show_lockmode, NULL, "DEQNA-Lock mode" },
   { MTAB_XTD|MTAB_VDV,           0, "LEDS", NULL,
@@ -945,6 +951,35 @@ t_stat xq_set_throttle (UNIT* uptr, int32 val, CONST char* cptr, void* desc)
   return SCPE_OK;
 }
 
+t_stat xq_show_capture (FILE* st, UNIT* uptr, int32 val, CONST void* desc)
+{
+  CTLR* xq = xq_unit2ctlr(uptr);
+
+  if (xq->var->capture[0])
+    fprintf(st, "capture=%s", xq->var->capture);
+  else
+    fprintf(st, "nocapture");
+  return SCPE_OK;
+}
+
+t_stat xq_set_capture (UNIT* uptr, int32 val, CONST char* cptr, void* desc)
+{
+  CTLR* xq = xq_unit2ctlr(uptr);
+  t_stat r;
+
+  if (val)                                  /* NOCAPTURE */
+    cptr = "";
+  else
+    if ((!cptr) || (!*cptr) || (strlen(cptr) >= sizeof(xq->var->capture)))
+      return SCPE_ARG;
+  /* start (or stop) now if attached, otherwise just check the specification */
+  r = eth_set_capture (xq->var->etherface, cptr);
+  if (r != SCPE_OK)
+    return r;
+  strcpy(xq->var->capture, cptr);
+  return SCPE_OK;
+}
+
 t_stat xq_show_lockmode (FILE* st, UNIT* uptr, int32 val, CONST void* desc)
 {
   CTLR* xq = xq_unit2ctlr(uptr);
@@ -2851,6 +2886,8 @@ t_stat xq_attach(UNIT* uptr, CONST char* cptr)
     return status;
   }
   eth_set_throttle (xq->var->etherface, xq->var->throttle_time, xq->var->throttle_burst, xq->var->throttle_delay);
+  if (xq->var->capture[0])
+    eth_set_capture (xq->var->etherface, xq->var->capture);
   if (xq->var->poll == 0) {
     status = eth_set_async(xq->var->etherface, xq->var->coalesce_latency_ticks);
     if (status != SCPE_OK) {
@@ -3256,6 +3293,21 @@ const char helpString[] =
     " the TIME gap that will cause a delay in sending subsequent packets.\n"
     " DELAY specifies the number of milliseconds which a throttled packet will\n"
     " be delayed prior to its transmission.\n"
+    "\n"
+     /****************************************************************************/
+    "3 CAPTURE\n"
+    " All packets sent and received by the simulated device can be recorded\n"
+    " in a pcapng file, readable by Wireshark or tcpdump, without the overhead\n"
+    " of tracing them to the debug log:\n"
+    "\n"
+    "+sim> SET %D CAPTURE=file{;MAXSIZE=n{;FILES=n}}\n"
+    "+sim> SET %D NOCAPTURE\n"
+    "\n"
+    " Each packet is recorded with the host time, its direction and the\n"
+    " simulated time (as the packet comment).  MAXSIZE limits the file to\n"
+    " n megabytes; when it fills, it is renamed file.1 (file.1 to file.2,\n"
+    " etc.) and a new file started, keeping FILES files in all (default 2).\n"
+    " Capture may be set up before or after the device is attached.\n"
     "\n"
      /****************************************************************************/
     "2 Attach\n"
@@ -303,6 +303,7 @@ struct xq_device {
   uint32            rbdl_ba;
   uint32            xbdl_ba;
   ETH_DEV*          etherface;
+  char              capture[CBUFSIZE];                  /* packet capture specification, empty if none */
   ETH_PACK          read_buffer;
   ETH_PACK          write_buffer;
   ETH_QUE           ReadQ;
@@ -102,7 +102,6 @@ DEVICE *sim_devices[] = {
 t_stat sim_load (FILE *fileref, CONST char *cptr, CONST char *fnam, int flag)
 {
 t_stat r;
-int32 i;
 uint32 origin, limit;
 
 if (flag)                                               /* dump? */
@@ -114,12 +113,6 @@ if (sim_switches & SWMASK ('O')) {                      /* origin? */
     if (r != SCPE_OK)
         return SCPE_ARG;
     }
-while ((i = Fgetc (fileref)) != EOF) {                   /* read byte stream */
-    if (origin >= limit)                                /* NXM? */
-        return SCPE_NXM;
-    else WriteB (origin, i);                            /* store byte */
-    origin = origin + 1;
-    }
-return SCPE_OK;
+return vax_load_bytes (fileref, origin, limit, 1, FALSE);/* load byte stream */
 }
 
@@ -108,7 +108,6 @@ DEVICE *sim_devices[] = {
 t_stat sim_load (FILE *fileref, CONST char *cptr, CONST char *fnam, int flag)
 {
 t_stat r;
-int32 val;
 uint32 origin, limit;
 
 if (flag)                                               /* dump? */
@@ -125,15 +124,6 @@ else
         if (r != SCPE_OK)
             return SCPE_ARG;
         }
-
-while ((val = Fgetc (fileref)) != EOF) {                 /* read byte stream */
-    if (origin >= limit)                                /* NXM? */
-        return SCPE_NXM;
-    if (sim_switches & SWMASK ('R'))                    /* ROM? */
-        rom_wr_B (origin, val);                         /* not writeable */
-    else
-        WriteB (origin, val);                           /* store byte */
-    origin = origin + 1;
-    }
-return SCPE_OK;
+return vax_load_bytes (fileref, origin, limit, 1,        /* load byte stream */
+    (sim_switches & SWMASK ('R')) != 0);
 }
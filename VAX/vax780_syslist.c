@@ -118,8 +118,7 @@ DEVICE *sim_devices[] = {
 t_stat sim_load (FILE *fileref, CONST char *cptr, CONST char *fnam, int flag)
 {
 t_stat r;
-int32 val;
-uint32 origin, limit;
+uint32 origin, limit, base;
 
 if (flag)                                               /* dump? */
     return sim_messagef (SCPE_NOFNC, "Command Not Implemented\n");
@@ -130,26 +129,13 @@ if (sim_switches & SWMASK ('O')) {                      /* origin? */
     if (r != SCPE_OK)
         return SCPE_ARG;
     }
-
-while ((val = Fgetc (fileref)) != EOF) {                 /* read byte stream */
-    if (sim_switches & SWMASK ('R')) {                  /* ROM0? */
-        if (origin >= ROMSIZE)
-            return SCPE_NXM;
-        rom_wr_B (ROM0BASE + origin, val);
-        }
-    else if (sim_switches & SWMASK ('S')) {             /* ROM1? */
-        if (origin >= ROMSIZE)
-            return SCPE_NXM;
-        rom_wr_B (ROM1BASE + origin, val);
-        }
-    else {
-        if (origin >= limit)                            /* NXM? */
-            return SCPE_NXM;
-        WriteB (origin, val);                           /* memory */
-        }
-    origin = origin + 1;
+if (sim_switches & (SWMASK ('R') | SWMASK ('S'))) {     /* ROM0, ROM1? */
+    base = (sim_switches & SWMASK ('R'))? ROM0BASE: ROM1BASE;
+    if (origin > ROMSIZE)                               /* past end? */
+        origin = ROMSIZE;
+    return vax_load_bytes (fileref, base + origin, base + ROMSIZE, 1, TRUE);
     }
-return SCPE_OK;
+return vax_load_bytes (fileref, origin, limit, 1, FALSE);/* load byte stream */
 }
 
 
@@ -264,6 +264,12 @@ MTAB uba_mod[] = {
       NULL, &show_nexus, NULL, "Display nexus" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IOSPACE", NULL,
       NULL, &show_iospace, NULL, "Display IO address space assignments" },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IOSTATS", NULL,
+      NULL, &show_iostats, NULL, "Display I/O page access counts" },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "IOSTATS",
+      &set_iostats, NULL, NULL, "Enable (or restart) I/O page access counts" },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIOSTATS",
+      &set_iostats, NULL, NULL, "Disable I/O page access counts" },
     { MTAB_XTD|MTAB_VDV, 1, "AUTOCONFIG", "AUTOCONFIG",
       &set_autocon, &show_autocon, NULL, "Enable/Display autoconfiguration" },
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOAUTOCONFIG",
@@ -480,6 +486,8 @@ int32 idx, val;
 if (ADDR_IS_IOP (pa) && !uba_uiip) {                    /* iopage,!init */
     idx = (pa & IOPAGEMASK) >> 1;
     if (iodispR[idx]) {
+        if (iostatR)                                    /* counting? */
+            iostatR[idx]++;
         iodispR[idx] (&val, pa, READ);
         return val;
         }
@@ -495,6 +503,8 @@ int32 idx;
 if (ADDR_IS_IOP (pa) && !uba_uiip) {                    /* iopage,!init */
     idx = (pa & IOPAGEMASK) >> 1;
     if (iodispW[idx]) {
+        if (iostatW)                                    /* counting? */
+            iostatW[idx]++;
         iodispW[idx] (val, pa, mode);
         return;
         }
@@ -882,6 +882,7 @@ extern t_bool BadCmPSL (int32 newpsl);
 
 /* vax_sys.c externals */
 extern const uint16 drom[NUM_INST][MAX_SPEC + 1];
+extern t_stat vax_load_bytes (FILE *fileref, uint32 origin, uint32 limit, uint32 step, t_bool rom);
 
 /* Model dependent definitions */
 extern int32 eval_int (void);
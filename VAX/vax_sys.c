@@ -717,6 +717,49 @@ const char* regname[] = {
 #define GETNUM(d,n)     for (k = d = 0; k < n; k++) \
                     d = d | (((int32) val[vp++]) << (k * 8))
 
+/* Byte stream loader
+
+   The model loaders load a raw byte stream from origin up to limit,
+   into memory or ROM, at a given address step.  The file is read into
+   memory once; unit steps into memory are deposited a longword at a
+   time where aligned.  Running past limit returns SCPE_NXM.
+*/
+
+t_stat vax_load_bytes (FILE *fileref, uint32 origin, uint32 limit, uint32 step, t_bool rom)
+{
+MEMFILE img;
+const uint8 *bp;
+size_t i;
+t_stat r;
+
+r = sim_load_image (fileref, &img);                     /* read file */
+if (r != SCPE_OK)
+    return r;
+bp = (const uint8 *) img.buf;
+for (i = 0; i < img.size; ) {
+    if (origin >= limit) {                              /* NXM? */
+        r = SCPE_NXM;
+        break;
+        }
+    if (rom)                                            /* ROM? */
+        rom_wr_B (origin, bp[i]);                       /* not writeable */
+    else if ((step == 1) && ((origin & 3) == 0) &&      /* aligned lw? */
+        ((img.size - i) >= 4) && ((limit - origin) >= 4) &&
+        ADDR_IS_MEM (origin)) {
+        WriteL (origin, (int32) (bp[i] | (bp[i + 1] << 8) |
+            (bp[i + 2] << 16) | (((uint32) bp[i + 3]) << 24)));
+        origin = origin + 4;
+        i = i + 4;
+        continue;
+        }
+    else WriteB (origin, bp[i]);                        /* store byte */
+    origin = origin + step;
+    i = i + 1;
+    }
+sim_load_image_free (&img);
+return r;
+}
+
 /* Symbolic decode
 
    Inputs:
@@ -1135,6 +1135,15 @@ static const char simh_help[] =
       "3Asynch\n"
       "+set asynch                  enable asynchronous I/O\n"
       "+set noasynch                disable asynchronous I/O\n"
+#define HLP_SET_DISKCACHE "*Commands SET Disk_Cache"
+      "3Disk_Cache\n"
+      "+set diskcache size          enable write-through disk block cache\n"
+      "+set diskcache size,writeback enable write-back disk block cache\n"
+      "+set nodiskcache             disable the disk block cache\n"
+      "++++++++                     The cache size is given in MB, or with a\n"
+      "++++++++                     K, M or G suffix.  The cache is shared by\n"
+      "++++++++                     all SIMH and VHD format disk units and is\n"
+      "++++++++                     write-through unless WRITEBACK is given.\n"
 #define HLP_SET_ENVIRON "*Commands SET Asynch"
       "3Environment\n"
       "+set environment name=val    set environment variable\n"
@@ -1184,6 +1193,12 @@ static const char simh_help[] =
       "+set <dev> arg{,arg...}      set device parameters (see show modifiers)\n"
       "+set <unit> ENABLED          enable unit\n"
       "+set <unit> DISABLED         disable unit\n"
+      "+set <unit> COMMIT           write a disk unit's memory overlay (ATTACH -T)\n"
+      "++++++++                     to its container\n"
+      "+set <unit> IOMODE=mode      select a disk unit's container I/O: STDIO,\n"
+      "++++++++                     POSITIONED, DIRECT or MAPPED (set before\n"
+      "++++++++                     attaching)\n"
+      "+set <unit> IOSTATS=RESET    clear a disk unit's I/O statistics\n"
       "+set <unit> arg{,arg...}     set unit parameters (see show modifiers)\n"
       "+help <dev> set              displays the device specific set commands\n"
       "++++++++                     available\n"
@@ -1212,6 +1227,10 @@ static const char simh_help[] =
       "+sh{ow} <dev> SHOW           show device SHOW commands\n"
       "+sh{ow} <dev> {arg,...}      show device parameters\n"
       "+sh{ow} <unit> {arg,...}     show unit parameters\n"
+      "+sh{ow} <unit> IOSTATS       show disk unit I/O statistics\n"
+      "+sh{ow} <unit> IOCSV         show disk unit I/O statistics as a CSV\n"
+      "++++++++                     record (SHOW @file <unit> IOCSV appends)\n"
+      "+sh{ow} <unit> IOMODE        show disk unit container I/O mode\n"
       "+sh{ow} ethernet             show ethernet devices\n"
       "+sh{ow} serial               show serial devices\n"
       "+sh{ow} multiplexer          show open multiplexer devices\n"
@@ -1220,6 +1239,7 @@ static const char simh_help[] =
 #endif
       "+sh{ow} clocks               show calibrated timer information\n"
       "+sh{ow} throttle             show throttle info\n"
+      "+sh{ow} diskcache            show disk block cache statistics\n"
       "+sh{ow} on                   show on condition actions\n"
       "+h{elp} <dev> show           displays the device specific show commands\n"
       "++++++++                     available\n"
@@ -1240,6 +1260,7 @@ static const char simh_help[] =
 #define HLP_SHOW_DEBUG          "*Commands SHOW"
 #define HLP_SHOW_THROTTLE       "*Commands SHOW"
 #define HLP_SHOW_ASYNCH         "*Commands SHOW"
+#define HLP_SHOW_DISKCACHE      "*Commands SHOW"
 #define HLP_SHOW_ETHERNET       "*Commands SHOW"
 #define HLP_SHOW_SERIAL         "*Commands SHOW"
 #define HLP_SHOW_MULTIPLEXER    "*Commands SHOW"
@@ -1860,6 +1881,8 @@ static CTAB set_glob_tab[] = {
     { "CLOCKS",     &sim_set_timers,            1, HLP_SET_CLOCKS },
     { "ASYNCH",     &sim_set_asynch,            1, HLP_SET_ASYNCH },
     { "NOASYNCH",   &sim_set_asynch,            0, HLP_SET_ASYNCH },
+    { "DISKCACHE",  &sim_disk_set_cache,        1, HLP_SET_DISKCACHE },
+    { "NODISKCACHE", &sim_disk_set_cache,       0, HLP_SET_DISKCACHE },
     { "ENVIRONMENT", &sim_set_environment,      1, HLP_SET_ENVIRON },
     { "ON",         &set_on,                    1, HLP_SET_ON },
     { "NOON",       &set_on,                    0, HLP_SET_ON },
@@ -1889,6 +1912,11 @@ static C1TAB set_dev_tab[] = {
 static C1TAB set_unit_tab[] = {
     { "ENABLED",    &set_unit_enbdis,   1 },
     { "DISABLED",   &set_unit_enbdis,   0 },
+    { "COMMIT",     &sim_disk_commit,   0 },
+    { "IOMODE",     &sim_disk_set_iomode, 0 },
+    { "IOSTATS",    &sim_disk_set_iostats, 0 },
+    { "ZEROELIDE",  &sim_disk_set_zeroelide, 1 },
+    { "NOZEROELIDE", &sim_disk_set_zeroelide, 0 },
     { NULL,         NULL,               0 }
     };
 
@@ -1911,6 +1939,7 @@ static SHTAB show_glob_tab[] = {
     { "DEBUG",          &sim_show_debug,            0, HLP_SHOW_DEBUG },
     { "THROTTLE",       &sim_show_throt,            0, HLP_SHOW_THROTTLE },
     { "ASYNCH",         &sim_show_asynch,           0, HLP_SHOW_ASYNCH },
+    { "DISKCACHE",      &sim_disk_show_cache,       0, HLP_SHOW_DISKCACHE },
     { "ETHERNET",       &eth_show_devices,          0, HLP_SHOW_ETHERNET },
     { "SERIAL",         &sim_show_serial,           0, HLP_SHOW_SERIAL },
     { "MULTIPLEXER",    &tmxr_show_open_devices,    0, HLP_SHOW_MULTIPLEXER },
@@ -1935,6 +1964,9 @@ static SHTAB show_dev_tab[] = {
     };
 
 static SHTAB show_unit_tab[] = {
+    { "IOSTATS",    &sim_disk_show_iostats,     0 },
+    { "IOCSV",      &sim_disk_show_iostats,     1 },
+    { "IOMODE",     &sim_disk_show_iomode,      0 },
     { NULL, NULL, 0 }
     };
 
@@ -5424,6 +5456,104 @@ else
     return fgetc (f);
 }
 
+/* Load images
+
+   Loaders that decode a whole load file read it into memory at once
+   with sim_load_image, and decode it from there, instead of reading it
+   a byte or word at a time.  The image is the rest of the file, or the
+   memory load file if one is set up.  sim_load_image_read is the analog
+   of sim_fread (with the same endian conversion), sim_load_image_getc
+   and sim_load_image_gets of fgetc and fgets.  The position in the
+   image is pos, and may be set beyond its end.
+*/
+
+t_stat sim_load_image (FILE *f, MEMFILE *img)
+{
+t_offset fsize, fpos;
+size_t cap, n;
+char *nbuf;
+
+memset (img, 0, sizeof (*img));
+if (mem_data) {                                         /* memory load file? */
+    img->buf = (char *)malloc (mem_data_size + 1);
+    if (img->buf == NULL)
+        return SCPE_MEM;
+    memcpy (img->buf, mem_data, mem_data_size);
+    img->size = mem_data_size;
+    mem_data += mem_data_size;                          /* consumed */
+    mem_data_size = 0;
+    return SCPE_OK;
+    }
+fsize = sim_fsize_ex (f);
+fpos = sim_ftell (f);
+cap = ((fsize > fpos) ? (size_t)(fsize - fpos) : 0) + 1;/* room to see EOF */
+img->buf = (char *)malloc (cap);
+while (img->buf != NULL) {
+    n = fread (img->buf + img->size, 1, cap - img->size, f);
+    if (n == 0)                                         /* EOF or error? */
+        break;
+    img->size += n;
+    if (img->size == cap) {                             /* grew? */
+        cap = 2 * cap;
+        nbuf = (char *)realloc (img->buf, cap);
+        if (nbuf == NULL)
+            free (img->buf);
+        img->buf = nbuf;
+        }
+    }
+if (img->buf == NULL) {
+    img->size = 0;
+    return SCPE_MEM;
+    }
+if (ferror (f)) {
+    sim_load_image_free (img);
+    return SCPE_IOERR;
+    }
+return SCPE_OK;
+}
+
+void sim_load_image_free (MEMFILE *img)
+{
+free (img->buf);
+memset (img, 0, sizeof (*img));
+}
+
+size_t sim_load_image_read (void *bptr, size_t size, size_t count, MEMFILE *img)
+{
+size_t avail;
+
+if ((size == 0) || (img->pos >= img->size))
+    return 0;
+avail = (img->size - img->pos) / size;
+if (count > avail)
+    count = avail;
+sim_buf_copy_swapped (bptr, img->buf + img->pos, size, count);
+img->pos += size * count;
+return count;
+}
+
+int sim_load_image_getc (MEMFILE *img)
+{
+if (img->pos >= img->size)
+    return EOF;
+return (int)((unsigned char)img->buf[img->pos++]);
+}
+
+char *sim_load_image_gets (char *buf, int size, MEMFILE *img)
+{
+int i = 0;
+
+if ((size <= 0) || (img->pos >= img->size))
+    return NULL;
+while ((i < size - 1) && (img->pos < img->size)) {
+    buf[i] = img->buf[img->pos++];
+    if (buf[i++] == '\n')
+        break;
+    }
+buf[i] = '\0';
+return buf;
+}
+
 
 t_stat load_cmd (int32 flag, CONST char *cptr)
 {
@@ -5853,6 +5983,8 @@ REG *rptr;
 
 #define WRITE_I(xx) sim_fwrite (&(xx), sizeof (xx), 1, sfile)
 
+sim_disk_cache_flush ();                                /* disk images current */
+
 /* Don't make changes below without also changing save_vercur above */
 
 fprintf (sfile, "%s\n%s\n%s\n%s\n%s\n%.0f\n",
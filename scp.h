@@ -175,6 +175,11 @@ int Fprintf (FILE *f, const char *fmt, ...) GCC_FMT_ATTR(2, 3);
 #define fputc(_c,_f) Fprintf(_f,"%c",_c)
 t_stat sim_set_memory_load_file (const unsigned char *data, size_t size);
 int Fgetc (FILE *f);
+t_stat sim_load_image (FILE *f, MEMFILE *img);
+void sim_load_image_free (MEMFILE *img);
+size_t sim_load_image_read (void *bptr, size_t size, size_t count, MEMFILE *img);
+int sim_load_image_getc (MEMFILE *img);
+char *sim_load_image_gets (char *buf, int size, MEMFILE *img);
 t_stat fprint_val (FILE *stream, t_value val, uint32 rdx, uint32 wid, uint32 fmt);
 t_stat sprint_val (char *buf, t_value val, uint32 rdx, uint32 wid, uint32 fmt);
 t_stat sim_print_val (t_value val, uint32 radix, uint32 width, uint32 format);
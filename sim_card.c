@@ -474,8 +474,55 @@ static int cmpcard(const char *p, const char *s) {
 }
 
 
-t_stat
-sim_read_card(UNIT * uptr)
+/* Card deck cache.
+
+   Each card read from the deck file is located in the input buffer, its
+   format detected and its characters translated.  Instead of doing this
+   for every card read, the first read after attach converts the whole
+   deck into an array of card images, each with the status its read
+   returns, using the same conversion routine.  Reading a card then just
+   copies the next image.  Changing the format of an attached reader
+   converts the deck again.  A deck ending in a short binary or EBCDIC
+   card keeps returning that card's error, as reading the file does.  If
+   the deck can not be converted (out of memory or an I/O error) cards
+   are converted from the file as they are read.
+*/
+
+struct _card_image {
+    uint16              image[80];      /* Image */
+    t_stat              status;         /* Status returned by read */
+};
+
+struct _card_deck {
+    struct _card_image  *cards;         /* Cards of deck */
+    int                 count;          /* Number of cards */
+    int                 size;           /* Number allocated */
+    int                 next;           /* Next card to read */
+    t_bool              last;           /* Deck ends in short card, read again */
+    uint32              flags;          /* Unit format flags deck was converted with */
+};
+
+#define DECK_FLAGS      (UNIT_CARD_MODE|MODE_LOWER|MODE_CHAR)
+
+/* Card conversion state */
+#define CARD_NEXT       0               /* More cards may follow */
+#define CARD_LAST       1               /* Short card, nothing can follow */
+#define CARD_END        2               /* End of file, no card */
+#define CARD_ERROR      3               /* File I/O error, no card */
+
+static void
+sim_card_free_deck(struct _card_data *data)
+{
+    if (data->deck != 0) {
+        free(data->deck->cards);
+        free(data->deck);
+        data->deck = 0;
+    }
+}
+
+/* Convert next card in file, setting state when no more cards follow */
+static t_stat
+sim_card_convert(UNIT * uptr, int *state)
 {
     int                 i;
     char                c;
@@ -488,9 +535,7 @@ sim_read_card(UNIT * uptr)
     DEVICE              *dptr;
     t_stat              r = SCPE_OK;
 
-    if ((uptr->flags & UNIT_ATT) == 0)
-        return SCPE_UNATT;      /* attached? */
-
+    *state = CARD_NEXT;
     dptr = find_dev_from_unit( uptr);
     data = (struct _card_data *)uptr->up7;
     sim_debug(DEBUG_CARD, dptr, "Read card ");
@@ -523,12 +568,14 @@ sim_read_card(UNIT * uptr)
 
     if ((len < 0 || size == 0) && feof(uptr->fileref)) {
         sim_debug(DEBUG_CARD, dptr, "EOF\n");
+        *state = CARD_END;
         return SCPE_EOF;
     }
 
     if (ferror(uptr->fileref)) {        /* error? */
         perror("Card reader I/O error");
         clearerr(uptr->fileref);
+        *state = CARD_ERROR;
         return SCPE_IOERR;
     }
 
@@ -690,8 +737,10 @@ sim_read_card(UNIT * uptr)
     case MODE_BIN:
         temp = 0;
         sim_debug(DEBUG_CARD, dptr, "bin\n");
-        if (size < 160) 
+        if (size < 160) {
+            *state = CARD_LAST;
             return SCPE_IOERR;
+        }
         /* Move data to buffer */
         for (col = i = 0; i < 160;) {
             temp |= data->cbuff[i];
@@ -783,8 +832,10 @@ sim_read_card(UNIT * uptr)
 
     case MODE_EBCDIC:
         sim_debug(DEBUG_CARD, dptr, "ebcdic\n");
-        if (size < 80)
+        if (size < 80) {
+            *state = CARD_LAST;
             return SCPE_IOERR;
+        }
         /* Move data to buffer */
         for (i = 0; i < 80; i++) {
             temp = data->cbuff[i];
@@ -800,6 +851,115 @@ sim_read_card(UNIT * uptr)
     return r;
 }
 
+/* Convert the deck from the start of the file, keeping position next.
+   Returns 0 if the deck could not be converted. */
+static struct _card_deck *
+sim_card_build_deck(UNIT * uptr, int next)
+{
+    struct _card_data   *data = (struct _card_data *)uptr->up7;
+    struct _card_deck   *deck;
+    DEVICE              *dptr = find_dev_from_unit(uptr);
+    uint32              dctrl = 0;
+    int                 state = CARD_NEXT;
+    t_stat              r;
+
+    deck = (struct _card_deck *)calloc(1, sizeof(struct _card_deck));
+    if (deck == 0)
+        return 0;
+    deck->flags = uptr->flags & DECK_FLAGS;
+    deck->next = next;
+    sim_fseek(uptr->fileref, 0, SEEK_SET);
+    data->ptr = data->len = 0;
+    if (dptr != 0) {                    /* Cards are traced as they are read */
+        dctrl = dptr->dctrl;
+        dptr->dctrl &= ~DEBUG_CARD;
+    }
+    while (1) {
+        r = sim_card_convert(uptr, &state);
+        if (state == CARD_END)
+            break;
+        if (state == CARD_ERROR) {
+            free(deck->cards);
+            free(deck);
+            deck = 0;
+            break;
+        }
+        if (deck->count == deck->size) {
+            int                 size = deck->size ? 2 * deck->size : 256;
+            struct _card_image  *cards;
+
+            cards = (struct _card_image *)realloc(deck->cards,
+                                            size * sizeof(struct _card_image));
+            if (cards == 0) {
+                free(deck->cards);
+                free(deck);
+                deck = 0;
+                break;
+            }
+            deck->cards = cards;
+            deck->size = size;
+        }
+        memcpy(deck->cards[deck->count].image, data->image, sizeof(data->image));
+        deck->cards[deck->count++].status = r;
+        if (state == CARD_LAST) {       /* Short card ends the deck */
+            deck->last = TRUE;
+            break;
+        }
+    }
+    if (dptr != 0)
+        dptr->dctrl = dctrl;
+    if (deck != 0 && deck->last && deck->next >= deck->count)
+        deck->next = deck->count - 1;
+    if (deck == 0) {                    /* Read from file from here on */
+        sim_fseek(uptr->fileref, 0, SEEK_SET);
+        clearerr(uptr->fileref);
+        data->ptr = data->len = 0;
+        state = CARD_NEXT;
+        while (next-- > 0 && state == CARD_NEXT)
+            sim_card_convert(uptr, &state);
+    }
+    return deck;
+}
+
+t_stat
+sim_read_card(UNIT * uptr)
+{
+    struct _card_data   *data;
+    struct _card_deck   *deck;
+    DEVICE              *dptr;
+    int                 state;
+
+    if ((uptr->flags & UNIT_ATT) == 0)
+        return SCPE_UNATT;      /* attached? */
+
+    data = (struct _card_data *)uptr->up7;
+    deck = data->deck;
+    if (deck != 0 && deck->flags != (uptr->flags & DECK_FLAGS)) {
+        int                 next = deck->next;
+
+        sim_card_free_deck(data);       /* Format changed, convert again */
+        data->deck = deck = sim_card_build_deck(uptr, next);
+        data->nodeck = (deck == 0);
+    } else if (deck == 0 && !data->nodeck) {
+        data->deck = deck = sim_card_build_deck(uptr, 0);
+        data->nodeck = (deck == 0);
+    }
+    if (deck == 0)
+        return sim_card_convert(uptr, &state);
+
+    dptr = find_dev_from_unit( uptr);
+    if (deck->next >= deck->count) {
+        sim_debug(DEBUG_CARD, dptr, "Read card EOF\n");
+        return SCPE_EOF;
+    }
+    memcpy(data->image, deck->cards[deck->next].image, sizeof(data->image));
+    sim_debug(DEBUG_CARD, dptr, "Read card %d status %d\n", deck->next,
+              deck->cards[deck->next].status);
+    if (deck->last && deck->next == deck->count - 1)
+        return deck->cards[deck->next].status;
+    return deck->cards[deck->next++].status;
+}
+
 /* Check if reader is at last card.
  *
  */
@@ -812,6 +972,8 @@ sim_card_eof(UNIT *uptr)
         return 1;               /* attached? */
 
     data = (struct _card_data *)uptr->up7;
+    if (data->deck != 0)
+        return (data->deck->next >= data->deck->count);
         
     if (data->ptr > 0) {
         if ((data->ptr - data->len) == 0 && feof(uptr->fileref))
@@ -1050,6 +1212,7 @@ sim_card_attach(UNIT * uptr, CONST char *cptr)
         data = (struct _card_data *)uptr->up7;
     } else {
         data = (struct _card_data *)uptr->up7;
+        sim_card_free_deck(data);
     }
     memset(data, 0, sizeof(struct _card_data));
 
@@ -1093,6 +1256,7 @@ sim_card_detach(UNIT * uptr)
 {
     /* Free buffer if one allocated */
     if (uptr->up7 != 0) {
+        sim_card_free_deck((struct _card_data *)uptr->up7);
         free((void *)uptr->up7);
         uptr->up7 = 0;
     }
@@ -92,6 +92,8 @@ struct _card_data
     char                cbuff[1024];    /* Read in buffer for cards */
     uint16              image[80];      /* Image */
     uint8               hol_to_ascii[4096]; /* Back conversion table */
+    struct _card_deck   *deck;          /* Converted deck, built on first read */
+    int                 nodeck;         /* Deck could not be converted, read file */
 };
 
 /* Generic routines. */
@@ -611,6 +611,10 @@ struct UNIT {
 #define UNIT_TMR_UNIT   0000020         /* Unit registered as a calibrated timer */
 #define UNIT_V_DF_TAPE  5               /* Bit offset for Tape Density reservation */
 #define UNIT_S_DF_TAPE  3               /* Bits Reserved for Tape Density */
+#define UNIT_PIO        0000400         /* positioned container I/O (sim_disk) */
+#define UNIT_DIRECTIO   0001000         /* direct container I/O (sim_disk) */
+#define UNIT_MAPPED     0002000         /* memory mapped container I/O (sim_disk) */
+#define UNIT_ZEROELIDE  0004000         /* leave all zero writes sparse (sim_disk) */
 
 struct BITFIELD {
     const char      *name;                              /* field name */
@@ -50,6 +50,15 @@ Public routines:
    sim_disk_show_capac       show disk capacity
    sim_disk_set_async        enable asynchronous operation
    sim_disk_clr_async        disable asynchronous operation
+   sim_disk_set_cache        configure host block cache
+   sim_disk_show_cache       show host block cache statistics
+   sim_disk_cache_flush      write back host block cache
+   sim_disk_show_iostats     show unit I/O statistics
+   sim_disk_set_iostats      reset unit I/O statistics
+   sim_disk_commit           write a unit's memory overlay to its container
+   sim_disk_set_iomode       select stdio, positioned, direct or mapped container I/O
+   sim_disk_show_iomode      show container I/O mode
+   sim_disk_mapped           pointer to sectors in a mapped container
    sim_disk_data_trace       debug support
 
 Internal routines:
@@ -87,6 +96,32 @@ Internal routines:
 #include <pthread.h>
 #endif
 
+/* Per unit I/O statistics (SHOW <unit> IOSTATS).  Histograms have log2
+   buckets: bucket 0 counts zero (service time: under a microsecond) and
+   bucket n counts values from 2**(n-1) to 2**n - 1. */
+
+#define DK_IOS_RD       0
+#define DK_IOS_WR       1
+#define DK_SEEK_BUCKETS 33                  /* seek distance in sectors */
+#define DK_SVC_BUCKETS  26                  /* service time in usecs (the last holds 16 seconds and up) */
+#define DK_QD_BUCKETS   9                   /* requests outstanding */
+
+struct disk_iostats {
+    t_uint64            ops[2];             /* requests (read, write) */
+    t_uint64            sects[2];           /* sectors requested */
+    t_uint64            errors[2];          /* requests that failed */
+    t_uint64            usecs[2];           /* total host service time */
+    t_uint64            seq;                /* requests starting where the previous one ended */
+    t_uint64            seek_hist[DK_SEEK_BUCKETS];
+    t_uint64            svc_hist[2][DK_SVC_BUCKETS];
+    t_uint64            qd_hist[DK_QD_BUCKETS];
+    t_uint64            ra_sects;           /* sectors read ahead */
+    t_uint64            ra_hits;            /* sectors requested that were already read ahead */
+    uint32              qd_max;             /* deepest queue seen */
+    t_lba               next_lba;           /* sector following the previous request */
+    double              since;              /* host time the counts started */
+    };
+
 struct disk_context {
     DEVICE              *dptr;              /* Device for unit (access to debug flags) */
     uint32              dbit;               /* debugging bit */
@@ -96,25 +131,53 @@ struct disk_context {
     uint32              storage_sector_size;/* Sector size of the containing storage */
     uint32              removable;          /* Removable device flag */
     uint32              auto_format;        /* Format determined dynamically */
+    UNIT                *uptr;              /* Unit this context belongs to */
+    t_bool              cache_ok;           /* Eligible for the host block cache */
+    uint32              cache_dirty;        /* Dirty blocks in the host block cache */
+    t_uint64            cache_hits;         /* Sectors read from the host block cache */
+    t_uint64            cache_misses;       /* Sectors read from the container */
+    t_uint64            cache_deferred;     /* Sector writes absorbed by the host block cache */
+    t_uint64            zero_elided;        /* All zero sector writes not stored in the container */
+    t_bool              no_punch;           /* Host can't punch holes in the container */
+    t_bool              prealloc;           /* Container is fully allocated, don't elide zeros */
+    t_bool              zero_flush;         /* stdio writes pending since the size was cached */
+    t_offset            zero_fsize;         /* Cached container size for zero elision, -1 unknown */
+    t_bool              overlay;            /* Writes are held in a memory overlay */
+    struct disk_ochunk  **ovl_map;          /* Memory overlay chunk table */
+    t_lba               ovl_chunks;         /* Entries in ovl_map */
+    t_uint64            ovl_sects;          /* Sectors held in the memory overlay */
+    FILE                *dio_file;          /* Container opened for direct transfers (IOMODE=DIRECT) */
+    struct disk_iostats ios;                /* I/O statistics */
+    uint8               *ra_buf;            /* Read-ahead window (DK_RA_MAX bytes) */
+    t_lba               ra_lba;             /* First sector in ra_buf */
+    t_seccnt            ra_cnt;             /* Sectors in ra_buf */
+    t_seccnt            ra_window;          /* Sectors to read ahead next time */
+    t_lba               ra_next;            /* Sector following the previous read */
+    uint32              ra_run;             /* Sequential reads in a row */
+    uint32              ra_wasted;          /* Windows discarded unused in a row */
+    uint32              ra_off;             /* Reads to go before reading ahead again */
+    t_bool              ra_used;            /* Reads were served from ra_buf */
+    t_bool              ra_pending;         /* Asynchronous refill queued */
+    FILEMAP             *map;               /* Container mapping (IOMODE=MAPPED) */
+    uint8               *map_base;          /* Address of the mapped container data */
+    t_offset            map_size;           /* Bytes of container data mapped */
+    t_bool              map_wr;             /* Mapping is writable */
 #if defined _WIN32
     HANDLE              disk_handle;        /* OS specific Raw device handle */
 #endif
 #if defined SIM_ASYNCH_IO
     int                 asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
-    pthread_mutex_t     lock;
-    pthread_t           io_thread;          /* I/O Thread Id */
-    pthread_mutex_t     io_lock;
-    pthread_cond_t      io_cond;
-    pthread_cond_t      io_done;
-    pthread_cond_t      startup_cond;
-    int                 io_dop;
-    uint8               *buf;
-    t_seccnt            *rsects;
-    t_seccnt            sects;
-    t_lba               lba;
-    DISK_PCALLBACK      callback;
-    t_stat              io_status;
+    struct disk_req     *sq_head;           /* Submitted requests, oldest first */
+    struct disk_req     *sq_tail;
+    struct disk_req     *cq_head;           /* Completed requests awaiting callback */
+    struct disk_req     *cq_tail;
+    struct disk_context *ready_next;        /* Link in the worker pool ready list */
+    int                 ready;              /* On the worker pool ready list */
+    int                 busy;               /* A worker is servicing this unit */
+    uint32              queued;             /* Requests submitted and not yet performed */
+    pthread_t           worker;             /* Worker servicing the unit while busy */
+    pthread_cond_t      io_done;            /* Signalled when the unit goes idle */
 #endif
     };
 
@@ -127,27 +190,8 @@ struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;   \
 if ((!callback) || !ctx->asynch_io)
 
 #define AIO_CALL(op, _lba, _buf, _rsects, _sects,  _callback)   \
-    if (ctx->asynch_io) {                                       \
-        struct disk_context *ctx =                              \
-                      (struct disk_context *)uptr->disk_ctx;    \
-                                                                \
-        pthread_mutex_lock (&ctx->io_lock);                     \
-                                                                \
-        sim_debug (ctx->dbit, ctx->dptr,                        \
-      "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n",\
-                op, (int)(uptr-ctx->dptr->units), _lba, _sects);\
-                                                                \
-        if (ctx->callback)                                      \
-            abort(); /* horrible mistake, stop */               \
-        ctx->io_dop = op;                                       \
-        ctx->lba = _lba;                                        \
-        ctx->buf = _buf;                                        \
-        ctx->sects = _sects;                                    \
-        ctx->rsects = _rsects;                                  \
-        ctx->callback = _callback;                              \
-        pthread_cond_signal (&ctx->io_cond);                    \
-        pthread_mutex_unlock (&ctx->io_lock);                   \
-        }                                                       \
+    if (ctx->asynch_io)                                         \
+        r = _disk_submit (uptr, op, _lba, _buf, _rsects, _sects, _callback); \
     else                                                        \
         if (_callback)                                          \
             (_callback) (uptr, r);
@@ -157,48 +201,178 @@ if ((!callback) || !ctx->asynch_io)
 #define DOP_RSEC  1             /* sim_disk_rdsect_a */
 #define DOP_WSEC  2             /* sim_disk_wrsect_a */
 #define DOP_IAVL  3             /* sim_disk_isavailable_a */
+#define DOP_RAHD  4             /* read-ahead refill (no completion) */
+
+/* Asynchronous I/O
+
+   Each asynchronous unit has a submission queue and a completion queue.
+   Any number of requests may be outstanding on a unit.  A shared pool of
+   worker threads services the units; a unit with pending requests sits
+   on the pool's ready list until a worker takes it.  A worker keeps the
+   unit, processing its requests in submission order, until the unit's
+   submission queue is empty.  Only one worker services a unit at a time,
+   because stdio has no atomic seek+(read|write) operation, so requests
+   to one unit are still performed one after another.  Different units
+   proceed in parallel.
+
+   A completed request moves to the unit's completion queue and the unit
+   is activated.  _disk_completion_dispatch then runs in the main thread
+   and makes the callbacks for every request completed since it last ran,
+   in submission order.
+
+   The pool starts when the first unit goes asynchronous and stops when
+   the last unit leaves asynchronous mode.
+*/
+
+#define DISK_AIO_WORKERS    4           /* worker threads in the pool */
+
+struct disk_req {
+    struct disk_req     *next;
+    int                 dop;            /* DOP_xxx */
+    t_lba               lba;
+    uint8               *buf;
+    t_seccnt            *rsects;
+    t_seccnt            sects;
+    DISK_PCALLBACK      callback;
+    t_stat              status;
+    };
+
+static pthread_mutex_t disk_aio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t disk_aio_work = PTHREAD_COND_INITIALIZER;
+static pthread_t disk_aio_thread[DISK_AIO_WORKERS];
+static int disk_aio_nthreads = 0;       /* running workers */
+static int disk_aio_units = 0;          /* asynchronous units */
+static int disk_aio_stop = 0;           /* pool shutting down */
+static struct disk_context *disk_aio_ready_head = NULL;
+static struct disk_context *disk_aio_ready_tail = NULL;
+
+static void _disk_ra_refill (UNIT *uptr);
+static void _disk_completion_dispatch (UNIT *uptr);
+static void _disk_aio_drain (struct disk_context *ctx);
 
 static void *
 _disk_io(void *arg)
 {
-UNIT* volatile uptr = (UNIT*)arg;
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_context *ctx;
+struct disk_req *req;
+UNIT *uptr;
 
 /* Boost Priority for this I/O thread vs the CPU instruction execution
    thread which in general won't be readily yielding the processor when
    this thread needs to run */
 sim_os_set_thread_priority (PRIORITY_ABOVE_NORMAL);
 
-sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) starting\n", (int)(uptr-ctx->dptr->units));
-
-pthread_mutex_lock (&ctx->io_lock);
-pthread_cond_signal (&ctx->startup_cond);   /* Signal we're ready to go */
-while (ctx->asynch_io) {
-    pthread_cond_wait (&ctx->io_cond, &ctx->io_lock);
-    if (ctx->io_dop == DOP_DONE)
+pthread_mutex_lock (&disk_aio_lock);
+while (1) {
+    while ((!disk_aio_stop) && (disk_aio_ready_head == NULL))
+        pthread_cond_wait (&disk_aio_work, &disk_aio_lock);
+    if (disk_aio_ready_head == NULL)                    /* stopping and idle */
         break;
-    pthread_mutex_unlock (&ctx->io_lock);
-    switch (ctx->io_dop) {
+    ctx = disk_aio_ready_head;                          /* take a unit */
+    disk_aio_ready_head = ctx->ready_next;
+    if (disk_aio_ready_head == NULL)
+        disk_aio_ready_tail = NULL;
+    ctx->ready_next = NULL;
+    ctx->ready = 0;
+    ctx->busy = 1;
+    ctx->worker = pthread_self ();
+    uptr = ctx->uptr;
+    while ((req = ctx->sq_head) != NULL) {              /* drain its requests */
+        pthread_mutex_unlock (&disk_aio_lock);
+        sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d, dop=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), req->dop, req->lba, req->sects);
+        switch (req->dop) {
+            case DOP_RSEC:
+                req->status = sim_disk_rdsect (uptr, req->lba, req->buf, req->rsects, req->sects);
+                break;
+            case DOP_WSEC:
+                req->status = sim_disk_wrsect (uptr, req->lba, req->buf, req->rsects, req->sects);
+                break;
+            case DOP_IAVL:
+                req->status = sim_disk_isavailable (uptr);
+                break;
+            case DOP_RAHD:
+                _disk_ra_refill (uptr);
+                break;
+            }
+        pthread_mutex_lock (&disk_aio_lock);
+        ctx->sq_head = req->next;                       /* dequeue */
+        if (ctx->sq_head == NULL)
+            ctx->sq_tail = NULL;
+        req->next = NULL;
+        if (req->dop == DOP_RAHD) {                     /* internal, nothing to report */
+            free (req);
+            continue;
+            }
+        --ctx->queued;
+        if (ctx->cq_tail)                               /* queue completion */
+            ctx->cq_tail->next = req;
+        else ctx->cq_head = req;
+        ctx->cq_tail = req;
+        sim_activate (uptr, ctx->asynch_io_latency);
+        }
+    ctx->busy = 0;
+    pthread_cond_broadcast (&ctx->io_done);             /* unit is idle */
+    }
+pthread_mutex_unlock (&disk_aio_lock);
+return NULL;
+}
+
+/* Queue a request for a unit, making the unit ready if no worker has it */
+
+static t_stat _disk_submit (UNIT *uptr, int dop, t_lba lba, uint8 *buf, t_seccnt *rsects, t_seccnt sects, DISK_PCALLBACK callback)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_req *req = (struct disk_req *)calloc (1, sizeof (*req));
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n", dop, (int)(uptr-ctx->dptr->units), lba, sects);
+if (req == NULL) {                                      /* no memory to queue it? */
+    t_stat r;
+
+    if (dop == DOP_RAHD)                                /* read-ahead is optional */
+        return SCPE_MEM;
+    _disk_aio_drain (ctx);                              /* perform it now, in order, */
+    _disk_completion_dispatch (uptr);                   /*   after earlier completions */
+    switch (dop) {
         case DOP_RSEC:
-            ctx->io_status = sim_disk_rdsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
+            r = sim_disk_rdsect (uptr, lba, buf, rsects, sects);
             break;
         case DOP_WSEC:
-            ctx->io_status = sim_disk_wrsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
+            r = sim_disk_wrsect (uptr, lba, buf, rsects, sects);
             break;
         case DOP_IAVL:
-            ctx->io_status = sim_disk_isavailable (uptr);
+            r = sim_disk_isavailable (uptr);
+            break;
+        default:
+            r = SCPE_IERR;
             break;
         }
-    pthread_mutex_lock (&ctx->io_lock);
-    ctx->io_dop = DOP_DONE;
-    pthread_cond_signal (&ctx->io_done);
-    sim_activate (uptr, ctx->asynch_io_latency);
+    if (callback)                                       /* complete as synchronous I/O does */
+        callback (uptr, r);
+    return r;
     }
-pthread_mutex_unlock (&ctx->io_lock);
-
-sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) exiting\n", (int)(uptr-ctx->dptr->units));
-
-return NULL;
+req->dop = dop;
+req->lba = lba;
+req->buf = buf;
+req->rsects = rsects;
+req->sects = sects;
+req->callback = callback;
+pthread_mutex_lock (&disk_aio_lock);
+if (ctx->sq_tail)
+    ctx->sq_tail->next = req;
+else ctx->sq_head = req;
+ctx->sq_tail = req;
+if (dop != DOP_RAHD)
+    ++ctx->queued;
+if ((!ctx->busy) && (!ctx->ready)) {                    /* put unit on ready list */
+    ctx->ready = 1;
+    if (disk_aio_ready_tail)
+        disk_aio_ready_tail->ready_next = ctx;
+    else disk_aio_ready_head = ctx;
+    disk_aio_ready_tail = ctx;
+    pthread_cond_signal (&disk_aio_work);
+    }
+pthread_mutex_unlock (&disk_aio_lock);
+return SCPE_OK;
 }
 
 /* This routine is called in the context of the main simulator thread before
@@ -207,50 +381,63 @@ return NULL;
    routine is to put the unit in proper condition to digest what may have
    occurred in the asynchrconous thread.
   
-   Since disk processing only handles a single I/O at a time to a
-   particular disk device (due to using stdio for the SimH Disk format
-   and stdio doesn't have an atomic seek+(read|write) operation),
-   we have the opportunity to possibly detect improper attempts to
-   issue multiple concurrent I/O requests. */
+   Several requests may have completed since the unit was last activated;
+   their callbacks are made here in the order the requests were issued. */
 static void _disk_completion_dispatch (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-DISK_PCALLBACK callback = ctx->callback;
+struct disk_req *req;
 
-sim_debug (ctx->dbit, ctx->dptr, "_disk_completion_dispatch(unit=%d, dop=%d, callback=%p)\n", (int)(uptr-ctx->dptr->units), ctx->io_dop, ctx->callback);
-
-if (ctx->io_dop != DOP_DONE)
-    abort();                                            /* horribly wrong, stop */
-
-if (ctx->callback && ctx->io_dop == DOP_DONE) {
-    ctx->callback = NULL;
-    callback (uptr, ctx->io_status);
+if (ctx == NULL)                                        /* detached? */
+    return;
+pthread_mutex_lock (&disk_aio_lock);
+req = ctx->cq_head;                                     /* take completions */
+ctx->cq_head = ctx->cq_tail = NULL;
+pthread_mutex_unlock (&disk_aio_lock);
+while (req) {
+    struct disk_req *next = req->next;
+
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_completion_dispatch(unit=%d, dop=%d, callback=%p)\n", (int)(uptr-ctx->dptr->units), req->dop, req->callback);
+    if (req->callback)
+        req->callback (uptr, req->status);
+    free (req);
+    req = next;
     }
 }
 
 static t_bool _disk_is_active (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_bool active;
 
 if (ctx) {
-    sim_debug (ctx->dbit, ctx->dptr, "_disk_is_active(unit=%d, dop=%d)\n", (int)(uptr-ctx->dptr->units), ctx->io_dop);
-    return (ctx->io_dop != DOP_DONE);
+    pthread_mutex_lock (&disk_aio_lock);
+    active = (ctx->queued != 0);                        /* requests not done? */
+    pthread_mutex_unlock (&disk_aio_lock);
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_is_active(unit=%d, active=%d)\n", (int)(uptr-ctx->dptr->units), active);
+    return active;
     }
 return FALSE;
 }
 
+/* Wait until every submitted request for the unit has been performed */
+
+static void _disk_aio_drain (struct disk_context *ctx)
+{
+pthread_mutex_lock (&disk_aio_lock);
+while (ctx->sq_head || ctx->busy)
+    pthread_cond_wait (&ctx->io_done, &disk_aio_lock);
+pthread_mutex_unlock (&disk_aio_lock);
+}
+
 static t_bool _disk_cancel (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
 if (ctx) {
-    sim_debug (ctx->dbit, ctx->dptr, "_disk_cancel(unit=%d, dop=%d)\n", (int)(uptr-ctx->dptr->units), ctx->io_dop);
-    if (ctx->asynch_io) {
-        pthread_mutex_lock (&ctx->io_lock);
-        while (ctx->io_dop != DOP_DONE)
-            pthread_cond_wait (&ctx->io_done, &ctx->io_lock);
-        pthread_mutex_unlock (&ctx->io_lock);
-        }
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_cancel(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+    if (ctx->asynch_io)
+        _disk_aio_drain (ctx);
     }
 return FALSE;
 }
@@ -269,6 +456,8 @@ static FILE *sim_vhd_disk_create (const char *szVHDPath, t_offset desiredsize);
 static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szParentVHDPath);
 static FILE *sim_vhd_disk_merge (const char *szVHDPath, char **ParentVHD);
 static int sim_vhd_disk_close (FILE *f);
+static void sim_vhd_disk_set_iomode (FILE *f, FILE *direct);
+static FILE *sim_vhd_disk_fixed_file (FILE *f);
 static void sim_vhd_disk_flush (FILE *f);
 static t_offset sim_vhd_disk_size (FILE *f);
 static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
@@ -463,18 +652,26 @@ sim_debug (ctx->dbit, ctx->dptr, "sim_disk_set_async(unit=%d)\n", (int)(uptr-ctx
 ctx->asynch_io = sim_asynch_enabled;
 ctx->asynch_io_latency = latency;
 if (ctx->asynch_io) {
-    pthread_mutex_init (&ctx->io_lock, NULL);
-    pthread_cond_init (&ctx->io_cond, NULL);
     pthread_cond_init (&ctx->io_done, NULL);
-    pthread_cond_init (&ctx->startup_cond, NULL);
+    pthread_mutex_lock (&disk_aio_lock);
+    ++disk_aio_units;
+    disk_aio_stop = 0;
     pthread_attr_init(&attr);
     pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    pthread_mutex_lock (&ctx->io_lock);
-    pthread_create (&ctx->io_thread, &attr, _disk_io, (void *)uptr);
+    while ((disk_aio_nthreads < DISK_AIO_WORKERS) &&    /* grow pool */
+           (disk_aio_nthreads < disk_aio_units)) {
+        if (pthread_create (&disk_aio_thread[disk_aio_nthreads], &attr, _disk_io, NULL))
+            break;
+        ++disk_aio_nthreads;
+        }
     pthread_attr_destroy(&attr);
-    pthread_cond_wait (&ctx->startup_cond, &ctx->io_lock); /* Wait for thread to stabilize */
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->startup_cond);
+    if (disk_aio_nthreads == 0)                         /* no workers? */
+        ctx->asynch_io = 0;                             /* stay synchronous */
+    if (!ctx->asynch_io) {
+        --disk_aio_units;
+        pthread_cond_destroy (&ctx->io_done);
+        }
+    pthread_mutex_unlock (&disk_aio_lock);
     }
 uptr->a_check_completion = _disk_completion_dispatch;
 uptr->a_is_active = _disk_is_active;
@@ -498,19 +695,211 @@ if (!ctx) return SCPE_UNATT;
 sim_debug (ctx->dbit, ctx->dptr, "sim_disk_clr_async(unit=%d)\n", (int)(uptr-ctx->dptr->units));
 
 if (ctx->asynch_io) {
-    pthread_mutex_lock (&ctx->io_lock);
+    _disk_aio_drain (ctx);                              /* finish its requests */
     ctx->asynch_io = 0;
-    pthread_cond_signal (&ctx->io_cond);
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_join (ctx->io_thread, NULL);
-    pthread_mutex_destroy (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->io_cond);
     pthread_cond_destroy (&ctx->io_done);
+    pthread_mutex_lock (&disk_aio_lock);
+    if (--disk_aio_units == 0) {                        /* last unit? */
+        int i, n = disk_aio_nthreads;
+
+        disk_aio_stop = 1;                              /* stop the pool */
+        disk_aio_nthreads = 0;
+        pthread_cond_broadcast (&disk_aio_work);
+        pthread_mutex_unlock (&disk_aio_lock);
+        for (i = 0; i < n; i++)
+            pthread_join (disk_aio_thread[i], NULL);
+        }
+    else pthread_mutex_unlock (&disk_aio_lock);
     }
 return SCPE_OK;
 #endif
 }
 
+/* Positioned I/O
+
+   SET <unit> IOMODE=POSITIONED moves a unit's SIMH and VHD format sector
+   transfers from stdio (seek, then read or write through the stream's
+   buffer) to positioned transfers directly on the container's descriptor.
+   That avoids a copy through the stream buffer and the separate seek.
+   RAW format units always work this way.
+
+   IOMODE=DIRECT additionally opens the container a second time bypassing
+   the host's file cache and uses that for transfers whose offset and
+   length are multiples of DK_DIO_ALIGN.  The data goes through an aligned
+   bounce buffer taken from a small shared pool.  If the host rejects a
+   direct transfer the unit quietly falls back to positioned transfers.
+*/
+
+#define DK_DIO_ALIGN    4096                /* direct transfer alignment */
+#define DK_DIO_POOL     8                   /* idle bounce buffers kept */
+
+struct disk_dbuf {
+    struct disk_dbuf    *next;
+    size_t              size;
+    uint8               *data;              /* aligned within raw */
+    uint8               raw[1];
+    };
+
+static struct disk_dbuf *disk_dbuf_pool = NULL;
+static uint32 disk_dbuf_idle = 0;
+#if defined SIM_ASYNCH_IO
+static pthread_mutex_t disk_dbuf_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static struct disk_dbuf *_dbuf_get (size_t size)
+{
+struct disk_dbuf *b, **pb;
+
+#if defined SIM_ASYNCH_IO
+pthread_mutex_lock (&disk_dbuf_lock);
+#endif
+for (pb = &disk_dbuf_pool; (b = *pb) != NULL; pb = &b->next)
+    if (b->size >= size) {
+        *pb = b->next;
+        --disk_dbuf_idle;
+        break;
+        }
+#if defined SIM_ASYNCH_IO
+pthread_mutex_unlock (&disk_dbuf_lock);
+#endif
+if (b == NULL) {
+    size = (size + 0xFFFF) & ~((size_t)0xFFFF);         /* 64KB multiples */
+    b = (struct disk_dbuf *)malloc (sizeof (*b) + size + DK_DIO_ALIGN);
+    if (b == NULL)
+        return NULL;
+    b->size = size;
+    b->data = (uint8 *)((((size_t)b->raw) + DK_DIO_ALIGN - 1) & ~((size_t)DK_DIO_ALIGN - 1));
+    }
+return b;
+}
+
+static void _dbuf_put (struct disk_dbuf *b)
+{
+#if defined SIM_ASYNCH_IO
+pthread_mutex_lock (&disk_dbuf_lock);
+#endif
+if (disk_dbuf_idle < DK_DIO_POOL) {
+    b->next = disk_dbuf_pool;
+    disk_dbuf_pool = b;
+    ++disk_dbuf_idle;
+    b = NULL;
+    }
+#if defined SIM_ASYNCH_IO
+pthread_mutex_unlock (&disk_dbuf_lock);
+#endif
+free (b);
+}
+
+/* Transfer len bytes at pos, directly through *df when possible, and
+   otherwise positioned on f.  *df is closed and cleared if the host
+   refuses direct transfers. */
+
+static t_stat _sim_disk_pio (FILE *f, FILE **df, t_bool wr, void *buf, size_t len, t_offset pos, size_t *done)
+{
+if (*df && (0 == (pos & (DK_DIO_ALIGN - 1))) && (0 == (len & (DK_DIO_ALIGN - 1)))) {
+    struct disk_dbuf *b = _dbuf_get (len);
+    int err = -1;
+
+    if (b) {
+        if (wr) {
+            memcpy (b->data, buf, len);
+            err = sim_fpwrite (*df, b->data, len, pos, done);
+            }
+        else {
+            err = sim_fpread (*df, b->data, len, pos, done);
+            if (err == 0)
+                memcpy (buf, b->data, *done);
+            }
+        _dbuf_put (b);
+        }
+    if (err == 0)
+        return SCPE_OK;
+    fclose (*df);                                       /* host won't, stop trying */
+    *df = NULL;
+    }
+if ((wr ? sim_fpwrite (f, buf, len, pos, done) : sim_fpread (f, buf, len, pos, done)) != 0)
+    return SCPE_IOERR;
+return SCPE_OK;
+}
+
+/* Mapped I/O
+
+   SET <unit> IOMODE=MAPPED maps a SIMH format or fixed VHD container into
+   memory when the unit is attached.  Transfers inside the mapping are then
+   just memory copies; the mapping is shared, so the host writes the data
+   back by itself and the unit's flush and detach only force it out with
+   sim_fmap_sync.  A writable SIMH format container is first extended
+   (sparsely) to the full drive size so that every sector is mapped.
+
+   Controllers that move data between guest memory and a host buffer can
+   call sim_disk_mapped for a pointer into the mapping and use it as that
+   buffer.  sim_disk_rdsect and sim_disk_wrsect recognize the pointer and
+   don't copy, so the transfer goes straight between guest memory and
+   the container's pages. */
+
+static uint8 *_sim_disk_map_addr (struct disk_context *ctx, t_lba lba, t_seccnt sects, t_bool write)
+{
+if ((ctx->map_base == NULL) || (write && !ctx->map_wr) ||
+    ((((t_offset)lba) + sects) * ctx->sector_size > ctx->map_size))
+    return NULL;
+return ctx->map_base + ((t_offset)lba) * ctx->sector_size;
+}
+
+static void _sim_disk_map (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_offset size = ((t_offset)uptr->capac)*ctx->capac_factor*((ctx->dptr->flags & DEV_SECTORS) ? 512 : 1);
+t_bool wr = !(uptr->flags & UNIT_RO) && !ctx->overlay;
+FILE *f = uptr->fileref;
+t_offset fsize;
+void *base;
+
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* Simh */
+        break;
+    case DKUF_F_VHD:                                    /* Virtual Disk */
+        f = sim_vhd_disk_fixed_file (uptr->fileref);
+        if (f != NULL) {
+            if (size > sim_vhd_disk_size (uptr->fileref))
+                size = sim_vhd_disk_size (uptr->fileref);
+            break;
+            }
+        /* fall through */
+    default:
+        sim_messagef (SCPE_OK, "%s: only SIMH format and fixed VHD containers can be mapped, using stdio\n", sim_uname (uptr));
+        return;
+    }
+if (fflush (f))
+    return;
+fsize = sim_fsize_ex (f);
+if (wr && (fsize < size) && (DK_GET_FMT (uptr) == DKUF_F_STD) &&
+    (0 == sim_set_fsize_ex (f, size)))
+    fsize = size;
+if (size > fsize)
+    size = fsize;
+if (size == 0)                                          /* nothing to map yet */
+    return;
+if (sim_fmap_open (f, size, wr, &ctx->map, &base) != SCPE_OK) {
+    sim_messagef (SCPE_OK, "%s: can't map %s, using stdio\n", sim_uname (uptr), uptr->filename);
+    return;
+    }
+ctx->map_base = (uint8 *)base;
+ctx->map_size = size;
+ctx->map_wr = wr;
+}
+
+static void _sim_disk_unmap (struct disk_context *ctx)
+{
+if (ctx->map == NULL)
+    return;
+if (ctx->map_wr)
+    sim_fmap_sync (ctx->map);
+sim_fmap_close (ctx->map);
+ctx->map = NULL;
+ctx->map_base = NULL;
+ctx->map_size = 0;
+}
+
 /* Read Sectors */
 
 static t_stat _sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
@@ -526,6 +915,16 @@ da = ((t_offset)lba) * ctx->sector_size;
 tbc = sects * ctx->sector_size;
 if (sectsread)
     *sectsread = 0;
+if (uptr->dynflags & (UNIT_PIO | UNIT_DIRECTIO)) {      /* positioned? */
+    if (_sim_disk_pio (uptr->fileref, &ctx->dio_file, FALSE, buf, tbc, da, &i) != SCPE_OK)
+        return SCPE_IOERR;
+    if (i < tbc)                                        /* fill */
+        memset (&buf[i], 0, tbc - i);
+    sim_buf_swap_data (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size);
+    if (sectsread)
+        *sectsread = (t_seccnt)((i+ctx->sector_size-1)/ctx->sector_size);
+    return SCPE_OK;
+    }
 err = sim_fseeko (uptr->fileref, da, SEEK_SET);          /* set pos */
 if (!err) {
     i = sim_fread (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
@@ -538,13 +937,12 @@ if (!err) {
 return err;
 }
 
-t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+static t_stat _sim_disk_rdsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
 {
 t_stat r;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 t_seccnt sread = 0;
-
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+uint8 *m;
 
 if ((sects == 1) &&                                     /* Single sector reads */
     (lba >= (uptr->capac*ctx->capac_factor)/(ctx->sector_size/((ctx->dptr->flags & DEV_SECTORS) ? 512 : 1)))) {/* beyond the end of the disk */
@@ -553,6 +951,13 @@ if ((sects == 1) &&                                     /* Single sector reads *
         *sectsread = 1;
     return SCPE_OK;                                     /* return success */
     }
+if ((m = _sim_disk_map_addr (ctx, lba, sects, FALSE))) {/* mapped? */
+    if (m != buf)                                       /* unless already there */
+        sim_buf_copy_swapped (buf, m, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+    if (sectsread)
+        *sectsread = sects;
+    return SCPE_OK;
+    }
 
 if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
     ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
@@ -629,66 +1034,129 @@ return r;
 
 /* Write Sectors */
 
+static t_bool _sim_disk_sector_is_zero (const uint8 *buf, uint32 size)
+{
+return ((buf[0] == 0) && (0 == memcmp (buf, buf + 1, size - 1)));
+}
+
+/* Store a run of all zero sectors in a SIMH format container without
+   writing them, when SET <unit> ZEROELIDE is in effect.  Space past the
+   current end of the container is left sparse by extending the file, space
+   inside it is given back to the host file system where that is supported.
+   Either way the range reads back as zeros.  Containers which are fully
+   allocated when attached (e.g. those created without ZEROELIDE) are left
+   alone, so zeroing them doesn't fragment them.  Returns FALSE if the
+   sectors must be written. */
+
+static t_bool _sim_disk_zero_sects (UNIT *uptr, t_offset da, t_offset len)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_offset fsize;
+
+if (ctx->zero_flush || (ctx->zero_fsize < 0)) {
+    if (fflush (uptr->fileref))                         /* host must see prior writes */
+        return FALSE;
+    ctx->zero_flush = FALSE;
+    }
+if (ctx->zero_fsize < 0)
+    ctx->zero_fsize = sim_fsize_ex (uptr->fileref);
+fsize = ctx->zero_fsize;
+if (fsize < 0)
+    return FALSE;
+if (da < fsize) {                                       /* inside existing data? */
+    if (ctx->no_punch)
+        return FALSE;
+    if (sim_fpunch_hole (uptr->fileref, da, ((da + len) > fsize) ? fsize - da : len)) {
+        ctx->no_punch = TRUE;
+        return FALSE;
+        }
+    }
+if ((da + len) > fsize) {                               /* extend sparsely */
+    if (sim_set_fsize_ex (uptr->fileref, da + len)) {
+        ctx->zero_fsize = -1;
+        return FALSE;
+        }
+    ctx->zero_fsize = da + len;
+    }
+return TRUE;
+}
+
 static t_stat _sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
 t_offset da;
-uint32 err, tbc;
+uint32 err = 0, tbc;
+t_seccnt done, run;
+t_bool zero = FALSE;
 size_t i;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_bool elide = (uptr->dynflags & UNIT_ZEROELIDE) && !ctx->prealloc;
 
 sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
 
-da = ((t_offset)lba) * ctx->sector_size;
-tbc = sects * ctx->sector_size;
 if (sectswritten)
     *sectswritten = 0;
-err = sim_fseeko (uptr->fileref, da, SEEK_SET);          /* set pos */
-if (!err) {
-    i = sim_fwrite (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
-    err = ferror (uptr->fileref);
-    if ((!err) && (sectswritten))
-        *sectswritten = (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+for (done = 0; (done < sects) && !err; done += run) {   /* split into zero and data runs */
+    if (elide) {
+        zero = _sim_disk_sector_is_zero (buf + done * ctx->sector_size, ctx->sector_size);
+        for (run = 1; (done + run < sects) &&
+                      (zero == _sim_disk_sector_is_zero (buf + (done + run) * ctx->sector_size, ctx->sector_size)); run++)
+            ;
+        }
+    else run = sects - done;
+    da = ((t_offset)(lba + done)) * ctx->sector_size;
+    tbc = run * ctx->sector_size;
+    if (zero && _sim_disk_zero_sects (uptr, da, tbc)) {
+        ctx->zero_elided += run;
+        if (sectswritten)
+            *sectswritten += run;
+        continue;
+        }
+    if (uptr->dynflags & (UNIT_PIO | UNIT_DIRECTIO)) {  /* positioned? */
+        uint8 *wbuf = buf + done * ctx->sector_size;
+
+        if (!sim_end && (ctx->xfer_element_size != sizeof (char))) {
+            wbuf = (uint8 *)malloc (tbc);
+            if (wbuf == NULL)
+                return SCPE_MEM;
+            sim_buf_copy_swapped (wbuf, buf + done * ctx->sector_size, ctx->xfer_element_size, tbc/ctx->xfer_element_size);
+            }
+        err = (_sim_disk_pio (uptr->fileref, &ctx->dio_file, TRUE, wbuf, tbc, da, &i) != SCPE_OK);
+        if (wbuf != buf + done * ctx->sector_size)
+            free (wbuf);
+        if ((!err) && (sectswritten))
+            *sectswritten += (t_seccnt)((i+ctx->sector_size-1)/ctx->sector_size);
+        if ((ctx->zero_fsize >= 0) && (da + (t_offset)i > ctx->zero_fsize))
+            ctx->zero_fsize = da + (t_offset)i;         /* container grew */
+        continue;
+        }
+    err = sim_fseeko (uptr->fileref, da, SEEK_SET);      /* set pos */
+    if (!err) {
+        i = sim_fwrite (buf + done * ctx->sector_size, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
+        err = ferror (uptr->fileref);
+        if ((!err) && (sectswritten))
+            *sectswritten += (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+        ctx->zero_flush = TRUE;                         /* buffered, flush before punching */
+        if ((ctx->zero_fsize >= 0) && (da + (t_offset)(i * ctx->xfer_element_size) > ctx->zero_fsize))
+            ctx->zero_fsize = da + (t_offset)(i * ctx->xfer_element_size);
+        }
     }
 return err;
 }
 
-t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+static t_stat _sim_disk_wrsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 uint32 f = DK_GET_FMT (uptr);
 t_stat r;
 uint8 *tbuf = NULL;
+uint8 *m;
 
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
-
-if (uptr->dynflags & UNIT_DISK_CHK) {
-    DEVICE *dptr = find_dev_from_unit (uptr);
-    uint32 capac_factor = ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* capacity units (word: 2, byte: 1) */
-    t_lba total_sectors = (t_lba)((uptr->capac*capac_factor)/(ctx->sector_size/((dptr->flags & DEV_SECTORS) ? 512 : 1)));
-    t_lba sect;
-
-    for (sect = 0; sect < sects; sect++) {
-        t_lba offset;
-        t_bool sect_error = FALSE;
-
-        for (offset = 0; offset < ctx->sector_size; offset += sizeof(uint32)) {
-            if (*((uint32 *)&buf[sect*ctx->sector_size + offset]) != (uint32)(lba + sect)) {
-                sect_error = TRUE;
-                break;
-                }
-            }
-        if (sect_error) {
-            uint32 save_dctrl = dptr->dctrl;
-            FILE *save_sim_deb = sim_deb;
-
-            sim_printf ("\n%s%d: Write Address Verification Error on lbn %d(0x%X) of %d(0x%X).\n", sim_dname (dptr), (int)(uptr-dptr->units), (int)(lba+sect), (int)(lba+sect), (int)total_sectors, (int)total_sectors);
-            dptr->dctrl = 0xFFFFFFFF;
-            sim_deb = save_sim_deb ? save_sim_deb : stdout;
-            sim_disk_data_trace (uptr, buf+sect*ctx->sector_size, lba+sect, ctx->sector_size,    "Found", TRUE, 1);
-            dptr->dctrl = save_dctrl;
-            sim_deb = save_sim_deb;
-            }
-        }
+if ((m = _sim_disk_map_addr (ctx, lba, sects, TRUE))) { /* mapped? */
+    if (m != buf)                                       /* unless already there */
+        sim_buf_copy_swapped (m, buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+    if (sectswritten)
+        *sectswritten = sects;
+    return SCPE_OK;
     }
 if (f == DKUF_F_STD)
     return _sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
@@ -728,63 +1196,1366 @@ else { /* Unaligned and/or partial sector transfers */
     t_lba tlba = lba & ~(sspsts - 1);
     t_seccnt tsects = sects + (lba - tlba);
 
-    tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
-    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
-    if (sectswritten)
-        *sectswritten = 0;
-    if (tbuf == NULL)
-        return SCPE_MEM;
-    /* Partial Sector writes require a read-modify-write sequence for the partial sectors */
-    if ((lba & (sspsts - 1)) ||
-        (sects < sspsts))
-        switch (DK_GET_FMT (uptr)) {                            /* case on format */
-            case DKUF_F_VHD:                                    /* VHD format */
-                sim_vhd_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
-                break;
-            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-                sim_os_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
-                break;
-            default:
-                r = SCPE_NOFNC;
+    tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
+    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
+    if (sectswritten)
+        *sectswritten = 0;
+    if (tbuf == NULL)
+        return SCPE_MEM;
+    /* Partial Sector writes require a read-modify-write sequence for the partial sectors */
+    if ((lba & (sspsts - 1)) ||
+        (sects < sspsts))
+        switch (DK_GET_FMT (uptr)) {                            /* case on format */
+            case DKUF_F_VHD:                                    /* VHD format */
+                sim_vhd_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
+                break;
+            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+                sim_os_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
+                break;
+            default:
+                r = SCPE_NOFNC;
+                break;
+            }
+    if ((tsects > sspsts) &&
+        ((sects + lba - tlba) & (sspsts - 1)))
+        switch (DK_GET_FMT (uptr)) {                            /* case on format */
+            case DKUF_F_VHD:                                    /* VHD format */
+                sim_vhd_disk_rdsect (uptr, tlba + tsects - sspsts,
+                                     tbuf + (tsects - sspsts) * ctx->sector_size,
+                                     NULL, sspsts);
+                break;
+            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+                sim_os_disk_rdsect (uptr, tlba + tsects - sspsts,
+                                    tbuf + (tsects - sspsts) * ctx->sector_size,
+                                    NULL, sspsts);
+                break;
+            default:
+                r = SCPE_NOFNC;
+                break;
+            }
+    sim_buf_copy_swapped (tbuf + (lba & (sspsts - 1)) * ctx->sector_size,
+                          buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+    switch (DK_GET_FMT (uptr)) {                            /* case on format */
+        case DKUF_F_VHD:                                    /* VHD format */
+            r = sim_vhd_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+            break;
+        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+            r = sim_os_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+            break;
+        default:
+            r = SCPE_NOFNC;
+            break;
+        }
+    if ((r == SCPE_OK) && sectswritten) {
+        *sectswritten -= (lba - tlba);
+        if (*sectswritten > sects)
+            *sectswritten = sects;
+        }
+    }
+free (tbuf);
+return r;
+}
+
+/* Memory overlay
+
+   ATTACH -T opens the container read only and keeps every sector written
+   in memory.  Reads are satisfied from the overlay where it holds the
+   sector and from the container otherwise.  The overlay is discarded when
+   the unit is detached, so a golden image can be booted any number of
+   times without copying it first.  SET <unit> COMMIT writes the overlay
+   back to the container.
+
+   The overlay is a table of chunks, each holding DO_CHUNK_SECTS sectors
+   and a bitmap of the ones which have been written.  It sits below the
+   host block cache, so the sectors are held as the simulator sees them.
+*/
+
+#define DO_CHUNK_SECTS  64
+
+struct disk_ochunk {
+    t_uint64            valid;              /* sectors present, bit n = sector n */
+    uint8               data[1];            /* DO_CHUNK_SECTS sectors */
+    };
+
+static t_bool _do_has (struct disk_context *ctx, t_lba lba)
+{
+t_lba c = lba / DO_CHUNK_SECTS;
+
+return ((c < ctx->ovl_chunks) && ctx->ovl_map[c] &&
+        ((ctx->ovl_map[c]->valid >> (lba % DO_CHUNK_SECTS)) & 1));
+}
+
+static uint8 *_do_sector (struct disk_context *ctx, t_lba lba, t_bool alloc)
+{
+t_lba c = lba / DO_CHUNK_SECTS;
+
+if (c >= ctx->ovl_chunks) {
+    struct disk_ochunk **map;
+    t_lba n = c + 1 + (c / 4);                          /* some room to grow */
+
+    if (!alloc)
+        return NULL;
+    map = (struct disk_ochunk **)realloc (ctx->ovl_map, n * sizeof (*map));
+    if (map == NULL)
+        return NULL;
+    memset (map + ctx->ovl_chunks, 0, (n - ctx->ovl_chunks) * sizeof (*map));
+    ctx->ovl_map = map;
+    ctx->ovl_chunks = n;
+    }
+if (ctx->ovl_map[c] == NULL) {
+    if (!alloc)
+        return NULL;
+    ctx->ovl_map[c] = (struct disk_ochunk *)calloc (1, sizeof (struct disk_ochunk) + DO_CHUNK_SECTS * ctx->sector_size);
+    if (ctx->ovl_map[c] == NULL)
+        return NULL;
+    }
+if (alloc && !((ctx->ovl_map[c]->valid >> (lba % DO_CHUNK_SECTS)) & 1)) {
+    ctx->ovl_map[c]->valid |= ((t_uint64)1) << (lba % DO_CHUNK_SECTS);
+    ++ctx->ovl_sects;
+    }
+return ctx->ovl_map[c]->data + (lba % DO_CHUNK_SECTS) * ctx->sector_size;
+}
+
+static void _do_purge (struct disk_context *ctx)
+{
+t_lba c;
+
+for (c = 0; c < ctx->ovl_chunks; c++)
+    free (ctx->ovl_map[c]);
+free (ctx->ovl_map);
+ctx->ovl_map = NULL;
+ctx->ovl_chunks = 0;
+ctx->ovl_sects = 0;
+}
+
+static t_stat _sim_disk_rdsect_ovl (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt done, run, sread, total = 0;
+t_bool ovl;
+t_stat r = SCPE_OK;
+
+if (!ctx->overlay)
+    return _sim_disk_rdsect_fmt (uptr, lba, buf, sectsread, sects);
+for (done = 0; (done < sects) && (r == SCPE_OK); done += run) {
+    ovl = _do_has (ctx, lba + done);
+    for (run = 1; (done + run < sects) && (ovl == _do_has (ctx, lba + done + run)); run++)
+        ;
+    if (ovl) {
+        for (sread = 0; sread < run; sread++)
+            memcpy (buf + (done + sread) * ctx->sector_size, _do_sector (ctx, lba + done + sread, FALSE), ctx->sector_size);
+        }
+    else {
+        sread = 0;
+        r = _sim_disk_rdsect_fmt (uptr, lba + done, buf + done * ctx->sector_size, &sread, run);
+        }
+    total += sread;
+    }
+if (sectsread)
+    *sectsread = total;
+return r;
+}
+
+static t_stat _sim_disk_wrsect_ovl (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt i;
+uint8 *sbuf;
+
+if (!ctx->overlay)
+    return _sim_disk_wrsect_fmt (uptr, lba, buf, sectswritten, sects);
+if (sectswritten)
+    *sectswritten = 0;
+for (i = 0; i < sects; i++) {
+    sbuf = _do_sector (ctx, lba + i, TRUE);
+    if (sbuf == NULL)
+        return SCPE_MEM;
+    memcpy (sbuf, buf + i * ctx->sector_size, ctx->sector_size);
+    if (sectswritten)
+        ++*sectswritten;
+    }
+return SCPE_OK;
+}
+
+/* Host block cache
+
+   SET DISKCACHE size[,WRITEBACK] establishes a block cache which is shared
+   by all attached SIMH and VHD format disk units.  A block is one simulated
+   sector, held in the form the simulator sees it (i.e. after any byte
+   swapping).
+
+   Replacement uses the 2Q algorithm.  A block read for the first time
+   enters a FIFO (A1in) which holds about a quarter of the cache.  When it
+   falls out of A1in only its address is remembered (A1out).  A block which
+   is referenced again while its address is in A1out is hot and is placed
+   in an LRU list (Am) which holds the rest of the cache.  A long scan
+   through a large file therefore can't displace the working set (index
+   files, directories, page and swap areas) from Am.
+
+   The cache is write-through unless WRITEBACK is specified.  In write-back
+   mode a write only updates the cached blocks and marks them dirty.  Dirty
+   blocks are written to the container when they are evicted, when the
+   unit is flushed (i.e. when the simulator stops), before a SAVE, when
+   the unit is unloaded or detached, and every few seconds by an internal
+   timer.
+
+   Asynchronous units perform their I/O in worker threads, so the cache is
+   protected by a lock, which is not held while dirty blocks are written to
+   a container.  Eviction only writes back dirty blocks which belong to the
+   unit the calling thread is doing I/O for; other units' dirty blocks are
+   passed over.  Those are written back by the main thread once
+   the owning unit's outstanding requests have been drained.
+*/
+
+#define DC_A1IN         0                   /* referenced once, resident */
+#define DC_AM           1                   /* referenced again, resident */
+#define DC_A1OUT        2                   /* evicted from A1in, address only */
+#define DC_NQ           3
+
+#define DC_FLUSH_USECS  5000000             /* periodic write-back interval */
+#define DC_FLUSH_MAX    128                 /* most sectors in one write-back */
+
+struct disk_cblk {
+    struct disk_cblk    *hnext;             /* hash chain */
+    struct disk_cblk    *prev;              /* queue links, head is most recent */
+    struct disk_cblk    *next;
+    struct disk_context *ctx;               /* owning unit */
+    t_lba               lba;
+    uint8               q;                  /* DC_xxx */
+    uint8               dirty;
+    uint8               *data;              /* NULL when in A1out */
+    };
+
+struct disk_cq {
+    struct disk_cblk    *head;
+    struct disk_cblk    *tail;
+    uint32              count;
+    size_t              bytes;
+    };
+
+static size_t disk_cache_size = 0;          /* bytes, 0 when disabled */
+static t_bool disk_cache_wb = FALSE;        /* write-back mode */
+static uint32 disk_cache_dirty = 0;         /* dirty blocks */
+static uint32 disk_cache_hmask = 0;
+static struct disk_cblk **disk_cache_hash = NULL;
+static struct disk_cq disk_cache_q[DC_NQ];
+#if defined SIM_ASYNCH_IO
+static pthread_mutex_t disk_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define DC_LOCK         pthread_mutex_lock (&disk_cache_lock)
+#define DC_UNLOCK       pthread_mutex_unlock (&disk_cache_lock)
+#else
+#define DC_LOCK
+#define DC_UNLOCK
+#endif
+
+static t_stat _disk_cache_svc (UNIT *uptr);
+static t_stat _disk_cache_reset (DEVICE *dptr);
+static void _sim_disk_io_flush (UNIT *uptr);
+
+static UNIT disk_cache_unit = { UDATA (&_disk_cache_svc, 0, 0) };
+
+static DEVICE disk_cache_dev = {
+    "INT-DISKCACHE", &disk_cache_unit, NULL, NULL,
+    1, 0, 0, 0, 0, 0,
+    NULL, NULL, &_disk_cache_reset, NULL, NULL, NULL,
+    NULL, DEV_NOSAVE};
+
+#define DC_ACTIVE(ctx)  (disk_cache_size && (ctx)->cache_ok)
+
+static uint32 _dc_hash (struct disk_context *ctx, t_lba lba)
+{
+return (uint32)((((size_t)ctx) >> 4) ^ (lba * 2654435761u)) & disk_cache_hmask;
+}
+
+static struct disk_cblk *_dc_find (struct disk_context *ctx, t_lba lba)
+{
+struct disk_cblk *blk;
+
+for (blk = disk_cache_hash[_dc_hash (ctx, lba)]; blk; blk = blk->hnext)
+    if ((blk->lba == lba) && (blk->ctx == ctx))
+        break;
+return blk;
+}
+
+static void _dc_unlink (struct disk_cblk *blk)
+{
+struct disk_cq *q = &disk_cache_q[blk->q];
+
+if (blk->prev)
+    blk->prev->next = blk->next;
+else q->head = blk->next;
+if (blk->next)
+    blk->next->prev = blk->prev;
+else q->tail = blk->prev;
+blk->prev = blk->next = NULL;
+--q->count;
+if (blk->data)
+    q->bytes -= blk->ctx->sector_size;
+}
+
+static void _dc_push (struct disk_cblk *blk, int qn)
+{
+struct disk_cq *q = &disk_cache_q[qn];
+
+blk->q = (uint8)qn;
+blk->prev = NULL;
+blk->next = q->head;
+if (q->head)
+    q->head->prev = blk;
+else q->tail = blk;
+q->head = blk;
+++q->count;
+if (blk->data)
+    q->bytes += blk->ctx->sector_size;
+}
+
+static void _dc_free (struct disk_cblk *blk)
+{
+struct disk_cblk **hp = &disk_cache_hash[_dc_hash (blk->ctx, blk->lba)];
+
+while (*hp != blk)
+    hp = &(*hp)->hnext;
+*hp = blk->hnext;
+_dc_unlink (blk);
+if (blk->dirty) {
+    --disk_cache_dirty;
+    --blk->ctx->cache_dirty;
+    }
+free (blk->data);
+free (blk);
+}
+
+static void _dc_clean (struct disk_cblk *blk)
+{
+if (blk->dirty) {
+    blk->dirty = 0;
+    --disk_cache_dirty;
+    --blk->ctx->cache_dirty;
+    }
+}
+
+/* Write a run of consecutive dirty blocks to the container.  Called with
+   the cache lock held; the lock is released while the container is written
+   so other units' cache lookups aren't held up.  The run's blocks stay put
+   meanwhile: they are dirty, so only their own unit may evict them, and the
+   calling thread is the one doing that unit's I/O. */
+
+static t_stat _dc_write_run (struct disk_cblk **run, t_seccnt n)
+{
+struct disk_context *ctx = run[0]->ctx;
+uint8 *buf = (uint8 *)malloc (n * ctx->sector_size);
+t_seccnt i;
+t_stat r;
+
+if (buf == NULL)
+    return SCPE_MEM;
+for (i = 0; i < n; i++)
+    memcpy (buf + i * ctx->sector_size, run[i]->data, ctx->sector_size);
+DC_UNLOCK;
+r = _sim_disk_wrsect_ovl (ctx->uptr, run[0]->lba, buf, NULL, n);
+DC_LOCK;
+free (buf);
+if (r == SCPE_OK)
+    for (i = 0; i < n; i++)
+        _dc_clean (run[i]);
+return r;
+}
+
+/* Write back a dirty block along with the dirty blocks which follow it */
+
+static t_stat _dc_writeback (struct disk_cblk *blk)
+{
+struct disk_cblk *run[DC_FLUSH_MAX];
+t_seccnt n;
+
+run[0] = blk;
+for (n = 1; n < DC_FLUSH_MAX; n++) {
+    run[n] = _dc_find (blk->ctx, blk->lba + n);
+    if ((run[n] == NULL) || (!run[n]->dirty))
+        break;
+    }
+return _dc_write_run (run, n);
+}
+
+/* Make room for a block of the given size.  Only clean blocks and dirty
+   blocks belonging to ctx may be evicted. */
+
+static t_bool _dc_reclaim (struct disk_context *ctx, size_t need)
+{
+struct disk_cblk *blk;
+int qn;
+
+while (disk_cache_q[DC_A1IN].bytes + disk_cache_q[DC_AM].bytes + need > disk_cache_size) {
+    qn = ((disk_cache_q[DC_A1IN].bytes > disk_cache_size / 4) ||
+          (disk_cache_q[DC_AM].head == NULL)) ? DC_A1IN : DC_AM;
+    for (blk = disk_cache_q[qn].tail; blk; blk = blk->prev)
+        if ((!blk->dirty) || (blk->ctx == ctx))
+            break;
+    if (blk == NULL) {                                  /* nothing there, */
+        qn = DC_A1IN + DC_AM - qn;                      /* try the other queue */
+        for (blk = disk_cache_q[qn].tail; blk; blk = blk->prev)
+            if ((!blk->dirty) || (blk->ctx == ctx))
+                break;
+        if (blk == NULL)
+            return FALSE;
+        }
+    if (blk->dirty && (_dc_writeback (blk) != SCPE_OK))
+        return FALSE;
+    if (qn == DC_AM) {
+        _dc_free (blk);
+        continue;
+        }
+    _dc_unlink (blk);                                   /* A1in -> A1out */
+    free (blk->data);
+    blk->data = NULL;
+    _dc_push (blk, DC_A1OUT);
+    while (disk_cache_q[DC_A1OUT].count > (disk_cache_size / 512) / 2)
+        _dc_free (disk_cache_q[DC_A1OUT].tail);
+    }
+return TRUE;
+}
+
+/* Return the resident block for ctx/lba, bringing it in if necessary */
+
+static struct disk_cblk *_dc_get (struct disk_context *ctx, t_lba lba)
+{
+struct disk_cblk *blk = _dc_find (ctx, lba);
+int qn = DC_A1IN;
+uint32 h;
+
+if (blk && blk->data) {                                 /* resident? */
+    if (blk->q == DC_AM) {                              /* Am is LRU */
+        _dc_unlink (blk);
+        _dc_push (blk, DC_AM);
+        }
+    return blk;
+    }
+if (blk) {                                              /* seen recently? */
+    _dc_free (blk);
+    qn = DC_AM;                                         /* it's hot */
+    }
+if (!_dc_reclaim (ctx, ctx->sector_size))
+    return NULL;
+blk = (struct disk_cblk *)calloc (1, sizeof (*blk));
+if (blk == NULL)
+    return NULL;
+blk->data = (uint8 *)malloc (ctx->sector_size);
+if (blk->data == NULL) {
+    free (blk);
+    return NULL;
+    }
+blk->ctx = ctx;
+blk->lba = lba;
+h = _dc_hash (ctx, lba);
+blk->hnext = disk_cache_hash[h];
+disk_cache_hash[h] = blk;
+_dc_push (blk, qn);
+return blk;
+}
+
+static int _dc_lba_cmp (const void *pa, const void *pb)
+{
+t_lba a = (*(struct disk_cblk * const *)pa)->lba;
+t_lba b = (*(struct disk_cblk * const *)pb)->lba;
+
+return (a < b) ? -1 : (a > b);
+}
+
+/* Write back a unit's dirty blocks in ascending block order, coalescing
+   adjacent blocks.  The caller has drained the unit's requests. */
+
+static t_stat _disk_cache_flush (struct disk_context *ctx)
+{
+struct disk_cblk *blk, **dirty;
+uint32 i, n = 0, first;
+t_stat r = SCPE_OK;
+int qn;
+
+DC_LOCK;
+if (ctx->cache_dirty == 0) {
+    DC_UNLOCK;
+    return SCPE_OK;
+    }
+dirty = (struct disk_cblk **)malloc (ctx->cache_dirty * sizeof (*dirty));
+if (dirty == NULL) {
+    DC_UNLOCK;
+    return SCPE_MEM;
+    }
+for (qn = DC_A1IN; qn <= DC_AM; qn++)
+    for (blk = disk_cache_q[qn].head; blk; blk = blk->next)
+        if ((blk->ctx == ctx) && blk->dirty)
+            dirty[n++] = blk;
+qsort (dirty, n, sizeof (*dirty), _dc_lba_cmp);
+for (first = 0; first < n; first = i) {
+    for (i = first + 1; (i < n) && (i - first < DC_FLUSH_MAX); i++)
+        if (dirty[i]->lba != dirty[i - 1]->lba + 1)
+            break;
+    if (_dc_write_run (&dirty[first], i - first) != SCPE_OK)
+        r = SCPE_IOERR;
+    }
+free (dirty);
+DC_UNLOCK;
+return r;
+}
+
+/* Discard all of a unit's blocks */
+
+static void _disk_cache_purge (struct disk_context *ctx)
+{
+struct disk_cblk *blk, *next;
+int qn;
+
+DC_LOCK;
+if (disk_cache_hash)
+    for (qn = 0; qn < DC_NQ; qn++)
+        for (blk = disk_cache_q[qn].head; blk; blk = next) {
+            next = blk->next;
+            if ((ctx == NULL) || (blk->ctx == ctx))
+                _dc_free (blk);
+            }
+DC_UNLOCK;
+}
+
+/* Write back every unit's dirty blocks */
+
+t_stat sim_disk_cache_flush (void)
+{
+uint32 i, j;
+DEVICE *dptr;
+UNIT *uptr;
+struct disk_context *ctx;
+t_stat r = SCPE_OK;
+
+if (disk_cache_dirty == 0)
+    return SCPE_OK;
+for (i = 0; (dptr = sim_devices[i]) != NULL; i++)
+    for (j = 0; j < dptr->numunits; j++) {
+        uptr = dptr->units + j;
+        if ((!(uptr->flags & UNIT_ATT)) || (uptr->io_flush != _sim_disk_io_flush))
+            continue;
+        ctx = (struct disk_context *)uptr->disk_ctx;
+        if (ctx->cache_dirty == 0)
+            continue;
+#if defined SIM_ASYNCH_IO
+        if (ctx->asynch_io)
+            _disk_aio_drain (ctx);
+#endif
+        if (_disk_cache_flush (ctx) != SCPE_OK)
+            r = SCPE_IOERR;
+        }
+return r;
+}
+
+static t_stat _disk_cache_svc (UNIT *uptr)
+{
+sim_disk_cache_flush ();
+if (disk_cache_size && disk_cache_wb)
+    sim_activate_after (uptr, DC_FLUSH_USECS);
+return SCPE_OK;
+}
+
+static t_stat _disk_cache_reset (DEVICE *dptr)
+{
+if (disk_cache_size && disk_cache_wb)
+    sim_activate_after (dptr->units, DC_FLUSH_USECS);
+else sim_cancel (dptr->units);
+return SCPE_OK;
+}
+
+/* SET DISKCACHE size{K|M|G}[,WRITEBACK|WRITETHROUGH] and SET NODISKCACHE */
+
+t_stat sim_disk_set_cache (int32 flag, CONST char *cptr)
+{
+#if defined SIM_ASYNCH_IO
+uint32 i, j;
+DEVICE *dptr;
+UNIT *uptr;
+#endif
+char gbuf[CBUFSIZE];
+char *tptr;
+size_t size = 0;
+uint32 nhash;
+t_bool wb = FALSE;
+t_stat r;
+
+if (flag) {
+    if ((cptr == NULL) || (*cptr == 0))
+        return SCPE_2FARG;
+    cptr = get_glyph (cptr, gbuf, ',');
+    size = (size_t)strtoul (gbuf, &tptr, 10);
+    switch (*tptr) {
+        case 'K':
+            size <<= 10;
+            ++tptr;
+            break;
+        case 0:                                         /* default is MB */
+        case 'M':
+            size <<= 20;
+            if (*tptr)
+                ++tptr;
+            break;
+        case 'G':
+            size <<= 30;
+            ++tptr;
+            break;
+        }
+    if ((tptr == gbuf) || (*tptr != 0))
+        return sim_messagef (SCPE_ARG, "Invalid cache size: %s\n", gbuf);
+    while (*cptr) {
+        cptr = get_glyph (cptr, gbuf, ',');
+        if (MATCH_CMD (gbuf, "WRITEBACK") == 0)
+            wb = TRUE;
+        else if (MATCH_CMD (gbuf, "WRITETHROUGH") == 0)
+            wb = FALSE;
+        else
+            return sim_messagef (SCPE_ARG, "Invalid cache option: %s\n", gbuf);
+        }
+    }
+else {
+    if (cptr && (*cptr != 0))
+        return SCPE_2MARG;
+    }
+r = sim_disk_cache_flush ();                            /* write back everything */
+if (r != SCPE_OK)
+    return sim_messagef (r, "Disk cache write back failed, cache unchanged\n");
+#if defined SIM_ASYNCH_IO
+for (i = 0; (dptr = sim_devices[i]) != NULL; i++)      /* no eviction in progress */
+    for (j = 0; j < dptr->numunits; j++) {
+        uptr = dptr->units + j;
+        if ((uptr->flags & UNIT_ATT) && (uptr->io_flush == _sim_disk_io_flush) &&
+            ((struct disk_context *)uptr->disk_ctx)->asynch_io)
+            _disk_aio_drain ((struct disk_context *)uptr->disk_ctx);
+        }
+#endif
+_disk_cache_purge (NULL);                               /* then start over */
+DC_LOCK;
+free (disk_cache_hash);
+disk_cache_hash = NULL;
+disk_cache_hmask = 0;
+disk_cache_size = 0;
+disk_cache_wb = FALSE;
+if (size) {
+    for (nhash = 1024; (nhash < (size / 512)) && (nhash < 0x40000000); nhash <<= 1)
+        ;
+    disk_cache_hash = (struct disk_cblk **)calloc (nhash, sizeof (*disk_cache_hash));
+    if (disk_cache_hash) {
+        disk_cache_hmask = nhash - 1;
+        disk_cache_size = size;
+        disk_cache_wb = wb;
+        }
+    }
+DC_UNLOCK;
+if (size && (disk_cache_size == 0))
+    return SCPE_MEM;
+sim_register_internal_device (&disk_cache_dev);
+_disk_cache_reset (&disk_cache_dev);
+return SCPE_OK;
+}
+
+/* SHOW DISKCACHE */
+
+t_stat sim_disk_show_cache (FILE *st, DEVICE *dnotused, UNIT *unotused, int32 flag, CONST char *cptr)
+{
+uint32 i, j;
+DEVICE *dptr;
+UNIT *uptr;
+struct disk_context *ctx;
+
+if (cptr && (*cptr != 0))
+    return SCPE_2MARG;
+if (disk_cache_size == 0) {
+    fprintf (st, "Disk cache disabled\n");
+    return SCPE_OK;
+    }
+DC_LOCK;
+fprintf (st, "Disk cache: %uKB, %s\n", (uint32)(disk_cache_size >> 10), disk_cache_wb ? "write-back" : "write-through");
+fprintf (st, "  %u KB resident, %u blocks frequent, %u recent, %u remembered, %u dirty\n",
+             (uint32)((disk_cache_q[DC_A1IN].bytes + disk_cache_q[DC_AM].bytes) >> 10),
+             disk_cache_q[DC_AM].count, disk_cache_q[DC_A1IN].count, disk_cache_q[DC_A1OUT].count, disk_cache_dirty);
+for (i = 0; (dptr = sim_devices[i]) != NULL; i++)
+    for (j = 0; j < dptr->numunits; j++) {
+        t_uint64 reads;
+
+        uptr = dptr->units + j;
+        if ((!(uptr->flags & UNIT_ATT)) || (uptr->io_flush != _sim_disk_io_flush))
+            continue;
+        ctx = (struct disk_context *)uptr->disk_ctx;
+        if (!ctx->cache_ok)
+            continue;
+        reads = ctx->cache_hits + ctx->cache_misses;
+        fprintf (st, "  %-8s hits: %" LL_FMT "u, misses: %" LL_FMT "u, hit rate: %.1f%%",
+                     sim_uname (uptr), ctx->cache_hits, ctx->cache_misses,
+                     reads ? (100.0 * ctx->cache_hits) / reads : 0.0);
+        if (disk_cache_wb)
+            fprintf (st, ", writes deferred: %" LL_FMT "u, dirty: %u", ctx->cache_deferred, ctx->cache_dirty);
+        fprintf (st, "\n");
+        }
+DC_UNLOCK;
+return SCPE_OK;
+}
+
+/* Show a disk unit's I/O statistics
+
+   SHOW <unit> IOSTATS          readable summary (flag 0)
+   SHOW <unit> IOCSV            one comma separated record (flag 1),
+                                preceded by a header line unless appending
+                                to a file that already has data
+                                (SHOW @file <unit> IOCSV)
+*/
+
+static const char *_disk_ios_range (int b, t_bool time, char sep, char *buf)
+{
+if (b == 0)
+    return time ? "<1" : "0";
+if (b == 1)
+    return "1";
+sprintf (buf, "%" LL_FMT "u%c%" LL_FMT "u", ((t_uint64)1) << (b - 1), sep, (((t_uint64)1) << b) - 1);
+return buf;
+}
+
+static t_stat _disk_ios_csv (FILE *st, UNIT *uptr, struct disk_context *ctx)
+{
+struct disk_iostats *ios = &ctx->ios;
+static const char *dname[2] = {"rd", "wr"};
+char rbuf[48];
+int b, d;
+
+if (sim_ftell (st) <= 0) {                              /* new file or not a file */
+    fprintf (st, "unit,seconds");
+    for (d = DK_IOS_RD; d <= DK_IOS_WR; d++)
+        fprintf (st, ",%s_ops,%s_sectors,%s_bytes,%s_errors,%s_usecs", dname[d], dname[d], dname[d], dname[d], dname[d]);
+    fprintf (st, ",sequential,random,readahead_sectors,readahead_hits,qdepth_max");
+    for (b = 1; b < DK_QD_BUCKETS; b++)                 /* depth is at least 1 */
+        fprintf (st, ",qdepth_%s", _disk_ios_range (b, FALSE, '_', rbuf));
+    for (b = 0; b < DK_SEEK_BUCKETS; b++)
+        fprintf (st, ",seek_%s", _disk_ios_range (b, FALSE, '_', rbuf));
+    for (d = DK_IOS_RD; d <= DK_IOS_WR; d++)
+        for (b = 0; b < DK_SVC_BUCKETS; b++)
+            fprintf (st, ",%s_usecs_%s", dname[d], (b == 0) ? "lt1" : _disk_ios_range (b, TRUE, '_', rbuf));
+    fprintf (st, "\n");
+    }
+fprintf (st, "%s,%.3f", sim_uname (uptr), sim_timenow_double () - ios->since);
+for (d = DK_IOS_RD; d <= DK_IOS_WR; d++)
+    fprintf (st, ",%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u",
+                 ios->ops[d], ios->sects[d], ios->sects[d] * ctx->sector_size, ios->errors[d], ios->usecs[d]);
+fprintf (st, ",%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u,%" LL_FMT "u,%u", ios->seq, ios->ops[DK_IOS_RD] + ios->ops[DK_IOS_WR] - ios->seq,
+             ios->ra_sects, ios->ra_hits, ios->qd_max);
+for (b = 1; b < DK_QD_BUCKETS; b++)
+    fprintf (st, ",%" LL_FMT "u", ios->qd_hist[b]);
+for (b = 0; b < DK_SEEK_BUCKETS; b++)
+    fprintf (st, ",%" LL_FMT "u", ios->seek_hist[b]);
+for (d = DK_IOS_RD; d <= DK_IOS_WR; d++)
+    for (b = 0; b < DK_SVC_BUCKETS; b++)
+        fprintf (st, ",%" LL_FMT "u", ios->svc_hist[d][b]);
+fprintf (st, "\n");
+return SCPE_OK;
+}
+
+t_stat sim_disk_show_iostats (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+struct disk_context *ctx;
+struct disk_iostats *ios;
+char rbuf[48];
+t_uint64 ops;
+int b, d;
+
+if (cptr && (*cptr != 0))
+    return SCPE_2MARG;
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+if (uptr->io_flush != _sim_disk_io_flush)
+    return SCPE_NOFNC;
+ctx = (struct disk_context *)uptr->disk_ctx;
+ios = &ctx->ios;
+if (flag)
+    return _disk_ios_csv (st, uptr, ctx);
+ops = ios->ops[DK_IOS_RD] + ios->ops[DK_IOS_WR];
+fprintf (st, "%s I/O statistics (%.1f seconds):\n", sim_uname (uptr), sim_timenow_double () - ios->since);
+for (d = DK_IOS_RD; d <= DK_IOS_WR; d++) {
+    fprintf (st, "  %s %" LL_FMT "u requests, %" LL_FMT "u sectors (%" LL_FMT "u bytes), %" LL_FMT "u errors",
+                 (d == DK_IOS_RD) ? "Reads: " : "Writes:", ios->ops[d], ios->sects[d],
+                 ios->sects[d] * ctx->sector_size, ios->errors[d]);
+    if (ios->ops[d])
+        fprintf (st, ", %" LL_FMT "u usecs avg", ios->usecs[d] / ios->ops[d]);
+    fprintf (st, "\n");
+    }
+if (ops) {
+    fprintf (st, "  Sequential: %" LL_FMT "u (%d%%), random: %" LL_FMT "u\n",
+                 ios->seq, (int)((100 * ios->seq) / ops), ops - ios->seq);
+    fprintf (st, "  Read-ahead: %" LL_FMT "u sectors read ahead, %" LL_FMT "u requested later%s\n",
+                 ios->ra_sects, ios->ra_hits, ctx->ra_off ? " (off, random reads)" : "");
+    fprintf (st, "  Queue depth: %u max\n", ios->qd_max);
+    for (b = 0; b < DK_QD_BUCKETS; b++)
+        if (ios->qd_hist[b])
+            fprintf (st, "    %-21s %12" LL_FMT "u\n", _disk_ios_range (b, FALSE, '-', rbuf), ios->qd_hist[b]);
+    fprintf (st, "  Seek distance (sectors):\n");
+    for (b = 0; b < DK_SEEK_BUCKETS; b++)
+        if (ios->seek_hist[b])
+            fprintf (st, "    %-21s %12" LL_FMT "u\n", _disk_ios_range (b, FALSE, '-', rbuf), ios->seek_hist[b]);
+    fprintf (st, "  Service time (usecs):          Reads       Writes\n");
+    for (b = 0; b < DK_SVC_BUCKETS; b++)
+        if (ios->svc_hist[DK_IOS_RD][b] || ios->svc_hist[DK_IOS_WR][b])
+            fprintf (st, "    %-21s %12" LL_FMT "u %12" LL_FMT "u\n", _disk_ios_range (b, TRUE, '-', rbuf),
+                         ios->svc_hist[DK_IOS_RD][b], ios->svc_hist[DK_IOS_WR][b]);
+    }
+fprintf (st, "  Zero sectors elided: %" LL_FMT "u (%" LL_FMT "u bytes not stored)%s\n",
+             ctx->zero_elided, ctx->zero_elided * ctx->sector_size,
+             ((DK_GET_FMT (uptr) != DKUF_F_STD) || ((uptr->dynflags & UNIT_ZEROELIDE) && !ctx->prealloc)) ? "" : ", off");
+if (ctx->overlay)
+    fprintf (st, "  Memory overlay:      %" LL_FMT "u sectors (%" LL_FMT "u KB)\n",
+                 ctx->ovl_sects, (ctx->ovl_sects * ctx->sector_size) >> 10);
+return SCPE_OK;
+}
+
+/* SET <unit> IOSTATS=RESET - start a unit's I/O statistics over */
+
+t_stat sim_disk_set_iostats (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+struct disk_context *ctx;
+char gbuf[CBUFSIZE];
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_MISVAL;
+cptr = get_glyph (cptr, gbuf, 0);
+if (*cptr != 0)
+    return SCPE_2MARG;
+if (MATCH_CMD (gbuf, "RESET") != 0)
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+if (uptr->io_flush != _sim_disk_io_flush)
+    return SCPE_NOFNC;
+ctx = (struct disk_context *)uptr->disk_ctx;
+memset (&ctx->ios, 0, sizeof (ctx->ios));
+ctx->ios.since = sim_timenow_double ();
+ctx->zero_elided = 0;
+return SCPE_OK;
+}
+
+/* SET <unit> ZEROELIDE and NOZEROELIDE - leave all zero writes to a SIMH
+   format container sparse, or write them (the default) */
+
+t_stat sim_disk_set_zeroelide (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (cptr && (*cptr != 0))
+    return SCPE_2MARG;
+if (flag)
+    uptr->dynflags |= UNIT_ZEROELIDE;
+else uptr->dynflags &= ~UNIT_ZEROELIDE;
+if (flag && (uptr->flags & UNIT_ATT) && (uptr->io_flush == _sim_disk_io_flush) && ctx->prealloc)
+    sim_messagef (SCPE_OK, "%s: %s is fully allocated, its zero writes are still stored\n", sim_uname (uptr), uptr->filename);
+return SCPE_OK;
+}
+
+/* SET <unit> IOMODE={STDIO|POSITIONED|DIRECT|MAPPED} and SHOW <unit> IOMODE */
+
+t_stat sim_disk_set_iomode (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+char gbuf[CBUFSIZE];
+uint32 mode;
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_MISVAL;
+if (uptr->flags & UNIT_ATT)
+    return sim_messagef (SCPE_ALATT, "%s: the I/O mode can't be changed while attached\n", sim_uname (uptr));
+cptr = get_glyph (cptr, gbuf, 0);
+if (*cptr != 0)
+    return SCPE_2MARG;
+if (MATCH_CMD (gbuf, "STDIO") == 0)
+    mode = 0;
+else if (MATCH_CMD (gbuf, "POSITIONED") == 0)
+    mode = UNIT_PIO;
+else if (MATCH_CMD (gbuf, "DIRECT") == 0)
+    mode = UNIT_PIO | UNIT_DIRECTIO;
+else if (MATCH_CMD (gbuf, "MAPPED") == 0)
+    mode = UNIT_MAPPED;
+else
+    return SCPE_ARG;
+uptr->dynflags = (uptr->dynflags & ~(UNIT_PIO | UNIT_DIRECTIO | UNIT_MAPPED)) | mode;
+return SCPE_OK;
+}
+
+t_stat sim_disk_show_iomode (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (cptr && (*cptr != 0))
+    return SCPE_2MARG;
+fprintf (st, "%s I/O mode: %s", sim_uname (uptr),
+             (uptr->dynflags & UNIT_MAPPED) ? "mapped" :
+             ((uptr->dynflags & UNIT_DIRECTIO) ? "direct" : ((uptr->dynflags & UNIT_PIO) ? "positioned" : "stdio")));
+if ((uptr->dynflags & UNIT_DIRECTIO) && (uptr->flags & UNIT_ATT) &&
+    (uptr->io_flush == _sim_disk_io_flush) && (DK_GET_FMT (uptr) == DKUF_F_STD) &&
+    (ctx->dio_file == NULL))
+    fprintf (st, " (not available, positioned)");
+if ((uptr->dynflags & UNIT_MAPPED) && (uptr->flags & UNIT_ATT) &&
+    (uptr->io_flush == _sim_disk_io_flush)) {
+    if (ctx->map == NULL)
+        fprintf (st, " (not available, stdio)");
+    else
+        fprintf (st, " (%" LL_FMT "dKB%s)", (LL_TYPE)(ctx->map_size >> 10), ctx->map_wr ? "" : ", read only");
+    }
+fprintf (st, "\n");
+return SCPE_OK;
+}
+
+/* Return a pointer to sects sectors starting at lba in the unit's mapped
+   container, or NULL if the caller must use a buffer of its own.  A
+   controller may transfer guest data to or from the pointer and then pass
+   it to sim_disk_rdsect or sim_disk_wrsect as the transfer buffer.  Only
+   offered when the container bytes are in the guest's order and nothing
+   sits between the sim_disk interface and the container. */
+
+uint8 *sim_disk_mapped (UNIT *uptr, t_lba lba, t_seccnt sects, t_bool write)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if ((ctx == NULL) || (uptr->io_flush != _sim_disk_io_flush) || (ctx->map_base == NULL) ||
+    DC_ACTIVE (ctx) || ctx->overlay || (uptr->dynflags & UNIT_DISK_CHK) ||
+    !(sim_end || (ctx->xfer_element_size == sizeof (char))))
+    return NULL;
+return _sim_disk_map_addr (ctx, lba, sects, write);
+}
+
+/* Reopen a unit's container with a different access mode */
+
+static t_stat _sim_disk_reopen (UNIT *uptr, const char *mode)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+FILE *(*open_function)(const char *filename, const char *mode);
+int (*close_function)(FILE *f);
+FILE *f;
+
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* Simh */
+        open_function = sim_fopen;
+        close_function = fclose;
+        break;
+    case DKUF_F_VHD:                                    /* Virtual Disk */
+        open_function = sim_vhd_disk_open;
+        close_function = sim_vhd_disk_close;
+        break;
+    case DKUF_F_RAW:                                    /* Physical */
+        open_function = sim_os_disk_open_raw;
+        close_function = sim_os_disk_close_raw;
+        break;
+    default:
+        return SCPE_IERR;
+    }
+f = open_function (uptr->filename, mode);
+if (f == NULL)
+    return SCPE_OPENERR;
+close_function (uptr->fileref);
+uptr->fileref = f;
+if ((uptr->dynflags & (UNIT_PIO | UNIT_DIRECTIO)) && (DK_GET_FMT (uptr) == DKUF_F_VHD))
+    sim_vhd_disk_set_iomode (f, (uptr->dynflags & UNIT_DIRECTIO) ? sim_fopen_direct (uptr->filename, mode) : NULL);
+if ((uptr->dynflags & UNIT_DIRECTIO) && (DK_GET_FMT (uptr) == DKUF_F_STD)) {
+    if (ctx->dio_file != NULL)                          /* direct transfers use their own handle */
+        fclose (ctx->dio_file);
+    ctx->dio_file = sim_fopen_direct (uptr->filename, mode);    /* NULL falls back to positioned I/O */
+    }
+ctx->zero_fsize = -1;                                   /* look at the new file */
+ctx->zero_flush = FALSE;
+return SCPE_OK;
+}
+
+/* SET <unit> COMMIT - write the memory overlay of a unit attached with -T
+   to the container and empty it.  The unit keeps its overlay. */
+
+t_stat sim_disk_commit (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr)
+{
+struct disk_context *ctx;
+t_lba c, lba;
+t_seccnt run;
+t_uint64 sects;
+t_stat r = SCPE_OK;
+
+if (cptr && (*cptr != 0))
+    return SCPE_2MARG;
+if (!(uptr->flags & UNIT_ATT))
+    return SCPE_UNATT;
+if (uptr->io_flush != _sim_disk_io_flush)
+    return SCPE_NOFNC;
+ctx = (struct disk_context *)uptr->disk_ctx;
+if (!ctx->overlay)
+    return sim_messagef (SCPE_ARG, "%s: not attached with a memory overlay\n", sim_uname (uptr));
+#if defined SIM_ASYNCH_IO
+if (ctx->asynch_io)
+    _disk_aio_drain (ctx);
+#endif
+if (_disk_cache_flush (ctx) != SCPE_OK)                 /* everything into the overlay */
+    return SCPE_IOERR;
+if (_sim_disk_reopen (uptr, "rb+") != SCPE_OK)
+    return sim_messagef (SCPE_OPENERR, "%s: can't open %s for writing\n", sim_uname (uptr), uptr->filename);
+sects = ctx->ovl_sects;
+for (c = 0; (c < ctx->ovl_chunks) && (r == SCPE_OK); c++) {
+    struct disk_ochunk *chunk = ctx->ovl_map[c];
+    t_lba s = 0;
+
+    if (chunk == NULL)
+        continue;
+    while ((s < DO_CHUNK_SECTS) && (r == SCPE_OK)) {    /* write each run of sectors */
+        if (!((chunk->valid >> s) & 1)) {
+            ++s;
+            continue;
+            }
+        for (run = 1; (s + run < DO_CHUNK_SECTS) && ((chunk->valid >> (s + run)) & 1); run++)
+            ;
+        lba = c * DO_CHUNK_SECTS + s;
+        r = _sim_disk_wrsect_fmt (uptr, lba, chunk->data + s * ctx->sector_size, NULL, run);
+        s += run;
+        }
+    }
+if (_sim_disk_reopen (uptr, "rb") != SCPE_OK)           /* back to read only, flushing */
+    r = SCPE_IOERR;
+if (r != SCPE_OK)
+    return sim_messagef (r, "%s: error writing the overlay to %s\n", sim_uname (uptr), uptr->filename);
+_do_purge (ctx);
+if (!sim_quiet)
+    sim_printf ("%s: %" LL_FMT "u sectors written to %s\n", sim_uname (uptr), sects, uptr->filename);
+return SCPE_OK;
+}
+
+static t_stat _disk_cache_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cblk *blk;
+t_seccnt i, sread = 0;
+t_stat r;
+
+DC_LOCK;
+for (i = 0; i < sects; i++) {                           /* all resident? */
+    blk = _dc_find (ctx, lba + i);
+    if ((blk == NULL) || (blk->data == NULL))
+        break;
+    }
+if (i == sects) {
+    for (i = 0; i < sects; i++) {
+        blk = _dc_get (ctx, lba + i);
+        memcpy (buf + i * ctx->sector_size, blk->data, ctx->sector_size);
+        }
+    ctx->cache_hits += sects;
+    DC_UNLOCK;
+    if (sectsread)
+        *sectsread = sects;
+    return SCPE_OK;
+    }
+DC_UNLOCK;
+r = _sim_disk_rdsect_ovl (uptr, lba, buf, &sread, sects);
+DC_LOCK;
+for (i = 0; i < sects; i++) {                           /* merge resident blocks */
+    blk = _dc_find (ctx, lba + i);
+    if (blk && blk->data) {
+        ++ctx->cache_hits;
+        if (blk->dirty)                                 /* newer than the container */
+            memcpy (buf + i * ctx->sector_size, blk->data, ctx->sector_size);
+        }
+    else ++ctx->cache_misses;
+    }
+if (r == SCPE_OK)                                       /* then cache what was read */
+    for (i = 0; i < sread; i++) {
+        blk = _dc_get (ctx, lba + i);
+        if (blk)
+            memcpy (blk->data, buf + i * ctx->sector_size, ctx->sector_size);
+        }
+DC_UNLOCK;
+if (sectsread)
+    *sectsread = sread;
+return r;
+}
+
+static t_stat _disk_cache_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cblk *blk;
+t_seccnt i;
+t_stat r;
+
+if (disk_cache_wb) {
+    DC_LOCK;
+    for (i = 0; i < sects; i++) {
+        blk = _dc_get (ctx, lba + i);
+        if (blk == NULL)                                /* no room, */
+            break;                                      /* write through */
+        memcpy (blk->data, buf + i * ctx->sector_size, ctx->sector_size);
+        if (!blk->dirty) {
+            blk->dirty = 1;
+            ++disk_cache_dirty;
+            ++ctx->cache_dirty;
+            }
+        }
+    if (i == sects) {
+        ctx->cache_deferred += sects;
+        DC_UNLOCK;
+        if (sectswritten)
+            *sectswritten = sects;
+        return SCPE_OK;
+        }
+    DC_UNLOCK;
+    }
+r = _sim_disk_wrsect_ovl (uptr, lba, buf, sectswritten, sects);
+DC_LOCK;
+for (i = 0; i < sects; i++) {                           /* update resident copies */
+    blk = _dc_find (ctx, lba + i);
+    if ((blk == NULL) || (blk->data == NULL))
+        continue;
+    if (r == SCPE_OK) {
+        memcpy (blk->data, buf + i * ctx->sector_size, ctx->sector_size);
+        _dc_clean (blk);
+        }
+    else if (!blk->dirty)                               /* container state unknown */
+        _dc_free (blk);
+    }
+DC_UNLOCK;
+return r;
+}
+
+/* Sequential read-ahead
+
+   A unit watches for reads that start where its previous read ended.
+   From the DK_RA_TRIGGER'th such read on, reads are served from a per
+   unit window of sectors read ahead of the stream.  The first window is
+   four times the size of the read that starts it and each refill doubles
+   it, up to half of DK_RA_MAX.  An asynchronous unit refills the window
+   from its I/O worker once the stream is within half a window of the end,
+   so the host read overlaps the guest's processing of the data it has; a
+   synchronous unit refills when a read runs past the end of the window.
+
+   A write to a sector in the window discards the window, as does a read
+   elsewhere, which also ends the stream.  After DK_RA_GIVEUP windows in
+   a row are discarded without serving any read, the unit's workload is
+   taken to be random and it doesn't read ahead for DK_RA_BACKOFF reads. */
+
+#define DK_RA_MAX       (256*1024)          /* read-ahead window buffer (bytes) */
+#define DK_RA_TRIGGER   3                   /* sequential reads that start read-ahead */
+#define DK_RA_GIVEUP    4                   /* wasted windows that stop read-ahead */
+#define DK_RA_BACKOFF   1000                /* reads before trying again */
+
+static t_stat _disk_rdsect_below (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (DC_ACTIVE (ctx))
+    return _disk_cache_rdsect (uptr, lba, buf, sectsread, sects);
+return _sim_disk_rdsect_ovl (uptr, lba, buf, sectsread, sects);
+}
+
+static void _disk_ra_drop (struct disk_context *ctx, t_bool wasted)
+{
+if (ctx->ra_cnt && wasted) {
+    if (ctx->ra_used)
+        ctx->ra_wasted = 0;
+    else if (++ctx->ra_wasted >= DK_RA_GIVEUP) {        /* random workload? */
+        ctx->ra_wasted = 0;
+        ctx->ra_off = DK_RA_BACKOFF;                    /* stop for a while */
+        }
+    }
+ctx->ra_cnt = 0;
+ctx->ra_used = FALSE;
+}
+
+/* Discard the sectors before keep and read the next window after what
+   is left */
+
+static t_stat _disk_ra_fill (UNIT *uptr, t_lba keep)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt cap = DK_RA_MAX / ctx->sector_size;
+t_lba limit = (t_lba)((uptr->capac*ctx->capac_factor)/(ctx->sector_size/((ctx->dptr->flags & DEV_SECTORS) ? 512 : 1)));
+t_seccnt want, got;
+t_lba end;
+t_stat r;
+
+if ((keep > ctx->ra_lba) && (keep <= ctx->ra_lba + ctx->ra_cnt)) {
+    t_seccnt gone = keep - ctx->ra_lba;
+
+    memmove (ctx->ra_buf, ctx->ra_buf + gone * ctx->sector_size, (ctx->ra_cnt - gone) * ctx->sector_size);
+    ctx->ra_lba = keep;
+    ctx->ra_cnt -= gone;
+    }
+end = ctx->ra_lba + ctx->ra_cnt;
+want = ctx->ra_window;
+if (want > cap - ctx->ra_cnt)
+    want = cap - ctx->ra_cnt;
+if (end >= limit)                                       /* end of the disk */
+    return SCPE_OK;
+if (want > limit - end)
+    want = limit - end;
+r = _disk_rdsect_below (uptr, end, ctx->ra_buf + ctx->ra_cnt * ctx->sector_size, &got, want);
+if (r != SCPE_OK)
+    return r;
+ctx->ra_cnt += want;                                    /* short reads are zero filled */
+ctx->ios.ra_sects += want;
+if (ctx->ra_window < cap / 4)                           /* grow the next window */
+    ctx->ra_window *= 2;
+else
+    ctx->ra_window = cap / 2;
+return SCPE_OK;
+}
+
+static t_stat _disk_ra_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt cap = DK_RA_MAX / ctx->sector_size;
+t_bool seq = (lba == ctx->ra_next) && (sects != 0);
+t_bool hit = TRUE;
+
+ctx->ra_next = lba + sects;
+if (!seq || (ctx->map_base != NULL) || (sects > cap / 4)) {
+    _disk_ra_drop (ctx, !seq);
+    ctx->ra_run = 0;
+    if (ctx->ra_off)
+        --ctx->ra_off;
+    return _disk_rdsect_below (uptr, lba, buf, sectsread, sects);
+    }
+if (ctx->ra_cnt == 0) {                                 /* not reading ahead now? */
+    if (ctx->ra_off)
+        --ctx->ra_off;
+    if ((++ctx->ra_run < DK_RA_TRIGGER) || ctx->ra_off)
+        return _disk_rdsect_below (uptr, lba, buf, sectsread, sects);
+    if ((ctx->ra_buf == NULL) &&
+        ((ctx->ra_buf = (uint8 *)malloc (DK_RA_MAX)) == NULL))
+        return _disk_rdsect_below (uptr, lba, buf, sectsread, sects);
+    ctx->ra_lba = lba;                                  /* start the window here */
+    ctx->ra_window = (4 * sects < cap / 2) ? 4 * sects : cap / 2;
+    }
+if (lba + sects > ctx->ra_lba + ctx->ra_cnt) {          /* past the window? */
+    hit = FALSE;
+    if ((_disk_ra_fill (uptr, lba) != SCPE_OK) ||
+        (lba + sects > ctx->ra_lba + ctx->ra_cnt)) {    /* couldn't cover it */
+        _disk_ra_drop (ctx, FALSE);
+        return _disk_rdsect_below (uptr, lba, buf, sectsread, sects);
+        }
+    }
+memcpy (buf, ctx->ra_buf + (lba - ctx->ra_lba) * ctx->sector_size, sects * ctx->sector_size);
+if (sectsread)
+    *sectsread = sects;
+if (hit) {
+    ctx->ra_used = TRUE;
+    ctx->ios.ra_hits += sects;
+    }
+#if defined (SIM_ASYNCH_IO)
+if (ctx->asynch_io && (!ctx->ra_pending) &&             /* refill from the worker */
+    ctx->busy && pthread_equal (ctx->worker, pthread_self ()) &&
+    ((ctx->ra_lba + ctx->ra_cnt) - ctx->ra_next < ctx->ra_window / 2) &&
+    (_disk_submit (uptr, DOP_RAHD, 0, NULL, NULL, 0, NULL) == SCPE_OK))
+    ctx->ra_pending = TRUE;
+#endif
+return SCPE_OK;
+}
+
+#if defined (SIM_ASYNCH_IO)
+static void _disk_ra_refill (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+ctx->ra_pending = FALSE;
+if ((ctx->ra_cnt == 0) ||                               /* stream ended? */
+    (ctx->ra_next < ctx->ra_lba) || (ctx->ra_next > ctx->ra_lba + ctx->ra_cnt))
+    return;
+if (_disk_ra_fill (uptr, ctx->ra_next) != SCPE_OK)
+    _disk_ra_drop (ctx, FALSE);
+}
+#endif
+
+/* Account for a request in the unit's I/O statistics.  Called from the
+   thread performing the request; the counts are only ever read for
+   display, so they aren't locked. */
+
+static int _disk_ios_bucket (t_uint64 val, int buckets)
+{
+int b;
+
+for (b = 0; val && (b < buckets - 1); b++)
+    val >>= 1;
+return b;
+}
+
+static void _disk_ios_record (struct disk_context *ctx, int dir, t_lba lba, t_seccnt sects, t_stat r, double start)
+{
+struct disk_iostats *ios = &ctx->ios;
+t_uint64 usecs = (t_uint64)((sim_timenow_double () - start) * 1000000.0);
+t_uint64 dist = (lba >= ios->next_lba) ? lba - ios->next_lba : ios->next_lba - lba;
+uint32 depth = 1;
+
+#if defined (SIM_ASYNCH_IO)
+if (ctx->queued > depth)                                /* includes this one */
+    depth = ctx->queued;
+#endif
+++ios->ops[dir];
+ios->sects[dir] += sects;
+if (r != SCPE_OK)
+    ++ios->errors[dir];
+ios->usecs[dir] += usecs;
+if (dist == 0)
+    ++ios->seq;
+++ios->seek_hist[_disk_ios_bucket (dist, DK_SEEK_BUCKETS)];
+++ios->svc_hist[dir][_disk_ios_bucket (usecs, DK_SVC_BUCKETS)];
+++ios->qd_hist[_disk_ios_bucket (depth, DK_QD_BUCKETS)];
+if (depth > ios->qd_max)
+    ios->qd_max = depth;
+ios->next_lba = lba + sects;
+}
+
+t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+double start = sim_timenow_double ();
+t_stat r;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+r = _disk_ra_rdsect (uptr, lba, buf, sectsread, sects);
+_disk_ios_record (ctx, DK_IOS_RD, lba, sects, r, start);
+return r;
+}
+
+t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+double start = sim_timenow_double ();
+t_stat r;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+if (uptr->dynflags & UNIT_DISK_CHK) {
+    DEVICE *dptr = find_dev_from_unit (uptr);
+    uint32 capac_factor = ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* capacity units (word: 2, byte: 1) */
+    t_lba total_sectors = (t_lba)((uptr->capac*capac_factor)/(ctx->sector_size/((dptr->flags & DEV_SECTORS) ? 512 : 1)));
+    t_lba sect;
+
+    for (sect = 0; sect < sects; sect++) {
+        t_lba offset;
+        t_bool sect_error = FALSE;
+
+        for (offset = 0; offset < ctx->sector_size; offset += sizeof(uint32)) {
+            if (*((uint32 *)&buf[sect*ctx->sector_size + offset]) != (uint32)(lba + sect)) {
+                sect_error = TRUE;
                 break;
+                }
             }
-    if ((tsects > sspsts) &&
-        ((sects + lba - tlba) & (sspsts - 1)))
-        switch (DK_GET_FMT (uptr)) {                            /* case on format */
-            case DKUF_F_VHD:                                    /* VHD format */
-                sim_vhd_disk_rdsect (uptr, tlba + tsects - sspsts,
-                                     tbuf + (tsects - sspsts) * ctx->sector_size,
-                                     NULL, sspsts);
-                break;
-            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-                sim_os_disk_rdsect (uptr, tlba + tsects - sspsts,
-                                    tbuf + (tsects - sspsts) * ctx->sector_size,
-                                    NULL, sspsts);
-                break;
-            default:
-                r = SCPE_NOFNC;
-                break;
+        if (sect_error) {
+            uint32 save_dctrl = dptr->dctrl;
+            FILE *save_sim_deb = sim_deb;
+
+            sim_printf ("\n%s%d: Write Address Verification Error on lbn %d(0x%X) of %d(0x%X).\n", sim_dname (dptr), (int)(uptr-dptr->units), (int)(lba+sect), (int)(lba+sect), (int)total_sectors, (int)total_sectors);
+            dptr->dctrl = 0xFFFFFFFF;
+            sim_deb = save_sim_deb ? save_sim_deb : stdout;
+            sim_disk_data_trace (uptr, buf+sect*ctx->sector_size, lba+sect, ctx->sector_size,    "Found", TRUE, 1);
+            dptr->dctrl = save_dctrl;
+            sim_deb = save_sim_deb;
             }
-    sim_buf_copy_swapped (tbuf + (lba & (sspsts - 1)) * ctx->sector_size,
-                          buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
-    switch (DK_GET_FMT (uptr)) {                            /* case on format */
-        case DKUF_F_VHD:                                    /* VHD format */
-            r = sim_vhd_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
-            break;
-        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-            r = sim_os_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
-            break;
-        default:
-            r = SCPE_NOFNC;
-            break;
-        }
-    if ((r == SCPE_OK) && sectswritten) {
-        *sectswritten -= (lba - tlba);
-        if (*sectswritten > sects)
-            *sectswritten = sects;
         }
     }
-free (tbuf);
+if (ctx->ra_cnt && (lba < ctx->ra_lba + ctx->ra_cnt) && (lba + sects > ctx->ra_lba))
+    _disk_ra_drop (ctx, FALSE);                         /* read-ahead window is stale */
+if (DC_ACTIVE (ctx))
+    r = _disk_cache_wrsect (uptr, lba, buf, sectswritten, sects);
+else
+    r = _sim_disk_wrsect_ovl (uptr, lba, buf, sectswritten, sects);
+_disk_ios_record (ctx, DK_IOS_WR, lba, sects, r, start);
 return r;
 }
 
@@ -818,14 +2589,16 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
 static void _sim_disk_io_flush (UNIT *uptr)
 {
 uint32 f = DK_GET_FMT (uptr);
-
-#if defined (SIM_ASYNCH_IO)
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
+#if defined (SIM_ASYNCH_IO)
 sim_disk_clr_async (uptr);
 if (sim_asynch_enabled)
     sim_disk_set_async (uptr, ctx->asynch_io_latency);
 #endif
+_disk_cache_flush (ctx);                                /* write back dirty blocks */
+if (ctx->map_wr)
+    sim_fmap_sync (ctx->map);                           /* force out mapped data */
 switch (f) {                                            /* case on format */
     case DKUF_F_STD:                                    /* Simh */
         fflush (uptr->fileref);
@@ -1531,6 +3304,9 @@ ctx->capac_factor = ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* save capaci
 ctx->xfer_element_size = (uint32)xfer_element_size;     /* save xfer_element_size */
 ctx->dptr = dptr;                                       /* save DEVICE pointer */
 ctx->dbit = dbit;                                       /* save debug bit */
+ctx->uptr = uptr;                                       /* save UNIT pointer */
+ctx->ios.since = sim_timenow_double ();                 /* statistics start now */
+ctx->zero_fsize = -1;                                   /* container size not known yet */
 sim_debug (ctx->dbit, ctx->dptr, "sim_disk_attach(unit=%d,filename='%s')\n", (int)(uptr-ctx->dptr->units), uptr->filename);
 ctx->auto_format = auto_format;                         /* save that we auto selected format */
 ctx->storage_sector_size = (uint32)sector_size;         /* Default */
@@ -1547,6 +3323,14 @@ if ((sim_switches & SWMASK ('R')) ||                    /* read only? */
         sim_printf ("%s%d: unit is read only\n", sim_dname (dptr), (int)(uptr-dptr->units));
         }
     }
+else if (sim_switches & SWMASK ('T')) {                 /* memory overlay? */
+    uptr->fileref = open_function (cptr, "rb");         /* container is never written */
+    if (uptr->fileref == NULL)                          /* open fail? */
+        return _err_return (uptr, SCPE_OPENERR);        /* yes, error */
+    ctx->overlay = TRUE;
+    if (!sim_quiet)
+        sim_printf ("%s%d: writes are kept in memory and discarded on detach\n", sim_dname (dptr), (int)(uptr-dptr->units));
+    }
 else {                                                  /* normal */
     uptr->fileref = open_function (cptr, "rb+");        /* open r/w */
     if (uptr->fileref == NULL) {                        /* open fail? */
@@ -1592,6 +3376,19 @@ uptr->pos = 0;
 if (storage_function)
     storage_function (uptr->fileref, &ctx->storage_sector_size, &ctx->removable);
 
+if ((uptr->dynflags & (UNIT_PIO | UNIT_DIRECTIO)) &&    /* positioned I/O? */
+    (DK_GET_FMT (uptr) != DKUF_F_RAW)) {                /* (RAW always is) */
+    if (uptr->dynflags & UNIT_DIRECTIO) {
+        ctx->dio_file = sim_fopen_direct (cptr, ((uptr->flags & UNIT_RO) || ctx->overlay) ? "rb" : "rb+");
+        if ((ctx->dio_file == NULL) && !sim_quiet)
+            sim_printf ("%s%d: direct I/O not available, using positioned I/O\n", sim_dname (dptr), (int)(uptr-dptr->units));
+        }
+    if (DK_GET_FMT (uptr) == DKUF_F_VHD) {
+        sim_vhd_disk_set_iomode (uptr->fileref, ctx->dio_file);
+        ctx->dio_file = NULL;                           /* VHD handle owns it */
+        }
+    }
+
 if ((created) && (!copied)) {
     t_stat r = SCPE_OK;
     uint8 *secbuf = (uint8 *)calloc (128, ctx->sector_size);     /* alloc temp sector buf */
@@ -1606,6 +3403,8 @@ if ((created) && (!copied)) {
             if the containing disk is full
          3) it leaves a Sinh Format disk at the intended size so it may
             subsequently be autosized with the correct size.
+       With SET <unit> ZEROELIDE all zero writes are elided, so the first
+       two then only apply to containers which can't be left sparse.
     */
     if (secbuf == NULL)
         r = SCPE_MEM;
@@ -1753,10 +3552,19 @@ if (capac && (capac != (t_offset)-1)) {
         }
     }
 
+if ((DK_GET_FMT (uptr) == DKUF_F_STD) &&                /* preallocated container? */
+    (0 == fflush (uptr->fileref)) && sim_fallocated (uptr->fileref))
+    ctx->prealloc = TRUE;                               /* then keep it that way */
+ctx->zero_fsize = -1;
+
+if (uptr->dynflags & UNIT_MAPPED)
+    _sim_disk_map (uptr);
+
 #if defined (SIM_ASYNCH_IO)
 sim_disk_set_async (uptr, completion_delay);
 #endif
 uptr->io_flush = _sim_disk_io_flush;
+ctx->cache_ok = (DK_GET_FMT (uptr) != DKUF_F_RAW);      /* host block cache for container files */
 
 return SCPE_OK;
 }
@@ -1801,6 +3609,23 @@ if (uptr->io_flush)
     uptr->io_flush (uptr);                              /* flush buffered data */
 
 sim_disk_clr_async (uptr);
+if (_disk_cache_flush (ctx) != SCPE_OK)                 /* write back anything left */
+    sim_printf ("%s: Disk cache write back failed\n", sim_uname (uptr));
+ctx->cache_ok = FALSE;
+_disk_cache_purge (ctx);
+_do_purge (ctx);                                        /* discard the overlay */
+_sim_disk_unmap (ctx);
+free (ctx->ra_buf);
+if (ctx->dio_file)
+    fclose (ctx->dio_file);
+#if defined (SIM_ASYNCH_IO)
+while (ctx->cq_head) {                                  /* drop undelivered */
+    struct disk_req *req = ctx->cq_head;                /* completions */
+
+    ctx->cq_head = req->next;
+    free (req);
+    }
+#endif
 
 uptr->flags &= ~(UNIT_ATT | UNIT_RO);
 uptr->dynflags &= ~(UNIT_NO_FIO | UNIT_DISK_CHK);
@@ -1878,6 +3703,9 @@ fprintf (st, "    -M          Merge a Differencing VHD into its parent VHD disk\
 fprintf (st, "    -O          Override consistency checks when attaching differencing disks\n");
 fprintf (st, "                which have unexpected parent disk GUID or timestamps\n\n");
 fprintf (st, "    -U          Fix inconsistencies which are overridden by the -O switch\n");
+fprintf (st, "    -T          Open the disk container read only and keep all writes in a\n");
+fprintf (st, "                memory overlay which is discarded on detach.  SET %s COMMIT\n", dptr->name);
+fprintf (st, "                writes the overlay back to the container.\n");
 fprintf (st, "    -Y          Answer Yes to prompt to overwrite last track (on disk create)\n");
 fprintf (st, "    -N          Answer No to prompt to overwrite last track (on disk create)\n");
 fprintf (st, "Examples:\n");
@@ -2763,6 +4591,17 @@ static int sim_vhd_disk_close (FILE *f)
 return -1;
 }
 
+static void sim_vhd_disk_set_iomode (FILE *f, FILE *direct)
+{
+if (direct)
+    fclose (direct);
+}
+
+static FILE *sim_vhd_disk_fixed_file (FILE *f)
+{
+return NULL;
+}
+
 static void sim_vhd_disk_flush (FILE *f)
 {
 }
@@ -3426,6 +5265,21 @@ struct VHD_IOData {
     FILE *File;
     char ParentVHDPath[512];
     struct VHD_IOData *Parent;
+    uint64 DataEnd;             /* end of allocated data blocks, 0 until the first allocation */
+    uint64 FooterOffset;        /* location of the trailing footer */
+    uint8 *BATDirty;            /* per BAT sector: changed in memory only */
+    uint32 BATDirtyCount;
+    uint64 ZeroSectorsElided;   /* all zero writes left in unallocated blocks */
+    t_bool Positioned;          /* data transfers bypass stdio (IOMODE) */
+    FILE *Direct;               /* File opened for direct transfers, or NULL */
+    struct VHD_BlockOwner *BlockMap;    /* differencing chain: owner of each block, or NULL */
+    };
+
+/* Owner of a block of a differencing disk chain, flattened across all parents */
+
+struct VHD_BlockOwner {
+    struct VHD_IOData *Owner;   /* disk holding the block data, NULL when it reads as zeros */
+    uint32 Sector;              /* file sector where the block data starts */
     };
 
 static t_stat sim_vhd_disk_implemented (void)
@@ -3492,6 +5346,64 @@ VHDHANDLE hVHD  = (VHDHANDLE)f;
 return (char *)(&hVHD->Footer.DriveType[0]);
 }
 
+/* Build the block map of a differencing disk
+
+   Each level of a differencing chain only holds the blocks written while
+   it was the top of the chain.  Rather than looking up every free block
+   in the BAT of each parent in turn on every read, the owning disk and
+   file location of every block is worked out once when the disk is
+   opened.  The parent's map already covers the rest of the chain, so the
+   child takes it over, overlaid with its own allocated blocks.  Reads
+   then go straight to the owning file and block allocations update the
+   map as they happen.  Parents are only ever opened read only, so the map
+   can't go stale.
+
+   A chain whose levels don't share the same block layout keeps walking
+   the parents on each read, as does every disk above a level without a
+   map.
+*/
+
+static void BuildVirtualDiskBlockMap (VHDHANDLE hVHD)
+{
+VHDHANDLE Parent = hVHD->Parent;
+uint32 SectorsPerBlock = NtoHl (hVHD->Dynamic.BlockSize)/512;
+uint32 BitMapSectors = (((7+SectorsPerBlock)/8)+511)/512;
+uint32 Blocks = NtoHl (hVHD->Dynamic.MaxTableEntries);
+t_bool ParentFixed = (NtoHl (Parent->Footer.DiskType) == VHD_DT_Fixed);
+uint32 i;
+
+if ((!ParentFixed) &&
+    ((Parent->Dynamic.BlockSize != hVHD->Dynamic.BlockSize) ||
+     (NtoHl (Parent->Dynamic.MaxTableEntries) < Blocks)))
+    return;
+if ((!ParentFixed) && (Parent->Parent != NULL) &&       /* parent walks its own parents? */
+    (Parent->BlockMap == NULL))
+    return;                                             /* then so must this disk */
+hVHD->BlockMap = (struct VHD_BlockOwner *)calloc (Blocks, sizeof (*hVHD->BlockMap));
+if (hVHD->BlockMap == NULL)
+    return;
+for (i = 0; i < Blocks; i++) {
+    struct VHD_BlockOwner *Block = &hVHD->BlockMap[i];
+
+    if (hVHD->BAT[i] != VHD_BAT_FREE_ENTRY) {
+        Block->Owner = hVHD;
+        Block->Sector = NtoHl (hVHD->BAT[i]) + BitMapSectors;
+        }
+    else if (Parent->BlockMap)
+        *Block = Parent->BlockMap[i];
+    else if (ParentFixed) {
+        Block->Owner = Parent;
+        Block->Sector = i * SectorsPerBlock;
+        }
+    else if (Parent->BAT[i] != VHD_BAT_FREE_ENTRY) {
+        Block->Owner = Parent;
+        Block->Sector = NtoHl (Parent->BAT[i]) + BitMapSectors;
+        }
+    }
+free (Parent->BlockMap);                        /* the parent is only read through this disk */
+Parent->BlockMap = NULL;
+}
+
 static FILE *sim_vhd_disk_open (const char *szVHDPath, const char *DesiredAccess)
     {
     VHDHANDLE hVHD = (VHDHANDLE) calloc (1, sizeof(*hVHD));
@@ -3571,6 +5483,8 @@ Cleanup_Return:
                 hVHD = NULL;
                 }
             }
+        if (hVHD && hVHD->Parent)
+            BuildVirtualDiskBlockMap (hVHD);
         }
     errno = Status;
     return (FILE *)hVHD;
@@ -3698,6 +5612,9 @@ Cleanup_Return:
     return (FILE *)hVHD;
     }
 
+static t_stat FlushVirtualDiskBAT (VHDHANDLE hVHD);
+static t_stat ReleaseVirtualDiskReserve (VHDHANDLE hVHD);
+
 static int sim_vhd_disk_close (FILE *f)
 {
 VHDHANDLE hVHD = (VHDHANDLE)f;
@@ -3705,23 +5622,55 @@ VHDHANDLE hVHD = (VHDHANDLE)f;
 if (NULL != hVHD) {
     if (hVHD->Parent)
         sim_vhd_disk_close ((FILE *)hVHD->Parent);
-    free (hVHD->BAT);
     if (hVHD->File) {
+        FlushVirtualDiskBAT (hVHD);
+        ReleaseVirtualDiskReserve (hVHD);
         fflush (hVHD->File);
         fclose (hVHD->File);
         }
+    if (hVHD->Direct)
+        fclose (hVHD->Direct);
+    free (hVHD->BAT);
+    free (hVHD->BATDirty);
+    free (hVHD->BlockMap);
     free (hVHD);
     return 0;
     }
 return -1;
 }
 
+/* Switch data transfers of a VHD (and its parents) to positioned I/O */
+
+static void sim_vhd_disk_set_iomode (FILE *f, FILE *direct)
+{
+VHDHANDLE hVHD = (VHDHANDLE)f;
+
+if (hVHD->Direct)
+    fclose (hVHD->Direct);
+hVHD->Direct = direct;
+for (; hVHD != NULL; hVHD = hVHD->Parent)
+    hVHD->Positioned = TRUE;
+}
+
+/* The container of a fixed VHD, whose data starts at offset 0, or NULL */
+
+static FILE *sim_vhd_disk_fixed_file (FILE *f)
+{
+VHDHANDLE hVHD = (VHDHANDLE)f;
+
+if (NtoHl (hVHD->Footer.DiskType) != VHD_DT_Fixed)
+    return NULL;
+return hVHD->File;
+}
+
 static void sim_vhd_disk_flush (FILE *f)
 {
 VHDHANDLE hVHD = (VHDHANDLE)f;
 
-if ((NULL != hVHD) && (hVHD->File))
+if ((NULL != hVHD) && (hVHD->File)) {
+    FlushVirtualDiskBAT (hVHD);
     fflush (hVHD->File);
+    }
 }
 
 static t_offset sim_vhd_disk_size (FILE *f)
@@ -4241,6 +6190,46 @@ static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szPare
 return (FILE *)CreateDifferencingVirtualDisk (szVHDPath, szParentVHDPath);
 }
 
+/* Data block transfers.  Metadata (footer, header, BAT and block bitmaps)
+   always goes through stdio, so that is flushed before a positioned
+   transfer to keep the two views of the file consistent. */
+
+static t_stat
+ReadVirtualDiskData(VHDHANDLE hVHD, void *buf, size_t bufsize, size_t *bytesread, uint64 position)
+{
+size_t done;
+
+if (!hVHD->Positioned)
+    return ReadFilePosition(hVHD->File, buf, bufsize, bytesread, position);
+fflush (hVHD->File);
+if (bytesread)
+    *bytesread = 0;
+if (_sim_disk_pio (hVHD->File, &hVHD->Direct, FALSE, buf, bufsize, (t_offset)position, &done))
+    return SCPE_IOERR;
+if (done < bufsize)                                     /* past the end reads as zeros */
+    memset ((uint8 *)buf + done, 0, bufsize - done);
+if (bytesread)
+    *bytesread = done;
+return SCPE_OK;
+}
+
+static t_stat
+WriteVirtualDiskData(VHDHANDLE hVHD, void *buf, size_t bufsize, size_t *byteswritten, uint64 position)
+{
+size_t done;
+
+if (!hVHD->Positioned)
+    return WriteFilePosition(hVHD->File, buf, bufsize, byteswritten, position);
+fflush (hVHD->File);
+if (byteswritten)
+    *byteswritten = 0;
+if (_sim_disk_pio (hVHD->File, &hVHD->Direct, TRUE, buf, bufsize, (t_offset)position, &done))
+    return SCPE_IOERR;
+if (byteswritten)
+    *byteswritten = done;
+return SCPE_OK;
+}
+
 static t_stat
 ReadVirtualDiskSectors(VHDHANDLE hVHD,
                        uint8 *buf,
@@ -4263,7 +6252,7 @@ if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll (hVHD->Footer.CurrentSize)
     return SCPE_IOERR;
     }
 if (NtoHl (hVHD->Footer.DiskType) == VHD_DT_Fixed) {
-    if (ReadFilePosition(hVHD->File,
+    if (ReadVirtualDiskData(hVHD,
                          buf,
                          sects*SectorSize,
                          &BytesRead,
@@ -4273,7 +6262,7 @@ if (NtoHl (hVHD->Footer.DiskType) == VHD_DT_Fixed) {
         return SCPE_IOERR;
         }
     if (sectsread)
-        *sectsread /= SectorSize;
+        *sectsread = (t_seccnt)(BytesRead/SectorSize);
     return SCPE_OK;
     }
 /* We are now dealing with a Dynamically expanding or differencing disk */
@@ -4286,7 +6275,24 @@ while (sects) {
     SectorsInRead = SectorsPerBlock - lba%SectorsPerBlock;
     if (SectorsInRead > sects)
         SectorsInRead = sects;
-    if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
+    if (hVHD->BlockMap) {                       /* flattened differencing chain */
+        struct VHD_BlockOwner *Block = &hVHD->BlockMap[BlockNumber];
+
+        if (Block->Owner == NULL)
+            memset (buf, 0, SectorSize*SectorsInRead);
+        else {
+            if (ReadVirtualDiskData(Block->Owner,
+                                 buf,
+                                 SectorsInRead*SectorSize,
+                                 NULL,
+                                 SectorSize*((uint64)Block->Sector + lba%SectorsPerBlock))) {
+                if (sectsread)
+                    *sectsread = BlocksRead;
+                return SCPE_IOERR;
+                }
+            }
+        }
+    else if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
         if (!hVHD->Parent)
             memset (buf, 0, SectorSize*SectorsInRead);
         else {
@@ -4304,7 +6310,7 @@ while (sects) {
         }
     else {
         BlockOffset = SectorSize*((uint64)(NtoHl (hVHD->BAT[BlockNumber]) + lba%SectorsPerBlock + BitMapSectors));
-        if (ReadFilePosition(hVHD->File,
+        if (ReadVirtualDiskData(hVHD,
                              buf,
                              SectorsInRead*SectorSize,
                              NULL,
@@ -4352,6 +6358,113 @@ for (i=0; i<BufferSize; ++i)
 return TRUE;
 }
 
+/* Dynamic disk block allocation
+
+   New data blocks go at the end of the allocated data.  Instead of
+   growing the file one block at a time (writing a whole zeroed block,
+   moving the footer and rewriting a BAT sector for every allocation),
+   the file is grown VHD_ALLOC_BATCH blocks at a time: the space is
+   reserved on the host (it reads as zeros) and the footer moves to the
+   new end of file.  Allocating a block inside the reserved space only
+   writes its sector bitmap.  The BAT entry is updated in memory and its
+   BAT sector is marked dirty.
+
+   Dirty BAT sectors are written when the reserved space is used up, when
+   the disk is flushed (the simulator stops) and when it is closed.  Data
+   and bitmaps are committed to the host's storage (sim_fsync) before the
+   BAT entries which refer to them are written, and a new footer is
+   committed before the old one is overwritten, so the file always ends
+   in a valid footer.  A host crash can lose recent allocations but
+   leaves a consistent VHD.  Closing the disk gives back the reserved
+   space which wasn't used.
+*/
+
+#define VHD_ALLOC_BATCH 8                               /* blocks reserved per extension */
+
+static t_stat FlushVirtualDiskBAT (VHDHANDLE hVHD)
+{
+uint32 BATBytes = sizeof (*hVHD->BAT) * NtoHl (hVHD->Dynamic.MaxTableEntries);
+uint32 BATSectors = (BATBytes + 511) / 512;
+uint32 i, j, End;
+t_stat r = SCPE_OK;
+
+if (hVHD->BATDirtyCount == 0)
+    return SCPE_OK;
+if (sim_fsync (hVHD->File))                             /* data is stable before the BAT */
+    return SCPE_IOERR;
+for (i = 0; i < BATSectors; i = j) {
+    if (!hVHD->BATDirty[i]) {
+        j = i + 1;
+        continue;
+        }
+    for (j = i; (j < BATSectors) && hVHD->BATDirty[j]; j++)
+        ;
+    End = (j * 512 > BATBytes) ? BATBytes : j * 512;
+    if (WriteFilePosition (hVHD->File,
+                           ((uint8 *)hVHD->BAT) + i * 512,
+                           End - i * 512,
+                           NULL,
+                           NtoHll (hVHD->Dynamic.TableOffset) + i * 512)) {
+        r = SCPE_IOERR;
+        continue;
+        }
+    memset (&hVHD->BATDirty[i], 0, j - i);
+    hVHD->BATDirtyCount -= j - i;
+    }
+fflush (hVHD->File);
+return r;
+}
+
+/* Grow the reserved space so that it extends at least to Needed */
+
+static t_stat ReserveVirtualDiskSpace (VHDHANDLE hVHD, uint64 Needed, uint64 Batch)
+{
+uint64 OldFooter = hVHD->FooterOffset;
+uint64 NewFooter = Needed + Batch;
+uint8 Zeros[sizeof (hVHD->Footer)];
+
+if (FlushVirtualDiskBAT (hVHD))                         /* previous batch complete */
+    return SCPE_IOERR;
+if (sim_fallocate (hVHD->File, (t_offset)(NewFooter + sizeof (hVHD->Footer))) ||
+    WriteFilePosition (hVHD->File,
+                       &hVHD->Footer,
+                       sizeof (hVHD->Footer),
+                       NULL,
+                       NewFooter))
+    return SCPE_IOERR;
+if (sim_fsync (hVHD->File))                             /* new footer is stable */
+    return SCPE_IOERR;
+memset (Zeros, 0, sizeof (Zeros));                      /* old footer is now reserved */
+if (WriteFilePosition (hVHD->File,                      /* space which must read as zeros */
+                       Zeros,
+                       sizeof (Zeros),
+                       NULL,
+                       OldFooter))
+    return SCPE_IOERR;
+hVHD->FooterOffset = NewFooter;
+return SCPE_OK;
+}
+
+/* Move the footer back to the end of the allocated data */
+
+static t_stat ReleaseVirtualDiskReserve (VHDHANDLE hVHD)
+{
+if ((hVHD->DataEnd == 0) || (hVHD->FooterOffset <= hVHD->DataEnd))
+    return SCPE_OK;
+if (WriteFilePosition (hVHD->File,
+                       &hVHD->Footer,
+                       sizeof (hVHD->Footer),
+                       NULL,
+                       hVHD->DataEnd))
+    return SCPE_IOERR;
+if (sim_fsync (hVHD->File))                             /* new footer is stable */
+    return SCPE_IOERR;
+if (sim_set_fsize_ex (hVHD->File, (t_offset)(hVHD->DataEnd + sizeof (hVHD->Footer))))
+    return SCPE_IOERR;
+hVHD->FooterOffset = hVHD->DataEnd;
+return SCPE_OK;
+}
+
 static t_stat
 WriteVirtualDiskSectors(VHDHANDLE hVHD,
                         uint8 *buf,
@@ -4374,7 +6487,7 @@ if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll(hVHD->Footer.CurrentSize))
     return SCPE_IOERR;
     }
 if (NtoHl(hVHD->Footer.DiskType) == VHD_DT_Fixed) {
-    if (WriteFilePosition(hVHD->File,
+    if (WriteVirtualDiskData(hVHD,
                           buf,
                           sects*SectorSize,
                           &BytesWritten,
@@ -4384,7 +6497,7 @@ if (NtoHl(hVHD->Footer.DiskType) == VHD_DT_Fixed) {
         return SCPE_IOERR;
         }
     if (sectswritten)
-        *sectswritten /= SectorSize;
+        *sectswritten = (t_seccnt)(BytesWritten/SectorSize);
     return SCPE_OK;
     }
 /* We are now dealing with a Dynamically expanding or differencing disk */
@@ -4402,105 +6515,68 @@ while (sects) {
     SectorsInWrite = 1;
     if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
         uint8 *BitMap = NULL;
-        uint32 BitMapBufferSize = VHD_DATA_BLOCK_ALIGNMENT;
-        uint8 *BitMapBuffer = NULL;
         void *BlockData = NULL;
-        uint8 *BATUpdateBufferAddress;
-        uint32 BATUpdateBufferSize;
-        uint64 BATUpdateStorageAddress;
+        uint64 BlockEnd;
 
-        if (!hVHD->Parent && BufferIsZeros(buf, SectorSize))
+        if (!hVHD->Parent && BufferIsZeros(buf, SectorSize)) {
+            ++hVHD->ZeroSectorsElided;                  /* block stays unallocated */
             goto IO_Done;
-        /* Need to allocate a new Data Block. */
-        BlockOffset = sim_fsize_ex (hVHD->File);
-        if (((int64)BlockOffset) == -1)
-            return SCPE_IOERR;
-        if (BitMapSectors*SectorSize > BitMapBufferSize)
-            BitMapBufferSize = BitMapSectors*SectorSize;
-        BitMapBuffer = (uint8 *)calloc(1, BitMapBufferSize + SectorSize*SectorsPerBlock);
-        if (BitMapBufferSize > BitMapSectors*SectorSize)
-            BitMap = BitMapBuffer + BitMapBufferSize-BitMapBytes;
-        else
-            BitMap = BitMapBuffer;
-        memset(BitMap, 0xFF, BitMapBytes);
-        BlockOffset -= sizeof(hVHD->Footer);
-        if (0 == (BlockOffset & ~(VHD_DATA_BLOCK_ALIGNMENT-1)))
-            {  // Already aligned, so use padded BitMapBuffer
-            if (WriteFilePosition(hVHD->File,
-                                  BitMapBuffer,
-                                  BitMapBufferSize + SectorSize*SectorsPerBlock,
-                                  NULL,
-                                  BlockOffset)) {
-                free (BitMapBuffer);
-                return SCPE_IOERR;
-                }
-            BlockOffset += BitMapBufferSize;
             }
-        else
-            {
-            // align the data portion of the block to the desired alignment
-            // compute the address of the data portion of the block
-            BlockOffset += BitMapSectors*SectorSize;
-            // round up this address to the desired alignment
-            BlockOffset += VHD_DATA_BLOCK_ALIGNMENT-1;
-            BlockOffset &= ~(VHD_DATA_BLOCK_ALIGNMENT-1);
-            BlockOffset -= BitMapSectors*SectorSize;
-            if (WriteFilePosition(hVHD->File,
-                                  BitMap,
-                                  SectorSize * (BitMapSectors + SectorsPerBlock),
-                                  NULL,
-                                  BlockOffset)) {
-                free (BitMapBuffer);
+        /* Need to allocate a new Data Block. */
+        if (hVHD->DataEnd == 0) {                       /* first allocation since open */
+            uint32 BATSectors = (sizeof (*hVHD->BAT) * NtoHl (hVHD->Dynamic.MaxTableEntries) + 511) / 512;
+
+            BlockOffset = sim_fsize_ex (hVHD->File);
+            if (((int64)BlockOffset) == -1)
                 return SCPE_IOERR;
-                }
-            BlockOffset += BitMapSectors*SectorSize;
+            if (hVHD->BATDirty == NULL)
+                hVHD->BATDirty = (uint8 *)calloc (BATSectors, sizeof (*hVHD->BATDirty));
+            if (hVHD->BATDirty == NULL)
+                return SCPE_MEM;
+            hVHD->DataEnd = hVHD->FooterOffset = BlockOffset - sizeof(hVHD->Footer);
             }
-        free(BitMapBuffer);
-        BitMapBuffer = BitMap = NULL;
-        /* the BAT block address is the beginning of the block bitmap */
+        /* align the data portion of the block to the desired alignment */
+        BlockOffset = hVHD->DataEnd + BitMapSectors*SectorSize;
+        BlockOffset += VHD_DATA_BLOCK_ALIGNMENT-1;
+        BlockOffset &= ~(VHD_DATA_BLOCK_ALIGNMENT-1);
         BlockOffset -= BitMapSectors*SectorSize;
-        hVHD->BAT[BlockNumber] = NtoHl((uint32)(BlockOffset/SectorSize));
-        BlockOffset += SectorSize * (SectorsPerBlock + BitMapSectors);
+        BlockEnd = BlockOffset + SectorSize * (BitMapSectors + SectorsPerBlock);
+        if ((BlockEnd > hVHD->FooterOffset) &&
+            ReserveVirtualDiskSpace (hVHD, BlockEnd, (VHD_ALLOC_BATCH - 1) * (BlockEnd - hVHD->DataEnd)))
+            return SCPE_IOERR;
+        /* the data portion is reserved space which reads as zeros, so only the bitmap is written */
+        BitMap = (uint8 *)calloc (BitMapSectors, SectorSize);
+        if (BitMap == NULL)
+            return SCPE_MEM;
+        memset(BitMap, 0xFF, BitMapBytes);
         if (WriteFilePosition(hVHD->File,
-                              &hVHD->Footer,
-                              sizeof(hVHD->Footer),
+                              BitMap,
+                              BitMapSectors*SectorSize,
                               NULL,
-                              BlockOffset))
-            goto Fatal_IO_Error;
-        /* Since a large VHD can have a pretty large BAT, and we've only changed one longword bat entry
-           in the current BAT, we write just the aligned sector which contains the updated BAT entry */
-        BATUpdateBufferAddress = (uint8 *)hVHD->BAT - (size_t)NtoHll(hVHD->Dynamic.TableOffset) + 
-            (size_t)((((size_t)&hVHD->BAT[BlockNumber]) - (size_t)hVHD->BAT + (size_t)NtoHll(hVHD->Dynamic.TableOffset)) & ~(VHD_DATA_BLOCK_ALIGNMENT-1));
-        /* If the starting of the BAT isn't on a VHD_DATA_BLOCK_ALIGNMENT boundary and we've just updated 
-           a BAT entry early in the array, the buffer computed address might be before the start of the
-           BAT table.  If so, only write the BAT data needed */
-        if (BATUpdateBufferAddress < (uint8 *)hVHD->BAT) {
-            BATUpdateBufferAddress = (uint8 *)hVHD->BAT;
-            BATUpdateBufferSize = (uint32)((((size_t)&hVHD->BAT[BlockNumber]) - (size_t)hVHD->BAT) + 512) & ~511;
-            BATUpdateStorageAddress = NtoHll(hVHD->Dynamic.TableOffset);
+                              BlockOffset)) {
+            free (BitMap);
+            return SCPE_IOERR;
             }
-        else {
-            BATUpdateBufferSize = VHD_DATA_BLOCK_ALIGNMENT;
-            BATUpdateStorageAddress = NtoHll(hVHD->Dynamic.TableOffset) + BATUpdateBufferAddress - ((uint8 *)hVHD->BAT);
+        free (BitMap);
+        BitMap = NULL;
+        /* the BAT block address is the beginning of the block bitmap */
+        hVHD->BAT[BlockNumber] = NtoHl((uint32)(BlockOffset/SectorSize));
+        if (!hVHD->BATDirty[(BlockNumber * sizeof (*hVHD->BAT)) / 512]) {
+            hVHD->BATDirty[(BlockNumber * sizeof (*hVHD->BAT)) / 512] = 1;
+            ++hVHD->BATDirtyCount;
             }
-        /* If the total BAT is smaller than one VHD_DATA_BLOCK_ALIGNMENT, then be sure to only write out the BAT data */
-        if ((size_t)(BATUpdateBufferAddress - (uint8 *)hVHD->BAT + BATUpdateBufferSize) > 512*((sizeof(*hVHD->BAT)*NtoHl(hVHD->Dynamic.MaxTableEntries) + 511)/512))
-            BATUpdateBufferSize = (uint32)(512*((sizeof(*hVHD->BAT)*NtoHl(hVHD->Dynamic.MaxTableEntries) + 511)/512) - (BATUpdateBufferAddress - ((uint8 *)hVHD->BAT)));
-        if (WriteFilePosition(hVHD->File,
-                              BATUpdateBufferAddress,
-                              BATUpdateBufferSize,
-                              NULL,
-                              BATUpdateStorageAddress))
-            goto Fatal_IO_Error;
+        hVHD->DataEnd = BlockEnd;
         if (hVHD->Parent)
             { /* Need to populate data block contents from parent VHD */
             uint32 BlockSectors = SectorsPerBlock;
 
-            BlockData = malloc(SectorsPerBlock*SectorSize);
-
             if (((lba/SectorsPerBlock)*SectorsPerBlock + BlockSectors) > ((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize)
                 BlockSectors = (uint32)(((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize - (lba/SectorsPerBlock)*SectorsPerBlock);
-            if (ReadVirtualDiskSectors(hVHD->Parent,
+            if ((lba%SectorsPerBlock == 0) && (sects >= BlockSectors))
+                goto Block_Allocated;                   /* whole block is about to be written */
+            BlockData = malloc(SectorsPerBlock*SectorSize);
+            /* the block map still names the previous owner of the block */
+            if (ReadVirtualDiskSectors(hVHD->BlockMap ? hVHD : hVHD->Parent,
                                        (uint8*) BlockData,
                                        BlockSectors,
                                        NULL,
@@ -4516,6 +6592,11 @@ while (sects) {
                 goto Fatal_IO_Error;
             free(BlockData);
             }
+Block_Allocated:
+        if (hVHD->BlockMap) {
+            hVHD->BlockMap[BlockNumber].Owner = hVHD;
+            hVHD->BlockMap[BlockNumber].Sector = (uint32)(BlockOffset/SectorSize) + BitMapSectors;
+            }
         continue;
 Fatal_IO_Error:
         free (BitMap);
@@ -4529,7 +6610,7 @@ Fatal_IO_Error:
         SectorsInWrite = SectorsPerBlock - lba%SectorsPerBlock;
         if (SectorsInWrite > sects)
             SectorsInWrite = sects;
-        if (WriteFilePosition(hVHD->File,
+        if (WriteVirtualDiskData(hVHD,
                               buf,
                               SectorsInWrite*SectorSize,
                               NULL,
@@ -4554,7 +6635,11 @@ static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *
 {
 VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+uint64 elided = hVHD->ZeroSectorsElided;
+t_stat r;
 
-return WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+r = WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+ctx->zero_elided += hVHD->ZeroSectorsElided - elided;
+return r;
 }
 #endif
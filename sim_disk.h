@@ -84,6 +84,16 @@ t_stat sim_disk_show_capac (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 t_stat sim_disk_set_asynch (UNIT *uptr, int latency);
 t_stat sim_disk_clr_asynch (UNIT *uptr);
 t_stat sim_disk_reset (UNIT *uptr);
+t_stat sim_disk_set_cache (int32 flag, CONST char *cptr);
+t_stat sim_disk_show_cache (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_cache_flush (void);
+t_stat sim_disk_show_iostats (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_set_iostats (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_commit (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_set_iomode (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_set_zeroelide (DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+t_stat sim_disk_show_iomode (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, CONST char *cptr);
+uint8 *sim_disk_mapped (UNIT *uptr, t_lba lba, t_seccnt sects, t_bool write);
 t_stat sim_disk_perror (UNIT *uptr, const char *msg);
 t_stat sim_disk_clearerr (UNIT *uptr);
 t_bool sim_disk_isavailable (UNIT *uptr);
@@ -150,6 +150,13 @@
                       specified at open time.  This functionality is only 
                       available on *nix platforms since the vde api isn't 
                       available on Windows.
+  HAVE_AF_PACKET_NETWORK
+                    - Specifies that support for native Linux AF_PACKET 
+                      networking should be included.  Frames move through 
+                      memory mapped TPACKET_V3 receive and transmit rings 
+                      and are filtered in the kernel, without needing 
+                      libpcap.  This allows device names of the form 
+                      afpacket:eth0 to be specified at open time.
   HAVE_SLIRP_NETWORK- Specifies that support for SLiRP networking should be 
                       included.  This can be leveraged to provide User Mode 
                       IP NAT connectivity for simulators.
@@ -945,6 +952,8 @@ t_stat eth_check_address_conflict (ETH_DEV* dev,
   {return SCPE_NOFNC;}
 t_stat eth_set_throttle (ETH_DEV* dev, uint32 time, uint32 burst, uint32 delay)
   {return SCPE_NOFNC;}
+t_stat eth_set_capture (ETH_DEV* dev, const char* spec)
+  {return SCPE_NOFNC;}
 t_stat eth_set_async (ETH_DEV *dev, int latency)
   {return SCPE_NOFNC;}
 t_stat eth_clr_async (ETH_DEV *dev)
@@ -967,6 +976,17 @@ static int _eth_get_system_id (char *buf, size_t buf_size)
   {memset (buf, 0, buf_size); return 0;}
 #else    /* endif unimplemented */
 
+/* AF_PACKET needs TPACKET_V3, so settle whether it is available before
+   eth_capabilities() reports it */
+#ifdef HAVE_AF_PACKET_NETWORK
+#if defined(__linux) || defined(__linux__)
+#include <linux/if_packet.h>
+#endif
+#if !defined(TPACKET3_HDRLEN)   /* Not Linux, or a kernel without TPACKET_V3 */
+#undef HAVE_AF_PACKET_NETWORK
+#endif
+#endif /* HAVE_AF_PACKET_NETWORK */
+
 const char *eth_capabilities(void)
  {
 #if defined (USE_READER_THREAD)
@@ -986,6 +1006,9 @@ const char *eth_capabilities(void)
 #endif
 #if defined (HAVE_SLIRP_NETWORK)
      ":NAT"
+#endif
+#if defined (HAVE_AF_PACKET_NETWORK)
+     ":AF_PACKET"
 #endif
      ":UDP";
  }
@@ -1037,6 +1060,35 @@ extern "C" {
 #endif
 #endif /* HAVE_VDE_NETWORK */
 
+#ifdef HAVE_AF_PACKET_NETWORK
+#if defined(__linux) || defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#endif
+struct eth_afpacket {
+  int           fd;                                     /* AF_PACKET socket */
+  char          ifname[IFNAMSIZ];                       /* interface name */
+  uint8*        map;                                    /* mapped rings (rx then tx) */
+  size_t        map_size;
+  struct tpacket_req3 rx_req;                           /* rx ring geometry */
+  struct tpacket_req3 tx_req;                           /* tx ring geometry (zero if no tx ring) */
+  uint8*        tx_ring;                                /* start of tx ring */
+  uint32        rx_block;                               /* rx block being consumed */
+  uint32        rx_pkt;                                 /* frames already taken from rx_block */
+  struct tpacket3_hdr* rx_next;                         /* next frame in rx_block */
+  uint32        tx_frame;                               /* next tx frame to fill */
+  int           filtered;                               /* kernel filter installed */
+  uint32        blocks;                                 /* rx blocks processed */
+  uint32        drops;                                  /* frames dropped by the kernel */
+  uint32        freezes;                                /* times the rx ring was full */
+  };
+#endif /* HAVE_AF_PACKET_NETWORK */
+
 #ifdef HAVE_SLIRP_NETWORK
 #include "sim_slirp.h"
 #endif /* HAVE_SLIRP_NETWORK */
@@ -1556,6 +1608,21 @@ static void eth_get_nic_hw_addr(ETH_DEV* dev, const char *devname)
 {
   memset(&dev->host_nic_phy_hw_addr, 0, sizeof(dev->host_nic_phy_hw_addr));
   dev->have_host_nic_phy_addr = 0;
+#if defined(HAVE_AF_PACKET_NETWORK)
+  if (dev->eth_api == ETH_API_AFPACKET) {
+    struct eth_afpacket *afp = (struct eth_afpacket *)dev->handle;
+    struct ifreq ifr;
+
+    memset (&ifr, 0, sizeof (ifr));
+    strcpy (ifr.ifr_name, afp->ifname);
+    if ((ioctl (afp->fd, SIOCGIFHWADDR, &ifr) == 0) &&
+        (ifr.ifr_hwaddr.sa_family == ARPHRD_ETHER)) {
+      memcpy (dev->host_nic_phy_hw_addr, ifr.ifr_hwaddr.sa_data, sizeof (ETH_MAC));
+      dev->have_host_nic_phy_addr = 1;
+      }
+    return;
+    }
+#endif
   if (dev->eth_api != ETH_API_PCAP)
     return;
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -1699,9 +1766,451 @@ _eth_callback((u_char *)opaque, &header, buf);
 }
 #endif
 
+#if defined(HAVE_AF_PACKET_NETWORK)
+/*
+   Native Linux AF_PACKET support
+
+   Frames are exchanged with the kernel through memory mapped PACKET_MMAP
+   rings rather than being copied through read()/write() calls.  The
+   receive ring uses TPACKET_V3, in which the kernel fills a whole block
+   with frames before handing it to user space.  Each time the reader
+   thread wakes it consumes every block which is ready and then wakes the
+   simulator once, so bursts of traffic cost a single wakeup.  Frames are
+   sent through a transmit ring when the kernel provides one (Linux 4.11
+   and later for TPACKET_V3) and with send() otherwise.
+
+   Filtering happens in the kernel with a classic BPF program built by
+   _eth_afpacket_setfilter() from the same device filter state which
+   eth_filter_hash() expresses as a libpcap filter string.
+*/
+
+#define ETH_AFP_RX_BLOCK_SIZE   (256*1024)              /* receive block (holds a 64KB jumbo) */
+#define ETH_AFP_RX_BLOCKS       16                      /* receive blocks in ring */
+#define ETH_AFP_RX_TIMEOUT      1                       /* ms before a partly filled block is handed over */
+#define ETH_AFP_TX_BLOCK_SIZE   (64*1024)               /* transmit block */
+#define ETH_AFP_TX_BLOCKS       2                       /* transmit blocks in ring */
+#define ETH_AFP_FRAME_SIZE      2048                    /* frame slot (ETH_MAX_PACKET plus header) */
+#define ETH_AFP_TX_DATA         TPACKET_ALIGN(sizeof(struct tpacket3_hdr))
+#define ETH_AFP_ACCEPT          262144                  /* bytes kept from an accepted frame */
+#define ETH_AFP_MAX_INSNS       256                     /* filter program size limit */
+
+/* Filter program assembly.  Jump targets below ETH_AFP_LABEL are literal
+   offsets, while targets at or above it name one of these labels */
+
+#define ETH_AFP_LABEL           0x100
+#define ETH_AFP_L_SRC           (ETH_AFP_LABEL+0)       /* destination accepted, check source */
+#define ETH_AFP_L_ALT           (ETH_AFP_LABEL+1)       /* try the physical address loopback term */
+#define ETH_AFP_L_NIC           (ETH_AFP_LABEL+2)       /* try the host NIC loopback term */
+#define ETH_AFP_L_REJECT        (ETH_AFP_LABEL+3)
+#define ETH_AFP_L_ACCEPT        (ETH_AFP_LABEL+4)
+#define ETH_AFP_LABELS          5
+#define ETH_AFP_NEXT            (-1)                    /* mismatch falls through to what follows */
+
+struct eth_afp_prog {
+  struct sock_filter insn[ETH_AFP_MAX_INSNS];
+  int           jt[ETH_AFP_MAX_INSNS];
+  int           jf[ETH_AFP_MAX_INSNS];
+  int           label[ETH_AFP_LABELS];
+  int           count;
+  };
+
+static void _eth_afp_emit (struct eth_afp_prog *p, uint16 code, uint32 k, int jt, int jf)
+{
+if (p->count < ETH_AFP_MAX_INSNS) {
+  p->insn[p->count].code = code;
+  p->insn[p->count].k = k;
+  p->jt[p->count] = jt;
+  p->jf[p->count] = jf;
+  }
+++p->count;
+}
+
+static void _eth_afp_label (struct eth_afp_prog *p, int label)
+{
+p->label[label - ETH_AFP_LABEL] = p->count;
+}
+
+/* Compare the 6 bytes at offset with mac, continuing at match or nomatch */
+
+static void _eth_afp_mac (struct eth_afp_prog *p, uint32 offset, const ETH_MAC mac, int match, int nomatch)
+{
+uint32 hi = ((uint32)mac[0] << 24) | ((uint32)mac[1] << 16) | ((uint32)mac[2] << 8) | mac[3];
+uint32 lo = ((uint32)mac[4] << 8) | mac[5];
+
+_eth_afp_emit (p, BPF_LD|BPF_W|BPF_ABS, offset, 0, 0);
+_eth_afp_emit (p, BPF_JMP|BPF_JEQ|BPF_K, hi, 0, (nomatch == ETH_AFP_NEXT) ? 2 : nomatch);
+_eth_afp_emit (p, BPF_LD|BPF_H|BPF_ABS, offset + 4, 0, 0);
+_eth_afp_emit (p, BPF_JMP|BPF_JEQ|BPF_K, lo, match, (nomatch == ETH_AFP_NEXT) ? 0 : nomatch);
+}
+
+/* Resolve label references into relative offsets */
+
+static t_stat _eth_afp_link (struct eth_afp_prog *p)
+{
+int i, off;
+
+if (p->count > ETH_AFP_MAX_INSNS)
+  return SCPE_IERR;
+for (i = 0; i < p->count; i++) {
+  if (p->insn[i].code == (BPF_JMP|BPF_JA)) {
+    p->insn[i].k = p->label[p->jt[i] - ETH_AFP_LABEL] - (i + 1);
+    p->insn[i].jt = p->insn[i].jf = 0;
+    continue;
+    }
+  off = (p->jt[i] >= ETH_AFP_LABEL) ? p->label[p->jt[i] - ETH_AFP_LABEL] - (i + 1) : p->jt[i];
+  if ((off < 0) || (off > 255))
+    return SCPE_IERR;
+  p->insn[i].jt = (uint8)off;
+  off = (p->jf[i] >= ETH_AFP_LABEL) ? p->label[p->jf[i] - ETH_AFP_LABEL] - (i + 1) : p->jf[i];
+  if ((off < 0) || (off > 255))
+    return SCPE_IERR;
+  p->insn[i].jf = (uint8)off;
+  }
+return SCPE_OK;
+}
+
+/* Build and install the kernel filter for the current device filter state.
+   This follows the libpcap filter string built by eth_filter_hash():
+
+     ((dst in filter addresses) or (multicast)) and not (src is ours)
+       or ((dst is physical) and (src is physical))
+       or ((dst is host NIC) and (proto 0x9000))
+ */
+
+static t_stat _eth_afpacket_setfilter (ETH_DEV* dev)
+{
+struct eth_afpacket *afp = (struct eth_afpacket *)dev->handle;
+struct eth_afp_prog *p = (struct eth_afp_prog *)calloc (1, sizeof (*p));
+static const ETH_MAC zeros = {0, 0, 0, 0, 0, 0};
+struct sock_fprog fprog;
+t_stat r;
+int i;
+
+if (!p)
+  return SCPE_MEM;
+if (!dev->promiscuous) {
+  for (i = 0; i < dev->addr_count; i++)
+    _eth_afp_mac (p, 0, dev->filter_address[i], ETH_AFP_L_SRC, ETH_AFP_NEXT);
+  if (dev->all_multicast || dev->hash_filter) {
+    _eth_afp_emit (p, BPF_LD|BPF_B|BPF_ABS, 0, 0, 0);
+    _eth_afp_emit (p, BPF_JMP|BPF_JSET|BPF_K, 0x01, ETH_AFP_L_SRC, ETH_AFP_L_ALT);
+    }
+  else
+    _eth_afp_emit (p, BPF_JMP|BPF_JA, 0, ETH_AFP_L_ALT, 0);
+  }
+_eth_afp_label (p, ETH_AFP_L_SRC);
+if ((dev->addr_count > 0) && (dev->reflections > 0)) {
+  for (i = 0; i < dev->addr_count; i++) {
+    if (dev->filter_address[i][0] & 0x01)
+      continue;                                 /* skip multicast addresses */
+    _eth_afp_mac (p, 6, dev->filter_address[i], ETH_AFP_L_ALT, ETH_AFP_NEXT);
+    }
+  }
+_eth_afp_emit (p, BPF_RET|BPF_K, ETH_AFP_ACCEPT, 0, 0);
+_eth_afp_label (p, ETH_AFP_L_ALT);
+if (memcmp (dev->physical_addr, zeros, sizeof (ETH_MAC))) {
+  _eth_afp_mac (p, 0, dev->physical_addr, 0, ETH_AFP_L_NIC);
+  _eth_afp_mac (p, 6, dev->physical_addr, ETH_AFP_L_ACCEPT, ETH_AFP_L_NIC);
+  _eth_afp_label (p, ETH_AFP_L_NIC);
+  if (dev->have_host_nic_phy_addr) {
+    _eth_afp_mac (p, 0, dev->host_nic_phy_hw_addr, 0, ETH_AFP_L_REJECT);
+    _eth_afp_emit (p, BPF_LD|BPF_H|BPF_ABS, 12, 0, 0);
+    _eth_afp_emit (p, BPF_JMP|BPF_JEQ|BPF_K, 0x9000, ETH_AFP_L_ACCEPT, ETH_AFP_L_REJECT);
+    }
+  }
+else
+  _eth_afp_label (p, ETH_AFP_L_NIC);
+_eth_afp_label (p, ETH_AFP_L_REJECT);
+_eth_afp_emit (p, BPF_RET|BPF_K, 0, 0, 0);
+_eth_afp_label (p, ETH_AFP_L_ACCEPT);
+_eth_afp_emit (p, BPF_RET|BPF_K, ETH_AFP_ACCEPT, 0, 0);
+r = _eth_afp_link (p);
+if (r == SCPE_OK) {
+  fprog.len = (unsigned short)p->count;
+  fprog.filter = p->insn;
+  if (setsockopt (afp->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof (fprog)) < 0) {
+    sim_printf ("Eth: AF_PACKET filter error: %s\r\n", strerror (errno));
+    r = SCPE_IOERR;
+    }
+  }
+else
+  sim_printf ("Eth: AF_PACKET filter too large, filtering in user mode\r\n");
+afp->filtered = (r == SCPE_OK);
+if (!afp->filtered)                             /* pass everything on to _eth_callback */
+  setsockopt (afp->fd, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+free (p);
+return r;
+}
+
+static void _eth_afpacket_close (struct eth_afpacket *afp)
+{
+if (!afp)
+  return;
+if (afp->map)
+  munmap (afp->map, afp->map_size);
+if (afp->fd >= 0)
+  close (afp->fd);
+free (afp);
+}
+
+static t_stat _eth_afpacket_open (const char *devname, void **handle, SOCKET *fd_handle, char errbuf[PCAP_ERRBUF_SIZE])
+{
+struct eth_afpacket *afp = (struct eth_afpacket *)calloc (1, sizeof (*afp));
+struct sock_filter nothing = BPF_STMT(BPF_RET|BPF_K, 0);
+struct sock_fprog fprog;
+struct sockaddr_ll sll;
+struct packet_mreq mr;
+struct ifreq ifr;
+size_t rx_size;
+int version = TPACKET_V3;
+int ifindex = 0;
+
+if (!afp) {
+  strncpy (errbuf, strerror (ENOMEM), PCAP_ERRBUF_SIZE-1);
+  return SCPE_MEM;
+  }
+afp->fd = -1;
+strncpy (afp->ifname, devname, sizeof (afp->ifname) - 1);
+if ((strlen (devname) >= sizeof (afp->ifname)) ||
+    (0 == (ifindex = (int)if_nametoindex (afp->ifname)))) {
+  snprintf (errbuf, PCAP_ERRBUF_SIZE, "No such interface: %s", devname);
+  _eth_afpacket_close (afp);
+  return SCPE_OPENERR;
+  }
+if ((afp->fd = socket (AF_PACKET, SOCK_RAW, htons (ETH_P_ALL))) < 0)
+  goto Error;
+/* Accept nothing until eth_filter describes what is wanted */
+fprog.len = 1;
+fprog.filter = &nothing;
+if (setsockopt (afp->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof (fprog)) < 0)
+  goto Error;
+memset (&ifr, 0, sizeof (ifr));
+strcpy (ifr.ifr_name, afp->ifname);
+if (ioctl (afp->fd, SIOCGIFHWADDR, &ifr) < 0)
+  goto Error;
+if ((ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER) &&
+    (ifr.ifr_hwaddr.sa_family != ARPHRD_LOOPBACK)) {
+  snprintf (errbuf, PCAP_ERRBUF_SIZE, "Not an Ethernet interface: %s", devname);
+  _eth_afpacket_close (afp);
+  return SCPE_OPENERR;
+  }
+if (setsockopt (afp->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof (version)) < 0)
+  goto Error;
+afp->rx_req.tp_block_size = ETH_AFP_RX_BLOCK_SIZE;
+afp->rx_req.tp_block_nr = ETH_AFP_RX_BLOCKS;
+afp->rx_req.tp_frame_size = ETH_AFP_FRAME_SIZE;
+afp->rx_req.tp_frame_nr = (ETH_AFP_RX_BLOCK_SIZE / ETH_AFP_FRAME_SIZE) * ETH_AFP_RX_BLOCKS;
+afp->rx_req.tp_retire_blk_tov = ETH_AFP_RX_TIMEOUT;
+if (setsockopt (afp->fd, SOL_PACKET, PACKET_RX_RING, &afp->rx_req, sizeof (afp->rx_req)) < 0)
+  goto Error;
+afp->tx_req.tp_block_size = ETH_AFP_TX_BLOCK_SIZE;
+afp->tx_req.tp_block_nr = ETH_AFP_TX_BLOCKS;
+afp->tx_req.tp_frame_size = ETH_AFP_FRAME_SIZE;
+afp->tx_req.tp_frame_nr = (ETH_AFP_TX_BLOCK_SIZE / ETH_AFP_FRAME_SIZE) * ETH_AFP_TX_BLOCKS;
+if (setsockopt (afp->fd, SOL_PACKET, PACKET_TX_RING, &afp->tx_req, sizeof (afp->tx_req)) < 0)
+  memset (&afp->tx_req, 0, sizeof (afp->tx_req));   /* older kernel, use send() */
+rx_size = (size_t)afp->rx_req.tp_block_size * afp->rx_req.tp_block_nr;
+afp->map_size = rx_size + (size_t)afp->tx_req.tp_block_size * afp->tx_req.tp_block_nr;
+afp->map = (uint8 *)mmap (NULL, afp->map_size, PROT_READ|PROT_WRITE, MAP_SHARED, afp->fd, 0);
+if (afp->map == (uint8 *)MAP_FAILED) {
+  afp->map = NULL;
+  goto Error;
+  }
+afp->tx_ring = afp->map + rx_size;
+memset (&sll, 0, sizeof (sll));
+sll.sll_family = AF_PACKET;
+sll.sll_protocol = htons (ETH_P_ALL);
+sll.sll_ifindex = ifindex;
+if (bind (afp->fd, (struct sockaddr *)&sll, sizeof (sll)) < 0)
+  goto Error;
+memset (&mr, 0, sizeof (mr));
+mr.mr_ifindex = ifindex;
+mr.mr_type = PACKET_MR_PROMISC;
+if (ETH_PROMISC &&
+    (setsockopt (afp->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof (mr)) < 0))
+  goto Error;
+*handle = (void *)afp;
+*fd_handle = afp->fd;
+return SCPE_OK;
+
+Error:
+strncpy (errbuf, strerror (errno), PCAP_ERRBUF_SIZE-1);
+_eth_afpacket_close (afp);
+return SCPE_OPENERR;
+}
+
+/* Hand up to limit (or, if limit is negative, all) received frames to
+   _eth_callback, returning blocks to the kernel once they are consumed */
+
+static int _eth_afpacket_dispatch (ETH_DEV* dev, int limit)
+{
+struct eth_afpacket *afp = (struct eth_afpacket *)dev->handle;
+struct pcap_pkthdr header;
+int count = 0;
+
+memset (&header, 0, sizeof (header));
+while ((limit < 0) || (count < limit)) {
+  struct tpacket_block_desc *pbd = (struct tpacket_block_desc *)(afp->map + (size_t)afp->rx_block * afp->rx_req.tp_block_size);
+
+  if (0 == (pbd->hdr.bh1.block_status & TP_STATUS_USER))
+    break;
+  __sync_synchronize ();                        /* read block contents after its status */
+  if (afp->rx_pkt == 0)
+    afp->rx_next = (struct tpacket3_hdr *)((uint8 *)pbd + pbd->hdr.bh1.offset_to_first_pkt);
+  if (afp->rx_pkt < pbd->hdr.bh1.num_pkts) {
+    struct tpacket3_hdr *ppd = afp->rx_next;
+    const u_char *data = (const u_char *)ppd + ppd->tp_mac;
+
+    afp->rx_next = (struct tpacket3_hdr *)((uint8 *)ppd + ppd->tp_next_offset);
+    ++afp->rx_pkt;
+    header.caplen = ppd->tp_snaplen;
+    header.len = ppd->tp_len;
+    if ((ppd->tp_status & TP_STATUS_VLAN_VALID) && (header.caplen >= 12)) {
+      u_char buf[ETH_MAX_JUMBO_FRAME + 4];      /* reinsert the tag the NIC removed */
+      uint16 tpid = ETH_P_8021Q;
+
+#if defined(TP_STATUS_VLAN_TPID_VALID)
+      if (ppd->tp_status & TP_STATUS_VLAN_TPID_VALID)
+        tpid = ppd->hv1.tp_vlan_tpid;
+#endif
+      if (header.caplen > ETH_MAX_JUMBO_FRAME)
+        header.caplen = ETH_MAX_JUMBO_FRAME;
+      memcpy (buf, data, 12);
+      buf[12] = (u_char)(tpid >> 8);
+      buf[13] = (u_char)tpid;
+      buf[14] = (u_char)(ppd->hv1.tp_vlan_tci >> 8);
+      buf[15] = (u_char)ppd->hv1.tp_vlan_tci;
+      memcpy (buf + 16, data + 12, header.caplen - 12);
+      header.caplen += 4;
+      header.len += 4;
+      _eth_callback ((u_char *)dev, &header, buf);
+      }
+    else
+      _eth_callback ((u_char *)dev, &header, data);
+    ++count;
+    }
+  if (afp->rx_pkt >= pbd->hdr.bh1.num_pkts) {   /* block consumed, give it back */
+    __sync_synchronize ();
+    pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    afp->rx_block = (afp->rx_block + 1) % afp->rx_req.tp_block_nr;
+    afp->rx_pkt = 0;
+    ++afp->blocks;
+    }
+  }
+if (count == 0) {                               /* woken without data, report any socket error */
+  int err = 0;
+  socklen_t errlen = sizeof (err);
+
+  if ((getsockopt (afp->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == 0) && err) {
+    errno = err;
+    return -1;
+    }
+  }
+return count;
+}
+
+static int _eth_afpacket_send (ETH_DEV* dev, const uint8 *msg, size_t len)
+{
+struct eth_afpacket *afp = (struct eth_afpacket *)dev->handle;
+struct tpacket3_hdr *hdr;
+
+if (0 == afp->tx_req.tp_frame_nr)
+  return (((ssize_t)len == send (afp->fd, msg, len, 0)) ? 0 : -1);
+hdr = (struct tpacket3_hdr *)(afp->tx_ring + (size_t)afp->tx_frame * afp->tx_req.tp_frame_size);
+if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+  errno = EBUSY;
+  return -1;
+  }
+afp->tx_frame = (afp->tx_frame + 1) % afp->tx_req.tp_frame_nr;
+memcpy ((uint8 *)hdr + ETH_AFP_TX_DATA, msg, len);
+hdr->tp_len = hdr->tp_snaplen = (uint32)len;
+hdr->tp_next_offset = 0;
+__sync_synchronize ();                          /* frame contents before its status */
+hdr->tp_status = TP_STATUS_SEND_REQUEST;
+if (send (afp->fd, NULL, 0, 0) < 0)             /* returns once the frame has been sent */
+  return -1;
+if (hdr->tp_status == TP_STATUS_WRONG_FORMAT) {
+  hdr->tp_status = TP_STATUS_AVAILABLE;
+  errno = EINVAL;
+  return -1;
+  }
+return 0;
+}
+
+static void _eth_afpacket_show (ETH_DEV* dev, FILE *st)
+{
+struct eth_afpacket *afp = (struct eth_afpacket *)dev->handle;
+struct tpacket_stats_v3 stats;
+socklen_t len = sizeof (stats);
+
+if (getsockopt (afp->fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+  afp->drops += stats.tp_drops;                 /* counters reset when read */
+  afp->freezes += stats.tp_freeze_q_cnt;
+  }
+fprintf(st, "  AF_PACKET Filter:        %s\n", afp->filtered ? "Kernel" : "User Mode");
+fprintf(st, "  AF_PACKET Rx Blocks:     %d\n", afp->blocks);
+if (afp->drops)
+  fprintf(st, "  AF_PACKET Kernel Drops:  %d\n", afp->drops);
+if (afp->freezes)
+  fprintf(st, "  AF_PACKET Ring Full:     %d\n", afp->freezes);
+fprintf(st, "  AF_PACKET Tx Ring:       %s\n", afp->tx_req.tp_frame_nr ? "Enabled" : "Disabled (send)");
+}
+#endif /* HAVE_AF_PACKET_NETWORK */
+
 #if defined (USE_READER_THREAD)
 #include <pthread.h>
 
+/* Receive the pending UDP datagrams (up to ETH_UDP_BATCH of them) into the
+   reader's packet pool with one system call and hand each to _eth_callback */
+static int
+_eth_udp_dispatch (ETH_DEV *dev, u_char *pool)
+{
+int lens[ETH_UDP_BATCH];
+int i, count;
+
+count = sim_read_sock_datagrams (dev->fd_handle, (char *)pool, ETH_UDP_SLOT, lens, ETH_UDP_BATCH);
+if (count <= 0)
+  return count;
+++dev->udp_rx_calls;
+dev->udp_rx_packets += count;
+for (i = 0; i < count; i++) {
+  struct pcap_pkthdr header;
+
+  if (lens[i] == 0)
+    continue;
+  if (lens[i] > ETH_UDP_SLOT) {                 /* too big for a pool slot */
+    ++dev->jumbo_truncated;
+    continue;
+    }
+  memset(&header, 0, sizeof(header));
+  header.caplen = header.len = lens[i];
+  _eth_callback((u_char *)dev, &header, pool + i * ETH_UDP_SLOT);
+  }
+return count;
+}
+
+/* Send the UDP frames batched by the writer thread (see _eth_write) */
+static void
+_eth_udp_flush (ETH_DEV *dev)
+{
+int sent, done = 0, count = dev->udp_tx_count;
+
+dev->udp_tx_count = 0;
+while (done < count) {
+  sent = sim_write_sock_datagrams (dev->fd_handle, &dev->udp_tx_msg[done], &dev->udp_tx_len[done], count - done);
+  ++dev->udp_tx_calls;
+  if (sent <= 0)
+    break;
+  dev->udp_tx_packets += sent;
+  done += sent;
+  }
+if (done < count) {
+  dev->transmit_packet_errors += count - done;
+  dev->write_status = SCPE_IOERR;
+  _eth_error (dev, "_eth_udp_flush");
+  }
+}
+
 static void *
 _eth_reader(void *arg)
 {
@@ -1710,6 +2219,7 @@ int status = 0;
 int sel_ret = 0;
 int do_select = 0;
 SOCKET select_fd = 0;
+u_char *udp_pool = NULL;
 #if defined (_WIN32)
 HANDLE hWait = (dev->eth_api == ETH_API_PCAP) ? pcap_getevent ((pcap_t*)dev->handle) : NULL;
 #endif
@@ -1723,10 +2233,13 @@ switch (dev->eth_api) {
 #endif
 #endif
     break;
+  case ETH_API_UDP:
+    udp_pool = (u_char *)malloc (ETH_UDP_BATCH * ETH_UDP_SLOT);
+    /* fall through */
   case ETH_API_TAP:
   case ETH_API_VDE:
-  case ETH_API_UDP:
   case ETH_API_NAT:
+  case ETH_API_AFPACKET:
     do_select = 1;
     select_fd = dev->fd_handle;
     break;
@@ -1833,26 +2346,15 @@ while (dev->handle) {
         status = 1;
         break;
 #endif /* HAVE_SLIRP_NETWORK */
+#ifdef HAVE_AF_PACKET_NETWORK
+      case ETH_API_AFPACKET:
+        /* consume every ready block, then wake the simulator once below */
+        status = _eth_afpacket_dispatch (dev, -1);
+        break;
+#endif /* HAVE_AF_PACKET_NETWORK */
       case ETH_API_UDP:
-        if (1) {
-          struct pcap_pkthdr header;
-          int len;
-          u_char buf[ETH_MAX_JUMBO_FRAME];
-
-          memset(&header, 0, sizeof(header));
-          len = (int)sim_read_sock (select_fd, (char *)buf, (int32)sizeof(buf));
-          if (len > 0) {
-            status = 1;
-            header.caplen = header.len = len;
-            _eth_callback((u_char *)dev, &header, buf);
-            }
-          else {
-            if (len < 0)
-              status = -1;
-            else
-              status = 0;
-            }
-          }
+        /* drain a batch of datagrams, then wake the simulator once below */
+        status = udp_pool ? _eth_udp_dispatch (dev, udp_pool) : -1;
         break;
       }
     if ((status > 0) && (dev->asynch_io)) {
@@ -1885,6 +2387,7 @@ while (dev->handle) {
     }
   }
 
+free (udp_pool);
 sim_debug(dev->dbit, dev->dptr, "Reader Thread Exiting\n");
 return NULL;
 }
@@ -1894,6 +2397,7 @@ _eth_writer(void *arg)
 {
 ETH_DEV* volatile dev = (ETH_DEV*)arg;
 ETH_WRITE_REQUEST *request;
+ETH_WRITE_REQUEST *batched = NULL;          /* buffers holding frames in the UDP batch */
 
 /* Boost Priority for this I/O thread vs the CPU instruction execution 
    thread which in general won't be readily yielding the processor when 
@@ -1915,15 +2419,37 @@ while (dev->handle) {
       dev->throttle_events <<= 1;
       dev->throttle_events += (packet_delta_time < dev->throttle_time) ? 1 : 0;
       if ((dev->throttle_events & dev->throttle_mask) == dev->throttle_mask) {
+        _eth_udp_flush (dev);               /* don't hold batched frames across the delay */
         sim_os_ms_sleep (dev->throttle_delay);
         ++dev->throttle_count;
         }
       dev->throttle_packet_time = sim_os_msec();
       }
+    if (dev->udp_tx_count == ETH_UDP_BATCH)
+      _eth_udp_flush (dev);
     dev->write_status = _eth_write(dev, &request->packet, NULL);
 
     pthread_mutex_lock (&dev->writer_lock);
-    /* Put buffer on free buffer list */
+    /* Hold the buffer until any batched frames have been sent */
+    request->next = batched;
+    batched = request;
+    if (dev->udp_tx_count == 0) {
+      /* Put buffers on free buffer list */
+      while (NULL != (request = batched)) {
+        batched = request->next;
+        request->next = dev->write_buffers;
+        dev->write_buffers = request;
+        }
+      }
+    }
+  if (dev->udp_tx_count) {
+    /* Queue drained, send the batch */
+    pthread_mutex_unlock (&dev->writer_lock);
+    _eth_udp_flush (dev);
+    pthread_mutex_lock (&dev->writer_lock);
+    }
+  while (NULL != (request = batched)) {
+    batched = request->next;
     request->next = dev->write_buffers;
     dev->write_buffers = request;
     }
@@ -1981,6 +2507,427 @@ dev->throttle_mask = (1 << dev->throttle_burst) - 1;
 return SCPE_OK;
 }
 
+/* Packet capture
+
+   SET <dev> CAPTURE=file{;MAXSIZE=n{;FILES=n}} copies every frame the
+   simulated device sends, and every frame delivered to it, into a
+   pcapng file.  Each frame is recorded with the host time it was seen
+   (the block timestamp), the simulated time (sim_gtime, as a frame
+   comment) and its direction (the epb_flags option).  With MAXSIZE
+   (in MB) the file is rotated when it would grow past that size: the
+   current file is renamed file.1, file.1 to file.2 and so on, keeping
+   FILES files in all (default 2).
+
+   Frames are recorded by whichever thread sends or receives them.  To
+   keep that cheap, when the reader/writer threads are in use they only
+   copy the frame into a ring of slots; a capture thread formats and
+   writes the ring out to the file.  The ring is the bounded queue with
+   per slot sequence numbers: producers claim a slot by advancing head
+   with a compare and swap, and publish it by setting the slot's
+   sequence; the capture thread is the only consumer.  Frames arriving
+   when the ring is full are counted and dropped rather than stalling
+   the simulator.
+*/
+
+#define ETH_CAPTURE_SLOTS   1024                        /* ring size (power of 2) */
+#define ETH_CAPTURE_POLL    100                         /* ms between idle ring checks */
+#define ETH_CAPTURE_IN      1                           /* epb_flags: inbound */
+#define ETH_CAPTURE_OUT     2                           /* epb_flags: outbound */
+
+typedef struct {
+  volatile uint32 seq;                                  /* slot sequence */
+  uint32        len;                                    /* frame length */
+  uint32        flags;                                  /* direction */
+  t_uint64      host_usec;                              /* host time (usec since epoch) */
+  double        sim_time;                               /* simulated time */
+  uint8         msg[ETH_FRAME_SIZE];                    /* frame */
+  } ETH_CAPTURE_SLOT;
+
+struct eth_capture {
+  char          name[CBUFSIZE];                         /* capture file name */
+  FILE*         file;                                   /* current file, NULL if stopped */
+  t_offset      size;                                   /* bytes written to current file */
+  t_offset      limit;                                  /* rotate size, 0 if unlimited */
+  uint32        files;                                  /* files kept when rotating */
+  uint32        frames;                                 /* frames written */
+  volatile uint32 dropped;                              /* frames lost to a full ring */
+  uint32        rotations;                              /* file rotations */
+  char          ifname[CBUFSIZE];                       /* interface recorded in file */
+#if defined (USE_READER_THREAD)
+  pthread_t     thread;                                 /* capture thread */
+  pthread_mutex_t lock;                                 /* file state lock */
+  pthread_cond_t cond;                                  /* frames queued */
+  int           done;                                   /* thread should exit */
+  volatile uint32 head;                                 /* next slot to claim */
+  uint32        tail;                                   /* next slot to write */
+  ETH_CAPTURE_SLOT ring[ETH_CAPTURE_SLOTS];
+#endif
+  };
+
+#if defined (USE_READER_THREAD)
+#if defined (_WIN32)
+#define _eth_cas32(ptr, newv, oldv) (uint32)InterlockedCompareExchange ((volatile LONG *)(ptr), (LONG)(newv), (LONG)(oldv))
+#define _eth_barrier() MemoryBarrier ()
+#elif defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#define _eth_cas32(ptr, newv, oldv) __sync_val_compare_and_swap ((ptr), (oldv), (newv))
+#define _eth_barrier() __sync_synchronize ()
+#else
+/* No intrinsics: the same algorithm with a lock standing in for them */
+static pthread_mutex_t _eth_cas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32 _eth_cas32 (volatile uint32 *ptr, uint32 newv, uint32 oldv)
+{
+uint32 val;
+
+pthread_mutex_lock (&_eth_cas_lock);
+val = *ptr;
+if (val == oldv)
+  *ptr = newv;
+pthread_mutex_unlock (&_eth_cas_lock);
+return val;
+}
+
+#define _eth_barrier() do {pthread_mutex_lock (&_eth_cas_lock); pthread_mutex_unlock (&_eth_cas_lock);} while (0)
+#endif
+#endif /* defined (USE_READER_THREAD) */
+
+/* Write a pcapng block: type, length, body, padding, length */
+
+static void _eth_capture_block (ETH_CAPTURE *cap, uint32 type, const uint8 *body, uint32 len)
+{
+static const uint8 pad[4] = {0};
+uint32 blen = 12 + ((len + 3) & ~3);
+
+if ((fwrite (&type, sizeof (type), 1, cap->file) != 1) ||
+    (fwrite (&blen, sizeof (blen), 1, cap->file) != 1) ||
+    (fwrite (body, 1, len, cap->file) != len) ||
+    (fwrite (pad, 1, (blen - 12) - len, cap->file) != (blen - 12) - len) ||
+    (fwrite (&blen, sizeof (blen), 1, cap->file) != 1)) {
+  sim_printf ("Eth: capture write error on %s: %s\r\n", cap->name, strerror (errno));
+  fclose (cap->file);
+  cap->file = NULL;
+  return;
+  }
+cap->size += blen;
+}
+
+/* Append a pcapng option to a block body */
+
+static uint32 _eth_capture_option (uint8 *body, uint32 len, uint16 code, const void *val, uint16 vlen)
+{
+memcpy (body + len, &code, sizeof (code));
+memcpy (body + len + 2, &vlen, sizeof (vlen));
+memcpy (body + len + 4, val, vlen);
+memset (body + len + 4 + vlen, 0, ((vlen + 3) & ~3) - vlen);
+return len + 4 + ((vlen + 3) & ~3);
+}
+
+/* Open (truncate) the capture file and write the section header and
+   interface description blocks */
+
+static t_stat _eth_capture_open (ETH_CAPTURE *cap)
+{
+uint8 body[2 * CBUFSIZE + 64];
+uint32 len, val32;
+uint16 val16;
+t_int64 val64;
+char appl[CBUFSIZE];
+
+cap->file = sim_fopen (cap->name, "wb");
+if (cap->file == NULL)
+  return sim_messagef (SCPE_OPENERR, "Eth: can't open capture file %s: %s\n", cap->name, strerror (errno));
+cap->size = 0;
+val32 = 0x1A2B3C4D;                                     /* Section Header: byte order magic */
+memcpy (body, &val32, sizeof (val32));
+val16 = 1;                                              /* version 1.0 */
+memcpy (body + 4, &val16, sizeof (val16));
+val16 = 0;
+memcpy (body + 6, &val16, sizeof (val16));
+val64 = -1;                                             /* section length unknown */
+memcpy (body + 8, &val64, sizeof (val64));
+snprintf (appl, sizeof (appl), "%s simulator", sim_name);
+len = _eth_capture_option (body, 16, 4, appl, (uint16)strlen (appl));/* shb_userappl */
+len = _eth_capture_option (body, len, 0, NULL, 0);      /* opt_endofopt */
+_eth_capture_block (cap, 0x0A0D0D0A, body, len);
+val16 = 1;                                              /* Interface Description: LINKTYPE_ETHERNET */
+memcpy (body, &val16, sizeof (val16));
+val16 = 0;
+memcpy (body + 2, &val16, sizeof (val16));
+val32 = ETH_FRAME_SIZE;                                 /* snaplen */
+memcpy (body + 4, &val32, sizeof (val32));
+len = _eth_capture_option (body, 8, 2, cap->ifname, (uint16)strlen (cap->ifname));/* if_name */
+len = _eth_capture_option (body, len, 0, NULL, 0);
+_eth_capture_block (cap, 0x00000001, body, len);
+return (cap->file == NULL) ? SCPE_IOERR : SCPE_OK;
+}
+
+/* Rotate the capture files: file.n-1 -> file.n, ..., file -> file.1 */
+
+static void _eth_capture_rotate (ETH_CAPTURE *cap)
+{
+char src[CBUFSIZE + 16], dst[CBUFSIZE + 16];
+uint32 i;
+
+fclose (cap->file);
+cap->file = NULL;
+for (i = cap->files - 1; i > 0; i--) {
+  if (i > 1)
+    snprintf (src, sizeof (src), "%s.%u", cap->name, i - 1);
+  else
+    snprintf (src, sizeof (src), "%s", cap->name);
+  snprintf (dst, sizeof (dst), "%s.%u", cap->name, i);
+  remove (dst);
+  rename (src, dst);
+  }
+++cap->rotations;
+_eth_capture_open (cap);
+}
+
+/* Write one frame as an Enhanced Packet Block */
+
+static void _eth_capture_record (ETH_CAPTURE *cap, const ETH_CAPTURE_SLOT *s)
+{
+uint8 body[ETH_FRAME_SIZE + 128];
+uint32 len, val32;
+char comment[64];
+
+if (cap->file == NULL)
+  return;
+if ((cap->limit != 0) && (cap->size + (t_offset)sizeof (body) > cap->limit)) {
+  _eth_capture_rotate (cap);
+  if (cap->file == NULL)
+    return;
+  }
+val32 = 0;                                              /* interface 0 */
+memcpy (body, &val32, sizeof (val32));
+val32 = (uint32)(s->host_usec >> 32);                   /* timestamp (usec) */
+memcpy (body + 4, &val32, sizeof (val32));
+val32 = (uint32)s->host_usec;
+memcpy (body + 8, &val32, sizeof (val32));
+memcpy (body + 12, &s->len, sizeof (s->len));           /* captured length */
+memcpy (body + 16, &s->len, sizeof (s->len));           /* original length */
+memcpy (body + 20, s->msg, s->len);
+len = 20 + ((s->len + 3) & ~3);
+memset (body + 20 + s->len, 0, len - (20 + s->len));
+len = _eth_capture_option (body, len, 2, &s->flags, sizeof (s->flags));/* epb_flags */
+snprintf (comment, sizeof (comment), "sim_time=%.0f", s->sim_time);
+len = _eth_capture_option (body, len, 1, comment, (uint16)strlen (comment));/* opt_comment */
+len = _eth_capture_option (body, len, 0, NULL, 0);
+_eth_capture_block (cap, 0x00000006, body, len);
+++cap->frames;
+}
+
+static void _eth_capture_time (ETH_CAPTURE_SLOT *s)
+{
+struct timespec now;
+
+clock_gettime (CLOCK_REALTIME, &now);
+s->host_usec = ((t_uint64)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+s->sim_time = sim_gtime ();
+}
+
+/* Record a frame; called by whichever thread sent or received it */
+
+static void _eth_capture (ETH_DEV *dev, const uint8 *msg, size_t len, uint32 flags)
+{
+ETH_CAPTURE *cap = dev->capture;
+ETH_CAPTURE_SLOT *s;
+#if defined (USE_READER_THREAD)
+uint32 pos, seq, dropped;
+#else
+ETH_CAPTURE_SLOT slot;
+#endif
+
+if ((cap == NULL) || (cap->file == NULL))               /* not capturing? */
+  return;
+if (len > ETH_FRAME_SIZE)
+  len = ETH_FRAME_SIZE;
+#if defined (USE_READER_THREAD)
+pos = cap->head;
+for (;;) {
+  s = &cap->ring[pos & (ETH_CAPTURE_SLOTS - 1)];
+  seq = s->seq;
+  _eth_barrier ();
+  if (seq == pos) {                                     /* slot free? */
+    if (_eth_cas32 (&cap->head, pos + 1, pos) == pos)   /* claimed it? */
+      break;
+    pos = cap->head;
+    }
+  else {
+    if ((int32)(seq - pos) < 0) {                       /* ring full? */
+      do
+        dropped = cap->dropped;
+      while (_eth_cas32 (&cap->dropped, dropped + 1, dropped) != dropped);
+      return;
+      }
+    pos = cap->head;                                    /* lost a race */
+    }
+  }
+#else
+s = &slot;
+#endif
+s->len = (uint32)len;
+s->flags = flags;
+memcpy (s->msg, msg, len);
+_eth_capture_time (s);
+#if defined (USE_READER_THREAD)
+_eth_barrier ();
+s->seq = pos + 1;                                       /* publish */
+pthread_cond_signal (&cap->cond);
+#else
+_eth_capture_record (cap, s);
+#endif
+}
+
+#if defined (USE_READER_THREAD)
+/* Write all published frames; called with cap->lock held */
+
+static void _eth_capture_drain (ETH_CAPTURE *cap)
+{
+ETH_CAPTURE_SLOT *s;
+int written = 0;
+
+for (;;) {
+  s = &cap->ring[cap->tail & (ETH_CAPTURE_SLOTS - 1)];
+  if (s->seq != cap->tail + 1)                          /* not published? */
+    break;
+  _eth_barrier ();
+  _eth_capture_record (cap, s);
+  _eth_barrier ();
+  s->seq = cap->tail + ETH_CAPTURE_SLOTS;               /* free for next lap */
+  ++cap->tail;
+  ++written;
+  }
+if (written && cap->file)
+  fflush (cap->file);
+}
+
+static void *
+_eth_capturer (void *arg)
+{
+ETH_CAPTURE *cap = (ETH_CAPTURE *)arg;
+struct timespec due;
+
+pthread_mutex_lock (&cap->lock);
+while (!cap->done) {
+  _eth_capture_drain (cap);
+  clock_gettime (CLOCK_REALTIME, &due);
+  due.tv_nsec += ETH_CAPTURE_POLL * 1000000;
+  if (due.tv_nsec >= 1000000000) {
+    due.tv_nsec -= 1000000000;
+    ++due.tv_sec;
+    }
+  pthread_cond_timedwait (&cap->cond, &cap->lock, &due);
+  }
+_eth_capture_drain (cap);
+pthread_mutex_unlock (&cap->lock);
+return NULL;
+}
+#endif
+
+t_stat eth_set_capture (ETH_DEV* dev, const char* spec)
+{
+ETH_CAPTURE *cap;
+char name[CBUFSIZE], tbuf[CBUFSIZE], gbuf[CBUFSIZE];
+const char *tptr;
+const char *cptr;
+uint32 maxsize = 0, files = 2, newval;
+t_stat r = SCPE_OK;
+
+if (spec && *spec) {
+  tptr = get_glyph_nc (spec, name, ';');
+  if (name[0] == '\0')
+    return SCPE_ARG;
+  while (*tptr) {
+    tptr = get_glyph_nc (tptr, tbuf, ';');
+    cptr = get_glyph (tbuf, gbuf, '=');
+    if ((NULL == cptr) || ('\0' == *cptr))
+      return SCPE_ARG;
+    newval = (uint32)get_uint (cptr, 10, 0xFFFFFFFF, &r);
+    if (r != SCPE_OK)
+      return SCPE_ARG;
+    if (!MATCH_CMD (gbuf, "MAXSIZE"))
+      maxsize = newval;
+    else
+      if ((!MATCH_CMD (gbuf, "FILES")) && (newval > 0) && (newval < 1000))
+        files = newval;
+      else
+        return SCPE_ARG;
+    }
+  }
+if (!dev)                                               /* syntax check only? */
+  return SCPE_OK;
+cap = dev->capture;
+if (cap == NULL) {                                      /* first use? */
+  if (!spec || !*spec)
+    return SCPE_OK;
+  cap = (ETH_CAPTURE *)calloc (1, sizeof (*cap));
+  if (cap == NULL)
+    return SCPE_MEM;
+#if defined (USE_READER_THREAD)
+  if (1) {
+    pthread_attr_t attr;
+    uint32 i;
+
+    for (i = 0; i < ETH_CAPTURE_SLOTS; i++)
+      cap->ring[i].seq = i;
+    pthread_mutex_init (&cap->lock, NULL);
+    pthread_cond_init (&cap->cond, NULL);
+    pthread_attr_init (&attr);
+    pthread_attr_setscope (&attr, PTHREAD_SCOPE_SYSTEM);
+    pthread_create (&cap->thread, &attr, _eth_capturer, (void *)cap);
+    pthread_attr_destroy (&attr);
+    }
+#endif
+  dev->capture = cap;
+  }
+#if defined (USE_READER_THREAD)
+pthread_mutex_lock (&cap->lock);
+_eth_capture_drain (cap);                               /* flush to old file */
+#endif
+if (cap->file) {
+  fclose (cap->file);
+  cap->file = NULL;
+  sim_printf ("Eth: capture to %s stopped, %u frames, %u dropped\r\n", cap->name, cap->frames, cap->dropped);
+  }
+if (spec && *spec) {
+  snprintf (cap->name, sizeof (cap->name), "%s", name);
+  snprintf (cap->ifname, sizeof (cap->ifname), "%s", dev->name);
+  cap->limit = (t_offset)maxsize * 1024 * 1024;
+  cap->files = files;
+  cap->frames = cap->dropped = cap->rotations = 0;
+  r = _eth_capture_open (cap);
+  }
+#if defined (USE_READER_THREAD)
+pthread_mutex_unlock (&cap->lock);
+#endif
+return r;
+}
+
+/* Stop capturing and release the capture state; the reader and writer
+   threads are already gone */
+
+static void _eth_capture_close (ETH_DEV* dev)
+{
+ETH_CAPTURE *cap = dev->capture;
+
+if (cap == NULL)
+  return;
+#if defined (USE_READER_THREAD)
+pthread_mutex_lock (&cap->lock);
+cap->done = 1;
+pthread_cond_signal (&cap->cond);
+pthread_mutex_unlock (&cap->lock);
+pthread_join (cap->thread, NULL);
+pthread_mutex_destroy (&cap->lock);
+pthread_cond_destroy (&cap->cond);
+#endif
+if (cap->file)
+  fclose (cap->file);
+free (cap);
+dev->capture = NULL;
+}
+
 static t_stat _eth_open_port(char *savname, int *eth_api, void **handle, SOCKET *fd_handle, char errbuf[PCAP_ERRBUF_SIZE], char *bpf_filter, void *opaque, DEVICE *dptr, uint32 dbit)
 {
 int bufsz = (BUFSIZ < ETH_MAX_PACKET) ? ETH_MAX_PACKET : BUFSIZ;
@@ -2121,6 +3068,26 @@ else { /* !tap: */
 #endif /* defined(HAVE_SLIRP_NETWORK) */
       }
     else { /* not nat: */
+      if (0 == strncmp("afpacket:", savname, 9)) {
+        const char *devname = savname + 9;
+
+        while (isspace(*devname))
+            ++devname;
+#if defined(HAVE_AF_PACKET_NETWORK)
+        if (!strcmp(devname, "ifname")) {
+          sim_printf ("Eth: Must specify actual network interface name (i.e. afpacket:eth0)\r\n");
+          return SCPE_OPENERR | SCPE_NOMESSAGE;
+          }
+        if (SCPE_OK == _eth_afpacket_open (devname, handle, fd_handle, errbuf)) {
+          *eth_api = ETH_API_AFPACKET;
+          if (bpf_filter)           /* ReOpen restores the filter in effect */
+            _eth_afpacket_setfilter ((ETH_DEV *)opaque);
+          }
+#else
+        strncpy(errbuf, "No support for afpacket: network devices", PCAP_ERRBUF_SIZE-1);
+#endif /* defined(HAVE_AF_PACKET_NETWORK) */
+        }
+      else { /* not afpacket: */
       if (0 == strncmp("udp:", savname, 4)) {
         char localport[CBUFSIZE], host[CBUFSIZE], port[CBUFSIZE];
         char hostport[2*CBUFSIZE];
@@ -2147,6 +3114,13 @@ else { /* !tap: */
         *fd_handle = sim_connect_sock_ex (localport, hostport, NULL, NULL, SIM_SOCK_OPT_DATAGRAM);
         if (INVALID_SOCKET == *fd_handle)
             return SCPE_OPENERR;
+        if (1) {
+          /* A peer sending batches delivers bursts of frames, so ask for
+             room for several batches (the host may cap this) */
+          int rcvbuf = 8 * ETH_UDP_BATCH * ETH_UDP_SLOT;
+
+          setsockopt (*fd_handle, SOL_SOCKET, SO_RCVBUF, (char *)&rcvbuf, sizeof(rcvbuf));
+          }
         *eth_api = ETH_API_UDP;
         *handle = (void *)1;  /* Flag used to indicated open */
         }
@@ -2192,6 +3166,7 @@ else { /* !tap: */
         strncpy (errbuf, "Unknown or unsupported network device", PCAP_ERRBUF_SIZE-1);
 #endif /* defined(HAVE_PCAP_NETWORK) */
         } /* not udp:, so attempt to open the parameter as if it were an explicit device name */
+      } /* !afpacket: */
       } /* !nat: */
     } /* !vde: */
   } /* !tap: */
@@ -2305,6 +3280,7 @@ if (1) {
   pthread_attr_t attr;
 
   ethq_init (&dev->read_queue, 200);         /* initialize FIFO queue */
+  dev->udp_tx_count = 0;
   pthread_mutex_init (&dev->lock, NULL);
   pthread_mutex_init (&dev->writer_lock, NULL);
   pthread_mutex_init (&dev->self_lock, NULL);
@@ -2352,6 +3328,11 @@ switch (eth_api) {
   case ETH_API_NAT:
     sim_slirp_close((SLIRP*)pcap);
     break;
+#endif
+#ifdef HAVE_AF_PACKET_NETWORK
+  case ETH_API_AFPACKET:
+    _eth_afpacket_close((struct eth_afpacket *)pcap);
+    break;
 #endif
   case ETH_API_UDP:
     sim_close_sock(pcap_fd);
@@ -2396,6 +3377,7 @@ if (1) {
   }
 ethq_destroy (&dev->read_queue);         /* release FIFO queue */
 #endif
+_eth_capture_close (dev);
 
 _eth_close_port (dev->eth_api, pcap, pcap_fd);
 sim_printf ("Eth: closed %s\r\n", dev->name);
@@ -2424,7 +3406,10 @@ fprintf (st, "    eth2   vde:device                           (Integrated VDE su
 #if defined(HAVE_SLIRP_NETWORK)
 fprintf (st, "    eth3   nat:{optional-nat-parameters}        (Integrated NAT (SLiRP) support)\n");
 #endif
-fprintf (st, "    eth4   udp:sourceport:remotehost:remoteport (Integrated UDP bridge support)\n");
+#if defined(HAVE_AF_PACKET_NETWORK)
+fprintf (st, "    eth4   afpacket:ifname                      (Integrated AF_PACKET support)\n");
+#endif
+fprintf (st, "    eth5   udp:sourceport:remotehost:remoteport (Integrated UDP bridge support)\n");
 fprintf (st, "   sim> ATTACH %s eth0\n\n", dptr->name);
 fprintf (st, "or equivalently:\n\n");
 fprintf (st, "   sim> ATTACH %s en0\n\n", dptr->name);
@@ -2614,6 +3599,9 @@ switch (dev->eth_api) {
   case ETH_API_NAT:
       netname = "nat";
       break;
+  case ETH_API_AFPACKET:
+      netname = "afpacket";
+      break;
   }
 sprintf(msg, "%s(%s): ", where, netname);
 switch (dev->eth_api) {
@@ -2710,6 +3698,8 @@ if ((packet->len >= ETH_MIN_PACKET) && (packet->len <= ETH_MAX_PACKET)) {
 #endif
   }
 
+  _eth_capture (dev, packet->msg, packet->len, ETH_CAPTURE_OUT);
+
     /* dispatch write request (synchronous; no need to save write info to dev) */
   switch (dev->eth_api) {
 #ifdef HAVE_PCAP_NETWORK
@@ -2742,9 +3732,31 @@ if ((packet->len >= ETH_MIN_PACKET) && (packet->len <= ETH_MAX_PACKET)) {
       else
         status = 1;
       break;
+#endif
+#ifdef HAVE_AF_PACKET_NETWORK
+    case ETH_API_AFPACKET:
+      status = _eth_afpacket_send (dev, packet->msg, packet->len);
+      break;
 #endif
     case ETH_API_UDP:
+#if defined (USE_READER_THREAD)
+      if (pthread_equal (pthread_self (), dev->writer_thread)) {
+        /* The writer thread batches frames and flushes them once its queue
+           drains.  Loopback self frames go out directly since a failed send
+           must undo the bookkeeping above. */
+        if ((!loopback_self_frame) && (dev->udp_tx_count < ETH_UDP_BATCH)) {
+          dev->udp_tx_msg[dev->udp_tx_count] = (const char *)packet->msg;
+          dev->udp_tx_len[dev->udp_tx_count++] = (int)packet->len;
+          status = 0;
+          break;
+          }
+        _eth_udp_flush (dev);               /* preserve frame order */
+        }
+#endif
       status = (((int32)packet->len == sim_write_sock (dev->fd_handle, (char *)packet->msg, (int32)packet->len)) ? 0 : -1);
+      ++dev->udp_tx_calls;
+      if (status == 0)
+        ++dev->udp_tx_packets;
       break;
     }
   ++dev->packets_sent;              /* basic bookkeeping */
@@ -3297,6 +4309,7 @@ if (data[offset+2]&1)
   return 1;
 
 eth_packet_trace (dev, data, len, "rcvd");
+_eth_capture (dev, data, len, ETH_CAPTURE_IN);
 
 sim_debug(dev->dbit, dev->dptr, "_eth_process_loopback()\n");
 
@@ -3352,6 +4365,19 @@ switch (dev->eth_api) {
       to_me = _eth_hash_lookup(dev->hash, data);
     break;
 #endif /* USE_BPF */
+#ifdef HAVE_AF_PACKET_NETWORK
+  case ETH_API_AFPACKET:
+    if ((dev->eth_api == ETH_API_AFPACKET) &&
+        ((struct eth_afpacket *)dev->handle)->filtered) {
+      bpf_used = 1;
+      to_me = 1;
+      /* AUTODIN II hash mode? */
+      if ((dev->hash_filter) && (data[0] & 0x01) && (!dev->promiscuous) && (!dev->all_multicast))
+        to_me = _eth_hash_lookup(dev->hash, data);
+      break;
+      }
+    /* Without a kernel filter, filter here */
+#endif /* HAVE_AF_PACKET_NETWORK */
   case ETH_API_TAP:
   case ETH_API_VDE:
   case ETH_API_UDP:
@@ -3440,6 +4466,7 @@ if (bpf_used ? to_me : (to_me && !from_me)) {
       crc_len = eth_get_packet_crc32_data(data, len, crc_data);
 
     eth_packet_trace (dev, data, len, "rcvqd");
+    _eth_capture (dev, data, len, ETH_CAPTURE_IN);
 
     pthread_mutex_lock (&dev->lock);
     ethq_insert_data(&dev->read_queue, ETH_ITM_NORMAL, data, 0, len, crc_len, crc_data, 0);
@@ -3469,6 +4496,7 @@ if (bpf_used ? to_me : (to_me && !from_me)) {
     dev->read_packet->crc_len = 0;
 
   eth_packet_trace (dev, dev->read_packet->msg, dev->read_packet->len, "reading");
+  _eth_capture (dev, dev->read_packet->msg, dev->read_packet->len, ETH_CAPTURE_IN);
 
   ++dev->packets_received;
 
@@ -3552,6 +4580,11 @@ do {
         }
       break;
 #endif /* HAVE_VDE_NETWORK */
+#ifdef HAVE_AF_PACKET_NETWORK
+    case ETH_API_AFPACKET:
+      status = _eth_afpacket_dispatch (dev, 1);
+      break;
+#endif /* HAVE_AF_PACKET_NETWORK */
     case ETH_API_UDP:
       if (1) {
         struct pcap_pkthdr header;
@@ -3561,6 +4594,8 @@ do {
         memset(&header, 0, sizeof(header));
         len = (int)sim_read_sock (dev->fd_handle, (char *)buf, (int32)sizeof(buf));
         if (len > 0) {
+          ++dev->udp_rx_calls;
+          ++dev->udp_rx_packets;
           status = 1;
           header.caplen = header.len = len;
           _eth_callback((u_char *)dev, &header, buf);
@@ -3794,6 +4829,23 @@ if (dev->eth_api == ETH_API_PCAP) {
 #endif
   }
 #endif /* USE_BPF */
+#if defined(HAVE_AF_PACKET_NETWORK)
+if (dev->eth_api == ETH_API_AFPACKET) {
+  /* the kernel program is built from the same state as the string above.
+     The string is saved even when filtering falls back to user mode so
+     that a ReOpen rebuilds the filter rather than keeping the socket's
+     initial "accept nothing" program */
+  _eth_afpacket_setfilter (dev);
+  /* Save BPF filter string */
+  dev->bpf_filter = (char *)realloc(dev->bpf_filter, 1 + strlen(buf));
+  strcpy (dev->bpf_filter, buf);
+#ifdef USE_READER_THREAD
+  pthread_mutex_lock (&dev->lock);
+  ethq_clear (&dev->read_queue); /* Empty FIFO Queue when filter list changes */
+  pthread_mutex_unlock (&dev->lock);
+#endif
+  }
+#endif /* HAVE_AF_PACKET_NETWORK */
 
 return SCPE_OK;
 }
@@ -3908,6 +4960,14 @@ if (used < max) {
   ++used;
   }
 #endif
+#ifdef HAVE_AF_PACKET_NETWORK
+if (used < max) {
+  sprintf(list[used].name, "%s", "afpacket:ifname");
+  sprintf(list[used].desc, "%s", "Integrated AF_PACKET support");
+  list[used].eth_api = ETH_API_AFPACKET;
+  ++used;
+  }
+#endif
 
 if (used < max) {
   sprintf(list[used].name, "%s", "udp:sourceport:remotehost:remoteport");
@@ -4007,11 +5067,27 @@ fprintf(st, "  Read Queue: High:        %d\n", dev->read_queue.high);
 fprintf(st, "  Read Queue: Loss:        %d\n", dev->read_queue.loss);
 fprintf(st, "  Peak Write Queue Size:   %d\n", dev->write_queue_peak);
 #endif
+if (dev->udp_rx_calls)
+  fprintf(st, "  UDP Rx Packets/Call:     %.2f\n", (double)dev->udp_rx_packets / dev->udp_rx_calls);
+if (dev->udp_tx_calls)
+  fprintf(st, "  UDP Tx Packets/Call:     %.2f\n", (double)dev->udp_tx_packets / dev->udp_tx_calls);
 if (dev->bpf_filter)
   fprintf(st, "  BPF Filter: %s\n", dev->bpf_filter);
+if (dev->capture && dev->capture->file) {
+  fprintf(st, "  Capture File:            %s\n", dev->capture->name);
+  fprintf(st, "  Capture Frames:          %d\n", dev->capture->frames);
+  if (dev->capture->dropped)
+    fprintf(st, "  Capture Dropped:         %d\n", dev->capture->dropped);
+  if (dev->capture->rotations)
+    fprintf(st, "  Capture Rotations:       %d\n", dev->capture->rotations);
+  }
 #if defined(HAVE_SLIRP_NETWORK)
 if (dev->eth_api == ETH_API_NAT)
   sim_slirp_show ((SLIRP *)dev->handle, st);
 #endif
+#if defined(HAVE_AF_PACKET_NETWORK)
+if (dev->eth_api == ETH_API_AFPACKET)
+  _eth_afpacket_show (dev, st);
+#endif
 }
 #endif /* USE_NETWORK */
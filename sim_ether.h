@@ -161,6 +161,8 @@ extern "C" {
 #define ETH_CRC_SIZE           4                        /* ethernet CRC size */
 #define ETH_FRAME_SIZE (ETH_MAX_PACKET+ETH_CRC_SIZE)    /* ethernet maximum frame size */
 #define ETH_MIN_JUMBO_FRAME ETH_MAX_PACKET              /* Threshold size for Jumbo Frame Processing */
+#define ETH_UDP_BATCH         32                        /* UDP datagrams moved per system call */
+#define ETH_UDP_SLOT        2048                        /* UDP receive pool slot size */
 
 #define LOOPBACK_SELF_FRAME(phy_mac, msg)                                                     \
     (((msg)[12] == 0x90) && ((msg)[13] == 0x00) &&              /* Ethernet Loopback */       \
@@ -240,6 +242,7 @@ typedef void (*ETH_PCALLBACK)(int status);
 typedef struct eth_list ETH_LIST;
 typedef struct eth_queue ETH_QUE;
 typedef struct eth_item ETH_ITEM;
+typedef struct eth_capture ETH_CAPTURE;
 struct eth_write_request {
   struct eth_write_request *next;
   ETH_PACK packet;
@@ -258,6 +261,7 @@ struct eth_device {
 #define ETH_API_VDE  3                                  /* VDE API in use */
 #define ETH_API_UDP  4                                  /* UDP API in use */
 #define ETH_API_NAT  5                                  /* NAT (SLiRP) API in use */
+#define ETH_API_AFPACKET 6                              /* Linux AF_PACKET API in use */
   ETH_PCALLBACK read_callback;                          /* read callback function */
   ETH_PCALLBACK write_callback;                         /* write callback function */
   ETH_PACK*     read_packet;                            /* read packet */
@@ -281,6 +285,10 @@ struct eth_device {
   uint32        loopback_packets_processed;             /* Total Loopback Packets Processed */
   uint32        transmit_packet_errors;                 /* Total Send Packet Errors */
   uint32        receive_packet_errors;                  /* Total Read Packet Errors */
+  uint32        udp_rx_calls;                           /* UDP receive system calls which returned data */
+  uint32        udp_rx_packets;                         /* UDP datagrams received by those calls */
+  uint32        udp_tx_calls;                           /* UDP send system calls */
+  uint32        udp_tx_packets;                         /* UDP datagrams sent by those calls */
   int32         error_waiting_threads;                  /* Count of threads currently waiting after an error */
   ETH_BOOL      error_needs_reset;                      /* Flag indicating to force reset */
 #define ETH_ERROR_REOPEN_THRESHOLD 10                   /* Attempt ReOpen after 20 send/receive errors */
@@ -303,6 +311,7 @@ struct eth_device {
   uint32        throttle_events;                        /* keeps track of packet arrival values */
   uint32        throttle_packet_time;                   /* time last packet was transmitted */
   uint32        throttle_count;                         /* Total Throttle Delays */
+  ETH_CAPTURE*  capture;                                /* packet capture state (NULL if never enabled) */
 #if defined (USE_READER_THREAD)
   int           asynch_io;                              /* Asynchronous Interrupt scheduling enabled */
   int           asynch_io_latency;                      /* instructions to delay pending interrupt */
@@ -317,6 +326,9 @@ struct eth_device {
   int write_queue_peak;
   ETH_WRITE_REQUEST *write_buffers;
   t_stat write_status;
+  const char*   udp_tx_msg[ETH_UDP_BATCH];              /* UDP frames batched by the writer thread */
+  int           udp_tx_len[ETH_UDP_BATCH];              /* lengths of the batched frames */
+  int           udp_tx_count;                           /* number of batched frames */
 #endif
 };
 
@@ -348,6 +360,7 @@ void eth_setcrc   (ETH_DEV* dev, int need_crc);         /* enable/disable CRC mo
 t_stat eth_set_async (ETH_DEV* dev, int latency);       /* set read behavior to be async */
 t_stat eth_clr_async (ETH_DEV* dev);                    /* set read behavior to be not async */
 t_stat eth_set_throttle (ETH_DEV* dev, uint32 time, uint32 burst, uint32 delay); /* set transmit throttle parameters */
+t_stat eth_set_capture (ETH_DEV* dev, const char* spec);/* capture packets to pcapng file (NULL spec stops, NULL dev checks spec) */
 uint32 eth_crc32(uint32 crc, const void* vbuf, size_t len); /* Compute Ethernet Autodin II CRC for buffer */
 
 void eth_packet_trace (ETH_DEV* dev, const uint8 *msg, int len, const char* txt); /* trace ethernet packet header+crc */
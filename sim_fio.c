@@ -48,10 +48,21 @@
    sim_fsize_name    -       get file size of named file
    sim_fsize_ex      -       get file size as a t_offset
    sim_fsize_name_ex -       get file size as a t_offset of named file
+   sim_set_fsize_ex  -       set file size from a t_offset
+   sim_fallocate     -       grow file, reserving host storage if possible
+   sim_fpunch_hole   -       release the host storage behind a range of a file
+   sim_fallocated    -       test whether a file has host storage for all of its data
+   sim_fsync         -       write a file's buffered data through to the host's storage
+   sim_fpread        -       read at an offset without using the stream position
+   sim_fpwrite       -       write at an offset without using the stream position
+   sim_fopen_direct  -       open a file bypassing the host's file cache
    sim_buf_copy_swapped -    copy data swapping elements along the way
    sim_buf_swap_data -       swap data elements inplace in buffer
    sim_shmem_open            create or attach to a shared memory region
    sim_shmem_close           close a shared memory region
+   sim_fmap_open             map an open file into memory
+   sim_fmap_sync             write a file mapping's changes back to the file
+   sim_fmap_close            unmap a file mapping
 
 
    sim_fopen and sim_fseek are OS-dependent.  The other routines are not.
@@ -99,6 +110,65 @@ sim_taddr_64 = sim_toffset_64 && (sizeof(t_addr) > sizeof(int32));
 return sim_end;
 }
 
+/* Byte swap kernels for the common element sizes.  Each element is loaded
+   whole before it is stored, so they also work in place (dptr == sptr).
+   Compilers turn the shift and mask sequences into the host's byte swap
+   instruction. */
+
+static void sim_swap_16 (unsigned char *dptr, const unsigned char *sptr, size_t count)
+{
+uint16 v;
+
+for ( ; count > 0; count--, sptr += 2, dptr += 2) {
+    memcpy (&v, sptr, sizeof (v));
+    v = (uint16)((v >> 8) | (v << 8));
+    memcpy (dptr, &v, sizeof (v));
+    }
+}
+
+static void sim_swap_32 (unsigned char *dptr, const unsigned char *sptr, size_t count)
+{
+uint32 v;
+
+for ( ; count > 0; count--, sptr += 4, dptr += 4) {
+    memcpy (&v, sptr, sizeof (v));
+    v = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+    memcpy (dptr, &v, sizeof (v));
+    }
+}
+
+static void sim_swap_64 (unsigned char *dptr, const unsigned char *sptr, size_t count)
+{
+uint32 v[2], h;
+
+for ( ; count > 0; count--, sptr += 8, dptr += 8) {
+    memcpy (v, sptr, sizeof (v));
+    h = v[0];
+    v[0] = (v[1] >> 24) | ((v[1] >> 8) & 0xFF00) | ((v[1] << 8) & 0xFF0000) | (v[1] << 24);
+    v[1] = (h >> 24) | ((h >> 8) & 0xFF00) | ((h << 8) & 0xFF0000) | (h << 24);
+    memcpy (dptr, v, sizeof (v));
+    }
+}
+
+/* Swap with the kernel for the element size, FALSE if there is none */
+
+static t_bool sim_swap_sized (unsigned char *dptr, const unsigned char *sptr, size_t size, size_t count)
+{
+switch (size) {
+    case 2:
+        sim_swap_16 (dptr, sptr, count);
+        return TRUE;
+    case 4:
+        sim_swap_32 (dptr, sptr, count);
+        return TRUE;
+    case 8:
+        sim_swap_64 (dptr, sptr, count);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
 void sim_buf_swap_data (void *bptr, size_t size, size_t count)
 {
 uint32 j;
@@ -107,6 +177,8 @@ unsigned char by, *sptr, *dptr;
 
 if (sim_end || (count == 0) || (size == sizeof (char)))
     return;
+if (sim_swap_sized ((unsigned char *) bptr, (const unsigned char *) bptr, size, count))
+    return;
 for (j = 0, dptr = sptr = (unsigned char *) bptr;       /* loop on items */
      j < count; j++) { 
     for (k = (int32)(size - 1); k >= (((int32) size + 1) / 2); k--) {
@@ -142,6 +214,8 @@ if (sim_end || (size == sizeof (char))) {
     memcpy (dptr, sptr, size * count);
     return;
     }
+if (sim_swap_sized (dptr, sptr, size, count))
+    return;
 for (j = 0; j < count; j++) {                           /* loop on items */
     for (k = (int32)(size - 1); k >= 0; k--)
         *(dptr + k) = *sptr++;
@@ -154,16 +228,16 @@ size_t sim_fwrite (const void *bptr, size_t size, size_t count, FILE *fptr)
 size_t c, nelem, nbuf, lcnt, total;
 int32 i;
 const unsigned char *sptr;
-unsigned char *sim_flip;
+t_uint64 flip[FLIP_SIZE / 8 / sizeof (t_uint64)];       /* flip buffer on the stack */
+unsigned char *sim_flip = (unsigned char *)flip;
 
 if ((size == 0) || (count == 0))                        /* check arguments */
     return 0;
 if (sim_end || (size == sizeof (char)))                 /* le or byte? */
     return fwrite (bptr, size, count, fptr);            /* done */
-sim_flip = (unsigned char *)malloc(FLIP_SIZE);
-if (!sim_flip)
+if (size > sizeof (flip))                               /* element too big? */
     return 0;
-nelem = FLIP_SIZE / size;                               /* elements in buffer */
+nelem = sizeof (flip) / size;                           /* elements in buffer */
 nbuf = count / nelem;                                   /* number buffers */
 lcnt = count % nelem;                                   /* count in last buf */
 if (lcnt) nbuf = nbuf + 1;
@@ -173,15 +247,12 @@ sptr = (const unsigned char *) bptr;                    /* init input ptr */
 for (i = (int32)nbuf; i > 0; i--) {                     /* loop on buffers */
     c = (i == 1)? lcnt: nelem;
     sim_buf_copy_swapped (sim_flip, sptr, size, c);
-    sptr = sptr + size * count;
+    sptr = sptr + size * c;
     c = fwrite (sim_flip, size, c, fptr);
-    if (c == 0) {
-        free(sim_flip);
+    if (c == 0)
         return total;
-        }
     total = total + c;
     }
-free(sim_flip);
 return total;
 }
 
@@ -381,6 +452,78 @@ int sim_set_fsize (FILE *fptr, t_addr size)
 return _chsize(_fileno(fptr), (long)size);
 }
 
+int sim_set_fsize_ex (FILE *fptr, t_offset size)
+{
+return _chsize_s(_fileno(fptr), (__int64)size);
+}
+
+int sim_fallocate (FILE *fptr, t_offset size)
+{
+if (size <= sim_fsize_ex (fptr))
+    return 0;
+return sim_set_fsize_ex (fptr, size);
+}
+
+int sim_fpunch_hole (FILE *fptr, t_offset offset, t_offset len)
+{
+return -1;
+}
+
+int sim_fallocated (FILE *fptr)                         /* holes can't be punched here */
+{
+return 1;
+}
+
+int sim_fsync (FILE *fptr)
+{
+if (fflush (fptr))
+    return -1;
+return _commit (_fileno (fptr));
+}
+
+int sim_fpread (FILE *fptr, void *bptr, size_t size, t_offset offset, size_t *done)
+{
+HANDLE h = (HANDLE)_get_osfhandle (_fileno (fptr));
+OVERLAPPED pos;
+DWORD n;
+
+*done = 0;
+while (*done < size) {
+    memset (&pos, 0, sizeof (pos));
+    pos.Offset = (DWORD)(offset + *done);
+    pos.OffsetHigh = (DWORD)((offset + *done) >> 32);
+    if (!ReadFile (h, (char *)bptr + *done, (DWORD)(size - *done), &n, &pos))
+        return (GetLastError () == ERROR_HANDLE_EOF) ? 0 : -1;
+    if (n == 0)                                         /* end of file */
+        break;
+    *done += n;
+    }
+return 0;
+}
+
+int sim_fpwrite (FILE *fptr, const void *bptr, size_t size, t_offset offset, size_t *done)
+{
+HANDLE h = (HANDLE)_get_osfhandle (_fileno (fptr));
+OVERLAPPED pos;
+DWORD n;
+
+*done = 0;
+while (*done < size) {
+    memset (&pos, 0, sizeof (pos));
+    pos.Offset = (DWORD)(offset + *done);
+    pos.OffsetHigh = (DWORD)((offset + *done) >> 32);
+    if (!WriteFile (h, (const char *)bptr + *done, (DWORD)(size - *done), &n, &pos))
+        return -1;
+    *done += n;
+    }
+return 0;
+}
+
+FILE *sim_fopen_direct (const char *file, const char *mode)
+{
+return NULL;
+}
+
 int sim_set_fifo_nonblock (FILE *fptr)
 {
 return -1;
@@ -430,6 +573,63 @@ if (shmem->hMapping != INVALID_HANDLE_VALUE)
 free (shmem);
 }
 
+struct FILEMAP {
+    HANDLE hFile;
+    HANDLE hMapping;
+    size_t map_size;
+    void *map_base;
+    };
+
+t_stat sim_fmap_open (FILE *fptr, t_offset size, t_bool writable, FILEMAP **fmap, void **addr)
+{
+*addr = NULL;
+*fmap = NULL;
+if ((size == 0) || ((t_offset)((size_t)size) != size))
+    return SCPE_NOFNC;
+*fmap = (FILEMAP *)calloc (1, sizeof(**fmap));
+if (*fmap == NULL)
+    return SCPE_MEM;
+fflush (fptr);
+(*fmap)->hFile = (HANDLE)_get_osfhandle (_fileno (fptr));
+(*fmap)->map_size = (size_t)size;
+(*fmap)->hMapping = CreateFileMappingA ((*fmap)->hFile, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                        (DWORD)(size >> 32), (DWORD)size, NULL);
+if ((*fmap)->hMapping == NULL) {
+    free (*fmap);
+    *fmap = NULL;
+    return SCPE_OPENERR;
+    }
+(*fmap)->map_base = MapViewOfFile ((*fmap)->hMapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (size_t)size);
+if ((*fmap)->map_base == NULL) {
+    sim_fmap_close (*fmap);
+    *fmap = NULL;
+    return SCPE_OPENERR;
+    }
+*addr = (*fmap)->map_base;
+return SCPE_OK;
+}
+
+t_stat sim_fmap_sync (FILEMAP *fmap)
+{
+if ((fmap == NULL) || (fmap->map_base == NULL))
+    return SCPE_OK;
+if (!FlushViewOfFile (fmap->map_base, 0))
+    return SCPE_IOERR;
+FlushFileBuffers (fmap->hFile);
+return SCPE_OK;
+}
+
+void sim_fmap_close (FILEMAP *fmap)
+{
+if (fmap == NULL)
+    return;
+if (fmap->map_base != NULL)
+    UnmapViewOfFile (fmap->map_base);
+if (fmap->hMapping != NULL)
+    CloseHandle (fmap->hMapping);
+free (fmap);
+}
+
 #else /* !defined(_WIN32) */
 #include <unistd.h>
 int sim_set_fsize (FILE *fptr, t_addr size)
@@ -437,9 +637,143 @@ int sim_set_fsize (FILE *fptr, t_addr size)
 return ftruncate(fileno(fptr), (off_t)size);
 }
 
+int sim_set_fsize_ex (FILE *fptr, t_offset size)
+{
+return ftruncate(fileno(fptr), (off_t)size);
+}
+
 #include <sys/stat.h>
 #include <fcntl.h>
 
+/* Grow a file to size, reserving the host storage where the platform can.
+   The added space reads as zeros.  Buffered output must already be flushed. */
+
+int sim_fallocate (FILE *fptr, t_offset size)
+{
+t_offset cur = sim_fsize_ex (fptr);
+
+if (size <= cur)
+    return 0;
+#if defined(_POSIX_ADVISORY_INFO) && (_POSIX_ADVISORY_INFO > 0)
+if (0 == posix_fallocate (fileno(fptr), (off_t)cur, (off_t)(size - cur)))
+    return 0;
+#endif
+return ftruncate(fileno(fptr), (off_t)size);
+}
+
+/* Deallocate the host storage behind a range of a file, which then reads
+   as zeros.  The file size is unchanged.  Returns -1 where the platform or
+   file system can't do it.  Buffered output must already be flushed. */
+
+int sim_fpunch_hole (FILE *fptr, t_offset offset, t_offset len)
+{
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+return fallocate (fileno(fptr), FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)len);
+#else
+return -1;
+#endif
+}
+
+/* Test whether a non empty file has host storage behind all of its data,
+   i.e. it has no holes.  Buffered output must already be flushed. */
+
+int sim_fallocated (FILE *fptr)
+{
+struct stat st;
+
+if (fstat (fileno (fptr), &st))
+    return 0;
+return (st.st_size > 0) && (((t_offset)st.st_blocks) * 512 >= (t_offset)st.st_size);
+}
+
+/* Write a stream's buffered output and have the host commit everything
+   written so far to stable storage.  Returns -1 on error. */
+
+int sim_fsync (FILE *fptr)
+{
+if (fflush (fptr))
+    return -1;
+return fsync (fileno (fptr));
+}
+
+/* Positioned transfers go straight to the descriptor.  They don't move or
+   use the stream position, and don't go through the stream's buffer, so
+   the caller must not have buffered output for the range pending.  Short
+   transfers are retried; a short read only stops at the end of file.
+   Returns -1 on error with *done holding what was transferred. */
+
+int sim_fpread (FILE *fptr, void *bptr, size_t size, t_offset offset, size_t *done)
+{
+ssize_t n;
+
+*done = 0;
+while (*done < size) {
+    n = pread (fileno (fptr), (char *)bptr + *done, size - *done, (off_t)(offset + *done));
+    if (n < 0) {
+        if (errno == EINTR)
+            continue;
+        return -1;
+        }
+    if (n == 0)                                         /* end of file */
+        break;
+    *done += (size_t)n;
+    }
+return 0;
+}
+
+int sim_fpwrite (FILE *fptr, const void *bptr, size_t size, t_offset offset, size_t *done)
+{
+ssize_t n;
+
+*done = 0;
+while (*done < size) {
+    n = pwrite (fileno (fptr), (const char *)bptr + *done, size - *done, (off_t)(offset + *done));
+    if (n < 0) {
+        if (errno == EINTR)
+            continue;
+        return -1;
+        }
+    *done += (size_t)n;
+    }
+return 0;
+}
+
+/* Open a file so that transfers bypass the host's file cache.  The stream
+   may only be used with sim_fpread and sim_fpwrite, and transfers must meet
+   the host's alignment rules (buffer, offset and length; 4KB satisfies all
+   current hosts).  Returns NULL where this isn't available. */
+
+FILE *sim_fopen_direct (const char *file, const char *mode)
+{
+#if defined(O_DIRECT) || defined(F_NOCACHE)
+int flags = (strchr (mode, '+') || strchr (mode, 'w')) ? O_RDWR : O_RDONLY;
+int fd;
+FILE *f;
+
+#if defined(O_DIRECT)
+flags |= O_DIRECT;
+#endif
+#if defined(O_LARGEFILE)
+flags |= O_LARGEFILE;
+#endif
+fd = open (file, flags);
+if (fd < 0)
+    return NULL;
+#if !defined(O_DIRECT)
+if (fcntl (fd, F_NOCACHE, 1) < 0) {
+    close (fd);
+    return NULL;
+    }
+#endif
+f = fdopen (fd, mode);
+if (f == NULL)
+    close (fd);
+return f;
+#else
+return NULL;
+#endif
+}
+
 int sim_set_fifo_nonblock (FILE *fptr)
 {
 struct stat stbuf;
@@ -522,4 +856,51 @@ if (shmem->shm_fd != -1)
 free (shmem);
 }
 
+/* Map the first size bytes of an open file.  The file must already be at
+   least that long; the mapping is shared, so stores reach the file (and
+   other openers) without any further I/O and sim_fmap_sync only needs to
+   force them to stable storage. */
+
+struct FILEMAP {
+    size_t map_size;
+    void *map_base;
+    };
+
+t_stat sim_fmap_open (FILE *fptr, t_offset size, t_bool writable, FILEMAP **fmap, void **addr)
+{
+*addr = NULL;
+*fmap = NULL;
+if ((size == 0) || ((t_offset)((size_t)size) != size))
+    return SCPE_NOFNC;
+*fmap = (FILEMAP *)calloc (1, sizeof(**fmap));
+if (*fmap == NULL)
+    return SCPE_MEM;
+fflush (fptr);
+(*fmap)->map_size = (size_t)size;
+(*fmap)->map_base = mmap (NULL, (*fmap)->map_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                         MAP_SHARED, fileno (fptr), 0);
+if ((*fmap)->map_base == MAP_FAILED) {
+    free (*fmap);
+    *fmap = NULL;
+    return SCPE_OPENERR;
+    }
+*addr = (*fmap)->map_base;
+return SCPE_OK;
+}
+
+t_stat sim_fmap_sync (FILEMAP *fmap)
+{
+if (fmap == NULL)
+    return SCPE_OK;
+return msync (fmap->map_base, fmap->map_size, MS_SYNC) ? SCPE_IOERR : SCPE_OK;
+}
+
+void sim_fmap_close (FILEMAP *fmap)
+{
+if (fmap == NULL)
+    return;
+munmap (fmap->map_base, fmap->map_size);
+free (fmap);
+}
+
 #endif
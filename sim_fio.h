@@ -58,6 +58,14 @@ FILE *sim_fopen (const char *file, const char *mode);
 int sim_fseek (FILE *st, t_addr offset, int whence);
 int sim_fseeko (FILE *st, t_offset offset, int whence);
 int sim_set_fsize (FILE *fptr, t_addr size);
+int sim_set_fsize_ex (FILE *fptr, t_offset size);
+int sim_fallocate (FILE *fptr, t_offset size);
+int sim_fpunch_hole (FILE *fptr, t_offset offset, t_offset len);
+int sim_fallocated (FILE *fptr);
+int sim_fsync (FILE *fptr);
+int sim_fpread (FILE *fptr, void *bptr, size_t size, t_offset offset, size_t *done);
+int sim_fpwrite (FILE *fptr, const void *bptr, size_t size, t_offset offset, size_t *done);
+FILE *sim_fopen_direct (const char *file, const char *mode);
 int sim_set_fifo_nonblock (FILE *fptr);
 size_t sim_fread (void *bptr, size_t size, size_t count, FILE *fptr);
 size_t sim_fwrite (const void *bptr, size_t size, size_t count, FILE *fptr);
@@ -71,6 +79,10 @@ void sim_buf_copy_swapped (void *dptr, const void *bptr, size_t size, size_t cou
 typedef struct SHMEM SHMEM;
 t_stat sim_shmem_open (const char *name, size_t size, SHMEM **shmem, void **addr);
 void sim_shmem_close (SHMEM *shmem);
+typedef struct FILEMAP FILEMAP;
+t_stat sim_fmap_open (FILE *fptr, t_offset size, t_bool writable, FILEMAP **fmap, void **addr);
+t_stat sim_fmap_sync (FILEMAP *fmap);
+void sim_fmap_close (FILEMAP *fmap);
 
 extern t_bool sim_taddr_64;         /* t_addr is > 32b and Large File Support available */
 extern t_bool sim_toffset_64;       /* Large File (>2GB) file I/O support */
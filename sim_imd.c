@@ -51,6 +51,16 @@
 #include "sim_defs.h"
 #include "sim_imd.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#endif
+
 #if (defined (__MWERKS__) && defined (macintosh)) || defined(__DECC)
 #define __FUNCTION__ __FILE__
 #endif
@@ -58,6 +68,13 @@
 static t_stat commentParse(DISK_INFO *myDisk, uint8 comment[], uint32 buffLen);
 static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose);
 static t_stat diskFormat(DISK_INFO *myDisk);
+static void diskFreeTracks(DISK_INFO *myDisk);
+static void diskRelease(DISK_INFO *myDisk);
+static void diskIoFlush(UNIT *uptr);
+
+static DISK_INFO *openDisks = NULL;     /* Images with an io_flush hook installed */
+
+#define SECT_RECORD_NONE    0xFF    /* Sector not present on the track */
 
 /* Open an existing IMD disk image.  It will be opened and parsed, and after this
  * call, will be ready for sector read/write. The result is the corresponding
@@ -67,15 +84,40 @@ DISK_INFO *diskOpenEx(FILE *fileref, uint32 isVerbose, DEVICE *device, uint32 de
 {
     DISK_INFO *myDisk = NULL;
 
-    myDisk = (DISK_INFO *)malloc(sizeof(DISK_INFO));
+    myDisk = (DISK_INFO *)calloc(1, sizeof(DISK_INFO));
+    if (myDisk == NULL)
+        return NULL;
     myDisk->file = fileref;
     myDisk->device = device;
     myDisk->debugmask = debugmask;
     myDisk->verbosedebugmask = verbosedebugmask;
 
     if (diskParse(myDisk, isVerbose) != SCPE_OK) {
-        free(myDisk);
-        myDisk = NULL;
+        diskRelease(myDisk);
+        return NULL;
+    }
+
+    /* Find the unit the file is attached to, so the image can be replaced atomically
+     * by diskFlush() and written back whenever the simulator stops.
+     */
+    if (fileref != NULL) {
+        DEVICE *dptr;
+        uint32 i, j;
+
+        for (i = 0; (dptr = sim_devices[i]) != NULL && myDisk->uptr == NULL; i++) {
+            for (j = 0; j < dptr->numunits; j++) {
+                if ((dptr->units[j].flags & UNIT_ATT) && (dptr->units[j].fileref == fileref)) {
+                    myDisk->uptr = &dptr->units[j];
+                    break;
+                }
+            }
+        }
+    }
+    if ((myDisk->uptr != NULL) &&
+        ((myDisk->uptr->io_flush == NULL) || (myDisk->uptr->io_flush == &diskIoFlush))) {
+        myDisk->uptr->io_flush = &diskIoFlush;
+        myDisk->next = openDisks;
+        openDisks = myDisk;
     }
 
     return myDisk;
@@ -117,11 +159,79 @@ static t_stat commentParse(DISK_INFO *myDisk, uint8 comment[], uint32 buffLen)
 }
 
 static uint32 headerOk(IMD_HEADER imd) {
-    return (imd.cyl < MAX_CYL) && (imd.head < MAX_HEAD);
+    return (imd.cyl < MAX_CYL) && (imd.head < MAX_HEAD) && (imd.nsects <= MAX_SPT);
+}
+
+/* Free the sector data of all tracks, leaving the disk without any tracks. */
+static void diskFreeTracks(DISK_INFO *myDisk)
+{
+    uint32 i, j;
+
+    for(i=0;i<MAX_CYL;i++) {
+        for(j=0;j<MAX_HEAD;j++) {
+            free(myDisk->track[i][j].sectorData);
+        }
+    }
+    memset(myDisk->track, 0, (sizeof(TRACK_INFO)*MAX_CYL*MAX_HEAD));
+    myDisk->ntrackOrder = 0;
+}
+
+/* Set up an empty track, allocating its sector data.  Sectors are indexed relative to the
+ * lowest sector number in sectorMap, like sectorOffsetMap.  Sectors of the track are marked
+ * SECT_RECORD_NORM, other entries are marked as not present.
+ */
+static t_stat trackAlloc(DISK_INFO *myDisk, uint32 Cyl, uint32 Head, uint8 nsects, uint32 sectorSize, uint8 sectorMap[])
+{
+    TRACK_INFO *trk = &myDisk->track[Cyl][Head];
+    uint32 i, nslots = 0;
+
+    free(trk->sectorData);
+    trk->sectorData = NULL;
+    trk->nsects = nsects;
+    trk->sectsize = sectorSize;
+    trk->start_sector = nsects;
+    for(i=0;i<nsects;i++) {
+        if(sectorMap[i] < trk->start_sector) {
+            trk->start_sector = sectorMap[i];
+        }
+    }
+    for(i=0;i<nsects;i++) {
+        if (sectorMap[i]-trk->start_sector >= MAX_SPT) {
+            sim_printf("SIM_IMD: ERROR: Illegal sector offset %d\n", sectorMap[i]-trk->start_sector);
+            return (SCPE_OPENERR);
+        }
+        if (sectorMap[i]-trk->start_sector >= nslots)
+            nslots = sectorMap[i]-trk->start_sector + 1;
+    }
+    memcpy(trk->sectorMap, sectorMap, nsects);
+    memset(trk->sectorType, SECT_RECORD_NONE, sizeof(trk->sectorType));
+    memset(trk->sectorOffsetMap, 0, sizeof(trk->sectorOffsetMap));
+    for(i=0;i<nsects;i++) {
+        trk->sectorType[sectorMap[i]-trk->start_sector] = SECT_RECORD_NORM;
+    }
+    if (nslots > 0) {
+        trk->sectorData = (uint8 *)calloc(nslots, sectorSize);
+        if (trk->sectorData == NULL) {
+            sim_printf("SIM_IMD: Memory allocation failure.\n");
+            return (SCPE_MEM);
+        }
+    }
+
+    /* Keep the tracks in the order they appear in the file. */
+    for(i=0;i<myDisk->ntrackOrder;i++) {
+        if (myDisk->trackOrder[i] == Cyl * MAX_HEAD + Head)
+            break;
+    }
+    if (i == myDisk->ntrackOrder) {
+        myDisk->trackOrder[myDisk->ntrackOrder++] = Cyl * MAX_HEAD + Head;
+    }
+
+    return SCPE_OK;
 }
 
-/* Parse an IMD image.  This sets up sim_imd to be able to do sector read/write and
- * track write.
+/* Parse an IMD image.  The track layout and all sector data are loaded into memory, from
+ * where sector reads are served.  Sector and track writes change the loaded image, which
+ * is written back to the file by diskFlush().
  */
 static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
 {
@@ -132,6 +242,9 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
     uint32 sectorSize, sectorHeadwithFlags, sectRecordType;
     uint32 i;
     uint8 start_sect;
+    uint8 *sectorData;
+    TRACK_INFO *trk;
+    t_stat r;
 
     uint32 TotalSectorCount = 0;
     IMD_HEADER imd;
@@ -140,7 +253,11 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
         return (SCPE_OPENERR);
     }
 
-    memset(myDisk->track, 0, (sizeof(TRACK_INFO)*MAX_CYL*MAX_HEAD));
+    diskFreeTracks(myDisk);
+    free(myDisk->comment);
+    myDisk->comment = NULL;
+    myDisk->commentLen = 0;
+    myDisk->dirty = 0;
 
     if (commentParse(myDisk, comment, sizeof(comment)) != SCPE_OK) {
         return (SCPE_OPENERR);
@@ -158,6 +275,16 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
         return (SCPE_OPENERR);
     }
 
+    /* Keep the comment, including the EOF marker, for writing the image back. */
+    myDisk->commentLen = ftell(myDisk->file);
+    myDisk->comment = (uint8 *)malloc(myDisk->commentLen);
+    rewind(myDisk->file);
+    if ((myDisk->comment == NULL) ||
+        (sim_fread(myDisk->comment, 1, myDisk->commentLen, myDisk->file) != myDisk->commentLen)) {
+        sim_printf("SIM_IMD: Corrupt file [Comment].\n");
+        return (SCPE_OPENERR);
+    }
+
     do {
         sim_debug(myDisk->debugmask, myDisk->device, "start of track %d at file offset %ld\n", myDisk->ntracks, ftell(myDisk->file));
 
@@ -180,23 +307,22 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
             myDisk->nsides = imd.head + 1;
         }
 
-        myDisk->track[imd.cyl][imd.head].mode = imd.mode;
-        myDisk->track[imd.cyl][imd.head].nsects = imd.nsects;
-        myDisk->track[imd.cyl][imd.head].sectsize = sectorSize;
+        trk = &myDisk->track[imd.cyl][imd.head];
+        trk->mode = imd.mode;
+        trk->mapFlags = sectorHeadwithFlags & (IMD_FLAG_SECT_HEAD_MAP | IMD_FLAG_SECT_CYL_MAP);
 
         if (sim_fread(sectorMap, 1, imd.nsects, myDisk->file) != imd.nsects) {
             sim_printf("SIM_IMD: Corrupt file [Sector Map].\n");
             return (SCPE_OPENERR);
         }
-        myDisk->track[imd.cyl][imd.head].start_sector = imd.nsects;
+        r = trackAlloc(myDisk, imd.cyl, imd.head, imd.nsects, sectorSize, sectorMap);
+        if (r != SCPE_OK)
+            return (r == SCPE_MEM) ? SCPE_MEM : SCPE_OPENERR;
         sim_debug(myDisk->debugmask, myDisk->device, "\tSector Map: ");
         for(i=0;i<imd.nsects;i++) {
             sim_debug(myDisk->debugmask, myDisk->device, "%d ", sectorMap[i]);
-            if(sectorMap[i] < myDisk->track[imd.cyl][imd.head].start_sector) {
-                myDisk->track[imd.cyl][imd.head].start_sector = sectorMap[i];
-            }
         }
-        sim_debug(myDisk->debugmask, myDisk->device, ", Start Sector=%d", myDisk->track[imd.cyl][imd.head].start_sector);
+        sim_debug(myDisk->debugmask, myDisk->device, ", Start Sector=%d", trk->start_sector);
 
         if(sectorHeadwithFlags & IMD_FLAG_SECT_HEAD_MAP) {
             if (sim_fread(sectorHeadMap, 1, imd.nsects, myDisk->file) != imd.nsects) {
@@ -235,7 +361,7 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
         sim_debug(myDisk->debugmask, myDisk->device, "\nSector data at offset 0x%08lx\n", ftell(myDisk->file));
 
         /* Build the table with location 0 being the start sector. */
-        start_sect = myDisk->track[imd.cyl][imd.head].start_sector;
+        start_sect = trk->start_sector;
 
         /* Now read each sector */
         for(i=0;i<imd.nsects;i++) {
@@ -243,55 +369,40 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
             sim_debug(myDisk->debugmask, myDisk->device, "Sector Phys: %d/Logical: %d: %d bytes: ", i, sectorMap[i], sectorSize);
             sectRecordType = fgetc(myDisk->file);
             /* AGN Logical head mapping */
-            myDisk->track[imd.cyl][imd.head].logicalHead[i] = sectorHeadMap[i];
+            trk->logicalHead[i] = sectorHeadMap[i];
             /* AGN Logical cylinder mapping */
-            myDisk->track[imd.cyl][imd.head].logicalCyl[i] = sectorCylMap[i];
+            trk->logicalCyl[i] = sectorCylMap[i];
+            sectorData = trk->sectorData + (sectorMap[i]-start_sect) * sectorSize;
             switch(sectRecordType) {
                 case SECT_RECORD_UNAVAILABLE:   /* Data could not be read from the original media */
-                    if (sectorMap[i]-start_sect < MAX_SPT)
-                        myDisk->track[imd.cyl][imd.head].sectorOffsetMap[sectorMap[i]-start_sect] = 0xBADBAD;
-                    else {
-                        sim_printf("SIM_IMD: ERROR: Illegal sector offset %d\n", sectorMap[i]-start_sect);
-                        return (SCPE_OPENERR);
-                    }
+                    trk->sectorOffsetMap[sectorMap[i]-start_sect] = 0xBADBAD;
                     break;
                 case SECT_RECORD_NORM:          /* Normal Data */
                 case SECT_RECORD_NORM_DAM:      /* Normal Data with deleted address mark */
                 case SECT_RECORD_NORM_ERR:      /* Normal Data with read error */
                 case SECT_RECORD_NORM_DAM_ERR:  /* Normal Data with deleted address mark with read error */
 /*                  sim_debug(myDisk->debugmask, myDisk->device, "Uncompressed Data\n"); */
-                    if (sectorMap[i]-start_sect < MAX_SPT) {
-                        myDisk->track[imd.cyl][imd.head].sectorOffsetMap[sectorMap[i]-start_sect] = ftell(myDisk->file);
-                        sim_fseek(myDisk->file, sectorSize, SEEK_CUR);
-                    }
-                    else {
-                        sim_printf("SIM_IMD: ERROR: Illegal sector offset %d\n", sectorMap[i]-start_sect);
-                        return (SCPE_OPENERR);
-                    }
+                    trk->sectorOffsetMap[sectorMap[i]-start_sect] = ftell(myDisk->file);
+                    sim_fread(sectorData, 1, sectorSize, myDisk->file);
                     break;
                 case SECT_RECORD_NORM_COMP:     /* Compressed Normal Data */
                 case SECT_RECORD_NORM_DAM_COMP: /* Compressed Normal Data with deleted address mark */
                 case SECT_RECORD_NORM_COMP_ERR: /* Compressed Normal Data */
                 case SECT_RECORD_NORM_DAM_COMP_ERR: /* Compressed Normal Data with deleted address mark */
-                    if (sectorMap[i]-start_sect < MAX_SPT) {
-                        myDisk->track[imd.cyl][imd.head].sectorOffsetMap[sectorMap[i]-start_sect] = ftell(myDisk->file);
-                        myDisk->flags |= FD_FLAG_WRITELOCK; /* Write-protect the disk if any sectors are compressed. */
-                        if (1) {
-                            uint8 cdata = fgetc(myDisk->file);
-
-                            sim_debug(myDisk->debugmask, myDisk->device, "Compressed Data = 0x%02x\n", cdata);
-                            }
-                    }
-                    else {
-                        sim_printf("SIM_IMD: ERROR: Illegal sector offset %d\n", sectorMap[i]-start_sect);
-                        return (SCPE_OPENERR);
-                    }
+                    trk->sectorOffsetMap[sectorMap[i]-start_sect] = ftell(myDisk->file);
+                    if (1) {
+                        uint8 cdata = fgetc(myDisk->file);
+
+                        sim_debug(myDisk->debugmask, myDisk->device, "Compressed Data = 0x%02x\n", cdata);
+                        memset(sectorData, cdata, sectorSize);
+                        }
                     break;
                 default:
                     sim_printf("SIM_IMD: ERROR: unrecognized sector record type %d\n", sectRecordType);
                     return (SCPE_OPENERR);
                     break;
             }
+            trk->sectorType[sectorMap[i]-start_sect] = sectRecordType;
             sim_debug(myDisk->debugmask, myDisk->device, "\n");
         }
 
@@ -308,24 +419,252 @@ static t_stat diskParse(DISK_INFO *myDisk, uint32 isVerbose)
         }
         sim_debug(myDisk->verbosedebugmask, myDisk->device, "\n");
     }
-    if(myDisk->flags & FD_FLAG_WRITELOCK) {
-        sim_printf("Disk write-protected because the image contains compressed sectors. Use IMDU to uncompress.\n");
-    }
 
     return SCPE_OK;
 }
 
+/* Replace the attached file with a new image.  The image is written to "<file>.tmp",
+ * synced to the disk and renamed over the original, so a crash leaves either the old
+ * or the new image, never a partly written one.  The file is then reopened and the
+ * unit's fileref updated to match.
+ *
+ * A symbolic link is followed, so the link itself is kept, and the new file gets the
+ * old file's permissions.  A file with other hard links can't be replaced without
+ * breaking them; SCPE_NOFNC is returned for it and the caller rewrites it in place.
+ */
+static t_stat diskReplace(DISK_INFO *myDisk, const uint8 *image, uint32 len)
+{
+    UNIT *uptr = myDisk->uptr;
+    const char *mode = (uptr->flags & UNIT_RO) ? "rb" : "rb+";
+    char *path, *tmpname;
+    FILE *tmp, *newfile;
+    int ok;
+#if !defined(_WIN32)
+    struct stat st;
+
+    if((fstat(fileno(myDisk->file), &st) != 0) || (st.st_nlink > 1))
+        return (SCPE_NOFNC);
+    if((path = realpath(uptr->filename, NULL)) == NULL)
+        return (SCPE_NOFNC);
+#else
+    if((path = (char *)malloc(strlen(uptr->filename) + 1)) == NULL)
+        return (SCPE_MEM);
+    strcpy(path, uptr->filename);
+#endif
+
+    if((tmpname = (char *)malloc(strlen(path) + 5)) == NULL) {
+        free(path);
+        return (SCPE_MEM);
+    }
+    sprintf(tmpname, "%s.tmp", path);
+    if((tmp = sim_fopen(tmpname, "wb")) == NULL) {
+        sim_printf("SIM_IMD: Cannot create %s.\n", tmpname);
+        free(tmpname);
+        free(path);
+        return (SCPE_OPENERR);
+    }
+    ok = (sim_fwrite((void *)image, 1, len, tmp) == len) && (fflush(tmp) == 0);
+#if defined(_WIN32)
+    ok = ok && (_commit(_fileno(tmp)) == 0);
+#else
+    ok = ok && (fchmod(fileno(tmp), st.st_mode & 07777) == 0);
+    ok = ok && (fsync(fileno(tmp)) == 0);
+#endif
+    ok = (fclose(tmp) == 0) && ok;
+    if(ok) {
+#if defined(_WIN32)
+        fclose(myDisk->file);               /* an open file can't be replaced */
+        myDisk->file = uptr->fileref = NULL;
+        ok = MoveFileExA(tmpname, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        ok = (rename(tmpname, path) == 0);
+#endif
+    }
+    if(!ok)
+        remove(tmpname);
+    free(tmpname);
+    if(myDisk->file == NULL || ok) {
+        if((newfile = sim_fopen(path, mode)) == NULL) {
+            sim_printf("SIM_IMD: Cannot reopen %s.\n", path);
+            free(path);
+            return (SCPE_OPENERR);
+        }
+        if(myDisk->file != NULL)
+            fclose(myDisk->file);
+        myDisk->file = uptr->fileref = newfile;
+    }
+    free(path);
+    return ok ? SCPE_OK : SCPE_IOERR;
+}
+
+/* Write the image back to the IMD file, if it was changed.  The whole file is assembled
+ * in memory first and then written with a single write, so a failure while assembling it
+ * leaves the file untouched.  Compressed sectors that were not written stay compressed.
+ */
+t_stat diskFlush(DISK_INFO *myDisk)
+{
+    uint8 *image, *p;
+    uint32 len, i, j, slot, sectsize;
+    uint8 code, sectRecordType;
+    TRACK_INFO *trk;
+    t_stat r = SCPE_OK;
+
+    if(myDisk == NULL)
+        return SCPE_IOERR;
+
+    if(!myDisk->dirty)
+        return SCPE_OK;
+
+    len = myDisk->commentLen;
+    for(i=0;i<myDisk->ntrackOrder;i++) {
+        trk = &myDisk->track[myDisk->trackOrder[i] / MAX_HEAD][myDisk->trackOrder[i] % MAX_HEAD];
+        len += sizeof(IMD_HEADER) + trk->nsects;
+        if(trk->mapFlags & IMD_FLAG_SECT_HEAD_MAP)
+            len += trk->nsects;
+        if(trk->mapFlags & IMD_FLAG_SECT_CYL_MAP)
+            len += trk->nsects;
+        for(j=0;j<trk->nsects;j++) {
+            switch(trk->sectorType[trk->sectorMap[j]-trk->start_sector]) {
+                case SECT_RECORD_UNAVAILABLE:
+                    len += 1;
+                    break;
+                case SECT_RECORD_NORM_COMP:
+                case SECT_RECORD_NORM_DAM_COMP:
+                case SECT_RECORD_NORM_COMP_ERR:
+                case SECT_RECORD_NORM_DAM_COMP_ERR:
+                    len += 2;
+                    break;
+                default:
+                    len += 1 + trk->sectsize;
+                    break;
+            }
+        }
+    }
+
+    if((p = image = (uint8 *)malloc(len)) == NULL) {
+        sim_printf("SIM_IMD: Memory allocation failure.\n");
+        return (SCPE_MEM);
+    }
+
+    memcpy(p, myDisk->comment, myDisk->commentLen);
+    p += myDisk->commentLen;
+    for(i=0;i<myDisk->ntrackOrder;i++) {
+        trk = &myDisk->track[myDisk->trackOrder[i] / MAX_HEAD][myDisk->trackOrder[i] % MAX_HEAD];
+        sectsize = trk->sectsize;
+        for(code=0;(128U << code) < sectsize;code++);
+        *p++ = trk->mode;
+        *p++ = myDisk->trackOrder[i] / MAX_HEAD;
+        *p++ = (myDisk->trackOrder[i] % MAX_HEAD) | trk->mapFlags;
+        *p++ = trk->nsects;
+        *p++ = code;
+        memcpy(p, trk->sectorMap, trk->nsects);
+        p += trk->nsects;
+        if(trk->mapFlags & IMD_FLAG_SECT_HEAD_MAP) {
+            memcpy(p, trk->logicalHead, trk->nsects);
+            p += trk->nsects;
+        }
+        if(trk->mapFlags & IMD_FLAG_SECT_CYL_MAP) {
+            memcpy(p, trk->logicalCyl, trk->nsects);
+            p += trk->nsects;
+        }
+        for(j=0;j<trk->nsects;j++) {
+            slot = trk->sectorMap[j]-trk->start_sector;
+            sectRecordType = trk->sectorType[slot];
+            *p++ = sectRecordType;
+            switch(sectRecordType) {
+                case SECT_RECORD_UNAVAILABLE:
+                    trk->sectorOffsetMap[slot] = 0xBADBAD;
+                    break;
+                case SECT_RECORD_NORM_COMP:
+                case SECT_RECORD_NORM_DAM_COMP:
+                case SECT_RECORD_NORM_COMP_ERR:
+                case SECT_RECORD_NORM_DAM_COMP_ERR:
+                    trk->sectorOffsetMap[slot] = (uint32)(p - image);
+                    *p++ = trk->sectorData[slot * sectsize];
+                    break;
+                default:
+                    trk->sectorOffsetMap[slot] = (uint32)(p - image);
+                    memcpy(p, trk->sectorData + slot * sectsize, sectsize);
+                    p += sectsize;
+                    break;
+            }
+        }
+    }
+
+    sim_debug(myDisk->debugmask, myDisk->device, "Writing image, %d tracks, %d bytes\n", myDisk->ntrackOrder, len);
+
+    r = SCPE_NOFNC;
+    if((myDisk->uptr != NULL) && (myDisk->uptr->fileref == myDisk->file) && (myDisk->uptr->filename != NULL))
+        r = diskReplace(myDisk, image, len);
+    if(r == SCPE_NOFNC) {                   /* not replaceable, write in place */
+        r = SCPE_OK;
+        rewind(myDisk->file);
+        if((sim_fwrite(image, 1, len, myDisk->file) != len) ||
+           (fflush(myDisk->file) != 0) ||
+           (sim_set_fsize(myDisk->file, (t_addr)len) == -1))
+            r = SCPE_IOERR;
+    }
+    if(r != SCPE_OK) {
+        sim_printf("SIM_IMD: Error writing disk image.\n");
+    } else {
+        myDisk->dirty = 0;
+        myDisk->fileWrites++;
+    }
+    free(image);
+
+    return r;
+}
+
+/* Unit io_flush routine: write a changed image back when the simulator stops. */
+static void diskIoFlush(UNIT *uptr)
+{
+    DISK_INFO *myDisk;
+
+    for(myDisk = openDisks; myDisk != NULL; myDisk = myDisk->next) {
+        if((myDisk->uptr == uptr) && (myDisk->file == uptr->fileref))
+            diskFlush(myDisk);
+    }
+}
+
+/* Remove the io_flush hook and free the in-memory image, without writing it. */
+static void diskRelease(DISK_INFO *myDisk)
+{
+    DISK_INFO **pp;
+    uint32 hooked = FALSE;
+
+    for(pp = &openDisks; *pp != NULL; pp = &(*pp)->next) {
+        if(*pp == myDisk) {
+            *pp = myDisk->next;
+            break;
+        }
+    }
+    for(pp = &openDisks; *pp != NULL; pp = &(*pp)->next)
+        hooked |= ((*pp)->uptr == myDisk->uptr);
+    if((myDisk->uptr != NULL) && !hooked && (myDisk->uptr->io_flush == &diskIoFlush))
+        myDisk->uptr->io_flush = NULL;
+    diskFreeTracks(myDisk);
+    free(myDisk->comment);
+    free(myDisk);
+}
+
 /*
  * This function closes the IMD image.  After closing, the sector read/write operations are not
- * possible.
+ * possible.  Changes to the image are written to the file first; if that fails, the error is
+ * returned and the image is kept open, so no data is lost and the close can be retried.
  *
  * The IMD file is not actually closed, we leave that to SIMH.
  */
 t_stat diskClose(DISK_INFO **myDisk)
 {
+    t_stat r;
+
     if(*myDisk == NULL)
         return SCPE_OPENERR;
-    free(*myDisk);
+    if((r = diskFlush(*myDisk)) != SCPE_OK)
+        return r;
+    sim_debug((*myDisk)->debugmask, (*myDisk)->device, "Sector reads: %d, sector writes: %d, track writes: %d, image writes: %d\n",
+              (*myDisk)->sectorReads, (*myDisk)->sectorWrites, (*myDisk)->trackWrites, (*myDisk)->fileWrites);
+    diskRelease(*myDisk);
     *myDisk = NULL;
     return SCPE_OK;
 }
@@ -347,6 +686,7 @@ t_stat diskCreate(FILE *fileref, const char *ctlr_comment)
     char *result;
     uint8 answer;
     int32 len, remaining;
+    t_stat r;
 
     if(fileref == NULL) {
         return (SCPE_OPENERR);
@@ -412,7 +752,10 @@ t_stat diskCreate(FILE *fileref, const char *ctlr_comment)
         sim_printf("SIM_IMD: error formatting disk.\n");
     }
 
-    return diskClose(&myDisk);
+    r = diskClose(&myDisk);
+    if(myDisk != NULL)                      /* flush failed, don't leave it hooked */
+        diskRelease(myDisk);
+    return r;
 }
 
 
@@ -487,9 +830,9 @@ t_stat sectRead(DISK_INFO *myDisk,
              uint32 *flags,
              uint32 *readlen)
 {
-    uint32 sectorFileOffset;
+    TRACK_INFO *trk;
+    uint32 slot;
     uint8 sectRecordType;
-    uint8 start_sect;
     *readlen = 0;
     *flags = 0;
 
@@ -504,27 +847,25 @@ t_stat sectRead(DISK_INFO *myDisk,
         return(SCPE_IOERR);
     }
 
-    if(Sector > myDisk->track[Cyl][Head].nsects) {
+    trk = &myDisk->track[Cyl][Head];
+    slot = Sector - trk->start_sector;
+
+    if((Sector > trk->nsects) || (slot >= MAX_SPT) || (trk->sectorType[slot] == SECT_RECORD_NONE)) {
         sim_debug(myDisk->debugmask, myDisk->device, "%s: invalid sector\n", __FUNCTION__);
         *flags |= IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
-    if(buflen < myDisk->track[Cyl][Head].sectsize) {
-        sim_printf("%s: Reading C:%d/H:%d/S:%d, len=%d: user buffer too short, need %d\n", __FUNCTION__, Cyl, Head, Sector, buflen, myDisk->track[Cyl][Head].sectsize);
+    if(buflen < trk->sectsize) {
+        sim_printf("%s: Reading C:%d/H:%d/S:%d, len=%d: user buffer too short, need %d\n", __FUNCTION__, Cyl, Head, Sector, buflen, trk->sectsize);
         *flags |= IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
-    start_sect = myDisk->track[Cyl][Head].start_sector;
-
-    sectorFileOffset = myDisk->track[Cyl][Head].sectorOffsetMap[Sector-start_sect];
-
-    sim_debug(myDisk->debugmask, myDisk->device, "Reading C:%d/H:%d/S:%d, len=%d, offset=0x%08x\n", Cyl, Head, Sector, buflen, sectorFileOffset);
+    sim_debug(myDisk->debugmask, myDisk->device, "Reading C:%d/H:%d/S:%d, len=%d, offset=0x%08x\n", Cyl, Head, Sector, buflen, trk->sectorOffsetMap[slot]);
 
-    sim_fseek(myDisk->file, sectorFileOffset-1, SEEK_SET);
-
-    sectRecordType = fgetc(myDisk->file);
+    myDisk->sectorReads++;
+    sectRecordType = trk->sectorType[slot];
     switch(sectRecordType) {
         case SECT_RECORD_UNAVAILABLE:   /* Data could not be read from the original media */
             *flags |= IMD_DISK_IO_ERROR_GENERAL;
@@ -536,10 +877,8 @@ t_stat sectRead(DISK_INFO *myDisk,
         case SECT_RECORD_NORM_DAM:      /* Normal Data with deleted address mark */
 
 /*          sim_debug(myDisk->debugmask, myDisk->device, "Uncompressed Data\n"); */
-            if (sim_fread(buf, 1, myDisk->track[Cyl][Head].sectsize, myDisk->file) != myDisk->track[Cyl][Head].sectsize) {
-                sim_printf("SIM_IMD[%s]: sim_fread error for SECT_RECORD_NORM_DAM.\n", __FUNCTION__);
-            }
-            *readlen = myDisk->track[Cyl][Head].sectsize;
+            memcpy(buf, trk->sectorData + slot * trk->sectsize, trk->sectsize);
+            *readlen = trk->sectsize;
             break;
         case SECT_RECORD_NORM_COMP_ERR: /* Compressed Normal Data */
         case SECT_RECORD_NORM_DAM_COMP_ERR: /* Compressed Normal Data with deleted address mark */
@@ -547,8 +886,8 @@ t_stat sectRead(DISK_INFO *myDisk,
         case SECT_RECORD_NORM_COMP:     /* Compressed Normal Data */
         case SECT_RECORD_NORM_DAM_COMP: /* Compressed Normal Data with deleted address mark */
 /*          sim_debug(myDisk->debugmask, myDisk->device, "Compressed Data\n"); */
-            memset(buf, fgetc(myDisk->file), myDisk->track[Cyl][Head].sectsize);
-            *readlen = myDisk->track[Cyl][Head].sectsize;
+            memcpy(buf, trk->sectorData + slot * trk->sectsize, trk->sectsize);
+            *readlen = trk->sectsize;
             *flags |= IMD_DISK_IO_COMPRESSED;
             break;
         default:
@@ -570,7 +909,9 @@ t_stat sectRead(DISK_INFO *myDisk,
     return(SCPE_OK);
 }
 
-/* Write a sector to an IMD image. */
+/* Write a sector to an IMD image.  The sector is changed in memory, and written to the
+ * file by diskFlush().  A compressed sector becomes an uncompressed one.
+ */
 t_stat sectWrite(DISK_INFO *myDisk,
               uint32 Cyl,
               uint32 Head,
@@ -580,49 +921,46 @@ t_stat sectWrite(DISK_INFO *myDisk,
               uint32 *flags,
               uint32 *writelen)
 {
-    uint32 sectorFileOffset;
+    TRACK_INFO *trk;
+    uint32 slot;
     uint8 sectRecordType;
-    uint8 start_sect;
     *writelen = 0;
 
-    sim_debug(myDisk->debugmask, myDisk->device, "Writing C:%d/H:%d/S:%d, len=%d\n", Cyl, Head, Sector, buflen);
-
     /* Check parameters */
     if(myDisk == NULL) {
         *flags = IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
+    sim_debug(myDisk->debugmask, myDisk->device, "Writing C:%d/H:%d/S:%d, len=%d\n", Cyl, Head, Sector, buflen);
+
     if(sectSeek(myDisk, Cyl, Head) != 0) {
         *flags = IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
-    if(Sector > myDisk->track[Cyl][Head].nsects) {
+    trk = &myDisk->track[Cyl][Head];
+    slot = Sector - trk->start_sector;
+
+    if((Sector > trk->nsects) || (slot >= MAX_SPT) || (trk->sectorType[slot] == SECT_RECORD_NONE)) {
         sim_debug(myDisk->debugmask, myDisk->device, "%s: invalid sector\n", __FUNCTION__);
         *flags = IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
     if(myDisk->flags & FD_FLAG_WRITELOCK) {
-        sim_printf("Disk write-protected because the image contains compressed sectors. Use IMDU to uncompress.\n");
+        sim_printf("Disk write-protected.\n");
         *flags = IMD_DISK_IO_ERROR_WPROT;
         return(SCPE_IOERR);
     }
 
-    if(buflen < myDisk->track[Cyl][Head].sectsize) {
+    if(buflen < trk->sectsize) {
         sim_printf("%s: user buffer too short [buflen %i < sectsize %i]\n",
-                   __FUNCTION__, buflen, myDisk->track[Cyl][Head].sectsize);
+                   __FUNCTION__, buflen, trk->sectsize);
         *flags = IMD_DISK_IO_ERROR_GENERAL;
         return(SCPE_IOERR);
     }
 
-    start_sect = myDisk->track[Cyl][Head].start_sector;
-
-    sectorFileOffset = myDisk->track[Cyl][Head].sectorOffsetMap[Sector-start_sect];
-
-    sim_fseek(myDisk->file, sectorFileOffset-1, SEEK_SET);
-
     if (*flags & IMD_DISK_IO_ERROR_GENERAL) {
         sectRecordType = SECT_RECORD_UNAVAILABLE;
     } else if (*flags & IMD_DISK_IO_ERROR_CRC) {
@@ -637,24 +975,28 @@ t_stat sectWrite(DISK_INFO *myDisk,
         sectRecordType = SECT_RECORD_NORM;
     }
 
-    fputc(sectRecordType, myDisk->file);
-    sim_fwrite(buf, 1, myDisk->track[Cyl][Head].sectsize, myDisk->file);
-    *writelen = myDisk->track[Cyl][Head].sectsize;
+    trk->sectorType[slot] = sectRecordType;
+    memcpy(trk->sectorData + slot * trk->sectsize, buf, trk->sectsize);
+    *writelen = trk->sectsize;
+    myDisk->sectorWrites++;
+    myDisk->dirty = 1;
 
     return(SCPE_OK);
 }
 
-/* Format an entire track.  The new track to be formatted must be after any existing tracks on
- * the disk.
+/* Format an entire track.  The track is created in memory, and written to the file by
+ * diskFlush().  Tracks are written to the file in the order they were formatted.
  *
- * This routine should be enhanced to re-format an existing track to the same format (this
- * does not involve changing the disk image size.)
+ * This routine should be enhanced to re-format an existing track to the same format.
  *
  * Any existing data on the disk image will be destroyed when Track 0, Head 0 is formatted.
- * At that time, the IMD file is truncated.  So for the trackWrite to be used to sucessfully
+ * At that time, all tracks are discarded.  So for the trackWrite to be used to sucessfully
  * format a disk image, then format program must format tracks starting with Cyl 0, Head 0,
  * and proceed sequentially through all tracks/heads on the disk.
  *
+ * The sector length may be given in bytes, or as IMD sector size code (0 for 128 bytes,
+ * 1 for 256 bytes, ...).
+ *
  * Format programs that are known to work include:
  * Cromemco CDOS "INIT.COM"
  * ADC Super-Six (CP/M-80) "FMT8.COM"
@@ -671,11 +1013,8 @@ t_stat trackWrite(DISK_INFO *myDisk,
                uint8 fillbyte,
                uint32 *flags)
 {
-    FILE *fileref;
-    IMD_HEADER track_header;
-    uint8 *sectorData;
-    unsigned long i;
-    unsigned long dataLen;
+    TRACK_INFO *trk;
+    uint32 i, sectorSize;
 
     *flags = 0;
 
@@ -691,25 +1030,15 @@ t_stat trackWrite(DISK_INFO *myDisk,
         return(SCPE_IOERR);
     }
 
-    fileref = myDisk->file;
-
     sim_debug(myDisk->debugmask, myDisk->device, "Formatting C:%d/H:%d/N:%d, len=%d, Fill=0x%02x\n", Cyl, Head, numSectors, sectorLen, fillbyte);
 
-    /* Truncate the IMD file when formatting Cyl 0, Head 0 */
+    /* Discard all tracks when formatting Cyl 0, Head 0 */
     if((Cyl == 0) && (Head == 0))
     {
-        /* Skip over IMD comment field. */
-        commentParse(myDisk, NULL, 0);
-
-        /* Truncate the IMD file after the comment field. */
-        if (sim_set_fsize(fileref, (t_addr)ftell (fileref)) == -1) {
-            sim_printf("Disk truncation failed.\n");
-            *flags |= IMD_DISK_IO_ERROR_GENERAL;
-            return(SCPE_IOERR);
-        }
-        /* Flush and re-parse the IMD file. */
-        fflush(fileref);
-        diskParse(myDisk, 0);
+        diskFreeTracks(myDisk);
+        myDisk->nsides = 1;
+        myDisk->ntracks = 0;
+        myDisk->dirty = 1;
     }
 
     /* Check to make sure the Cyl / Head is not already formatted. */
@@ -719,37 +1048,37 @@ t_stat trackWrite(DISK_INFO *myDisk,
         return(SCPE_IOERR);
     }
 
-    track_header.mode = mode;
-    track_header.cyl = Cyl;
-    track_header.head = Head;
-    track_header.nsects = numSectors;
-    track_header.sectsize = sectorLen;
-
-    /* Forward to end of the file, write track header and sector map. */
-    sim_fseek(myDisk->file, 0, SEEK_END);
-    sim_fwrite(&track_header, 1, sizeof(IMD_HEADER), fileref);
-    sim_fwrite(sectorMap, 1, numSectors, fileref);
+    if((Cyl >= MAX_CYL) || (Head >= MAX_HEAD) || (numSectors > MAX_SPT)) {
+        sim_printf("SIM_IMD: ERROR: Not Formatting C:%d/H:%d/N:%d, out of range.\n", Cyl, Head, numSectors);
+        *flags |= IMD_DISK_IO_ERROR_GENERAL;
+        return(SCPE_IOERR);
+    }
 
-    /* Compute data length, and fill a sector buffer with the
-     * sector record type as the first byte, and fill the sector
-     * data with the fillbyte.
-     */
-    dataLen = sectorLen + 1;
-    sectorData = (uint8 *)malloc(dataLen);
-    memset(sectorData, fillbyte, dataLen);
-    sectorData[0] = SECT_RECORD_NORM;
+    if(sectorLen < 128)     /* IMD sector size code */
+        sectorSize = 128 << (sectorLen & 7);
+    else
+        for(sectorSize=128;(sectorSize < sectorLen) && (sectorSize < (128 << 6));sectorSize<<=1);
 
-    /* For each sector on the track, write the record type and sector data. */
+    /* Create the track, with the sector data filled with the fillbyte. */
+    if(trackAlloc(myDisk, Cyl, Head, numSectors, sectorSize, sectorMap) != SCPE_OK) {
+        *flags |= IMD_DISK_IO_ERROR_GENERAL;
+        return(SCPE_IOERR);
+    }
+    trk = &myDisk->track[Cyl][Head];
+    trk->mode = mode;
+    trk->mapFlags = 0;
     for(i=0;i<numSectors;i++) {
-        sim_fwrite(sectorData, 1, dataLen, fileref);
+        trk->logicalHead[i] = Head;
+        trk->logicalCyl[i] = Cyl;
+        memset(trk->sectorData + (sectorMap[i]-trk->start_sector) * sectorSize, fillbyte, sectorSize);
     }
 
-    /* Flush the file, and free the sector buffer. */
-    fflush(fileref);
-    free(sectorData);
-
-    /* Now that the disk track/sector layout has been modified, re-parse the disk image. */
-    diskParse(myDisk, 0);
+    if((Head + 1) > myDisk->nsides) {
+        myDisk->nsides = Head + 1;
+    }
+    myDisk->ntracks++;
+    myDisk->trackWrites++;
+    myDisk->dirty = 1;
 
     return(SCPE_OK);
 }
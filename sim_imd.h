@@ -106,10 +106,16 @@ typedef struct {
     uint8 start_sector;
     uint8 logicalHead[MAX_SPT];
     uint8 logicalCyl[MAX_SPT];
+    uint8 mapFlags;                 /* Sector head/cylinder map flags of track header */
+    uint8 sectorMap[MAX_SPT];       /* Sector numbers in physical order */
+    uint8 sectorType[MAX_SPT];      /* Sector record types, indexed like sectorOffsetMap */
+    uint8 *sectorData;              /* Sector data, indexed like sectorOffsetMap */
 } TRACK_INFO;
 
-typedef struct {
+typedef struct disk_info {
     FILE *file;
+    UNIT *uptr;                     /* Unit the image is attached to, if known */
+    struct disk_info *next;         /* Next image with an io_flush hook */
     uint32 ntracks;
     uint8 nsides;
     uint8 flags;
@@ -117,11 +123,21 @@ typedef struct {
     uint32 debugmask;
     uint32 verbosedebugmask;
     TRACK_INFO track[MAX_CYL][MAX_HEAD];
+    uint8 *comment;                 /* Comment header, including EOF marker */
+    uint32 commentLen;
+    uint16 trackOrder[MAX_CYL * MAX_HEAD];  /* Tracks in file order, as Cyl * MAX_HEAD + Head */
+    uint32 ntrackOrder;
+    uint32 dirty;                   /* Image changed since last written to the file */
+    uint32 sectorReads;             /* Statistics */
+    uint32 sectorWrites;
+    uint32 trackWrites;
+    uint32 fileWrites;
 } DISK_INFO;
 
 extern DISK_INFO *diskOpen(FILE *fileref, uint32 isVerbose);
 extern DISK_INFO *diskOpenEx(FILE *fileref, uint32 isVerbose, DEVICE *device, uint32 debugmask, uint32 verbosedebugmask);
 extern t_stat diskClose(DISK_INFO **myDisk);
+extern t_stat diskFlush(DISK_INFO *myDisk);
 extern t_stat diskCreate(FILE *fileref, const char *ctlr_comment);
 extern uint32 imdGetSides(DISK_INFO *myDisk);
 extern uint32 imdIsWriteLocked(DISK_INFO *myDisk);
@@ -79,6 +79,8 @@ extern "C" {
    sim_accept_conn      accept connection
    sim_read_sock        read from socket
    sim_write_sock       write from socket
+   sim_read_sock_datagrams  read a batch of datagrams from socket
+   sim_write_sock_datagrams write a batch of datagrams to socket
    sim_close_sock       close socket
    sim_setnonblock      set socket non-blocking
 */
@@ -120,6 +122,16 @@ int sim_write_sock (SOCKET sock, char *msg, int nbytes)
 return 0;
 }
 
+int sim_read_sock_datagrams (SOCKET sock, char *buf, int bufsize, int *lens, int count)
+{
+return -1;
+}
+
+int sim_write_sock_datagrams (SOCKET sock, const char **msgs, const int *lens, int count)
+{
+return -1;
+}
+
 void sim_close_sock (SOCKET sock)
 {
 return;
@@ -1257,6 +1269,108 @@ if (sbytes == SOCKET_ERROR) {
 return sbytes;
 }
 
+/* Datagram batch transfers
+
+   sim_read_sock_datagrams receives up to count pending datagrams into
+   consecutive bufsize byte slots of buf and stores each datagram's length
+   in lens (a length larger than bufsize means the datagram was truncated).
+   It returns the number of datagrams received, 0 if none are pending, or
+   -1 on error.
+
+   sim_write_sock_datagrams sends up to count datagrams and returns the
+   number sent, 0 if the socket would block, or -1 on error.
+
+   Each call makes at most one system call.  Where recvmmsg/sendmmsg exist
+   that call moves a whole batch; elsewhere a single datagram.
+*/
+
+#if defined (__linux__) && defined (_GNU_SOURCE) && defined (MSG_WAITFORONE)
+#define SIM_SOCK_MMSG
+#define SIM_SOCK_MMSG_MAX   64                          /* datagrams per system call */
+#endif
+
+int sim_read_sock_datagrams (SOCKET sock, char *buf, int bufsize, int *lens, int count)
+{
+int rbytes;
+
+if (count <= 0)
+    return 0;
+#if defined (SIM_SOCK_MMSG)
+if (1) {
+    struct mmsghdr hdrs[SIM_SOCK_MMSG_MAX];
+    struct iovec iovs[SIM_SOCK_MMSG_MAX];
+    int i, n, err;
+
+    if (count > SIM_SOCK_MMSG_MAX)
+        count = SIM_SOCK_MMSG_MAX;
+    memset (hdrs, 0, count * sizeof (*hdrs));
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = buf + i * bufsize;
+        iovs[i].iov_len = bufsize;
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+    n = recvmmsg (sock, hdrs, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (n >= 0) {
+        for (i = 0; i < n; i++)
+            lens[i] = (int)hdrs[i].msg_len;
+        return n;
+        }
+    err = WSAGetLastError ();
+    if ((err == WSAEWOULDBLOCK) || (err == EAGAIN))     /* no data */
+        return 0;
+    if (err != ENOSYS) {                                /* unless not supported by this kernel */
+        if ((err != WSAECONNREFUSED) &&                 /* ICMP unreachable from the peer */
+            (err != WSAEINTR))
+            sim_err_sock (INVALID_SOCKET, "recvmmsg");
+        return -1;
+        }
+    }
+#endif
+rbytes = sim_read_sock (sock, buf, bufsize);
+if (rbytes <= 0)
+    return rbytes;
+lens[0] = rbytes;
+return 1;
+}
+
+int sim_write_sock_datagrams (SOCKET sock, const char **msgs, const int *lens, int count)
+{
+int sbytes;
+
+if (count <= 0)
+    return 0;
+#if defined (SIM_SOCK_MMSG)
+if (1) {
+    struct mmsghdr hdrs[SIM_SOCK_MMSG_MAX];
+    struct iovec iovs[SIM_SOCK_MMSG_MAX];
+    int i, n, err;
+
+    if (count > SIM_SOCK_MMSG_MAX)
+        count = SIM_SOCK_MMSG_MAX;
+    memset (hdrs, 0, count * sizeof (*hdrs));
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = (void *)msgs[i];
+        iovs[i].iov_len = lens[i];
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+    n = sendmmsg (sock, hdrs, count, 0);
+    if (n >= 0)
+        return n;
+    err = WSAGetLastError ();
+    if ((err == WSAEWOULDBLOCK) || (err == EAGAIN))     /* no room */
+        return 0;
+    if (err != ENOSYS)                                  /* unless not supported by this kernel */
+        return -1;
+    }
+#endif
+sbytes = sim_write_sock (sock, msgs[0], lens[0]);
+if (sbytes == lens[0])
+    return 1;
+return ((sbytes == 0) ? 0 : -1);
+}
+
 void sim_close_sock (SOCKET sock)
 {
 shutdown(sock, SD_BOTH);
@@ -96,6 +96,10 @@
 #include <pthread.h>
 #endif
 
+#if defined (HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
 struct sim_tape_fmt {
     const char          *name;                          /* name */
     int32               uflags;                         /* unit flags */
@@ -108,6 +112,8 @@ static struct sim_tape_fmt fmts[MTUF_N_FMT] = {
     { "TPC",  UNIT_RO, sizeof (t_tpclnt) - 1 },
     { "P7B",  0,       0 },
 /*  { "TPF",  UNIT_RO, 0 }, */
+    { NULL,   0,       0 },
+    { "ZTAP", 0,       sizeof (t_mtrlnt) - 1 },
     { NULL,   0,       0 }
     };
 
@@ -129,12 +135,42 @@ static t_stat sim_tape_simh_check (UNIT *uptr);
 static t_stat sim_tape_e11_check (UNIT *uptr);
 static t_addr sim_tape_tpc_fnd (UNIT *uptr, t_addr *map);
 static void sim_tape_data_trace (UNIT *uptr, const uint8 *data, size_t len, const char* txt, int detail, uint32 reason);
-
+struct tape_context;
+static void sim_tape_io_invalidate (struct tape_context *ctx);
+struct ztap_file;
+static t_stat sim_tape_ztap_open (FILE *file, t_bool readonly, struct ztap_file **zp);
+static t_stat sim_tape_ztap_flush (struct ztap_file *z);
+static t_stat sim_tape_ztap_close (struct ztap_file *z);
+static t_stat sim_tape_ztap_convert (UNIT *uptr, const char *dname, const char *sname, t_bool verify);
+
+
+struct tape_object {
+    t_addr              pos;                /* position of the leading length word */
+    t_addr              next;               /* position following the object */
+    t_mtrlnt            bc;                 /* record length word or tape mark */
+    };
 
 struct tape_context {
     DEVICE              *dptr;              /* Device for unit (access to debug flags) */
     uint32              dbit;               /* debugging bit for trace */
     uint32              auto_format;        /* Format determined dynamically */
+    struct tape_object  *idx;               /* objects known from BOT (SIMH and E11 formats) */
+    uint32              idx_count;
+    uint32              idx_size;
+    uint32              *idx_tmk;           /* entries in idx which are tape marks */
+    uint32              idx_tmk_count;
+    uint32              idx_tmk_size;
+    struct ztap_file    *ztap;              /* compressed container (ZTAP format) */
+    uint8               *iobuf;             /* image data buffered for reading */
+    t_addr              iobuf_pos;          /* image position of iobuf[0] */
+    uint32              iobuf_len;          /* valid bytes in iobuf */
+    t_bool              iobuf_eof;          /* iobuf ends at the end of the image */
+    t_addr              io_pos;             /* logical image position */
+    t_bool              io_eof;             /* last read reached the end of the image */
+    t_addr              file_pos;           /* stdio file position */
+    int                 file_op;            /* last stdio transfer (read or write) */
+    uint8               *wrbuf;             /* record being written */
+    uint32              wrbuf_size;
 #if defined SIM_ASYNCH_IO
     int                 asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
@@ -426,13 +462,15 @@ return SCPE_OK;
 */
 static void _sim_tape_io_flush (UNIT *uptr)
 {
-#if defined (SIM_ASYNCH_IO)
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 
+#if defined (SIM_ASYNCH_IO)
 sim_tape_clr_async (uptr);
 if (sim_asynch_enabled)
     sim_tape_set_async (uptr, ctx->asynch_io_latency);
 #endif
+if (ctx->ztap)
+    sim_tape_ztap_flush (ctx->ztap);
 fflush (uptr->fileref);
 }
 
@@ -467,6 +505,21 @@ if (sim_switches & SWMASK ('F')) {                      /* format spec? */
     sim_switches = sim_switches & ~(SWMASK ('F'));      /* Record Format specifier already processed */
     auto_format = TRUE;
     }
+if (sim_switches & SWMASK ('C')) {                      /* convert an image to a ZTAP container? */
+    if (MT_GET_FMT (uptr) != MTUF_F_ZTP)
+        return sim_messagef (SCPE_ARG, "Conversion requires the ZTAP tape format\n");
+    cptr = get_glyph_nc (cptr, gbuf, 0);                /* get new container name */
+    if (*cptr == 0)                                     /* must be more */
+        return SCPE_2FARG;
+    r = sim_tape_ztap_convert (uptr, gbuf, cptr, (sim_switches & SWMASK ('V')) != 0);
+    sim_switches = sim_switches & ~(SWMASK ('C') | SWMASK ('V'));
+    if (r != SCPE_OK) {
+        if (auto_format)
+            sim_tape_set_fmt (uptr, 0, "SIMH", NULL);   /* restore default format */
+        return r;
+        }
+    cptr = gbuf;                                        /* attach the new container */
+    }
 if (MT_GET_FMT (uptr) == MTUF_F_TPC)
     sim_switches |= SWMASK ('R');                       /* Force ReadOnly attach for TPC tapes */
 r = attach_unit (uptr, (CONST char *)cptr);             /* attach unit */
@@ -488,6 +541,9 @@ switch (MT_GET_FMT (uptr)) {                            /* case on format */
             }
         break;
 
+    case MTUF_F_ZTP:                                    /* ZTAP, opened below */
+        break;
+
     case MTUF_F_TPC:                                    /* TPC */
         objc = sim_tape_tpc_map (uptr, NULL, 0);        /* get # objects */
         if (objc == 0) {                                /* tape empty? */
@@ -511,6 +567,14 @@ uptr->tape_ctx = ctx = (struct tape_context *)calloc(1, sizeof(struct tape_conte
 ctx->dptr = dptr;                                       /* save DEVICE pointer */
 ctx->dbit = dbit;                                       /* save debug bit */
 ctx->auto_format = auto_format;                         /* save that we auto selected format */
+sim_tape_io_invalidate (ctx);
+if (MT_GET_FMT (uptr) == MTUF_F_ZTP) {                  /* compressed container? */
+    r = sim_tape_ztap_open (uptr->fileref, (uptr->flags & UNIT_RO) != 0, &ctx->ztap);
+    if (r != SCPE_OK) {
+        sim_tape_detach (uptr);
+        return r;
+        }
+    }
 
 sim_tape_rewind (uptr);
 
@@ -541,6 +605,8 @@ if (ctx)
 
 sim_tape_clr_async (uptr);
 
+sim_tape_ztap_close (ctx->ztap);                        /* release compressed container */
+ctx->ztap = NULL;
 r = detach_unit (uptr);                                 /* detach unit */
 if (r != SCPE_OK)
     return r;
@@ -558,6 +624,10 @@ switch (f) {                                            /* case on format */
         }
 
 sim_tape_rewind (uptr);
+free (ctx->idx);
+free (ctx->idx_tmk);
+free (ctx->iobuf);
+free (ctx->wrbuf);
 free (uptr->tape_ctx);
 uptr->tape_ctx = NULL;
 uptr->io_flush = NULL;
@@ -587,7 +657,12 @@ fprintf (st, "    -R          Attach Read Only.\n");
 fprintf (st, "    -E          Must Exist (if not specified an attempt to create the indicated\n");
 fprintf (st, "                virtual tape will be attempted).\n");
 fprintf (st, "    -F          Open the indicated tape container in a specific format (default\n");
-fprintf (st, "                is SIMH, alternatives are E11, TPC and P7B)\n");
+fprintf (st, "                is SIMH, alternatives are E11, TPC, P7B and ZTAP)\n");
+fprintf (st, "    -C          Convert a SIMH format tape image into a new ZTAP (compressed)\n");
+fprintf (st, "                container and attach the result.  Requires -F ZTAP.\n");
+fprintf (st, "    -V          Verify the converted container against the original image.\n\n");
+fprintf (st, "Examples:\n");
+fprintf (st, "  sim> ATTACH -F -C -V %s ZTAP archive.ztap original.tap\n", dptr->name);
 return SCPE_OK;
 }
 
@@ -601,6 +676,932 @@ if (sim_deb && (ctx->dptr->dctrl & reason))
     sim_data_trace(ctx->dptr, uptr, (detail ? data : NULL), "", len, txt, reason);
 }
 
+/* Compressed tape container (internal routines)
+
+   A ZTAP container holds the byte stream of a SIMH format tape image cut
+   into chunks of a fixed size, each compressed on its own with zlib.  An
+   index of the chunk locations follows the last chunk, so any position on
+   the tape, and with the object index any file mark, is reached by
+   decompressing a single chunk.
+
+        header      "SIMHZTAP", chunk size, reserved (32 bits each)
+        chunk       compressed length, data length (32 bits each), data
+        ...
+        index       file offset of each chunk (64 bits each)
+        trailer     "ZTAPINDX", index offset, tape length (64 bits each),
+                    chunk count, chunk size (32 bits each)
+
+   All values are little endian.  Every chunk except the last holds a full
+   chunk size of data.
+
+   The container is written at its end only.  The last chunk is kept in
+   memory while it fills and is compressed when full, when the simulator
+   stops and at detach, at which times the index and trailer are rewritten.
+   A write ahead of the last chunk truncates the tape there.  If the trailer
+   is missing, say after a host crash, the chunks are found by walking their
+   headers.
+*/
+
+#define ZTAP_CHUNK      (256 * 1024)                    /* default chunk size */
+#define ZTAP_HDR_SIZE   16                              /* container header */
+#define ZTAP_CHK_SIZE   8                               /* chunk header */
+#define ZTAP_TRL_SIZE   32                              /* container trailer */
+#define ZTAP_NONE       0xFFFFFFFF                      /* no chunk */
+
+#if defined (HAVE_ZLIB)
+
+static const char ztap_magic[8] = { 'S', 'I', 'M', 'H', 'Z', 'T', 'A', 'P' };
+static const char ztap_trl_magic[8] = { 'Z', 'T', 'A', 'P', 'I', 'N', 'D', 'X' };
+
+struct ztap_file {
+    FILE                *file;              /* container file */
+    t_bool              readonly;
+    uint32              chunk_size;         /* data bytes per chunk */
+    t_offset            *offset;            /* file offset of each stored chunk */
+    uint32              count;              /* stored chunks */
+    uint32              size;               /* offset entries allocated */
+    t_offset            data_end;           /* end of the stored chunks */
+    t_addr              length;             /* tape length */
+    t_addr              pos;                /* current position */
+    t_bool              eof;                /* last read reached the end of tape */
+    t_bool              error;              /* I/O or decompression error seen */
+    t_bool              dirty;              /* index and trailer need rewriting */
+    t_bool              trailer;            /* trailer on disk is current */
+    uint8               *cache;             /* last chunk decompressed */
+    uint32              cache_chunk;
+    uint32              cache_len;
+    uint8               *tail;              /* chunk being written */
+    uint32              tail_chunk;         /* its number (ZTAP_NONE if not writing) */
+    uint32              tail_len;
+    uint8               *zbuf;              /* compressed chunk */
+    uint32              zbuf_size;
+    };
+
+static void sim_tape_ztap_put32 (uint8 *p, uint32 v)
+{
+p[0] = (uint8)v;
+p[1] = (uint8)(v >> 8);
+p[2] = (uint8)(v >> 16);
+p[3] = (uint8)(v >> 24);
+}
+
+static uint32 sim_tape_ztap_get32 (const uint8 *p)
+{
+return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static void sim_tape_ztap_put64 (uint8 *p, t_uint64 v)
+{
+sim_tape_ztap_put32 (p, (uint32)v);
+sim_tape_ztap_put32 (p + 4, (uint32)(v >> 32));
+}
+
+static t_uint64 sim_tape_ztap_get64 (const uint8 *p)
+{
+return sim_tape_ztap_get32 (p) | (((t_uint64)sim_tape_ztap_get32 (p + 4)) << 32);
+}
+
+static t_bool sim_tape_ztap_pread (struct ztap_file *z, void *buf, size_t len, t_offset pos)
+{
+return (sim_fseeko (z->file, pos, SEEK_SET) == 0) &&
+       (sim_fread (buf, 1, len, z->file) == len);
+}
+
+static t_bool sim_tape_ztap_pwrite (struct ztap_file *z, const void *buf, size_t len, t_offset pos)
+{
+return (sim_fseeko (z->file, pos, SEEK_SET) == 0) &&
+       (sim_fwrite (buf, 1, len, z->file) == len);
+}
+
+static t_bool sim_tape_ztap_zbuf (struct ztap_file *z, uint32 len)
+{
+if (len > z->zbuf_size) {
+    uint8 *p = (uint8 *)realloc (z->zbuf, len);
+
+    if (p == NULL)
+        return FALSE;
+    z->zbuf = p;
+    z->zbuf_size = len;
+    }
+return TRUE;
+}
+
+static t_bool sim_tape_ztap_append_offset (struct ztap_file *z, t_offset offset)
+{
+if (z->count == z->size) {
+    uint32 size = z->size ? 2 * z->size : 256;
+    t_offset *p = (t_offset *)realloc (z->offset, size * sizeof (*p));
+
+    if (p == NULL)
+        return FALSE;
+    z->offset = p;
+    z->size = size;
+    }
+z->offset[z->count++] = offset;
+return TRUE;
+}
+
+/* Data of chunk k, or NULL if it is beyond the end of tape or unreadable */
+
+static const uint8 *sim_tape_ztap_chunk (struct ztap_file *z, uint32 k, uint32 *len)
+{
+uint8 hdr[ZTAP_CHK_SIZE];
+uint32 clen, ulen;
+uLongf dlen;
+
+if (k == z->tail_chunk) {
+    *len = z->tail_len;
+    return z->tail;
+    }
+if (k >= z->count)
+    return NULL;
+if (k != z->cache_chunk) {
+    z->cache_chunk = ZTAP_NONE;
+    if (!sim_tape_ztap_pread (z, hdr, sizeof (hdr), z->offset[k])) {
+        z->error = TRUE;
+        return NULL;
+        }
+    clen = sim_tape_ztap_get32 (hdr);
+    ulen = sim_tape_ztap_get32 (hdr + 4);
+    dlen = z->chunk_size;
+    if ((ulen == 0) || (ulen > z->chunk_size) ||
+        (clen == 0) || (clen > compressBound (z->chunk_size)) ||
+        !sim_tape_ztap_zbuf (z, clen) ||
+        !sim_tape_ztap_pread (z, z->zbuf, clen, z->offset[k] + ZTAP_CHK_SIZE) ||
+        (uncompress (z->cache, &dlen, z->zbuf, clen) != Z_OK) ||
+        (dlen != ulen)) {
+        z->error = TRUE;
+        return NULL;
+        }
+    z->cache_chunk = k;
+    z->cache_len = ulen;
+    }
+*len = z->cache_len;
+return z->cache;
+}
+
+/* Compress the chunk being written and store it after the others */
+
+static t_bool sim_tape_ztap_emit (struct ztap_file *z)
+{
+uLongf clen = compressBound (z->tail_len);
+
+if (!sim_tape_ztap_zbuf (z, (uint32)clen + ZTAP_CHK_SIZE) ||
+    (compress2 (z->zbuf + ZTAP_CHK_SIZE, &clen, z->tail, z->tail_len, Z_DEFAULT_COMPRESSION) != Z_OK))
+    return FALSE;
+sim_tape_ztap_put32 (z->zbuf, (uint32)clen);
+sim_tape_ztap_put32 (z->zbuf + 4, z->tail_len);
+if (!sim_tape_ztap_pwrite (z, z->zbuf, clen + ZTAP_CHK_SIZE, z->data_end) ||
+    !sim_tape_ztap_append_offset (z, z->data_end))
+    return FALSE;
+z->data_end = z->data_end + clen + ZTAP_CHK_SIZE;
+return TRUE;
+}
+
+/* Make pos the end of tape, with the chunk holding it ready for writing */
+
+static t_bool sim_tape_ztap_truncate (struct ztap_file *z, t_addr pos)
+{
+static const uint8 no_trailer[sizeof (ztap_trl_magic)] = { 0 };
+const uint8 *data;
+uint32 k, len;
+
+if (z->trailer) {                                       /* stale from now on */
+    if (!sim_tape_ztap_pwrite (z, no_trailer, sizeof (no_trailer),
+                               z->data_end + (t_offset)z->count * 8))
+        return FALSE;
+    z->trailer = FALSE;
+    }
+k = (uint32)(pos / z->chunk_size);
+if (k != z->tail_chunk) {
+    if (k < z->count) {                                 /* reopen a stored chunk */
+        data = sim_tape_ztap_chunk (z, k, &len);
+        if (data == NULL)
+            return FALSE;
+        memcpy (z->tail, data, (size_t)(pos - (t_addr)k * z->chunk_size));
+        z->data_end = z->offset[k];
+        z->count = k;
+        if ((z->cache_chunk != ZTAP_NONE) && (z->cache_chunk >= k))
+            z->cache_chunk = ZTAP_NONE;
+        }
+    z->tail_chunk = k;
+    }
+z->tail_len = (uint32)(pos - (t_addr)k * z->chunk_size);
+z->length = pos;
+z->dirty = TRUE;
+return TRUE;
+}
+
+/* Add data (zeros if buf is NULL) at the end of tape */
+
+static t_bool sim_tape_ztap_append (struct ztap_file *z, const uint8 *buf, size_t len)
+{
+size_t n;
+
+while (len > 0) {
+    n = z->chunk_size - z->tail_len;
+    if (n > len)
+        n = len;
+    if (buf) {
+        memcpy (z->tail + z->tail_len, buf, n);
+        buf = buf + n;
+        }
+    else
+        memset (z->tail + z->tail_len, 0, n);
+    z->tail_len = z->tail_len + (uint32)n;
+    z->length = z->length + n;
+    len = len - n;
+    if (z->tail_len == z->chunk_size) {                 /* chunk full? */
+        if (!sim_tape_ztap_emit (z))
+            return FALSE;
+        z->tail_chunk = z->count;
+        z->tail_len = 0;
+        }
+    }
+return TRUE;
+}
+
+static size_t sim_tape_ztap_read (struct ztap_file *z, void *buf, size_t len)
+{
+uint8 *bp = (uint8 *)buf;
+const uint8 *data;
+uint32 k, off, clen;
+size_t n, done = 0;
+
+while (len > 0) {
+    k = (uint32)(z->pos / z->chunk_size);
+    off = (uint32)(z->pos - (t_addr)k * z->chunk_size);
+    data = sim_tape_ztap_chunk (z, k, &clen);
+    if ((data == NULL) || (off >= clen)) {
+        if (!z->error)
+            z->eof = TRUE;
+        break;
+        }
+    n = clen - off;
+    if (n > len)
+        n = len;
+    memcpy (bp, data + off, n);
+    bp = bp + n;
+    z->pos = z->pos + n;
+    done = done + n;
+    len = len - n;
+    }
+return done;
+}
+
+static size_t sim_tape_ztap_write (struct ztap_file *z, const void *buf, size_t len)
+{
+t_addr pos = z->pos;
+
+if ((z->tail_chunk == ZTAP_NONE) || (pos < z->length)) {
+    if (!sim_tape_ztap_truncate (z, (pos < z->length) ? pos : z->length)) {
+        z->error = TRUE;
+        return 0;
+        }
+    }
+if (!sim_tape_ztap_append (z, NULL, (size_t)(pos - z->length)) ||   /* fill any hole */
+    !sim_tape_ztap_append (z, (const uint8 *)buf, len)) {
+    z->error = TRUE;
+    return 0;
+    }
+z->pos = z->length;
+return len;
+}
+
+/* Store the chunk being written and a current index and trailer */
+
+static t_stat sim_tape_ztap_flush (struct ztap_file *z)
+{
+uint8 hdr[ZTAP_HDR_SIZE], trl[ZTAP_TRL_SIZE];
+uint8 *index;
+uint32 i;
+t_bool ok;
+
+if (z->readonly || !z->dirty)
+    return SCPE_OK;
+if ((z->tail_chunk != ZTAP_NONE) && (z->tail_len > 0) && !sim_tape_ztap_emit (z))
+    return SCPE_IOERR;
+z->tail_chunk = ZTAP_NONE;
+index = (uint8 *)malloc (z->count * 8 + 1);
+if (index == NULL)
+    return SCPE_MEM;
+for (i = 0; i < z->count; i++)
+    sim_tape_ztap_put64 (index + i * 8, z->offset[i]);
+memcpy (hdr, ztap_magic, sizeof (ztap_magic));
+sim_tape_ztap_put32 (hdr + 8, z->chunk_size);
+sim_tape_ztap_put32 (hdr + 12, 0);
+memcpy (trl, ztap_trl_magic, sizeof (ztap_trl_magic));
+sim_tape_ztap_put64 (trl + 8, z->data_end);
+sim_tape_ztap_put64 (trl + 16, z->length);
+sim_tape_ztap_put32 (trl + 24, z->count);
+sim_tape_ztap_put32 (trl + 28, z->chunk_size);
+ok = sim_tape_ztap_pwrite (z, hdr, sizeof (hdr), 0) &&
+     sim_tape_ztap_pwrite (z, index, z->count * 8, z->data_end) &&
+     (sim_fwrite (trl, 1, sizeof (trl), z->file) == sizeof (trl)) &&
+     (fflush (z->file) == 0) &&
+     (sim_set_fsize_ex (z->file, z->data_end + z->count * 8 + sizeof (trl)) == 0);
+free (index);
+if (!ok)
+    return SCPE_IOERR;
+z->dirty = FALSE;
+z->trailer = TRUE;
+return SCPE_OK;
+}
+
+static t_stat sim_tape_ztap_close (struct ztap_file *z)
+{
+t_stat r;
+
+if (z == NULL)
+    return SCPE_OK;
+r = sim_tape_ztap_flush (z);
+free (z->offset);
+free (z->cache);
+free (z->tail);
+free (z->zbuf);
+free (z);
+return r;
+}
+
+/* Locate the chunks from the trailer, or failing that from their headers */
+
+static t_bool sim_tape_ztap_load (struct ztap_file *z, t_offset size)
+{
+uint8 trl[ZTAP_TRL_SIZE], hdr[ZTAP_CHK_SIZE];
+uint8 *index;
+uint32 i, count, len;
+t_offset pos;
+
+if ((size >= ZTAP_HDR_SIZE + ZTAP_TRL_SIZE) &&
+    sim_tape_ztap_pread (z, trl, sizeof (trl), size - sizeof (trl)) &&
+    (memcmp (trl, ztap_trl_magic, sizeof (ztap_trl_magic)) == 0) &&
+    (sim_tape_ztap_get32 (trl + 28) == z->chunk_size)) {
+    z->data_end = (t_offset)sim_tape_ztap_get64 (trl + 8);
+    z->length = (t_addr)sim_tape_ztap_get64 (trl + 16);
+    count = sim_tape_ztap_get32 (trl + 24);
+    index = (uint8 *)malloc (count * 8 + 1);
+    if ((z->data_end + (t_offset)count * 8 + ZTAP_TRL_SIZE == size) &&
+        (z->length <= (t_addr)count * z->chunk_size) &&
+        (z->length + z->chunk_size > (t_addr)count * z->chunk_size) &&
+        index && sim_tape_ztap_pread (z, index, count * 8, z->data_end)) {
+        for (i = 0; i < count; i++) {
+            pos = (t_offset)sim_tape_ztap_get64 (index + i * 8);
+            if ((pos < (i ? z->offset[i - 1] + ZTAP_CHK_SIZE : ZTAP_HDR_SIZE)) ||
+                (pos + ZTAP_CHK_SIZE > z->data_end) ||
+                !sim_tape_ztap_append_offset (z, pos))
+                break;
+            }
+        if (i == count) {
+            free (index);
+            z->trailer = TRUE;
+            return TRUE;
+            }
+        }
+    free (index);
+    z->count = 0;
+    }
+z->length = 0;                                          /* walk the chunks */
+pos = ZTAP_HDR_SIZE;
+while (sim_tape_ztap_pread (z, hdr, sizeof (hdr), pos)) {
+    len = sim_tape_ztap_get32 (hdr + 4);
+    if (!sim_tape_ztap_append_offset (z, pos))
+        break;
+    if ((sim_tape_ztap_get32 (hdr) == 0) ||
+        (sim_tape_ztap_chunk (z, z->count - 1, &len) == NULL)) {
+        z->count = z->count - 1;                        /* partially written */
+        z->error = FALSE;
+        break;
+        }
+    pos = pos + ZTAP_CHK_SIZE + sim_tape_ztap_get32 (hdr);
+    z->length = z->length + len;
+    if (len < z->chunk_size)                            /* last chunk? */
+        break;
+    }
+z->data_end = pos;
+z->dirty = TRUE;
+return FALSE;
+}
+
+static t_stat sim_tape_ztap_open (FILE *file, t_bool readonly, struct ztap_file **zp)
+{
+struct ztap_file *z;
+uint8 hdr[ZTAP_HDR_SIZE];
+t_offset size = sim_fsize_ex (file);
+
+*zp = NULL;
+z = (struct ztap_file *)calloc (1, sizeof (*z));
+if (z == NULL)
+    return SCPE_MEM;
+z->file = file;
+z->readonly = readonly;
+z->cache_chunk = z->tail_chunk = ZTAP_NONE;
+z->chunk_size = ZTAP_CHUNK;
+z->data_end = ZTAP_HDR_SIZE;
+if (size == 0)                                          /* new container */
+    z->dirty = TRUE;
+else {
+    if (!sim_tape_ztap_pread (z, hdr, sizeof (hdr), 0) ||
+        (memcmp (hdr, ztap_magic, sizeof (ztap_magic)) != 0) ||
+        (sim_tape_ztap_get32 (hdr + 8) < 512) ||
+        (sim_tape_ztap_get32 (hdr + 8) > 64 * 1024 * 1024)) {
+        free (z);
+        return sim_messagef (SCPE_FMT, "Not a ZTAP tape container\n");
+        }
+    z->chunk_size = sim_tape_ztap_get32 (hdr + 8);
+    }
+z->cache = (uint8 *)malloc (z->chunk_size);
+z->tail = (uint8 *)malloc (z->chunk_size);
+if ((z->cache == NULL) || (z->tail == NULL)) {
+    z->readonly = TRUE;
+    sim_tape_ztap_close (z);
+    return SCPE_MEM;
+    }
+if (size == 0) {                                        /* new container */
+    t_stat r = sim_tape_ztap_flush (z);                 /* header on disk before any chunk */
+
+    if (r != SCPE_OK) {
+        z->readonly = TRUE;
+        sim_tape_ztap_close (z);
+        return sim_messagef (r, "Can't initialize ZTAP tape container\n");
+        }
+    }
+else if (!sim_tape_ztap_load (z, size))
+    sim_printf ("ZTAP container index missing, %u chunks recovered\n", z->count);
+*zp = z;
+return SCPE_OK;
+}
+
+/* Copy a tape image into a new ZTAP container, optionally verifying it */
+
+static t_stat sim_tape_ztap_convert (UNIT *uptr, const char *dname, const char *sname, t_bool verify)
+{
+FILE *src, *dst;
+struct ztap_file *z;
+uint8 *buf, *vbuf;
+size_t n;
+t_offset total = 0;
+t_stat r;
+
+src = sim_fopen (sname, "rb");
+if (src == NULL)
+    return sim_messagef (SCPE_OPENERR, "Can't open source tape image: %s\n", sname);
+dst = sim_fopen (dname, "wb+");
+if (dst == NULL) {
+    fclose (src);
+    return sim_messagef (SCPE_OPENERR, "Can't create tape container: %s\n", dname);
+    }
+buf = (uint8 *)malloc (ZTAP_CHUNK);
+vbuf = (uint8 *)malloc (ZTAP_CHUNK);
+r = ((buf == NULL) || (vbuf == NULL)) ? SCPE_MEM : sim_tape_ztap_open (dst, FALSE, &z);
+if (r == SCPE_OK) {
+    while ((n = sim_fread (buf, 1, ZTAP_CHUNK, src)) > 0) {
+        if (sim_tape_ztap_write (z, buf, n) != n) {
+            r = SCPE_IOERR;
+            break;
+            }
+        total = total + n;
+        if (!sim_quiet)
+            sim_printf ("%s: Converted %dMB.\r", sim_uname (uptr), (int)(total / 1000000));
+        }
+    if (ferror (src))
+        r = SCPE_IOERR;
+    if (r == SCPE_OK)
+        r = sim_tape_ztap_close (z);
+    else {
+        z->readonly = TRUE;
+        sim_tape_ztap_close (z);
+        }
+    if (!sim_quiet) {
+        if (r == SCPE_OK)
+            sim_printf ("\n%s: Converted %dMB into %dMB. Done.\n", sim_uname (uptr), (int)(total / 1000000), (int)(sim_fsize_ex (dst) / 1000000));
+        else
+            sim_printf ("\n%s: Error converting: %s.\n", sim_uname (uptr), sim_error_text (r));
+        }
+    }
+if ((r == SCPE_OK) && verify) {
+    r = sim_tape_ztap_open (dst, TRUE, &z);
+    if (r == SCPE_OK) {
+        rewind (src);
+        total = 0;
+        do {
+            n = sim_fread (buf, 1, ZTAP_CHUNK, src);
+            if ((sim_tape_ztap_read (z, vbuf, ZTAP_CHUNK) != n) ||
+                (memcmp (buf, vbuf, n) != 0))
+                r = SCPE_IOERR;
+            else
+                total = total + n;
+            }
+        while ((n > 0) && (r == SCPE_OK));
+        sim_tape_ztap_close (z);
+        }
+    if (!sim_quiet) {
+        if (r == SCPE_OK)
+            sim_printf ("%s: Verified %dMB. Done.\n", sim_uname (uptr), (int)(total / 1000000));
+        else
+            sim_printf ("%s: Verification Error after %dMB.\n", sim_uname (uptr), (int)(total / 1000000));
+        }
+    }
+free (buf);
+free (vbuf);
+fclose (src);
+fclose (dst);
+if (r != SCPE_OK)
+    remove (dname);
+return r;
+}
+
+#else /* !defined (HAVE_ZLIB) */
+
+struct ztap_file {
+    t_addr              pos;
+    t_bool              eof;
+    t_bool              error;
+    };
+
+static size_t sim_tape_ztap_read (struct ztap_file *z, void *buf, size_t len)
+{
+return 0;
+}
+
+static size_t sim_tape_ztap_write (struct ztap_file *z, const void *buf, size_t len)
+{
+return 0;
+}
+
+static t_stat sim_tape_ztap_flush (struct ztap_file *z)
+{
+return SCPE_OK;
+}
+
+static t_stat sim_tape_ztap_close (struct ztap_file *z)
+{
+return SCPE_OK;
+}
+
+static t_stat sim_tape_ztap_open (FILE *file, t_bool readonly, struct ztap_file **zp)
+{
+*zp = NULL;
+return sim_messagef (SCPE_NOFNC, "ZTAP tape containers require zlib support\n");
+}
+
+static t_stat sim_tape_ztap_convert (UNIT *uptr, const char *dname, const char *sname, t_bool verify)
+{
+return sim_messagef (SCPE_NOFNC, "ZTAP tape containers require zlib support\n");
+}
+
+#endif
+
+/* Tape image I/O (internal routines)
+
+   These take the place of the stdio calls on the unit's file.  They let the
+   record handling of the SIMH format also serve ZTAP containers, and they
+   keep the traffic to the other formats' image files down to a few large
+   transfers.
+
+   A seek only sets the logical position; the file itself is repositioned
+   when data has to be transferred from somewhere other than where the last
+   transfer left it, or when switching between reading and writing.  Reads
+   are served from a buffer holding TAPE_IOBUF_SIZE bytes of the image.  The
+   buffer is refilled starting at the position read when the tape moves
+   forward, and ending just after it when the tape moves backward, so that
+   spacing and reading in either direction hit the buffer.  Writes go to the
+   file immediately and update any buffered copy of the data written.  The
+   buffer is discarded on rewind, after an I/O error and at detach.
+*/
+
+#define TAPE_IOBUF_SIZE (128 * 1024)                    /* read buffer size */
+#define TAPE_IO_NOPOS   ((t_addr)-1)                    /* file position unknown */
+#define TAPE_IO_READ    1                               /* last file transfer was a read */
+#define TAPE_IO_WRITE   2                               /*   or a write */
+
+static void sim_tape_io_invalidate (struct tape_context *ctx)
+{
+ctx->iobuf_len = 0;
+ctx->iobuf_eof = FALSE;
+ctx->file_pos = TAPE_IO_NOPOS;
+}
+
+/* Position the file for a transfer at pos */
+
+static t_bool sim_tape_io_position (UNIT *uptr, t_addr pos, int op)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if ((ctx->file_pos != pos) || (ctx->file_op != op)) {
+    if (sim_fseek (uptr->fileref, pos, SEEK_SET)) {
+        ctx->file_pos = TAPE_IO_NOPOS;
+        return FALSE;
+        }
+    ctx->file_pos = pos;
+    }
+ctx->file_op = op;
+return TRUE;
+}
+
+static size_t sim_tape_io_read (UNIT *uptr, uint8 *buf, size_t len)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+t_addr start, end;
+size_t n, done = 0;
+
+if (ctx->ztap)
+    return sim_tape_ztap_read (ctx->ztap, buf, len);
+if (ctx->iobuf == NULL)
+    ctx->iobuf = (uint8 *)malloc (TAPE_IOBUF_SIZE);
+while (len > 0) {
+    end = ctx->iobuf_pos + ctx->iobuf_len;
+    if ((ctx->io_pos >= ctx->iobuf_pos) && (ctx->io_pos < end)) {  /* buffered? */
+        n = (size_t)(end - ctx->io_pos);
+        if (n > len)
+            n = len;
+        memcpy (buf, ctx->iobuf + (ctx->io_pos - ctx->iobuf_pos), n);
+        }
+    else if ((ctx->io_pos == end) && ctx->iobuf_eof)    /* at the end of the image? */
+        n = 0;
+    else if ((ctx->iobuf == NULL) || (len >= TAPE_IOBUF_SIZE)) {    /* transfer directly */
+        if (!sim_tape_io_position (uptr, ctx->io_pos, TAPE_IO_READ))
+            break;
+        n = sim_fread (buf, 1, len, uptr->fileref);
+        ctx->file_pos = ctx->file_pos + n;
+        }
+    else {                                              /* refill the buffer */
+        start = ctx->io_pos;
+        if ((ctx->iobuf_len > 0) && (ctx->io_pos < ctx->iobuf_pos)) {   /* moving backward? */
+            end = ctx->io_pos + len;
+            start = (end > TAPE_IOBUF_SIZE) ? end - TAPE_IOBUF_SIZE : 0;
+            }
+        ctx->iobuf_len = 0;
+        if (!sim_tape_io_position (uptr, start, TAPE_IO_READ))
+            break;
+        ctx->iobuf_pos = start;
+        ctx->iobuf_len = (uint32)sim_fread (ctx->iobuf, 1, TAPE_IOBUF_SIZE, uptr->fileref);
+        ctx->iobuf_eof = (ctx->iobuf_len < TAPE_IOBUF_SIZE) && !ferror (uptr->fileref);
+        ctx->file_pos = ctx->file_pos + ctx->iobuf_len;
+        if ((ctx->io_pos < start + ctx->iobuf_len) || ctx->iobuf_eof)
+            continue;
+        n = 0;
+        }
+    if (n == 0) {
+        if (!ferror (uptr->fileref))
+            ctx->io_eof = TRUE;
+        break;
+        }
+    buf = buf + n;
+    ctx->io_pos = ctx->io_pos + n;
+    done = done + n;
+    len = len - n;
+    }
+return done;
+}
+
+static size_t sim_tape_io_write (UNIT *uptr, const uint8 *buf, size_t len)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+t_addr lo, hi;
+size_t n;
+
+if (ctx->ztap)
+    return sim_tape_ztap_write (ctx->ztap, buf, len);
+if (!sim_tape_io_position (uptr, ctx->io_pos, TAPE_IO_WRITE))
+    return 0;
+n = sim_fwrite (buf, 1, len, uptr->fileref);
+ctx->file_pos = ctx->file_pos + n;
+lo = (ctx->io_pos > ctx->iobuf_pos) ? ctx->io_pos : ctx->iobuf_pos;
+hi = ctx->iobuf_pos + ctx->iobuf_len;
+if (ctx->io_pos + n < hi)
+    hi = ctx->io_pos + n;
+if (lo < hi)                                            /* update the buffered data */
+    memcpy (ctx->iobuf + (lo - ctx->iobuf_pos), buf + (lo - ctx->io_pos), (size_t)(hi - lo));
+if (ctx->io_pos + n > ctx->iobuf_pos + ctx->iobuf_len)  /* image may have grown */
+    ctx->iobuf_eof = FALSE;
+ctx->io_pos = ctx->io_pos + n;
+return n;
+}
+
+static void sim_tape_fseek (UNIT *uptr, t_addr pos)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if (ctx->ztap) {
+    ctx->ztap->pos = pos;
+    ctx->ztap->eof = FALSE;
+    }
+ctx->io_pos = pos;
+ctx->io_eof = FALSE;
+}
+
+static size_t sim_tape_fread (void *buf, size_t size, size_t count, UNIT *uptr)
+{
+size_t n = sim_tape_io_read (uptr, (uint8 *)buf, size * count) / size;
+
+if ((size > 1) && !sim_end)
+    sim_buf_swap_data (buf, size, n);
+return n;
+}
+
+static size_t sim_tape_fwrite (const void *buf, size_t size, size_t count, UNIT *uptr)
+{
+uint8 sbuf[sizeof (t_mtrlnt)];
+
+if ((size > 1) && !sim_end) {                           /* metadata on a big endian host? */
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        sim_buf_copy_swapped (sbuf, (const uint8 *)buf + i * size, size, 1);
+        if (sim_tape_io_write (uptr, sbuf, size) != size)
+            break;
+        }
+    return i;
+    }
+return sim_tape_io_write (uptr, (const uint8 *)buf, size * count) / size;
+}
+
+static int sim_tape_feof (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+return ctx->ztap ? ctx->ztap->eof : ctx->io_eof;
+}
+
+static int sim_tape_ferror (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+return ctx->ztap ? ctx->ztap->error : ferror (uptr->fileref);
+}
+
+/* Tape object index (internal routines)
+
+   Spacing over a SIMH or E11 format tape image reads each record's length
+   word and seeks past the record, one record at a time, so positioning to a
+   file far down a large tape takes a long time.  Instead, the position and
+   length word of each record and tape mark is recorded as the objects are
+   first read or written, forming an index which describes the tape from the
+   BOT up to the furthest point examined.  Within that part of the tape,
+   reading a record length in either direction is a lookup, and spacing over
+   records or files is a binary search for the next tape mark.
+
+   Only objects with no erase gap in front of them are recorded, so the index
+   never has to reproduce the tape runaway behavior of "sim_tape_rdlntf" and
+   "sim_tape_rdlntr"; it stops growing at the first gap.  A write discards
+   the entries for everything at or beyond the position written.
+*/
+
+static t_bool sim_tape_idx_fmt (UNIT *uptr)
+{
+uint32 f = MT_GET_FMT (uptr);
+
+return (f == MTUF_F_STD) || (f == MTUF_F_E11) || (f == MTUF_F_ZTP);
+}
+
+static t_addr sim_tape_idx_end (struct tape_context *ctx)
+{
+return ctx->idx_count ? ctx->idx[ctx->idx_count - 1].next : 0;
+}
+
+/* Entry for the object starting at pos, or -1 if none */
+
+static int32 sim_tape_idx_find (struct tape_context *ctx, t_addr pos)
+{
+uint32 lo = 0, hi = ctx->idx_count, p;
+
+while (lo < hi) {
+    p = (lo + hi) >> 1;
+    if (ctx->idx[p].pos == pos)
+        return (int32)p;
+    if (ctx->idx[p].pos < pos)
+        lo = p + 1;
+    else
+        hi = p;
+    }
+return -1;
+}
+
+/* Entry for the object which ends at pos, or -1 if none */
+
+static int32 sim_tape_idx_prev (struct tape_context *ctx, t_addr pos)
+{
+int32 i;
+
+if ((ctx->idx_count == 0) || (pos == 0))
+    return -1;
+if (pos == sim_tape_idx_end (ctx))
+    return (int32)ctx->idx_count - 1;
+i = sim_tape_idx_find (ctx, pos);
+return (i > 0) ? i - 1 : -1;
+}
+
+/* Index of the first tape mark at or after entry i (idx_tmk_count if none) */
+
+static uint32 sim_tape_idx_tmk (struct tape_context *ctx, uint32 i)
+{
+uint32 lo = 0, hi = ctx->idx_tmk_count, p;
+
+while (lo < hi) {
+    p = (lo + hi) >> 1;
+    if (ctx->idx_tmk[p] < i)
+        lo = p + 1;
+    else
+        hi = p;
+    }
+return lo;
+}
+
+/* Record an object found or written at the end of the known part of the tape */
+
+static void sim_tape_idx_add (UNIT *uptr, t_addr pos, t_addr next, t_mtrlnt bc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if (!sim_tape_idx_fmt (uptr) || (pos != sim_tape_idx_end (ctx)))
+    return;
+if (ctx->idx_count == ctx->idx_size) {
+    uint32 size = ctx->idx_size ? 2 * ctx->idx_size : 1024;
+    struct tape_object *idx = (struct tape_object *)realloc (ctx->idx, size * sizeof (*idx));
+
+    if (idx == NULL)
+        return;
+    ctx->idx = idx;
+    ctx->idx_size = size;
+    }
+if (bc == MTR_TMK) {
+    if (ctx->idx_tmk_count == ctx->idx_tmk_size) {
+        uint32 size = ctx->idx_tmk_size ? 2 * ctx->idx_tmk_size : 64;
+        uint32 *tmk = (uint32 *)realloc (ctx->idx_tmk, size * sizeof (*tmk));
+
+        if (tmk == NULL)
+            return;
+        ctx->idx_tmk = tmk;
+        ctx->idx_tmk_size = size;
+        }
+    ctx->idx_tmk[ctx->idx_tmk_count++] = ctx->idx_count;
+    }
+ctx->idx[ctx->idx_count].pos = pos;
+ctx->idx[ctx->idx_count].next = next;
+ctx->idx[ctx->idx_count].bc = bc;
+++ctx->idx_count;
+}
+
+/* Forget the objects which extend to or beyond a position being written */
+
+static void sim_tape_idx_trunc (UNIT *uptr, t_addr pos)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+while ((ctx->idx_count > 0) && (ctx->idx[ctx->idx_count - 1].next > pos))
+    --ctx->idx_count;
+ctx->idx_tmk_count = sim_tape_idx_tmk (ctx, ctx->idx_count);
+}
+
+/* Space forward over up to count data records described by the index
+
+   Stops in front of a tape mark or at the end of the known part of the tape
+   and returns the number of records spaced over.
+*/
+
+static uint32 sim_tape_idx_spacef (UNIT *uptr, uint32 count)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+int32 i = sim_tape_idx_find (ctx, uptr->pos);
+uint32 t, avail;
+
+if ((i < 0) || (count == 0))
+    return 0;
+t = sim_tape_idx_tmk (ctx, (uint32)i);
+avail = ((t < ctx->idx_tmk_count) ? ctx->idx_tmk[t] : ctx->idx_count) - (uint32)i;
+if (avail > count)
+    avail = count;
+if (avail) {
+    MT_CLR_PNU (uptr);
+    uptr->pos = ctx->idx[i + avail - 1].next;
+    sim_debug (MTSE_DBG_STR, ctx->dptr, "idx_space: fwd %u records, pos: %" T_ADDR_FMT "u\n", avail, uptr->pos);
+    }
+return avail;
+}
+
+/* Space reverse over up to count data records described by the index */
+
+static uint32 sim_tape_idx_spacer (UNIT *uptr, uint32 count)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+int32 i = sim_tape_idx_prev (ctx, uptr->pos);
+uint32 t, first, avail;
+
+if ((i < 0) || (count == 0))
+    return 0;
+t = sim_tape_idx_tmk (ctx, (uint32)i + 1);              /* first tape mark beyond entry i */
+first = (t > 0) ? ctx->idx_tmk[t - 1] + 1 : 0;          /* first record after the preceding mark */
+avail = (uint32)i + 1 - first;
+if (avail > count)
+    avail = count;
+if (avail) {
+    MT_CLR_PNU (uptr);
+    uptr->pos = ctx->idx[i + 1 - avail].pos;
+    sim_debug (MTSE_DBG_STR, ctx->dptr, "idx_space: rev %u records, pos: %" T_ADDR_FMT "u\n", avail, uptr->pos);
+    }
+return avail;
+}
+
 /* Read record length forward (internal routine)
 
    Inputs:
@@ -697,6 +1698,8 @@ t_tpclnt tpcbc;
 t_mtrlnt buffer [256];                                  /* local tape buffer */
 uint32 bufcntr, bufcap;                                 /* buffer counter and capacity */
 int32 runaway_counter, sizeof_gap;                      /* bytes remaining before runaway and bytes per gap */
+t_addr spos = uptr->pos;                                /* starting position */
+int32 i;
 t_stat r = MTSE_OK;
 
 MT_CLR_PNU (uptr);                                      /* clear the position-not-updated flag */
@@ -706,12 +1709,25 @@ if ((uptr->flags & UNIT_ATT) == 0)                      /* if the unit is not at
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 
-sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set the initial tape position */
+if (sim_tape_idx_fmt (uptr) &&                          /* if the object here is already known */
+    ((i = sim_tape_idx_find (ctx, spos)) >= 0)) {
+    *bc = ctx->idx[i].bc;                               /*   then take it from the index */
+    uptr->pos = ctx->idx[i].next;
+    if (*bc == MTR_TMK)
+        r = MTSE_TMK;
+    else
+        sim_tape_fseek (uptr, spos + sizeof (t_mtrlnt));
+    sim_debug (MTSE_DBG_STR, ctx->dptr, "rd_lnt: st: %d, lnt: %d, pos: %" T_ADDR_FMT "u\n", r, *bc, uptr->pos);
+    return r;
+    }
+
+sim_tape_fseek (uptr, uptr->pos);                       /* set the initial tape position */
 
 switch (f) {                                            /* the read method depends on the tape format */
 
     case MTUF_F_STD:
     case MTUF_F_E11:
+    case MTUF_F_ZTP:
         runaway_counter = 25 * 12 * bpi [MT_DENS (uptr->dynflags)]; /* set the largest legal gap size in bytes */
 
         if (runaway_counter == 0) {                     /* if tape density has not been not set */
@@ -726,7 +1742,7 @@ switch (f) {                                            /* the read method depen
 
         do {                                            /* loop until a record, gap, or error is seen */
             if (bufcntr == bufcap) {                    /* if the buffer is empty then refill it */
-                if (feof (uptr->fileref)) {             /* if we hit the EOF while reading a gap */
+                if (sim_tape_feof (uptr)) {             /* if we hit the EOF while reading a gap */
                     if (sizeof_gap > 0)                 /*   then if detection is enabled */
                         r = MTSE_RUNAWAY;               /*     then report a tape runaway */
                     else                                /*   otherwise report the physical EOF */
@@ -741,12 +1757,12 @@ switch (f) {                                            /* the read method depen
                     bufcap = sizeof (buffer)            /*   to the full size of the buffer */
                                / sizeof (buffer [0]);
 
-                bufcap = sim_fread (buffer,             /* fill the buffer */
-                                    sizeof (t_mtrlnt),  /*   with tape metadata */
-                                    bufcap,
-                                    uptr->fileref);
+                bufcap = sim_tape_fread (buffer,        /* fill the buffer */
+                                         sizeof (t_mtrlnt), /*   with tape metadata */
+                                         bufcap,
+                                         uptr);
 
-                if (ferror (uptr->fileref)) {           /* if a file I/O error occurred */
+                if (sim_tape_ferror (uptr)) {           /* if a file I/O error occurred */
                     if (bufcntr == 0)                   /*   then if this is the initial read */
                         MT_SET_PNU (uptr);              /*     then set position not updated */
 
@@ -796,7 +1812,7 @@ switch (f) {                                            /* the read method depen
 
             else if (*bc == MTR_FHGAP) {                        /* otherwise if the value if a half gap */
                 uptr->pos = uptr->pos - sizeof (t_mtrlnt) / 2;  /*   then back up */
-                sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /*     to resync */
+                sim_tape_fseek (uptr, uptr->pos);               /*     to resync */
                 bufcntr = bufcap;                               /* mark the buffer as invalid to force a read */
 
                 *bc = MTR_GAP;                                  /* reset the marker */
@@ -805,11 +1821,11 @@ switch (f) {                                            /* the read method depen
 
             else {                                                  /* otherwise it's a record marker */
                 if (bufcntr < bufcap)                               /* if the position is within the buffer */
-                    sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /*   then seek to the data area */
+                    sim_tape_fseek (uptr, uptr->pos);               /*   then seek to the data area */
 
                 sbc = MTR_L (*bc);                                  /* extract the record length */
                 uptr->pos = uptr->pos + sizeof (t_mtrlnt)           /* position to the start */
-                  + (f == MTUF_F_STD ? (sbc + 1) & ~1 : sbc);       /*   of the record */
+                  + (f == MTUF_F_E11 ? sbc : (sbc + 1) & ~1);       /*   of the record */
                 }
             }
         while (*bc == MTR_GAP && runaway_counter > 0);  /* continue until data or runaway occurs */
@@ -817,16 +1833,22 @@ switch (f) {                                            /* the read method depen
         if (r == MTSE_OK && runaway_counter <= 0)       /* if a tape runaway occurred */
             r = MTSE_RUNAWAY;                           /*   then report it */
 
+        if ((r == MTSE_TMK) && (uptr->pos == spos + sizeof (t_mtrlnt)))
+            sim_tape_idx_add (uptr, spos, uptr->pos, *bc);  /* no gap preceded the object? */
+        else if ((r == MTSE_OK) &&
+                 (uptr->pos == spos + 2 * sizeof (t_mtrlnt) + (f == MTUF_F_E11 ? MTR_L (*bc) : (MTR_L (*bc) + 1) & ~1)))
+            sim_tape_idx_add (uptr, spos, uptr->pos, *bc);
+
         break;                                          /* otherwise the operation succeeded */
 
     case MTUF_F_TPC:
-        sim_fread (&tpcbc, sizeof (t_tpclnt), 1, uptr->fileref);
+        sim_tape_fread (&tpcbc, sizeof (t_tpclnt), 1, uptr);
         *bc = tpcbc;                                    /* save rec lnt */
-        if (ferror (uptr->fileref)) {                   /* error? */
+        if (sim_tape_ferror (uptr)) {                   /* error? */
             MT_SET_PNU (uptr);                          /* pos not upd */
             return sim_tape_ioerr (uptr);
             }
-        if (feof (uptr->fileref)) {                     /* eof? */
+        if (sim_tape_feof (uptr)) {                     /* eof? */
             MT_SET_PNU (uptr);                          /* pos not upd */
             r = MTSE_EOM;
             break;
@@ -839,12 +1861,12 @@ switch (f) {                                            /* the read method depen
 
     case MTUF_F_P7B:
         for (sbc = 0, all_eof = 1; ; sbc++) {           /* loop thru record */
-            sim_fread (&c, sizeof (uint8), 1, uptr->fileref);
-            if (ferror (uptr->fileref)) {               /* error? */
+            sim_tape_fread (&c, sizeof (uint8), 1, uptr);
+            if (sim_tape_ferror (uptr)) {               /* error? */
                 MT_SET_PNU (uptr);                      /* pos not upd */
                 return sim_tape_ioerr (uptr);
                 }
-            if (feof (uptr->fileref)) {                 /* eof? */
+            if (sim_tape_feof (uptr)) {                 /* eof? */
                 if (sbc == 0)                           /* no data? eom */
                     return MTSE_EOM;
                 break;                                  /* treat like eor */
@@ -855,7 +1877,7 @@ switch (f) {                                            /* the read method depen
                 all_eof = 0;
             }
         *bc = sbc;                                      /* save rec lnt */
-        sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /* for read */
+        sim_tape_fseek (uptr, uptr->pos);               /* for read */
         uptr->pos = uptr->pos + sbc;                    /* spc over record */
         if (all_eof)                                    /* tape mark? */
             r = MTSE_TMK;
@@ -921,10 +1943,26 @@ if (ctx == NULL)                                        /* if not properly attac
 if (sim_tape_bot (uptr))                                /* if the unit is positioned at the BOT */
     return MTSE_BOT;                                    /*   then reading backward is not possible */
 
+if (sim_tape_idx_fmt (uptr)) {                          /* if the preceding object is already known */
+    int32 i = sim_tape_idx_prev (ctx, uptr->pos);
+
+    if (i >= 0) {                                       /*   then take it from the index */
+        *bc = ctx->idx[i].bc;
+        uptr->pos = ctx->idx[i].pos;
+        if (*bc == MTR_TMK)
+            r = MTSE_TMK;
+        else
+            sim_tape_fseek (uptr, uptr->pos + sizeof (t_mtrlnt));
+        sim_debug (MTSE_DBG_STR, ctx->dptr, "rd_lnt: st: %d, lnt: %d, pos: %" T_ADDR_FMT "u\n", r, *bc, uptr->pos);
+        return r;
+        }
+    }
+
 switch (f) {                                            /* the read method depends on the tape format */
 
     case MTUF_F_STD:
     case MTUF_F_E11:
+    case MTUF_F_ZTP:
         runaway_counter = 25 * 12 * bpi [MT_DENS (uptr->dynflags)]; /* set largest legal gap size in bytes */
 
         if (runaway_counter == 0) {                     /* if tape density has not been not set */
@@ -949,14 +1987,15 @@ switch (f) {                                            /* the read method depen
                     bufcap = (uint32) uptr->pos         /*   then reduce the capacity accordingly */
                                / sizeof (t_mtrlnt);
 
-                sim_fseek (uptr->fileref,                           /* seek back to the location */
-                           uptr->pos - bufcap * sizeof (t_mtrlnt),  /*   corresponding to the start */
-                           SEEK_SET);                               /*     of the buffer */
+                sim_tape_fseek (uptr,                               /* seek back to the location */
+                                uptr->pos                           /*   corresponding to the start */
+                                  - bufcap * sizeof (t_mtrlnt));    /*     of the buffer */
 
-                bufcntr = sim_fread (buffer, sizeof (t_mtrlnt),     /* fill the buffer */
-                                     bufcap, uptr->fileref);        /*   with tape metadata */
+                bufcntr = sim_tape_fread (buffer,                   /* fill the buffer */
+                                          sizeof (t_mtrlnt),        /*   with tape metadata */
+                                          bufcap, uptr);
 
-                if (ferror (uptr->fileref)) {           /* if a file I/O error occurred */
+                if (sim_tape_ferror (uptr)) {           /* if a file I/O error occurred */
                     MT_SET_PNU (uptr);                  /*   then set position not updated */
                     r = sim_tape_ioerr (uptr);          /*     report the error and quit */
                     break;
@@ -991,9 +2030,9 @@ switch (f) {                                            /* the read method depen
             else {                                              /* otherwise it's a record marker */
                 sbc = MTR_L (*bc);                              /* extract the record length */
                 uptr->pos = uptr->pos - sizeof (t_mtrlnt)       /* position to the start */
-                  - (f == MTUF_F_STD ? (sbc + 1) & ~1 : sbc);   /*   of the record */
-                sim_fseek (uptr->fileref,                       /* seek to the data area */
-                           uptr->pos + sizeof (t_mtrlnt), SEEK_SET);
+                  - (f == MTUF_F_E11 ? sbc : (sbc + 1) & ~1);   /*   of the record */
+                sim_tape_fseek (uptr,                           /* seek to the data area */
+                                uptr->pos + sizeof (t_mtrlnt));
                 }
             }
         while (*bc == MTR_GAP && runaway_counter > 0);  /* continue until data or runaway occurs */
@@ -1005,12 +2044,12 @@ switch (f) {                                            /* the read method depen
 
     case MTUF_F_TPC:
         ppos = sim_tape_tpc_fnd (uptr, (t_addr *) uptr->filebuf); /* find prev rec */
-        sim_fseek (uptr->fileref, ppos, SEEK_SET);      /* position */
-        sim_fread (&tpcbc, sizeof (t_tpclnt), 1, uptr->fileref);
+        sim_tape_fseek (uptr, ppos);                    /* position */
+        sim_tape_fread (&tpcbc, sizeof (t_tpclnt), 1, uptr);
         *bc = tpcbc;                                    /* save rec lnt */
-        if (ferror (uptr->fileref))                     /* error? */
+        if (sim_tape_ferror (uptr))                     /* error? */
             return sim_tape_ioerr (uptr);
-        if (feof (uptr->fileref)) {                     /* eof? */
+        if (sim_tape_feof (uptr)) {                     /* eof? */
             r = MTSE_EOM;
             break;
             }
@@ -1019,16 +2058,16 @@ switch (f) {                                            /* the read method depen
             r = MTSE_TMK;
             break;
             }
-        sim_fseek (uptr->fileref, uptr->pos + sizeof (t_tpclnt), SEEK_SET);
+        sim_tape_fseek (uptr, uptr->pos + sizeof (t_tpclnt));
         break;
 
     case MTUF_F_P7B:
         for (sbc = 1, all_eof = 1; (t_addr) sbc <= uptr->pos ; sbc++) {
-            sim_fseek (uptr->fileref, uptr->pos - sbc, SEEK_SET);
-            sim_fread (&c, sizeof (uint8), 1, uptr->fileref);
-            if (ferror (uptr->fileref))                 /* error? */
+            sim_tape_fseek (uptr, uptr->pos - sbc);
+            sim_tape_fread (&c, sizeof (uint8), 1, uptr);
+            if (sim_tape_ferror (uptr))                 /* error? */
                 return sim_tape_ioerr (uptr);
-            if (feof (uptr->fileref)) {                 /* eof? */
+            if (sim_tape_feof (uptr)) {                 /* eof? */
                 r = MTSE_EOM;
                 break;
                 }
@@ -1039,7 +2078,7 @@ switch (f) {                                            /* the read method depen
             }
         uptr->pos = uptr->pos - sbc;                    /* update position */
         *bc = sbc;                                      /* save rec lnt */
-        sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /* for read */
+        sim_tape_fseek (uptr, uptr->pos);               /* for read */
         if (all_eof)                                    /* tape mark? */
             r = MTSE_TMK;
         break;
@@ -1093,8 +2132,8 @@ if (rbc > max) {                                        /* rec out of range? */
     uptr->pos = opos;
     return MTSE_INVRL;
     }
-i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
-if (ferror (uptr->fileref)) {                           /* error? */
+i = (t_mtrlnt)sim_tape_fread (buf, sizeof (uint8), rbc, uptr);    /* read record */
+if (sim_tape_ferror (uptr)) {                           /* error? */
     MT_SET_PNU (uptr);
     uptr->pos = opos;
     return sim_tape_ioerr (uptr);
@@ -1155,8 +2194,8 @@ if (MTSE_OK != (st = sim_tape_rdlntr (uptr, &tbc)))     /* read rec lnt */
 *bc = rbc = MTR_L (tbc);                                /* strip error flag */
 if (rbc > max)                                          /* rec out of range? */
     return MTSE_INVRL;
-i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
-if (ferror (uptr->fileref))                             /* error? */
+i = (t_mtrlnt)sim_tape_fread (buf, sizeof (uint8), rbc, uptr);    /* read record */
+if (sim_tape_ferror (uptr))                             /* error? */
     return sim_tape_ioerr (uptr);
 for ( ; i < rbc; i++)                                   /* fill with 0's */
     buf[i] = 0;
@@ -1197,6 +2236,7 @@ t_stat sim_tape_wrrecf (UNIT *uptr, uint8 *buf, t_mtrlnt bc)
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint32 f = MT_GET_FMT (uptr);
 t_mtrlnt sbc;
+t_addr opos;
 
 if (ctx == NULL)                                        /* if not properly attached? */
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
@@ -1211,27 +2251,42 @@ if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
 if (sbc == 0)                                           /* nothing to do? */
     return MTSE_OK;
-sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set pos */
+opos = uptr->pos;
+sim_tape_idx_trunc (uptr, opos);                        /* later objects are overwritten */
+sim_tape_fseek (uptr, uptr->pos);                       /* set pos */
 switch (f) {                                            /* case on format */
 
     case MTUF_F_STD:                                    /* standard */
+    case MTUF_F_ZTP:                                    /* compressed */
         sbc = MTR_L ((bc + 1) & ~1);                    /* pad odd length */
     case MTUF_F_E11:                                    /* E11 */
-        sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
-        sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        if (ferror (uptr->fileref)) {                   /* error? */
+        if (ctx->wrbuf_size < sbc + 2 * sizeof (t_mtrlnt)) {    /* assemble the record */
+            uint8 *wrbuf = (uint8 *)realloc (ctx->wrbuf, sbc + 2 * sizeof (t_mtrlnt));
+
+            if (wrbuf == NULL) {
+                MT_SET_PNU (uptr);
+                return MTSE_IOERR;
+                }
+            ctx->wrbuf = wrbuf;
+            ctx->wrbuf_size = sbc + 2 * sizeof (t_mtrlnt);
+            }
+        sim_buf_copy_swapped (ctx->wrbuf, &bc, sizeof (t_mtrlnt), 1);
+        memcpy (ctx->wrbuf + sizeof (t_mtrlnt), buf, sbc);
+        memcpy (ctx->wrbuf + sizeof (t_mtrlnt) + sbc, ctx->wrbuf, sizeof (t_mtrlnt));
+        sim_tape_fwrite (ctx->wrbuf, sizeof (uint8), sbc + 2 * sizeof (t_mtrlnt), uptr);
+        if (sim_tape_ferror (uptr)) {                   /* error? */
             MT_SET_PNU (uptr);
             return sim_tape_ioerr (uptr);
             }
         uptr->pos = uptr->pos + sbc + (2 * sizeof (t_mtrlnt));  /* move tape */
+        sim_tape_idx_add (uptr, opos, uptr->pos, bc);
         break;
 
     case MTUF_F_P7B:                                    /* Pierce 7B */
         buf[0] = buf[0] | P7B_SOR;                      /* mark start of rec */
-        sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
-        sim_fwrite (buf, sizeof (uint8), 1, uptr->fileref); /* delimit rec */
-        if (ferror (uptr->fileref)) {                   /* error? */
+        sim_tape_fwrite (buf, sizeof (uint8), sbc, uptr);
+        sim_tape_fwrite (buf, sizeof (uint8), 1, uptr);     /* delimit rec */
+        if (sim_tape_ferror (uptr)) {                   /* error? */
             MT_SET_PNU (uptr);
             return sim_tape_ioerr (uptr);
             }
@@ -1264,13 +2319,16 @@ if (ctx == NULL)                                        /* if not properly attac
     return sim_messagef (SCPE_IERR, "Bad Attach\n");    /*   that's a problem */
 if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
-sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set pos */
-sim_fwrite (&dat, sizeof (t_mtrlnt), 1, uptr->fileref);
-if (ferror (uptr->fileref)) {                           /* error? */
+sim_tape_idx_trunc (uptr, uptr->pos);                   /* later objects are overwritten */
+sim_tape_fseek (uptr, uptr->pos);                       /* set pos */
+sim_tape_fwrite (&dat, sizeof (t_mtrlnt), 1, uptr);
+if (sim_tape_ferror (uptr)) {                           /* error? */
     MT_SET_PNU (uptr);
     return sim_tape_ioerr (uptr);
     }
 sim_debug (MTSE_DBG_STR, ctx->dptr, "wr_lnt: lnt: %d, pos: %" T_ADDR_FMT "u\n", dat, uptr->pos);
+if (dat == MTR_TMK)
+    sim_tape_idx_add (uptr, uptr->pos, uptr->pos + sizeof (t_mtrlnt), dat);
 uptr->pos = uptr->pos + sizeof (t_mtrlnt);              /* move tape */
 return MTSE_OK;
 }
@@ -1493,7 +2551,8 @@ else                                                    /* otherwise */
     gap_needed = (gaplen * tape_density) / 10;          /*   determine the gap size needed in bytes */
 
 file_size = sim_fsize (uptr->fileref);                  /* get file size */
-sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* position tape */
+sim_tape_idx_trunc (uptr, gap_pos);                     /* later objects are erased */
+sim_tape_fseek (uptr, uptr->pos);                       /* position tape */
 
 /* Read tape records and allocate to gap until amount required is consumed.
 
@@ -1507,9 +2566,9 @@ sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* position tape */
 */
 
 do {
-    sim_fread (&meta, meta_size, 1, uptr->fileref);     /* read metadatum */
+    sim_tape_fread (&meta, meta_size, 1, uptr);         /* read metadatum */
 
-    if (ferror (uptr->fileref)) {                       /* read error? */
+    if (sim_tape_ferror (uptr)) {                       /* read error? */
         uptr->pos = gap_pos;                            /* restore original position */
         MT_SET_PNU (uptr);                              /* position not updated */
         return sim_tape_ioerr (uptr);                   /* translate error */
@@ -1517,7 +2576,7 @@ do {
     else
         uptr->pos = uptr->pos + meta_size;              /* move tape over datum */
 
-    if (feof (uptr->fileref) || (meta == MTR_EOM)) {    /* at eof or eom? */
+    if (sim_tape_feof (uptr) || (meta == MTR_EOM)) {    /* at eof or eom? */
         gap_alloc = gap_alloc + gap_needed;             /* allocate remainder */
         gap_needed = 0;
         }
@@ -1529,7 +2588,7 @@ do {
 
     else if (meta == MTR_FHGAP) {                       /* half gap? */
         uptr->pos = uptr->pos - meta_size / 2;          /* backup to resync */
-        sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /* position tape */
+        sim_tape_fseek (uptr, uptr->pos);               /* position tape */
         gap_alloc = gap_alloc + meta_size / 2;          /* allocate marker space */
         gap_needed = gap_needed - meta_size / 2;        /* reduce requirement */
         }
@@ -1552,7 +2611,7 @@ do {
 
         if (rec_size < gap_needed + min_rec_size) {         /* rec too small? */
             uptr->pos = uptr->pos - meta_size + rec_size;   /* position past record */
-            sim_fseek (uptr->fileref, uptr->pos, SEEK_SET); /* move tape */
+            sim_tape_fseek (uptr, uptr->pos);               /* move tape */
             gap_alloc = gap_alloc + rec_size;               /* allocate record */
             gap_needed = gap_needed - rec_size;             /* reduce requirement */
             }
@@ -1689,6 +2748,9 @@ sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecsf(unit=%d, count=%d)\n", (int)(
 
 *skipped = 0;
 while (*skipped < count) {                              /* loopo */
+    *skipped += sim_tape_idx_spacef (uptr, count - *skipped);/* known recs */
+    if (*skipped == count)
+        break;
     st = sim_tape_sprecf (uptr, &tbc);                  /* spc rec */
     if (st != MTSE_OK)
         return st;
@@ -1785,6 +2847,11 @@ sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecsr(unit=%d, count=%d)\n", (int)(
 
 *skipped = 0;
 while (*skipped < count) {                              /* loopo */
+    if (!MT_TST_PNU (uptr)) {
+        *skipped += sim_tape_idx_spacer (uptr, count - *skipped);/* known recs */
+        if (*skipped == count)
+            break;
+        }
     st = sim_tape_sprecr (uptr, &tbc);                  /* spc rec rev */
     if (st != MTSE_OK)
         return st;
@@ -2024,6 +3091,7 @@ if (uptr->flags & UNIT_ATT) {
     if (ctx == NULL)                                    /* if not properly attached? */
         return sim_messagef (SCPE_IERR, "Bad Attach\n");/*   that's a problem */
     sim_debug (ctx->dbit, ctx->dptr, "sim_tape_rewind(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+    sim_tape_io_invalidate (ctx);
     }
 uptr->pos = 0;
 MT_CLR_PNU (uptr);
@@ -2145,12 +3213,30 @@ t_bool sim_tape_wrp (UNIT *uptr)
 return ((uptr->flags & MTUF_WRP) || (MT_GET_FMT (uptr) == MTUF_F_TPC))? TRUE: FALSE;
 }
 
+/* Note that the caller moved the file position with its own stdio calls,
+   so the next transfer must seek instead of trusting the cached position */
+
+void sim_tape_file_moved (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+if (ctx)
+    ctx->file_pos = TAPE_IO_NOPOS;
+}
+
 /* Process I/O error */
 
 static t_stat sim_tape_ioerr (UNIT *uptr)
 {
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
 sim_printf ("%s: Magtape library I/O error: %s\n", sim_uname (uptr), strerror (errno));
 clearerr (uptr->fileref);
+if (ctx) {
+    sim_tape_io_invalidate (ctx);
+    if (ctx->ztap)
+        ctx->ztap->error = FALSE;
+    }
 return MTSE_IOERR;
 }
 
@@ -81,6 +81,7 @@ typedef uint16          t_tpclnt;                       /* magtape rec lnt */
 #define MTUF_F_TPC       2                              /* TPC format */
 #define MTUF_F_P7B       3                              /* P7B format */
 #define MUTF_F_TDF       4                              /* TDF format */
+#define MTUF_F_ZTP       5                              /* ZTAP compressed format */
 #define MTUF_V_UF       (MTUF_V_FMT + MTUF_W_FMT)
 #define MTUF_PNU        (1u << MTUF_V_PNU)
 #define MTUF_WLK        (1u << MTUF_V_WLK)
@@ -92,6 +93,7 @@ typedef uint16          t_tpclnt;                       /* magtape rec lnt */
 #define MT_F_TPC        (MTUF_F_TPC << MTUF_V_FMT)
 #define MT_F_P7B        (MTUF_F_P7B << MTUF_V_FMT)
 #define MT_F_TDF        (MTUF_F_TDF << MTUF_V_FMT)
+#define MT_F_ZTP        (MTUF_F_ZTP << MTUF_V_FMT)
 
 #define MT_SET_PNU(u)   (u)->flags = (u)->flags | MTUF_PNU
 #define MT_CLR_PNU(u)   (u)->flags = (u)->flags & ~MTUF_PNU
@@ -194,6 +196,7 @@ t_stat sim_tape_reset (UNIT *uptr);
 t_bool sim_tape_bot (UNIT *uptr);
 t_bool sim_tape_wrp (UNIT *uptr);
 t_bool sim_tape_eot (UNIT *uptr);
+void sim_tape_file_moved (UNIT *uptr);
 t_stat sim_tape_set_fmt (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
 t_stat sim_tape_show_fmt (FILE *st, UNIT *uptr, int32 val, CONST void *desc);
 t_stat sim_tape_set_capac (UNIT *uptr, int32 val, CONST char *cptr, void *desc);
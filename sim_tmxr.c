@@ -462,6 +462,12 @@ lp->tsta = 0;                                           /* init telnet state */
 lp->xmte = 1;                                           /* enable transmit */
 lp->dstb = 0;                                           /* default bin mode */
 lp->rxbpr = lp->rxbpi = lp->rxcnt = lp->rxpcnt = 0;     /* init receive indexes */
+lp->rxdgcnt = lp->rxdgidx = 0;                          /* discard pooled datagrams */
+lp->rxdgcalls = lp->rxdgpkts = 0;
+free (lp->rxdgb);
+lp->rxdgb = NULL;
+free (lp->rxdglen);
+lp->rxdglen = NULL;
 if (!lp->txbfd || lp->notelnet)                         /* if not buffered telnet */
     lp->txbpr = lp->txbpi = lp->txcnt = lp->txpcnt = 0; /*   init transmit indexes */
 lp->txdrp = 0;
@@ -656,6 +662,44 @@ if (lp->datagram) {
 return loop_read_ex (lp, buf, bufsize);
 }
 
+/* Read a datagram from a UDP line.
+
+   Pending datagrams are received a batch at a time into the line's datagram
+   pool and then returned one per call, so a busy link costs one system call
+   per batch rather than one per datagram.  Returns the datagram length (cut
+   to "length" characters), 0 if none are available, or -1 on error.
+*/
+
+static int32 tmxr_read_datagram (TMLN *lp, char *buf, int32 length)
+{
+int32 count, len;
+
+if (lp->rxdgidx >= lp->rxdgcnt) {                       /* pool empty? */
+    if (lp->rxdgb == NULL) {
+        lp->rxdgsz = lp->rxbsz;
+        lp->rxdgb = (char *)malloc (TMXR_DGRAM_BATCH * lp->rxdgsz);
+        lp->rxdglen = (int *)malloc (TMXR_DGRAM_BATCH * sizeof (*lp->rxdglen));
+        if ((lp->rxdgb == NULL) || (lp->rxdglen == NULL))
+            return -1;
+        }
+    lp->rxdgcnt = lp->rxdgidx = 0;
+    count = sim_read_sock_datagrams (lp->sock, lp->rxdgb, lp->rxdgsz, lp->rxdglen, TMXR_DGRAM_BATCH);
+    if (count <= 0)
+        return count;
+    lp->rxdgcnt = count;
+    lp->rxdgcalls = lp->rxdgcalls + 1;
+    lp->rxdgpkts = lp->rxdgpkts + count;
+    }
+len = lp->rxdglen[lp->rxdgidx];
+if (len > lp->rxdgsz)                                   /* truncated? */
+    len = lp->rxdgsz;
+if (len > length)
+    len = length;
+memcpy (buf, lp->rxdgb + lp->rxdgidx * lp->rxdgsz, len);
+lp->rxdgidx = lp->rxdgidx + 1;
+return len;
+}
+
 /* Read from a line.
 
    Up to "length" characters are read into the character buffer associated with
@@ -676,6 +720,8 @@ if (lp->loopback)
     return loop_read (lp, &(lp->rxb[i]), length);
 if (lp->serport)                                        /* serial port connection? */
     return sim_read_serial (lp->serport, &(lp->rxb[i]), length, &(lp->rbr[i]));
+else if (lp->datagram)                                  /* UDP connection */
+    return tmxr_read_datagram (lp, &(lp->rxb[i]), length);
 else                                                    /* Telnet connection */
     return sim_read_sock (lp->sock, &(lp->rxb[i]), length);
 }
@@ -3805,6 +3851,11 @@ for (i = 0; i < mp->lines; i++) {  /* loop thru conn */
     lp->rxb = NULL;
     free (lp->rbr);
     lp->rbr = NULL;
+    free (lp->rxdgb);
+    lp->rxdgb = NULL;
+    free (lp->rxdglen);
+    lp->rxdglen = NULL;
+    lp->rxdgcnt = lp->rxdgidx = 0;
     lp->modembits = 0;
     }
 
@@ -4350,6 +4401,8 @@ else {
         fprintf (st, " queued/total = %d/%d", tmxr_rqln (lp), lp->rxcnt);
     if (lp->rxpcnt)
         fprintf (st, " packets = %d", lp->rxpcnt);
+    if (lp->rxdgcalls)
+        fprintf (st, " datagrams/receive call = %.2f", (double)lp->rxdgpkts / lp->rxdgcalls);
     fprintf (st, "\n  output (%s)", (lp->xmte? enab: dsab));
     if (lp->txcnt || lp->txbpi)
         fprintf (st, " queued/total = %d/%d", tmxr_tqln (lp), lp->txcnt);
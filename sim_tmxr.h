@@ -61,6 +61,7 @@ typedef struct SERPORT *SERHANDLE;
 #define TMXR_V_VALID    15
 #define TMXR_VALID      (1 << TMXR_V_VALID)
 #define TMXR_MAXBUF     256                             /* buffer size */
+#define TMXR_DGRAM_BATCH 16                             /* datagrams received per system call */
 
 #define TMXR_DTR_DROP_TIME 500                          /* milliseconds to drop DTR for 'pseudo' modem control */
 #define TMXR_MODEM_RING_TIME 3                          /* seconds to wait for DTR for incoming connections */
@@ -188,6 +189,13 @@ struct tmln {
     t_bool              halfduplex;                     /* Line in half-duplex mode */
     t_bool              datagram;                       /* Line is datagram packet oriented */
     t_bool              packet;                         /* Line is packet oriented */
+    char                *rxdgb;                         /* rcv datagram pool */
+    int                 *rxdglen;                       /* rcv datagram pool lengths */
+    int32               rxdgsz;                         /* rcv datagram pool slot size */
+    int32               rxdgcnt;                        /* rcv datagrams in pool */
+    int32               rxdgidx;                        /* rcv next datagram in pool */
+    uint32              rxdgcalls;                      /* rcv datagram system calls */
+    uint32              rxdgpkts;                       /* rcv datagrams from those calls */
     int32               lpbpr;                          /* loopback buf remove */
     int32               lpbpi;                          /* loopback buf insert */
     int32               lpbcnt;                         /* loopback buf used count */